@@ -181,6 +181,8 @@ BENCHMARK(BM_test)->Unit(benchmark::kMillisecond);
 #include <set>
 
 #if defined(BENCHMARK_HAS_CXX11)
+#include <atomic>
+#include <functional>
 #include <type_traits>
 #include <initializer_list>
 #include <utility>
@@ -259,12 +261,20 @@ bool ReportUnrecognizedArguments(int argc, char** argv);
 //   by '--benchmark_output'. If '--benchmark_output' is not given the
 //  'file_reporter' is ignored.
 //
-// RETURNS: The number of matching benchmarks.
+// RETURNS: The number of matching benchmarks, or zero if none matched or
+// none was run because of an error, such as an invalid output, manifest or
+// sweep file or a failed preflight check with '--benchmark_preflight=fail'.
+// The error is reported on the error stream of 'console_reporter', and
+// RunSpecifiedBenchmarksFailed() tells the two apart.
 size_t RunSpecifiedBenchmarks();
 size_t RunSpecifiedBenchmarks(BenchmarkReporter* console_reporter);
 size_t RunSpecifiedBenchmarks(BenchmarkReporter* console_reporter,
                               BenchmarkReporter* file_reporter);
 
+// Returns true if the last call to RunSpecifiedBenchmarks() stopped because
+// of an error, rather than because no benchmark matched the filter.
+bool RunSpecifiedBenchmarksFailed();
+
 // If this routine is called, peak memory allocation past this point in the
 // benchmark is reported at the end of the benchmark report line. (It is
 // computed by running the benchmark once with a single iteration and a memory
@@ -334,6 +344,13 @@ inline BENCHMARK_ALWAYS_INLINE void DoNotOptimize(Tp const& value) {
 // FIXME Add ClobberMemory() for non-gnu and non-msvc compilers
 #endif
 
+// Return a timestamp to embed in a message sent to another thread, which
+// records the latency of the message with State::RecordLatencySince() when
+// it receives it. Stamps are read from the same clock as the real time, and
+// when it is the time stamp counter, corrected for the offsets between the
+// counters of the CPUs, which the first call measures. Only meaningful once
+// the benchmarks have started.
+int64_t Stamp();
 
 
 // This class is used for user-defined counters.
@@ -377,6 +394,18 @@ enum TimeUnit { kNanosecond, kMicrosecond, kMillisecond };
 // calculated automatically to the best fit.
 enum BigO { oNone, o1, oN, oNSquared, oNCubed, oLogN, oNLogN, oAuto, oLambda };
 
+// AllocatorKind is passed to a benchmark in order to select the allocator
+// which operator new and delete use while it runs. This requires linking
+// with the benchmark_allocator library. kDefaultAllocator uses the one
+// selected by --benchmark_allocator, if any.
+enum AllocatorKind {
+  kDefaultAllocator,
+  kSystemAllocator,
+  kThreadCachingAllocator,
+  kArenaAllocator,
+  kSlabAllocator
+};
+
 // BigOFunc is passed to a benchmark in order to specify the asymptotic
 // computational complexity for the benchmark.
 typedef double(BigOFunc)(int);
@@ -409,6 +438,54 @@ enum ReportMode
 };
 }  // namespace internal
 
+#ifdef BENCHMARK_HAS_CXX11
+// A pool of worker threads for benchmarks of parallel algorithms, shared by
+// all the benchmarks of the program, see State::executor(). Each worker runs
+// the tasks of its own queue, newest first, and steals the oldest task of
+// another worker's queue when its own is empty.
+class Executor {
+ public:
+  virtual ~Executor() {}
+
+  // The number of worker threads.
+  virtual int num_workers() const = 0;
+
+  // Queue 'task' to run on a worker. The tasks queued by a worker are queued
+  // on its own queue, the others on the queues of the workers in turn.
+  virtual void Submit(std::function<void()> task) = 0;
+
+  // Run one queued task on the calling thread, preferably one of its own if
+  // it is a worker. Returns false if no task was queued.
+  virtual bool RunQueuedTask() = 0;
+
+  // Call 'body(chunk_begin, chunk_end)' for consecutive chunks of at most
+  // 'grain' indices which cover [begin, end), on the workers and on the
+  // calling thread, and return once all the calls have returned.
+  void ParallelFor(int64_t begin, int64_t end, int64_t grain,
+                   const std::function<void(int64_t, int64_t)>& body);
+};
+
+// A group of tasks run on an Executor which are waited for together.
+class TaskGroup {
+ public:
+  explicit TaskGroup(Executor& executor) : executor_(executor), pending_(0) {}
+  ~TaskGroup() { Wait(); }
+
+  // Queue 'task' on the executor as a task of the group.
+  void Run(std::function<void()> task);
+
+  // Run queued tasks on the calling thread until all the tasks of the group
+  // have returned.
+  void Wait();
+
+ private:
+  Executor& executor_;
+  std::atomic<int> pending_;
+
+  BENCHMARK_DISALLOW_COPY_AND_ASSIGN(TaskGroup);
+};
+#endif  // BENCHMARK_HAS_CXX11
+
 // State is passed to a running Benchmark and contains state for the
 // benchmark to use.
 class State {
@@ -435,6 +512,8 @@ class State {
     }
     bool const res = (--total_iterations_ != 0);
     if (BENCHMARK_BUILTIN_EXPECT(!res, false)) {
+      total_iterations_ = ClaimIterations();
+      if (total_iterations_ != 0) return true;
       FinishKeepRunning();
     }
     return res;
@@ -497,6 +576,54 @@ class State {
   // reported values.
   void SetIterationTime(double seconds);
 
+  // Record the latency, in seconds, of one operation, e.g. a request made in
+  // this iteration. May be called any number of times per iteration. If any
+  // latency was recorded, the mean, the 50th, 90th, 99th and 99.9th
+  // percentiles and the maximum over all threads are reported in the
+  // "latency_*" counters, in seconds.
+  void RecordLatency(double seconds);
+
+  // As above, for the latencies of a kind of operation 'name', which are
+  // reported in the "<name>_latency_*" counters. They are not included in the
+  // "latency_*" counters.
+  void RecordLatency(const std::string& name, double seconds);
+
+  // Returns the index of the latencies named 'name' for this thread, to be
+  // passed to RecordLatency(index, seconds) instead of the name, which is
+  // then not looked up again for each latency. Call it outside of the
+  // benchmark loop.
+  int LatencyIndex(const std::string& name);
+  void RecordLatency(int index, double seconds);
+
+  // Record the latency from the time 'stamp' was taken by benchmark::Stamp(),
+  // possibly on another thread, until now, as RecordLatency() does.
+  void RecordLatencySince(int64_t stamp);
+  void RecordLatencySince(const std::string& name, int64_t stamp);
+
+  // Wait until the next request of this thread is due and return the time it
+  // was due as a stamp, to be passed to RecordLatencySince() once the request
+  // has been served. While Benchmark::FindCapacity() drives open-loop load,
+  // the requests of all threads are due at a fixed total rate, so a request
+  // delayed by an earlier one counts the delay in its latency. Otherwise, as
+  // in the ordinary runs of the benchmark, return Stamp() right away.
+  //
+  // REQUIRES: called inside the benchmark loop, at most once per iteration.
+  int64_t WaitForArrival();
+
+#ifdef BENCHMARK_HAS_CXX11
+  // Returns the pool of worker threads which the benchmark should run its
+  // parallel work on instead of starting threads of its own. It is started,
+  // with --benchmark_executor_workers threads pinned to the CPUs of
+  // --benchmark_executor_cpus, and warmed up the first time any benchmark
+  // asks for it, so ask for it before the benchmark loop. It is kept until
+  // the program exits. The fraction of the time of a run which the workers
+  // spent running tasks, and the tasks stolen and the time the workers were
+  // idle per iteration are reported in the "executor_utilization",
+  // "executor_steals" and "executor_idle" counters of the runs which ran
+  // tasks on it.
+  Executor& executor();
+#endif
+
   // Set the number of bytes processed by the current benchmark
   // execution.  This routine is typically called once at the end of a
   // throughput oriented benchmark.  If this routine is called with a
@@ -571,6 +698,13 @@ class State {
   bool started_;
   bool finished_;
   size_t total_iterations_;
+  // Whether the iterations are shared with the other threads, see
+  // Benchmark::SharedIterations().
+  bool shared_iterations_;
+  // The stamp ticks between the requests of the thread and when the next one
+  // is due, see WaitForArrival(). Zero if they are not paced.
+  int64_t arrival_interval_;
+  int64_t next_arrival_;
 
   std::vector<int> range_;
 
@@ -589,15 +723,28 @@ class State {
   // Number of threads concurrently executing the benchmark.
   const int threads;
   const size_t max_iterations;
+  // Seed for the random inputs of the benchmark, the same in all its threads.
+  // It differs between runs, is recorded by --benchmark_manifest and is
+  // restored by --benchmark_replay.
+  const uint64_t seed;
+
+  // Seed for the random inputs of this thread only, derived from seed and
+  // thread_index, e.g. for the own problem of each thread of a weakly scaled
+  // benchmark. It differs between the threads of a run and is restored with
+  // seed by --benchmark_replay.
+  uint64_t thread_seed() const;
 
   // TODO(EricWF) make me private
   State(size_t max_iters, const std::vector<int>& ranges, int thread_i,
         int n_threads, internal::ThreadTimer* timer,
-        internal::ThreadManager* manager);
+        internal::ThreadManager* manager, uint64_t run_seed = 0);
 
  private:
   void StartKeepRunning();
   void FinishKeepRunning();
+  // Returns the number of iterations claimed by the thread from those shared
+  // with the other threads, or 0 if none are left or they are not shared.
+  size_t ClaimIterations();
   internal::ThreadTimer* timer_;
   internal::ThreadManager* manager_;
   BENCHMARK_DISALLOW_COPY_AND_ASSIGN(State);
@@ -617,7 +764,10 @@ struct State::StateIterator {
 
   BENCHMARK_ALWAYS_INLINE
   explicit StateIterator(State* st)
-      : cached_(st->error_occurred_ ? 0 : st->max_iterations), parent_(st) {}
+      : cached_(st->error_occurred_ || st->shared_iterations_
+                    ? 0
+                    : st->max_iterations),
+        parent_(st) {}
 
  public:
   BENCHMARK_ALWAYS_INLINE
@@ -631,8 +781,10 @@ struct State::StateIterator {
   }
 
   BENCHMARK_ALWAYS_INLINE
-  bool operator!=(StateIterator const&) const {
+  bool operator!=(StateIterator const&) {
     if (BENCHMARK_BUILTIN_EXPECT(cached_ != 0, true)) return true;
+    cached_ = parent_->ClaimIterations();
+    if (cached_ != 0) return true;
     parent_->FinishKeepRunning();
     return false;
   }
@@ -744,6 +896,23 @@ class Benchmark {
   // `--benchmark_min_time=N` or `MinTime(...)` should be used instead.
   Benchmark* Iterations(size_t n);
 
+  // After the benchmark has been measured, run it once more for exactly
+  // 'iterations' iterations and count the distinct memory pages written
+  // (and, where the kernel permits, accessed) by the process during the
+  // benchmark loop. The result is reported per iteration in the 'ws_written'
+  // and 'ws_accessed' counters. Only supported on Linux.
+  // REQUIRES: 'iterations > 0'
+  Benchmark* MeasureWorkingSet(size_t iterations = 1);
+
+  // After the benchmark has been measured, run it once more for exactly
+  // 'iterations' iterations and count the calls made by the benchmark
+  // threads during their loops to each function compiled with
+  // -finstrument-functions. The total and the functions with the most calls
+  // are reported per iteration in the 'calls' and 'calls:<function>'
+  // counters. Requires linking with the benchmark_instrument library.
+  // REQUIRES: 'iterations > 0'
+  Benchmark* CountCalls(size_t iterations = 1);
+
   // Specify the amount of times to repeat this benchmark. This option overrides
   // the `benchmark_repetitions` flag.
   // REQUIRES: `n > 0`
@@ -770,6 +939,20 @@ class Benchmark {
   // or MB/second values.
   Benchmark* UseManualTime();
 
+  // If the benchmarked code runs threads of its own, e.g. a parallel sort or
+  // an asynchronous logger, the CPU time of the benchmark threads alone
+  // underestimates its cost. If this method is called the CPU time of the
+  // whole process is measured instead, and the number of threads started
+  // by the process during the run, besides the benchmark threads, is
+  // reported in the "extra_threads" counter where it can be determined.
+  Benchmark* MeasureProcessCPUTime();
+
+  // Dispatch operator new and delete to the allocator 'kind' while the
+  // benchmark runs, and report the number of allocations and of bytes
+  // allocated per iteration. Has no effect unless the program is linked with
+  // the benchmark_allocator library.
+  Benchmark* Allocator(AllocatorKind kind);
+
   // Set the asymptotic computational complexity for the benchmark. If called
   // the asymptotic computational complexity will be shown on the output.
   Benchmark* Complexity(BigO complexity = benchmark::oAuto);
@@ -778,6 +961,23 @@ class Benchmark {
   // the asymptotic computational complexity will be shown on the output.
   Benchmark* Complexity(BigOFunc* complexity);
 
+  // Also fit the complexity separately over segments of the range of N, each
+  // reported as a BigO and an RMS entry with the range of N in its name. If
+  // 'bytes_per_n' is positive, the working set of the benchmark is taken to
+  // be 'bytes_per_n' * N bytes and the segments are those where it fits in
+  // each level of cache, and where it does not fit in any, which are used as
+  // labels. Otherwise the segments are placed where the complexity changes
+  // most, if anywhere. Has no effect without Complexity().
+  Benchmark* PiecewiseComplexity(double bytes_per_n = 0);
+
+  // After the last instance of this benchmark has run, fit a log-linear
+  // main effects model of its time over its arguments and thread counts,
+  // and report the fraction of the variance explained by each one, by their
+  // interactions and by the noise between repetitions, as well as the best
+  // configuration with the 95% confidence interval of its time, in a
+  // "<name>_Sensitivity" entry.
+  Benchmark* AnalyzeSensitivity();
+
   // Add this statistics to be computed over all the values of benchmark run
   Benchmark* ComputeStatistics(std::string name, StatisticsFunc* statistics);
 
@@ -811,8 +1011,75 @@ class Benchmark {
   // Equivalent to ThreadRange(NumCPUs(), NumCPUs())
   Benchmark* ThreadPerCpu();
 
+  // Declare that the benchmark is weakly scaled over its thread counts: each
+  // thread works on its own problem of the full size given by the arguments,
+  // e.g. on its own buffer of state.range(0) bytes and seeded from
+  // state.thread_seed(), instead of sharing one problem. The efficiency of
+  // each thread count, i.e. the real time per iteration of a thread at 1
+  // thread divided by the one at this thread count, is reported in the
+  // "weak_scaling_efficiency" counter. The 1-thread run always comes first,
+  // and is added to the thread counts if they do not include it.
+  Benchmark* WeakScaling();
+
+  // Share the iterations of a run between its threads instead of running
+  // the same number on each: the threads claim them in chunks until all are
+  // claimed, so that a fast thread is not left waiting for a slow one at the
+  // end of the run. The fewest and most iterations run by a thread are
+  // reported in the "thread_iterations_min" and "thread_iterations_max"
+  // counters. Within the benchmark loop State::iterations() is only exact
+  // once the loop has finished.
+  Benchmark* SharedIterations();
+
+  // Search for the highest rate of requests per second at which the fraction
+  // 'percentile' of the requests, e.g. 0.99, are served within
+  // 'target_latency' seconds. After the ordinary runs, the benchmark is run
+  // with its requests paced by State::WaitForArrival(), starting at a
+  // quarter of the rate at which the ordinary runs completed iterations and
+  // doubling the rate until the target is missed, or halving it until it is
+  // met, then bisecting between the last rate which met it and the first
+  // which did not. A probe is repeated with more requests until a 95%
+  // confidence bound decides it, for at most ten times the minimum time per
+  // attempt. Each probe is
+  // reported as "<name>/rate:<rate>", with its latency counters and the
+  // "offered_rate" and "slo_met" counters, and the highest rate which met
+  // the target in the "capacity" counter of "<name>_capacity". The benchmark
+  // must record the latency of each request:
+  //   for (auto _ : state) {
+  //     const int64_t arrival = state.WaitForArrival();
+  //     Serve(request);
+  //     state.RecordLatencySince(arrival);
+  //   }
+  Benchmark* FindCapacity(double percentile, double target_latency);
+
+  // Compare each instance of the benchmark to the instance of the benchmark
+  // named 'baseline' with the same arguments and number of threads, which is
+  // then run right before it. The baseline time per iteration divided by the
+  // one of the instance is reported in the "speedup" counter, and if both
+  // process items, or else bytes, the ratio of their rates is reported in the
+  // "throughput_ratio" counter. With repetitions, the mean aggregate also
+  // reports the half-width of the 95% confidence interval of each ratio in
+  // the "speedup_ci" and "throughput_ratio_ci" counters. The baseline
+  // reports ratios of 1. Both must be timed with the same clock.
+  Benchmark* RelativeTo(const std::string& baseline);
+
+  // Report the time taken by the hooks below, in seconds, in the
+  // "setup_once", "teardown_once", "setup_thread" and "teardown_thread"
+  // counters. The per-thread ones are averaged over the threads.
+  Benchmark* ReportHookTimes();
+
   virtual void Run(State& state) = 0;
 
+  // Hooks run outside of the measurement. SetUpOnce() and TearDownOnce() run
+  // on the thread which starts the benchmark threads, once for each instance
+  // of the benchmark: before its first run, including the runs which search
+  // for the iteration count, and after its last; 'state' may not be
+  // iterated. SetUpThread() and TearDownThread() run on each benchmark thread
+  // before and after each call to Run(). See Fixture and ReportHookTimes().
+  virtual void SetUpOnce(State& state);
+  virtual void TearDownOnce(State& state);
+  virtual void SetUpThread(State& state);
+  virtual void TearDownThread(State& state);
+
   // Used inside the benchmark implementation
   struct Instance;
 
@@ -836,13 +1103,26 @@ class Benchmark {
   int range_multiplier_;
   double min_time_;
   size_t iterations_;
+  size_t working_set_iterations_;
+  size_t call_count_iterations_;
   int repetitions_;
   bool use_real_time_;
   bool use_manual_time_;
+  bool measure_process_cpu_time_;
+  AllocatorKind allocator_;
   BigO complexity_;
   BigOFunc* complexity_lambda_;
+  bool piecewise_complexity_;
+  double complexity_bytes_per_n_;
+  bool analyze_sensitivity_;
   std::vector<Statistics> statistics_;
   std::vector<int> thread_counts_;
+  bool weak_scaling_;
+  bool shared_iterations_;
+  double capacity_percentile_;  // Zero unless FindCapacity() was called.
+  double capacity_target_;
+  std::string relative_to_;
+  bool report_hook_times_;
 
   Benchmark& operator=(Benchmark const&);
 };
@@ -948,6 +1228,18 @@ class Fixture : public internal::Benchmark {
   virtual void SetUp(State& st) { SetUp(const_cast<const State&>(st)); }
   virtual void TearDown(State& st) { TearDown(const_cast<const State&>(st)); }
 
+  // SetUp() and TearDown() run on every thread against this same object.
+  // Shared state is better set up in SetUpOnce() and TearDownOnce(), which
+  // run once for each instance before its threads first start and after they
+  // last finish, and per-thread state in SetUpThread() and TearDownThread(),
+  // which run on the thread that owns it, e.g. to allocate its memory on the
+  // right NUMA node:
+  //
+  //   void SetUpOnce(benchmark::State& st) { bufs_.resize(st.threads); }
+  //   void SetUpThread(benchmark::State& st) {
+  //     bufs_[st.thread_index].assign(st.range(0), 0);
+  //   }
+
  protected:
   virtual void BenchmarkCase(State&) = 0;
 };
@@ -1146,6 +1438,7 @@ class Fixture : public internal::Benchmark {
     ::benchmark::Initialize(&argc, argv);  \
     if (::benchmark::ReportUnrecognizedArguments(argc, argv)) return 1; \
     ::benchmark::RunSpecifiedBenchmarks(); \
+    if (::benchmark::RunSpecifiedBenchmarksFailed()) return 1; \
   }                                        \
   int main(int, char**)
 
@@ -1163,10 +1456,20 @@ struct CPUInfo {
     int num_sharing;
   };
 
+  // A kind of core of a hybrid CPU, e.g. the performance and the efficiency
+  // cores, and the CPUs which have it.
+  struct CoreType {
+    std::string name;
+    std::vector<int> cpus;
+  };
+
   int num_cpus;
   double cycles_per_second;
   std::vector<CacheInfo> caches;
   bool scaling_enabled;
+  // The core types, fastest first. Empty if all cores are of the same type
+  // or the types cannot be determined on this system.
+  std::vector<CoreType> core_types;
 
   static const CPUInfo& Get();
 
@@ -1175,6 +1478,42 @@ struct CPUInfo {
   BENCHMARK_DISALLOW_COPY_AND_ASSIGN(CPUInfo);
 };
 
+// Information about the clock used to measure real time. The library picks
+// the cheapest trustworthy timing backend when this is first requested.
+struct TimerInfo {
+  // The kernel clocksource, e.g. "tsc", "hpet" or "kvm-clock". Empty if it is
+  // not known.
+  std::string clocksource;
+  // The backend used to measure real time: "chrono" for the steady clock of
+  // the standard library, or "tsc" for the invariant time stamp counter.
+  std::string backend;
+  // The cost of reading the chosen backend once, in seconds.
+  double call_overhead;
+
+  static const TimerInfo& Get();
+
+ private:
+  TimerInfo();
+  BENCHMARK_DISALLOW_COPY_AND_ASSIGN(TimerInfo);
+};
+
+// The result of checking one property of the host against the policy of
+// --benchmark_preflight, e.g. that the CPU frequency governor is
+// "performance".
+struct PreflightCheck {
+  PreflightCheck() : ok(true) {}
+
+  // The property checked: "governor", "turbo", "smt", "aslr", "thp", "swap",
+  // "load_average", "cgroup_quota", "clocksource" or "free_memory".
+  std::string name;
+  // Its observed value, or "unknown" if it could not be read.
+  std::string value;
+  // The values the policy allows.
+  std::string expected;
+  // Whether the value is allowed. Unknown values are.
+  bool ok;
+};
+
 // Interface for custom benchmark result printers.
 // By default, benchmark reports are printed to stdout. However an application
 // can control the destination of the reports by calling
@@ -1184,8 +1523,25 @@ class BenchmarkReporter {
  public:
   struct Context {
     CPUInfo const& cpu_info;
+    TimerInfo const& timer_info;
     // The number of chars in the longest benchmark name.
     size_t name_field_width;
+    // The metric the benchmarks are compared by: either "time" or the name of
+    // a perf event, which is then also reported as a counter.
+    std::string primary_metric;
+    // Whether the runs are checked for suspicious results, see
+    // Run::suspicious.
+    bool check_suspicious;
+    // The preflight policy, "warn" or "fail", or empty if the host was not
+    // checked, and the results of the checks.
+    std::string preflight;
+    std::vector<PreflightCheck> preflight_checks;
+    // The names of the counters which the library may add to the runs, as
+    // known from the options of the benchmarks before they run. It does not
+    // include the counters named after what a run found, e.g. the functions
+    // counted by CountCalls(), nor those of the latencies recorded with
+    // State::RecordLatency() outside of FindCapacity().
+    std::set<std::string> library_counters;
 
     Context();
   };
@@ -1211,6 +1567,12 @@ class BenchmarkReporter {
     std::string report_label;  // Empty if not set by benchmark.
     bool error_occurred;
     std::string error_message;
+    // Why the results do not seem to measure the work of the benchmark, or
+    // empty if they do or were not checked.
+    std::string suspicious;
+    // The core type the run was pinned to, see --benchmark_core_types, or
+    // empty if it was not.
+    std::string core_type;
 
     int64_t iterations;
     TimeUnit time_unit;
@@ -1319,7 +1681,7 @@ public:
   };
   explicit ConsoleReporter(OutputOptions opts_ = OO_Defaults)
       : output_options_(opts_), name_field_width_(0),
-        prev_counters_(), printed_header_(false) {}
+        prev_counters_(), printed_header_(false), primary_metric_() {}
 
   virtual bool ReportContext(const Context& context);
   virtual void ReportRuns(const std::vector<Run>& reports);
@@ -1332,6 +1694,7 @@ public:
   size_t name_field_width_;
   UserCounters prev_counters_;
   bool printed_header_;
+  std::string primary_metric_;
 };
 
 class JSONReporter : public BenchmarkReporter {
@@ -1349,7 +1712,7 @@ class JSONReporter : public BenchmarkReporter {
 
 class CSVReporter : public BenchmarkReporter {
  public:
-  CSVReporter() : printed_header_(false) {}
+  CSVReporter() : printed_header_(false), check_suspicious_(false) {}
   virtual bool ReportContext(const Context& context);
   virtual void ReportRuns(const std::vector<Run>& reports);
 
@@ -1357,6 +1720,7 @@ class CSVReporter : public BenchmarkReporter {
   void PrintRunData(const Run& report);
 
   bool printed_header_;
+  bool check_suspicious_;
   std::set< std::string > user_counter_names_;
 };
 
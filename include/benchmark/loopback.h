@@ -0,0 +1,125 @@
+// Copyright 2018 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// A fixture for benchmarking request/response exchanges over a loopback
+// connection, optionally shaped to add latency, jitter and a bandwidth limit.
+// Everything runs inside the benchmark process. Only supported on POSIX
+// systems.
+
+/* Example usage:
+class EchoRpc : public benchmark::LoopbackFixture {
+ public:
+  EchoRpc() : LoopbackFixture(benchmark::kTcpSocket, Shape()) {}
+
+  static benchmark::LinkShape Shape() {
+    benchmark::LinkShape shape;
+    shape.latency = 50e-6;
+    shape.bandwidth = 1e9 / 8;  // 1 Gbit/s
+    return shape;
+  }
+};
+
+BENCHMARK_DEFINE_F(EchoRpc, Call)(benchmark::State& st) {
+  std::string request(st.range(0), 'x'), response;
+  for (auto _ : st) {
+    if (!Call(st, request, &response)) break;
+  }
+  st.SetItemsProcessed(st.iterations());
+}
+// One connection per thread.
+BENCHMARK_REGISTER_F(EchoRpc, Call)->Arg(128)->ThreadRange(1, 8)
+    ->UseRealTime();
+*/
+
+#ifndef BENCHMARK_LOOPBACK_H_
+#define BENCHMARK_LOOPBACK_H_
+
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+namespace benchmark {
+
+// How the client end of a loopback connection reaches the server end.
+enum LoopbackTransport {
+  kSocketPair,  // A pair of connected Unix-domain sockets.
+  kUnixSocket,  // A Unix-domain socket listening on a temporary path.
+  kTcpSocket    // A TCP socket listening on 127.0.0.1.
+};
+
+// Impairments injected between the client and the server. If all of them are
+// zero the client talks to the server directly, otherwise a shaper thread
+// forwards the data of each connection in both directions.
+struct LinkShape {
+  LinkShape() : latency(0), jitter(0), bandwidth(0) {}
+
+  double latency;    // One-way delay, in seconds.
+  double jitter;     // Maximum extra delay, uniformly distributed, in seconds.
+  double bandwidth;  // Bytes per second in each direction. 0 means no limit.
+};
+
+// Connects each benchmark thread to a server over its own loopback
+// connection, so that a thread sweep measures the throughput per connection
+// count. The server runs a thread per connection which answers each request
+// with HandleRequest().
+//
+// Derived fixtures which override the SetUp/TearDown hooks of Fixture must
+// call the ones of LoopbackFixture.
+class LoopbackFixture : public Fixture {
+ public:
+  explicit LoopbackFixture(LoopbackTransport transport = kSocketPair,
+                           LinkShape shape = LinkShape());
+  virtual ~LoopbackFixture();
+
+  virtual void SetUpOnce(State& st);
+  virtual void TearDownOnce(State& st);
+  virtual void SetUpThread(State& st);
+  virtual void TearDownThread(State& st);
+
+ protected:
+  // Send 'request' to the server on the connection of the calling thread and
+  // wait for the response. The round-trip time is recorded with
+  // State::RecordLatency(). On failure SkipWithError() is called and false is
+  // returned; the caller should then leave the benchmark loop.
+  bool Call(State& st, const std::string& request, std::string* response);
+
+  // Called on the server thread of a connection to answer 'request'. With
+  // several connections it is called concurrently. The default
+  // implementation echoes the request.
+  virtual void HandleRequest(const std::string& request,
+                             std::string* response);
+
+  // The client end of the connection of the calling thread, for benchmarks
+  // using a protocol of their own. Requests sent by Call() are framed with a
+  // 4 byte little-endian length.
+  int client_fd(const State& st) const;
+
+ private:
+  struct Connection;
+  struct Listener;
+
+  void ServeConnection(Connection* conn);
+
+  LoopbackTransport transport_;
+  LinkShape shape_;
+  Listener* listener_;
+  std::vector<Connection*> connections_;
+
+  BENCHMARK_DISALLOW_COPY_AND_ASSIGN(LoopbackFixture);
+};
+
+}  // end namespace benchmark
+
+#endif  // BENCHMARK_LOOPBACK_H_
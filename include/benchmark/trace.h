@@ -0,0 +1,161 @@
+// Copyright 2018 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Support for replaying recorded operation traces through user-supplied
+// handlers.
+
+/* Example usage:
+class KvReplay : public benchmark::TraceReplayFixture {
+ public:
+  KvReplay() : TraceReplayFixture("kv.trace", benchmark::kReplayOpenLoop) {
+    Handle("get", [this](const benchmark::TraceRecord& r) {
+      store_.Get(r.key);
+    });
+    Handle("put", [this](const benchmark::TraceRecord& r) {
+      store_.Put(r.key, r.size);
+    });
+  }
+
+  Store store_;
+};
+
+BENCHMARK_DEFINE_F(KvReplay, Production)(benchmark::State& st) { Replay(st); }
+// The trace is partitioned between the threads by key.
+BENCHMARK_REGISTER_F(KvReplay, Production)->ThreadRange(1, 8)->UseRealTime();
+*/
+
+#ifndef BENCHMARK_TRACE_H_
+#define BENCHMARK_TRACE_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+namespace benchmark {
+
+// One operation of a trace. Binary traces are used in place on little-endian
+// hosts, so this is also the layout of the records in the file, in
+// little-endian byte order.
+struct TraceRecord {
+  uint64_t timestamp_ns;  // When the operation was issued.
+  uint64_t key;
+  uint64_t size;
+  uint32_t op;  // Index of the name of the operation in Trace::op_names().
+  uint32_t reserved;
+};
+
+// A trace of operations, sorted by timestamp. Two formats are supported:
+//
+// * CSV, with one "timestamp,op,key,size" line per operation and an optional
+//   header line. The timestamp is in seconds, the op is a name and the key is
+//   either an unsigned integer or a string, which is then hashed.
+//
+// * Binary: the magic "BMTRACE1", the uint32 number of operation names, four
+//   bytes of padding, the uint64 number of records, the NUL-terminated
+//   operation names padded with NULs to a multiple of 8 bytes, then the
+//   TraceRecords.
+//
+// The file is memory-mapped where possible; binary traces are not copied
+// unless the host is big-endian.
+class Trace {
+ public:
+  // Returns nullptr and sets 'error' if 'path' cannot be loaded.
+  static Trace* Load(const std::string& path, std::string* error);
+  ~Trace();
+
+  size_t size() const { return size_; }
+  const TraceRecord& operator[](size_t i) const { return records_[i]; }
+  const std::vector<std::string>& op_names() const { return op_names_; }
+
+ private:
+  Trace();
+
+  bool Map(const std::string& path, std::string* error);
+  bool ParseBinary(std::string* error);
+  bool ParseCSV(std::string* error);
+
+  const char* data_;  // The contents of the file.
+  size_t data_size_;
+  bool mapped_;  // Whether 'data_' was memory-mapped or allocated.
+  const TraceRecord* records_;
+  size_t size_;
+  // The records of a CSV trace, or of a binary one on a big-endian host.
+  std::vector<TraceRecord> parsed_;
+  std::vector<std::string> op_names_;
+
+  BENCHMARK_DISALLOW_COPY_AND_ASSIGN(Trace);
+};
+
+enum ReplayMode {
+  // Issue each operation as soon as the previous one has completed.
+  kReplayAsFastAsPossible,
+  // Issue each operation at its recorded time relative to the start of the
+  // trace, whether or not the previous ones have completed. Latencies are
+  // measured from that time, so that they include any queueing delay.
+  kReplayOpenLoop
+};
+
+// A fixture replaying a trace. Each iteration of Replay() issues one
+// operation through the handler registered for it. With several threads the
+// trace is partitioned by a hash of the key, so that each key is handled by a
+// single thread, in order. The trace is restarted as needed to run the
+// requested number of iterations.
+//
+// The trace is loaded and checked against the handlers by SetUpOnce() and
+// partitioned by SetUpThread(), so a derived fixture which overrides these
+// hooks, or TearDownOnce(), must call the ones of TraceReplayFixture before
+// running its own.
+class TraceReplayFixture : public Fixture {
+ public:
+  typedef std::function<void(const TraceRecord&)> Handler;
+
+  explicit TraceReplayFixture(const std::string& path,
+                              ReplayMode mode = kReplayAsFastAsPossible);
+  virtual ~TraceReplayFixture();
+
+  // Register 'handler' for the operations named 'op'. Every operation in the
+  // trace must have a handler when the benchmark runs.
+  void Handle(const std::string& op, Handler handler);
+
+  virtual void SetUpOnce(State& st);
+  virtual void SetUpThread(State& st);
+  virtual void TearDownOnce(State& st);
+
+ protected:
+  // Replay the trace in the benchmark loop. The number of operations is
+  // reported as the items processed, the latency of each one with
+  // State::RecordLatency(), both overall and per operation name.
+  void Replay(State& st);
+
+  // The trace, once loaded by SetUpOnce().
+  const Trace* trace() const { return trace_; }
+
+ private:
+  const std::string path_;
+  const ReplayMode mode_;
+  std::vector<std::pair<std::string, Handler> > handlers_;
+  Trace* trace_;
+  // Indexed by the op of a record.
+  std::vector<const Handler*> op_handlers_;
+  // Indices of the records replayed by each thread.
+  std::vector<std::vector<size_t> > partitions_;
+
+  BENCHMARK_DISALLOW_COPY_AND_ASSIGN(TraceReplayFixture);
+};
+
+}  // end namespace benchmark
+
+#endif  // BENCHMARK_TRACE_H_
@@ -0,0 +1,342 @@
+// Copyright 2018 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "allocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "check.h"
+#include "mutex.h"
+
+namespace benchmark {
+namespace internal {
+
+namespace {
+
+// Every block starts with a header telling which allocator it belongs to.
+// While a block is free, 'owner' links it to the next free block of its
+// size class.
+struct alignas(16) BlockHeader {
+  void* owner;  // The arena chunk of the block, if any.
+  uint32_t kind;
+  uint32_t size_class;
+};
+
+// The thread caching and slab allocators round sizes up to a size class:
+// multiples of 16 bytes up to 256, then powers of 2 up to 32K. Larger blocks
+// always come from the system allocator.
+const std::size_t kNumSmallClasses = 16;
+const std::size_t kNumSizeClasses = kNumSmallClasses + 7;
+const std::size_t kMaxClassSize = 32 * 1024;
+
+// The most blocks of each size class a thread caches.
+const uint32_t kMaxCachedBlocks = 256;
+
+// The slab allocator carves blocks out of slabs of at least this size, which
+// are never returned to the system.
+const std::size_t kSlabSize = 64 * 1024;
+
+// The arena allocator carves blocks out of chunks of this size, which are
+// returned to the system once all their blocks are freed. Larger blocks come
+// from the system allocator.
+const std::size_t kArenaChunkSize = 1024 * 1024;
+const std::size_t kMaxArenaBlock = kArenaChunkSize / 16;
+
+std::size_t SizeClass(std::size_t size) {
+  if (size <= 256) return size == 0 ? 0 : (size - 1) / 16;
+  std::size_t size_class = kNumSmallClasses;
+  for (std::size_t class_size = 512; class_size < size; class_size *= 2) {
+    ++size_class;
+  }
+  return size_class;
+}
+
+std::size_t ClassSize(std::size_t size_class) {
+  if (size_class < kNumSmallClasses) return (size_class + 1) * 16;
+  return std::size_t(512) << (size_class - kNumSmallClasses);
+}
+
+struct alignas(16) ArenaChunk {
+  // The number of live blocks, plus one while the chunk is being carved.
+  std::atomic<int64_t> live;
+};
+
+struct SlabClass {
+  Mutex mutex;
+  BlockHeader* free_list;
+  char* next;
+  char* end;
+};
+
+// The state of a thread. It is trivial so that it can be used before the
+// thread_local objects with constructors are, and after they are destroyed.
+struct ThreadState {
+  BlockHeader* cache[kNumSizeClasses];
+  uint32_t cached[kNumSizeClasses];
+  ArenaChunk* chunk;
+  std::size_t chunk_used;
+  int64_t allocations;
+  int64_t allocated_bytes;
+  bool flush_registered;
+  bool exited;
+};
+
+thread_local ThreadState thread_state;
+
+std::atomic<bool> dispatched(false);
+std::atomic<int> current_kind(kSystemAllocator);
+SlabClass slab_classes[kNumSizeClasses];
+
+void ReleaseChunk(ArenaChunk* chunk) {
+  if (chunk->live.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    chunk->~ArenaChunk();
+    std::free(chunk);
+  }
+}
+
+// Returns the cached blocks of the thread to the system, and its arena chunk
+// once its blocks are freed, when the thread exits.
+struct ThreadExitFlush {
+  ~ThreadExitFlush() {
+    ThreadState& state = thread_state;
+    state.exited = true;
+    for (std::size_t i = 0; i < kNumSizeClasses; ++i) {
+      while (state.cache[i] != nullptr) {
+        BlockHeader* block = state.cache[i];
+        state.cache[i] = static_cast<BlockHeader*>(block->owner);
+        std::free(block);
+      }
+      state.cached[i] = 0;
+    }
+    if (state.chunk != nullptr) {
+      ReleaseChunk(state.chunk);
+      state.chunk = nullptr;
+    }
+  }
+};
+
+void RegisterThreadExitFlush() {
+  if (thread_state.flush_registered) return;
+  thread_state.flush_registered = true;
+  static thread_local ThreadExitFlush flush;
+  (void)flush;
+}
+
+BlockHeader* SystemAllocate(std::size_t size) {
+  if (size > static_cast<std::size_t>(-1) - sizeof(BlockHeader)) {
+    return nullptr;
+  }
+  void* memory = std::malloc(sizeof(BlockHeader) + size);
+  if (memory == nullptr) return nullptr;
+  BlockHeader* block = new (memory) BlockHeader;
+  block->owner = nullptr;
+  block->kind = kSystemAllocator;
+  block->size_class = 0;
+  return block;
+}
+
+BlockHeader* ThreadCachingAllocate(std::size_t size) {
+  const std::size_t size_class = SizeClass(size);
+  ThreadState& state = thread_state;
+  BlockHeader* block = state.cache[size_class];
+  if (block != nullptr) {
+    state.cache[size_class] = static_cast<BlockHeader*>(block->owner);
+    --state.cached[size_class];
+  } else {
+    block = SystemAllocate(ClassSize(size_class));
+    if (block == nullptr) return nullptr;
+    RegisterThreadExitFlush();
+  }
+  block->owner = nullptr;
+  block->kind = kThreadCachingAllocator;
+  block->size_class = static_cast<uint32_t>(size_class);
+  return block;
+}
+
+void ThreadCachingFree(BlockHeader* block) {
+  ThreadState& state = thread_state;
+  const uint32_t size_class = block->size_class;
+  if (state.exited || state.cached[size_class] >= kMaxCachedBlocks) {
+    std::free(block);
+    return;
+  }
+  block->owner = state.cache[size_class];
+  state.cache[size_class] = block;
+  ++state.cached[size_class];
+}
+
+BlockHeader* ArenaAllocate(std::size_t size) {
+  ThreadState& state = thread_state;
+  const std::size_t needed = sizeof(BlockHeader) + (size + 15) / 16 * 16;
+  if (state.chunk == nullptr ||
+      state.chunk_used + needed > kArenaChunkSize) {
+    if (state.chunk != nullptr) ReleaseChunk(state.chunk);
+    state.chunk = nullptr;
+    void* memory = std::malloc(kArenaChunkSize);
+    if (memory == nullptr) return nullptr;
+    state.chunk = new (memory) ArenaChunk;
+    state.chunk->live.store(1, std::memory_order_relaxed);
+    state.chunk_used = sizeof(ArenaChunk);
+    RegisterThreadExitFlush();
+  }
+  BlockHeader* block = new (reinterpret_cast<char*>(state.chunk) +
+                            state.chunk_used) BlockHeader;
+  state.chunk_used += needed;
+  state.chunk->live.fetch_add(1, std::memory_order_relaxed);
+  block->owner = state.chunk;
+  block->kind = kArenaAllocator;
+  block->size_class = 0;
+  return block;
+}
+
+BlockHeader* SlabAllocate(std::size_t size) {
+  const std::size_t size_class = SizeClass(size);
+  const std::size_t block_size = sizeof(BlockHeader) + ClassSize(size_class);
+  SlabClass& slab = slab_classes[size_class];
+  BlockHeader* block;
+  {
+    MutexLock l(slab.mutex);
+    if (slab.free_list != nullptr) {
+      block = slab.free_list;
+      slab.free_list = static_cast<BlockHeader*>(block->owner);
+    } else {
+      if (slab.next == nullptr ||
+          static_cast<std::size_t>(slab.end - slab.next) < block_size) {
+        const std::size_t slab_size = std::max(kSlabSize, 4 * block_size);
+        slab.next = static_cast<char*>(std::malloc(slab_size));
+        if (slab.next == nullptr) return nullptr;
+        slab.end = slab.next + slab_size;
+      }
+      block = new (slab.next) BlockHeader;
+      slab.next += block_size;
+    }
+  }
+  block->owner = nullptr;
+  block->kind = kSlabAllocator;
+  block->size_class = static_cast<uint32_t>(size_class);
+  return block;
+}
+
+void SlabFree(BlockHeader* block) {
+  SlabClass& slab = slab_classes[block->size_class];
+  MutexLock l(slab.mutex);
+  block->owner = slab.free_list;
+  slab.free_list = block;
+}
+
+}  // end namespace
+
+void RegisterAllocatorDispatch() {
+  dispatched.store(true, std::memory_order_relaxed);
+}
+
+bool IsAllocatorDispatched() {
+  return dispatched.load(std::memory_order_relaxed);
+}
+
+void SetAllocator(AllocatorKind kind) {
+  CHECK_NE(kind, kDefaultAllocator);
+  current_kind.store(kind, std::memory_order_release);
+}
+
+void* DispatchAllocate(std::size_t size) {
+  ThreadState& state = thread_state;
+  ++state.allocations;
+  state.allocated_bytes += static_cast<int64_t>(size);
+
+  int kind = current_kind.load(std::memory_order_acquire);
+  // Threads which are exiting can no longer cache nor carve blocks.
+  if (state.exited) kind = kSystemAllocator;
+  BlockHeader* block = nullptr;
+  switch (kind) {
+    case kThreadCachingAllocator:
+    case kSlabAllocator:
+      if (size > kMaxClassSize) {
+        block = SystemAllocate(size);
+      } else if (kind == kThreadCachingAllocator) {
+        block = ThreadCachingAllocate(size);
+      } else {
+        block = SlabAllocate(size);
+      }
+      break;
+    case kArenaAllocator:
+      block = size > kMaxArenaBlock ? SystemAllocate(size)
+                                    : ArenaAllocate(size);
+      break;
+    default:
+      block = SystemAllocate(size);
+      break;
+  }
+  return block == nullptr ? nullptr : block + 1;
+}
+
+void DispatchFree(void* ptr) {
+  if (ptr == nullptr) return;
+  BlockHeader* block = static_cast<BlockHeader*>(ptr) - 1;
+  switch (block->kind) {
+    case kThreadCachingAllocator:
+      ThreadCachingFree(block);
+      break;
+    case kArenaAllocator:
+      ReleaseChunk(static_cast<ArenaChunk*>(block->owner));
+      break;
+    case kSlabAllocator:
+      SlabFree(block);
+      break;
+    default:
+      std::free(block);
+      break;
+  }
+}
+
+AllocationCounts ThreadAllocationCounts() {
+  AllocationCounts counts;
+  counts.count = thread_state.allocations;
+  counts.bytes = thread_state.allocated_bytes;
+  return counts;
+}
+
+bool ParseAllocatorKind(const std::string& name, AllocatorKind* kind) {
+  static const AllocatorKind kinds[] = {kSystemAllocator,
+                                        kThreadCachingAllocator,
+                                        kArenaAllocator, kSlabAllocator};
+  for (AllocatorKind k : kinds) {
+    if (name == AllocatorKindName(k)) {
+      *kind = k;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char* AllocatorKindName(AllocatorKind kind) {
+  switch (kind) {
+    case kSystemAllocator:
+      return "system";
+    case kThreadCachingAllocator:
+      return "thread_cache";
+    case kArenaAllocator:
+      return "arena";
+    case kSlabAllocator:
+      return "slab";
+    default:
+      return "default";
+  }
+}
+
+}  // end namespace internal
+}  // end namespace benchmark
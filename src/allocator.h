@@ -0,0 +1,51 @@
+#ifndef BENCHMARK_ALLOCATOR_H_
+#define BENCHMARK_ALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "benchmark/benchmark.h"
+
+namespace benchmark {
+namespace internal {
+
+// The allocators which operator new and delete are dispatched to when the
+// program is linked with the benchmark_allocator library, whose replacements
+// of operator new and delete call DispatchAllocate() and DispatchFree().
+// Blocks are always freed by the allocator which allocated them, whichever
+// is selected at the time.
+
+// Called once by the benchmark_allocator library when it is linked in.
+void RegisterAllocatorDispatch();
+
+// Whether operator new and delete are dispatched.
+bool IsAllocatorDispatched();
+
+// Select the allocator of all the threads. 'kind' may not be
+// kDefaultAllocator.
+void SetAllocator(AllocatorKind kind);
+
+// Returns nullptr if the memory is exhausted.
+void* DispatchAllocate(std::size_t size);
+void DispatchFree(void* ptr);
+
+// The number and total size of the blocks allocated by the calling thread
+// since it started.
+struct AllocationCounts {
+  AllocationCounts() : count(0), bytes(0) {}
+
+  int64_t count;
+  int64_t bytes;
+};
+AllocationCounts ThreadAllocationCounts();
+
+// Parses the names accepted by --benchmark_allocator. Returns false if 'name'
+// is not one of them.
+bool ParseAllocatorKind(const std::string& name, AllocatorKind* kind);
+const char* AllocatorKindName(AllocatorKind kind);
+
+}  // end namespace internal
+}  // end namespace benchmark
+
+#endif  // BENCHMARK_ALLOCATOR_H_
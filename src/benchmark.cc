@@ -24,27 +24,46 @@
 
 #include <algorithm>
 #include <atomic>
+#include <cmath>
 #include <condition_variable>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <random>
+#include <set>
 #include <thread>
 
+#include "allocator.h"
+#include "call_counter.h"
+#include "capacity.h"
 #include "check.h"
 #include "colorprint.h"
 #include "commandlineflags.h"
 #include "complexity.h"
 #include "counter.h"
+#include "executor.h"
 #include "internal_macros.h"
+#include "interference.h"
+#include "latency_histogram.h"
 #include "log.h"
+#include "manifest.h"
 #include "mutex.h"
+#include "perf_counters.h"
+#include "preflight.h"
 #include "re.h"
+#include "sensitivity.h"
 #include "statistics.h"
 #include "string_util.h"
+#include "suspicious.h"
+#include "sweep.h"
+#include "sysinfo.h"
 #include "timers.h"
+#include "working_set.h"
 
 DEFINE_bool(benchmark_list_tests, false,
             "Print a list of benchmarks. This option overrides all other "
@@ -96,12 +115,131 @@ DEFINE_bool(benchmark_counters_tabular, false,
             "the console.  Valid values: 'true'/'yes'/1, 'false'/'no'/0."
             "Defaults to false.");
 
+DEFINE_bool(benchmark_report_schedstat, false,
+            "Whether to read the scheduler statistics of each benchmark thread "
+            "when its timer is started and stopped, and report the "
+            "per-iteration run-queue delay and off-CPU time as counters. "
+            "Only supported on Linux.");
+
+DEFINE_string(benchmark_primary_metric, "time",
+              "The metric used to decide how many iterations to run and to "
+              "compare benchmarks. Valid values are 'time' or the name of a "
+              "perf event counted in user mode, such as 'instructions' or "
+              "'cycles'. The event count per iteration is reported as a "
+              "counter; times are still reported. Only supported on Linux.");
+
+DEFINE_bool(benchmark_topdown, false,
+            "Whether to count the events of a level 1 top-down analysis "
+            "during each benchmark and report the fractions of the issue "
+            "slots which were frontend bound, lost to bad speculation, "
+            "backend bound and retiring as counters. Only supported on Linux "
+            "on the Intel CPUs for which the kernel exports the top-down "
+            "events.");
+
+DEFINE_bool(benchmark_check_suspicious, false,
+            "Whether to check that the time per iteration of each benchmark "
+            "is about the same in all its runs and well above the time of an "
+            "empty benchmark loop, and mark the results which are not as "
+            "suspicious. With 'instructions' as the primary metric the "
+            "instructions per iteration are checked as well.");
+
+DEFINE_string(benchmark_allocator, "",
+              "The allocator which operator new and delete use while the "
+              "benchmarks which do not select one run. Valid values are "
+              "'system', 'thread_cache', 'arena' and 'slab'. The number of "
+              "allocations and of bytes allocated per iteration is reported "
+              "as counters. Requires linking with the benchmark_allocator "
+              "library.");
+
+DEFINE_string(benchmark_preflight, "",
+              "Whether to check the host for settings which make results "
+              "noisy before running the benchmarks: the CPU frequency "
+              "governor, turbo, SMT, ASLR, transparent huge pages, swap "
+              "activity, the load average, the cgroup CPU quota, the "
+              "clocksource and the free memory. Valid values are 'warn', to "
+              "print a warning for each failed check, and 'fail', to also "
+              "exit without running the benchmarks if any check fails. The "
+              "results are reported in the context. Only supported on "
+              "Linux.");
+
+DEFINE_string(benchmark_manifest, "",
+              "The file to write the manifest of the run to: the flags which "
+              "affect the measurements and, in the order in which they were "
+              "run, the measured runs of each benchmark with their iteration "
+              "count, seed and the CPU each thread started on. See "
+              "--benchmark_replay.");
+
+DEFINE_string(benchmark_replay, "",
+              "A manifest written by --benchmark_manifest whose runs are "
+              "repeated in the same order, with the same iteration counts, "
+              "seeds and threads pinned to the same CPUs, and without "
+              "running the benchmarks to choose the iteration counts. The "
+              "benchmarks must still be registered and match the filter.");
+
+DEFINE_int32(benchmark_executor_workers, 0,
+             "The number of worker threads of the pool returned by "
+             "State::executor(), or 0 for one per CPU.");
+
+DEFINE_string(benchmark_executor_cpus, "",
+              "The CPUs to pin the workers of the pool returned by "
+              "State::executor() to, e.g. '0-3,8'. The i-th worker is pinned "
+              "to the i-th CPU, modulo their number. By default the workers "
+              "are not pinned. Only supported on Linux.");
+
+DEFINE_string(benchmark_core_types, "",
+              "Run each benchmark once per core type of a hybrid CPU, with "
+              "its threads pinned to the CPUs of that type: 'all', or a "
+              "comma separated list of the types to run on, e.g. "
+              "'core,atom'. The core type is appended to the name of each "
+              "run, e.g. 'BM_foo/core_type:atom'. Only supported on Linux.");
+
+DEFINE_string(benchmark_sweep_file, "",
+              "A file which sets the arguments, thread counts, min_time and "
+              "repetitions of benchmark families by name, overriding those "
+              "they were registered with, so that they can be swept without "
+              "recompiling. See the README for its format.");
+
+DEFINE_string(benchmark_interference_cpus, "",
+              "The CPUs to run victims on, e.g. '4-7', to measure how much "
+              "each benchmark slows down its neighbours through the shared "
+              "last level cache and memory bandwidth. Each benchmark is run "
+              "once more with a victim pinned to each of these CPUs, doing "
+              "random lookups in a cache-sized table and a sequential read "
+              "of a large buffer, and the victims' slowdown relative to "
+              "running on their own is reported in the 'interference_*' "
+              "counters. The benchmark threads are kept off these CPUs "
+              "meanwhile. Only pinned on Linux.");
+
+DEFINE_string(benchmark_timer, "auto",
+              "The clock to measure real time with: 'chrono' for the steady "
+              "clock of the standard library, 'tsc' for the time stamp "
+              "counter if it is invariant, or 'auto' for the time stamp "
+              "counter if it is invariant and either cheaper to read or the "
+              "kernel clocksource is slow. The 'tsc' clock is calibrated "
+              "against the 'chrono' one at startup.");
+
 DEFINE_int32(v, 0, "The level of verbose logging to output");
 
 namespace benchmark {
 
 namespace {
 static const size_t kMaxIterations = 1000000000;
+
+// With shared iterations each thread claims about this many chunks, so that
+// the threads rarely contend for the next one and the last chunks leave
+// little imbalance between them.
+static const size_t kSharedIterationChunksPerThread = 64;
+
+// State::WaitForArrival() stops sleeping this long before a request is due,
+// more than a sleep commonly overshoots by.
+static const double kArrivalSleepMargin = 1e-3;
+
+// Returns the perf event selected by --benchmark_primary_metric, or the empty
+// string if the benchmarks are measured by time.
+std::string PrimaryPerfEvent() {
+  if (FLAGS_benchmark_primary_metric == "time") return std::string();
+  return FLAGS_benchmark_primary_metric;
+}
 }  // end namespace
 
 namespace internal {
@@ -111,16 +249,38 @@ void UseCharPointer(char const volatile*) {}
 class ThreadManager {
  public:
   ThreadManager(int num_threads)
-      : alive_threads_(num_threads), start_stop_barrier_(num_threads) {}
+      : alive_threads_(num_threads),
+        start_stop_barrier_(num_threads),
+        shared_iterations_(0),
+        chunk_(0),
+        next_iteration_(0),
+        claimed_(num_threads, 0),
+        arrival_rate_(0) {}
 
   Mutex& GetBenchmarkMutex() const RETURN_CAPABILITY(benchmark_mutex_) {
     return benchmark_mutex_;
   }
 
-  bool StartStopBarrier() EXCLUDES(end_cond_mutex_) {
+  // Waits for all threads before ('starting') or after the benchmark loop.
+  // The action for that barrier, if any, is run by the last thread to arrive
+  // while the others wait.
+  bool StartStopBarrier(bool starting) EXCLUDES(end_cond_mutex_) {
+    const std::function<void()>& action =
+        starting ? start_action_ : stop_action_;
+    if (!action) return start_stop_barrier_.wait();
+    if (start_stop_barrier_.wait()) action();
     return start_stop_barrier_.wait();
   }
 
+  // Sets the actions run when all threads have reached the barrier before
+  // the benchmark loop and the one after it. Must be called before they
+  // start.
+  void SetBarrierActions(std::function<void()> start,
+                         std::function<void()> stop) {
+    start_action_ = std::move(start);
+    stop_action_ = std::move(stop);
+  }
+
   void NotifyThreadComplete() EXCLUDES(end_cond_mutex_) {
     start_stop_barrier_.removeThread();
     if (--alive_threads_ == 0) {
@@ -135,6 +295,41 @@ class ThreadManager {
                         [this]() { return alive_threads_ == 0; });
   }
 
+  // Shares 'iterations' between the threads, which claim them in chunks of
+  // 'chunk' with ClaimIterations(). Must be called before they start.
+  void ShareIterations(size_t iterations, size_t chunk) {
+    shared_iterations_ = iterations;
+    chunk_ = chunk;
+    next_iteration_ = 0;
+    claimed_.assign(claimed_.size(), 0);
+  }
+
+  bool shares_iterations() const { return shared_iterations_ != 0; }
+
+  // Claims the next chunk of the shared iterations for thread 'thread_id'.
+  // Returns its size, or 0 once all have been claimed.
+  size_t ClaimIterations(int thread_id) {
+    const size_t first =
+        next_iteration_.fetch_add(chunk_, std::memory_order_relaxed);
+    if (first >= shared_iterations_) return 0;
+    const size_t count = std::min(chunk_, shared_iterations_ - first);
+    claimed_[thread_id] += count;
+    return count;
+  }
+
+  // The shared iterations claimed by thread 'thread_id' so far.
+  size_t claimed_iterations(int thread_id) const {
+    return claimed_[thread_id];
+  }
+
+  // Paces the requests of the threads, see State::WaitForArrival(), so that
+  // together they arrive at 'rate' per second. Must be called before they
+  // start.
+  void PaceArrivals(double rate) { arrival_rate_ = rate; }
+
+  // The total rate of the paced requests, or 0 if they are not paced.
+  double arrival_rate() const { return arrival_rate_; }
+
  public:
   struct Result {
     double real_time_used = 0;
@@ -143,6 +338,39 @@ class ThreadManager {
     int64_t bytes_processed = 0;
     int64_t items_processed = 0;
     int complexity_n = 0;
+    // Scheduler statistics, summed over all threads which could read them.
+    int sched_stat_threads = 0;
+    double sched_wait_time = 0;
+    double off_cpu_time = 0;
+    // Count of the primary perf event, summed over all threads which could
+    // count it.
+    int perf_event_threads = 0;
+    double perf_event_count = 0;
+    // Top-down events, summed over all threads which could count them.
+    int topdown_threads = 0;
+    TopdownCounts topdown;
+    // Time taken by the per-thread fixture hooks, summed over all threads.
+    double setup_thread_time = 0;
+    double teardown_thread_time = 0;
+    LatencyHistogram latency;
+    std::map<std::string, LatencyHistogram> named_latencies;
+    // Number of threads started by the process during the run besides the
+    // benchmark threads, or -1 if it was not measured.
+    int extra_threads = -1;
+    // Allocations made through operator new, summed over all threads which
+    // counted them.
+    int alloc_threads = 0;
+    int64_t allocations = 0;
+    int64_t allocated_bytes = 0;
+    // The seed of the run and the CPU each thread started on, see
+    // PlannedRun.
+    uint64_t seed = 0;
+    std::vector<int> cpus;
+    // The iterations run by each thread, if they were shared between them.
+    std::vector<size_t> thread_iterations;
+    // What the workers of the executor did during the run, if any task was
+    // run on it.
+    internal::ExecutorStats executor;
     std::string report_label_;
     std::string error_message_;
     bool has_error_ = false;
@@ -156,33 +384,121 @@ class ThreadManager {
   Barrier start_stop_barrier_;
   Mutex end_cond_mutex_;
   Condition end_condition_;
+  // The shared iterations, of which those before 'next_iteration_' have been
+  // claimed, and the number claimed by each thread.
+  size_t shared_iterations_;
+  size_t chunk_;
+  std::atomic<size_t> next_iteration_;
+  std::vector<size_t> claimed_;
+  double arrival_rate_;
+  std::function<void()> start_action_;
+  std::function<void()> stop_action_;
 };
 
 // Timer management class
 class ThreadTimer {
  public:
-  ThreadTimer() = default;
+  // If 'measure_sched_stat' is true the scheduler statistics of the thread
+  // are sampled around each timed slice. The timer must be constructed on the
+  // thread it measures. If 'perf_event' is not empty the event is counted
+  // during each timed slice as well. If 'measure_process_cpu_time' is true the
+  // CPU time of the whole process is measured instead of the thread's. If
+  // 'measure_topdown' is true the top-down events are counted as well.
+  explicit ThreadTimer(bool measure_sched_stat = false,
+                       const std::string& perf_event = std::string(),
+                       bool measure_process_cpu_time = false,
+                       bool measure_topdown = false)
+      : measure_process_cpu_time_(measure_process_cpu_time) {
+    if (measure_sched_stat) {
+      sched_stat_reader_.reset(new SchedStatReader);
+      if (!sched_stat_reader_->ok()) sched_stat_reader_.reset();
+    }
+    if (!perf_event.empty()) {
+      perf_counter_.reset(new PerfCounter(perf_event));
+      if (!perf_counter_->ok()) perf_counter_.reset();
+    }
+    if (measure_topdown) {
+      topdown_counter_.reset(new TopdownCounter);
+      if (!topdown_counter_->ok()) topdown_counter_.reset();
+    }
+  }
 
   // Called by each thread
   void StartTimer() {
     running_ = true;
-    start_real_time_ = ChronoClockNow();
-    start_cpu_time_ = ThreadCPUUsage();
+    // Sample the scheduler statistics outside of the timed region so the cost
+    // of reading them is not attributed to the benchmark.
+    if (sched_stat_reader_ && !sched_stat_reader_->Read(&start_sched_stat_))
+      sched_stat_reader_.reset();
+    start_real_time_ = RealClockNow();
+    start_cpu_time_ = ReadCPUTime();
+    // Read the perf counters last so the clocks are not counted.
+    if (topdown_counter_ && !topdown_counter_->Read(&start_topdown_))
+      topdown_counter_.reset();
+    if (perf_counter_ && !perf_counter_->Read(&start_perf_count_))
+      perf_counter_.reset();
   }
 
   // Called by each thread
   void StopTimer() {
     CHECK(running_);
     running_ = false;
-    real_time_used_ += ChronoClockNow() - start_real_time_;
+    uint64_t perf_count = 0;
+    if (perf_counter_ && perf_counter_->Read(&perf_count)) {
+      perf_event_count_ += static_cast<double>(perf_count - start_perf_count_);
+    } else {
+      perf_counter_.reset();
+    }
+    TopdownCounter::Sample topdown;
+    if (!topdown_counter_ || !topdown_counter_->Read(&topdown)) {
+      topdown_counter_.reset();
+    } else if (topdown_counter_->Accumulate(start_topdown_, topdown,
+                                            &topdown_counts_)) {
+      topdown_scheduled_ = true;
+    }
+    const double real_time = RealClockNow() - start_real_time_;
+    real_time_used_ += real_time;
     // Floating point error can result in the subtraction producing a negative
     // time. Guard against that.
-    cpu_time_used_ += std::max<double>(ThreadCPUUsage() - start_cpu_time_, 0);
+    cpu_time_used_ += std::max<double>(ReadCPUTime() - start_cpu_time_, 0);
+    SchedStat stat;
+    if (sched_stat_reader_ && sched_stat_reader_->Read(&stat)) {
+      const double run_time = stat.run_time - start_sched_stat_.run_time;
+      sched_wait_time_ += stat.wait_time - start_sched_stat_.wait_time;
+      off_cpu_time_ += std::max<double>(real_time - run_time, 0);
+    } else {
+      sched_stat_reader_.reset();
+    }
   }
 
   // Called by each thread
   void SetIterationTime(double seconds) { manual_time_used_ += seconds; }
 
+  // Called by each thread
+  void RecordLatency(double seconds) { latency_.Record(seconds); }
+
+  // Called by each thread
+  int LatencyIndex(const std::string& name) {
+    auto it = named_latency_indices_.find(name);
+    if (it != named_latency_indices_.end()) return it->second;
+    const int index = static_cast<int>(named_latencies_.size());
+    named_latency_indices_[name] = index;
+    named_latencies_.emplace_back(name, LatencyHistogram());
+    return index;
+  }
+
+  // Called by each thread
+  void RecordLatency(int index, double seconds) {
+    named_latencies_[index].second.Record(seconds);
+  }
+
+  const LatencyHistogram& latency() const { return latency_; }
+
+  const std::vector<std::pair<std::string, LatencyHistogram> >&
+  named_latencies() const {
+    return named_latencies_;
+  }
+
   bool running() const { return running_; }
 
   // REQUIRES: timer is not running
@@ -203,7 +519,50 @@ class ThreadTimer {
     return manual_time_used_;
   }
 
+  // Returns true if scheduler statistics were requested and could be read
+  // for every timed slice.
+  bool has_sched_stat() const { return sched_stat_reader_ != nullptr; }
+
+  // REQUIRES: timer is not running and has_sched_stat()
+  double sched_wait_time() {
+    CHECK(!running_ && has_sched_stat());
+    return sched_wait_time_;
+  }
+
+  // REQUIRES: timer is not running and has_sched_stat()
+  double off_cpu_time() {
+    CHECK(!running_ && has_sched_stat());
+    return off_cpu_time_;
+  }
+
+  // Returns true if a perf event was requested and could be counted for
+  // every timed slice.
+  bool has_perf_event() const { return perf_counter_ != nullptr; }
+
+  // REQUIRES: timer is not running and has_perf_event()
+  double perf_event_count() {
+    CHECK(!running_ && has_perf_event());
+    return perf_event_count_;
+  }
+
+  // Returns true if the top-down events were requested and could be counted
+  // for every timed slice.
+  bool has_topdown() const {
+    return topdown_counter_ != nullptr && topdown_scheduled_;
+  }
+
+  // REQUIRES: timer is not running and has_topdown()
+  const TopdownCounts& topdown_counts() {
+    CHECK(!running_ && has_topdown());
+    return topdown_counts_;
+  }
+
  private:
+  double ReadCPUTime() const {
+    return measure_process_cpu_time_ ? ProcessCPUUsage() : ThreadCPUUsage();
+  }
+
+  const bool measure_process_cpu_time_;
   bool running_ = false;        // Is the timer running
   double start_real_time_ = 0;  // If running_
   double start_cpu_time_ = 0;   // If running_
@@ -213,10 +572,51 @@ class ThreadTimer {
   double cpu_time_used_ = 0;
   // Manually set iteration time. User sets this with SetIterationTime(seconds).
   double manual_time_used_ = 0;
+  // Latencies recorded by the user with RecordLatency(seconds).
+  LatencyHistogram latency_;
+  // Latencies recorded by the user with RecordLatency(name, seconds), in the
+  // order of their first LatencyIndex(name), and their indices.
+  std::vector<std::pair<std::string, LatencyHistogram> > named_latencies_;
+  std::map<std::string, int> named_latency_indices_;
+
+  // Scheduler statistics. 'sched_stat_reader_' is null if they were not
+  // requested or could not be read.
+  std::unique_ptr<SchedStatReader> sched_stat_reader_;
+  SchedStat start_sched_stat_;  // If running_
+  double sched_wait_time_ = 0;
+  double off_cpu_time_ = 0;
+
+  // The primary perf event. 'perf_counter_' is null if it was not requested
+  // or could not be counted.
+  std::unique_ptr<PerfCounter> perf_counter_;
+  uint64_t start_perf_count_ = 0;  // If running_
+  double perf_event_count_ = 0;
+
+  // The top-down events. 'topdown_counter_' is null if they were not
+  // requested or could not be counted.
+  std::unique_ptr<TopdownCounter> topdown_counter_;
+  TopdownCounter::Sample start_topdown_;  // If running_
+  TopdownCounts topdown_counts_;
+  // Whether the PMU could schedule the events at all.
+  bool topdown_scheduled_ = false;
 };
 
 namespace {
 
+// Add the mean, some percentiles and the maximum of 'latency' to 'counters',
+// with names starting with 'prefix'. Nothing is added if it is empty.
+void AddLatencyCounters(const std::string& prefix,
+                        const LatencyHistogram& latency,
+                        UserCounters* counters) {
+  if (latency.count() == 0) return;
+  (*counters)[prefix + "mean"] = latency.mean();
+  (*counters)[prefix + "p50"] = latency.Percentile(0.5);
+  (*counters)[prefix + "p90"] = latency.Percentile(0.9);
+  (*counters)[prefix + "p99"] = latency.Percentile(0.99);
+  (*counters)[prefix + "p999"] = latency.Percentile(0.999);
+  (*counters)[prefix + "max"] = latency.max();
+}
+
 BenchmarkReporter::Run CreateRunReport(
     const benchmark::internal::Benchmark::Instance& b,
     const internal::ThreadManager::Result& results, size_t iters,
@@ -225,6 +625,7 @@ BenchmarkReporter::Run CreateRunReport(
   BenchmarkReporter::Run report;
 
   report.benchmark_name = b.name;
+  if (b.core_type != nullptr) report.core_type = b.core_type->name;
   report.error_occurred = results.has_error_;
   report.error_message = results.error_message_;
   report.report_label = results.report_label_;
@@ -256,20 +657,154 @@ BenchmarkReporter::Run CreateRunReport(
     report.statistics = b.statistics;
     report.counters = results.counters;
     internal::Finish(&report.counters, seconds, b.threads);
+
+    // Report the scheduler statistics per iteration, averaged over threads.
+    if (results.sched_stat_threads == b.threads && report.iterations > 0) {
+      const double iterations = static_cast<double>(report.iterations);
+      report.counters["sched_wait"] = results.sched_wait_time / iterations;
+      report.counters["off_cpu"] = results.off_cpu_time / iterations;
+    }
+
+    // Report the primary perf event per iteration.
+    if (results.perf_event_threads == b.threads && report.iterations > 0) {
+      report.counters[FLAGS_benchmark_primary_metric] =
+          results.perf_event_count / static_cast<double>(report.iterations);
+    }
+
+    // Report the fraction of the issue slots in each top-down category.
+    const TopdownCounts& topdown = results.topdown;
+    if (results.topdown_threads == b.threads && topdown.total_slots > 0) {
+      report.counters["topdown_frontend"] = topdown.frontend_bound();
+      report.counters["topdown_bad_speculation"] = topdown.bad_speculation();
+      report.counters["topdown_backend"] = topdown.backend_bound();
+      report.counters["topdown_retiring"] = topdown.retiring();
+      if (TopdownCounter::HasLevel2()) {
+        report.counters["topdown_fetch_latency"] = topdown.fetch_latency();
+        report.counters["topdown_fetch_bandwidth"] = topdown.fetch_bandwidth();
+        report.counters["topdown_branch_mispredicts"] =
+            topdown.branch_mispredicts();
+        report.counters["topdown_machine_clears"] = topdown.machine_clears();
+        report.counters["topdown_heavy_operations"] =
+            topdown.heavy_operations();
+        report.counters["topdown_light_operations"] =
+            topdown.light_operations();
+        report.counters["topdown_memory_bound"] = topdown.memory_bound();
+        report.counters["topdown_core_bound"] = topdown.core_bound();
+      }
+    }
+
+    if (results.extra_threads >= 0)
+      report.counters["extra_threads"] = results.extra_threads;
+
+    // Report the allocations per iteration.
+    if (results.alloc_threads == b.threads && report.iterations > 0) {
+      const double iterations = static_cast<double>(report.iterations);
+      report.counters["allocs"] = results.allocations / iterations;
+      report.counters["alloc_bytes"] = results.allocated_bytes / iterations;
+    }
+
+    // Report how busy the workers of the executor were.
+    const internal::ExecutorStats& executor = results.executor;
+    if (executor.tasks > 0 && report.iterations > 0 &&
+        results.real_time_used > 0) {
+      const double iterations = static_cast<double>(report.iterations);
+      const double worker_time = executor.workers * results.real_time_used;
+      report.counters["executor_utilization"] =
+          std::min(executor.busy_time / worker_time, 1.0);
+      report.counters["executor_steals"] = executor.steals / iterations;
+      report.counters["executor_idle"] =
+          std::max(worker_time - executor.busy_time, 0.0) / iterations;
+    }
+
+    // Report how evenly the threads shared the iterations.
+    if (!results.thread_iterations.empty()) {
+      const auto minmax = std::minmax_element(results.thread_iterations.begin(),
+                                              results.thread_iterations.end());
+      report.counters["thread_iterations_min"] =
+          static_cast<double>(*minmax.first);
+      report.counters["thread_iterations_max"] =
+          static_cast<double>(*minmax.second);
+    }
+
+    // Report the distribution of the latencies recorded by the benchmark.
+    AddLatencyCounters("latency_", results.latency, &report.counters);
+    for (const auto& named : results.named_latencies)
+      AddLatencyCounters(named.first + "_latency_", named.second,
+                         &report.counters);
+
+    // Report the time taken by the per-thread hooks, averaged over threads.
+    // The run-wide ones are added by RunBenchmark().
+    if (b.report_hook_times) {
+      report.counters["setup_thread"] = results.setup_thread_time / b.threads;
+      report.counters["teardown_thread"] =
+          results.teardown_thread_time / b.threads;
+    }
   }
   return report;
 }
 
+// Returns the allocator selected for 'b', by the benchmark or by
+// --benchmark_allocator, or kDefaultAllocator if there is none or operator
+// new is not dispatched.
+AllocatorKind SelectedAllocator(
+    const benchmark::internal::Benchmark::Instance& b) {
+  if (!IsAllocatorDispatched()) return kDefaultAllocator;
+  if (b.allocator != kDefaultAllocator) return b.allocator;
+  AllocatorKind kind = kDefaultAllocator;
+  if (!FLAGS_benchmark_allocator.empty())
+    ParseAllocatorKind(FLAGS_benchmark_allocator, &kind);
+  return kind;
+}
+
+// Dispatches operator new to the allocator selected for a benchmark while it
+// is alive, and to the system allocator afterwards.
+class ScopedAllocator {
+ public:
+  explicit ScopedAllocator(const benchmark::internal::Benchmark::Instance& b)
+      : kind_(SelectedAllocator(b)) {
+    if (kind_ != kDefaultAllocator) SetAllocator(kind_);
+  }
+
+  ~ScopedAllocator() {
+    if (kind_ != kDefaultAllocator) SetAllocator(kSystemAllocator);
+  }
+
+ private:
+  const AllocatorKind kind_;
+};
+
 // Execute one thread of benchmark b for the specified number of iterations.
-// Adds the stats collected for the thread into *total.
+// Adds the stats collected for the thread into *total. If 'call_counter' is
+// not null the calls made by the thread while the benchmark runs are counted.
+// Unless 'cpus' is empty the thread is pinned to its CPUs while it runs.
 void RunInThread(const benchmark::internal::Benchmark::Instance* b,
-                 size_t iters, int thread_id,
-                 internal::ThreadManager* manager) {
-  internal::ThreadTimer timer;
-  State st(iters, b->arg, thread_id, b->threads, &timer, manager);
+                 size_t iters, int thread_id, uint64_t seed,
+                 std::vector<int> cpus, internal::ThreadManager* manager,
+                 internal::CallCounter* call_counter) {
+  ScopedCPUPin pin(cpus);
+  const int started_on = CurrentCPU();
+  internal::ThreadTimer timer(FLAGS_benchmark_report_schedstat,
+                              PrimaryPerfEvent(), b->measure_process_cpu_time,
+                              FLAGS_benchmark_topdown);
+  // A thread sharing the iterations of the run may run all of them.
+  const size_t max_iters = b->shared_iterations ? iters * b->threads : iters;
+  State st(max_iters, b->arg, thread_id, b->threads, &timer, manager, seed);
+  const double setup_start = ChronoClockNow();
+  b->benchmark->SetUpThread(st);
+  const double setup_time = ChronoClockNow() - setup_start;
+  const bool count_allocations = SelectedAllocator(*b) != kDefaultAllocator;
+  const AllocationCounts allocs_before = ThreadAllocationCounts();
+  if (call_counter != nullptr) call_counter->StartThread();
   b->benchmark->Run(st);
-  CHECK(st.iterations() == st.max_iterations)
+  if (call_counter != nullptr) call_counter->StopThread();
+  const AllocationCounts allocs_after = ThreadAllocationCounts();
+  CHECK(st.iterations() == (b->shared_iterations
+                                ? manager->claimed_iterations(thread_id)
+                                : st.max_iterations))
       << "Benchmark returned before State::KeepRunning() returned false!";
+  const double teardown_start = ChronoClockNow();
+  b->benchmark->TearDownThread(st);
+  const double teardown_time = ChronoClockNow() - teardown_start;
   {
     MutexLock l(manager->GetBenchmarkMutex());
     internal::ThreadManager::Result& results = manager->results;
@@ -279,71 +814,897 @@ void RunInThread(const benchmark::internal::Benchmark::Instance* b,
     results.bytes_processed += st.bytes_processed();
     results.items_processed += st.items_processed();
     results.complexity_n += st.complexity_length_n();
+    results.setup_thread_time += setup_time;
+    results.teardown_thread_time += teardown_time;
+    results.latency.Merge(timer.latency());
+    for (const auto& named : timer.named_latencies())
+      results.named_latencies[named.first].Merge(named.second);
+    if (timer.has_sched_stat()) {
+      results.sched_stat_threads += 1;
+      results.sched_wait_time += timer.sched_wait_time();
+      results.off_cpu_time += timer.off_cpu_time();
+    }
+    if (timer.has_perf_event()) {
+      results.perf_event_threads += 1;
+      results.perf_event_count += timer.perf_event_count();
+    }
+    if (timer.has_topdown()) {
+      results.topdown_threads += 1;
+      results.topdown += timer.topdown_counts();
+    }
+    if (count_allocations) {
+      results.alloc_threads += 1;
+      results.allocations += allocs_after.count - allocs_before.count;
+      results.allocated_bytes += allocs_after.bytes - allocs_before.bytes;
+    }
     internal::Increment(&results.counters, st.counters);
+    results.cpus[thread_id] = started_on;
+    if (b->shared_iterations)
+      results.thread_iterations[thread_id] = st.iterations();
   }
   manager->NotifyThreadComplete();
 }
 
+// Samples the number of threads of the process on a thread of its own, from
+// its construction until Stop() is called, to find the threads started by the
+// benchmarked code. Threads living less than the sampling interval may be
+// missed. The sampler's own CPU time is counted while it is measuring, so
+// that it can be taken out of the CPU time of the process.
+class ThreadCountSampler {
+ public:
+  ThreadCountSampler()
+      : max_threads_(ProcessThreadCount()),
+        done_(false),
+        measuring_(false),
+        cpu_time_(0) {
+    if (max_threads_ >= 0)
+      thread_ = std::thread(&ThreadCountSampler::Run, this);
+  }
+
+  ~ThreadCountSampler() { Stop(); }
+
+  // Returns the largest number of threads seen, not counting the sampler, or
+  // -1 if it cannot be determined.
+  int Stop() {
+    if (thread_.joinable()) {
+      {
+        MutexLock l(mutex_);
+        done_ = true;
+      }
+      condition_.notify_all();
+      thread_.join();
+    }
+    return max_threads_;
+  }
+
+  // Starts or stops counting the CPU time of the sampler.
+  void SetMeasuring(bool measuring) {
+    MutexLock l(mutex_);
+    measuring_ = measuring;
+  }
+
+  // Returns the CPU time the sampler used while measuring.
+  // REQUIRES: Stop() was called
+  double cpu_time() const { return cpu_time_; }
+
+ private:
+  void Run() {
+    MutexLock l(mutex_);
+    double cpu = ThreadCPUUsage();
+    while (!done_) {
+      max_threads_ = std::max(max_threads_, ProcessThreadCount() - 1);
+      // Also counts the wake-up which led to this sample.
+      const double now = ThreadCPUUsage();
+      if (measuring_) cpu_time_ += now - cpu;
+      cpu = now;
+      condition_.wait_for(l.native_handle(), std::chrono::milliseconds(10));
+    }
+  }
+
+  int max_threads_;
+  bool done_;
+  bool measuring_;
+  double cpu_time_;
+  Mutex mutex_;
+  Condition condition_;
+  std::thread thread_;
+};
+
+// Returns the size of the chunks in which 'threads' threads claim 'iterations'
+// shared iterations.
+size_t SharedIterationChunk(size_t iterations, int threads) {
+  return std::max<size_t>(
+      1, iterations / (kSharedIterationChunksPerThread * threads));
+}
+
+// The output function of SplitMix64, which maps consecutive values of 'z' to
+// unrelated ones.
+uint64_t MixSeed(uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+// Returns a new seed for each run, see State::seed.
+uint64_t NextRunSeed() {
+  static uint64_t state =
+      (static_cast<uint64_t>(std::random_device()()) << 32) ^
+      std::random_device()();
+  return MixSeed(state += 0x9E3779B97F4A7C15ull);
+}
+
+// Run the benchmark on 'b.threads' threads, each executing 'iters'
+// iterations, and return the combined results of all threads. If
+// 'call_counter' is not null the calls made by the threads are counted. If
+// 'planned' is not null the run uses its seed and pins the threads to its
+// CPUs; otherwise they are pinned to the CPUs of the core type of 'b', if
+// any. If 'arrival_rate' is not zero the requests of the threads are paced,
+// see ThreadManager::PaceArrivals(). If 'excluded_cpus' is not null the
+// threads are kept off those CPUs. 'at_start' and 'at_stop', if set, are
+// run once all threads have reached the start and the stop of the benchmark
+// loop, see ThreadManager::SetBarrierActions().
+internal::ThreadManager::Result RunThreads(
+    const benchmark::internal::Benchmark::Instance& b, size_t iters,
+    internal::CallCounter* call_counter = nullptr,
+    const PlannedRun* planned = nullptr, double arrival_rate = 0,
+    const std::vector<int>* excluded_cpus = nullptr,
+    std::function<void()> at_start = nullptr,
+    std::function<void()> at_stop = nullptr) {
+  const uint64_t seed = planned != nullptr ? planned->seed : NextRunSeed();
+  std::vector<std::vector<int> > cpus(b.threads);
+  if (b.core_type != nullptr) cpus.assign(b.threads, b.core_type->cpus);
+  if (planned != nullptr && planned->cpus.size() == cpus.size()) {
+    for (size_t i = 0; i < cpus.size(); ++i) {
+      if (planned->cpus[i] >= 0) cpus[i].assign(1, planned->cpus[i]);
+    }
+  }
+  if (excluded_cpus != nullptr) {
+    const std::vector<int> allowed = AllowedCPUs();
+    for (std::vector<int>& thread_cpus : cpus) {
+      if (thread_cpus.empty()) thread_cpus = allowed;
+      thread_cpus.erase(
+          std::remove_if(thread_cpus.begin(), thread_cpus.end(),
+                         [&](int cpu) {
+                           return std::find(excluded_cpus->begin(),
+                                            excluded_cpus->end(),
+                                            cpu) != excluded_cpus->end();
+                         }),
+          thread_cpus.end());
+    }
+  }
+  ScopedAllocator allocator(b);
+  // Threads which are running before the run, such as those started by
+  // SetUpOnce(), are not extra threads.
+  std::unique_ptr<ThreadCountSampler> sampler;
+  int threads_before = -1;
+  if (b.measure_process_cpu_time) {
+    threads_before = ProcessThreadCount();
+    sampler.reset(new ThreadCountSampler);
+    // The sampler's CPU time is only counted during the benchmark loop.
+    ThreadCountSampler* s = sampler.get();
+    at_start = [s, at_start] {
+      s->SetMeasuring(true);
+      if (at_start) at_start();
+    };
+    at_stop = [s, at_stop] {
+      if (at_stop) at_stop();
+      s->SetMeasuring(false);
+    };
+  }
+
+  std::unique_ptr<internal::ThreadManager> manager(
+      new internal::ThreadManager(b.threads));
+  {
+    MutexLock l(manager->GetBenchmarkMutex());
+    manager->results.seed = seed;
+    manager->results.cpus.assign(b.threads, -1);
+    if (b.shared_iterations) {
+      manager->results.thread_iterations.assign(b.threads, 0);
+      const size_t shared = iters * b.threads;
+      manager->ShareIterations(shared,
+                               SharedIterationChunk(shared, b.threads));
+    }
+  }
+  manager->PaceArrivals(arrival_rate);
+  manager->SetBarrierActions(std::move(at_start), std::move(at_stop));
+  internal::ExecutorStats executor_before;
+  internal::ReadExecutorStats(&executor_before);
+  std::vector<std::thread> pool(b.threads - 1);
+  for (std::size_t ti = 0; ti < pool.size(); ++ti) {
+    pool[ti] = std::thread(&RunInThread, &b, iters, static_cast<int>(ti + 1),
+                           seed, cpus[ti + 1], manager.get(), call_counter);
+  }
+  RunInThread(&b, iters, 0, seed, cpus[0], manager.get(), call_counter);
+  manager->WaitForAllThreads();
+  for (std::thread& thread : pool) thread.join();
+  internal::ThreadManager::Result results;
+  {
+    MutexLock l(manager->GetBenchmarkMutex());
+    results = manager->results;
+  }
+  // The executor may have been started during the run, in which case the
+  // stats before it are zero; its warm-up is not counted in either.
+  if (internal::ReadExecutorStats(&results.executor)) {
+    results.executor.tasks -= executor_before.tasks;
+    results.executor.steals -= executor_before.steals;
+    results.executor.busy_time -= executor_before.busy_time;
+  }
+  // Adjust real/manual time stats since they were reported per thread.
+  results.real_time_used /= b.threads;
+  results.manual_time_used /= b.threads;
+  // Each thread measured the CPU time of the whole process, including the
+  // one the sampler used during the benchmark loop.
+  if (b.measure_process_cpu_time) {
+    results.cpu_time_used /= b.threads;
+    const int max_threads = sampler->Stop();
+    results.cpu_time_used =
+        std::max(results.cpu_time_used - sampler->cpu_time(), 0.0);
+    if (threads_before >= 0 && max_threads >= 0)
+      results.extra_threads =
+          std::max(max_threads - threads_before - (b.threads - 1), 0);
+  }
+  return results;
+}
+
+// Run the working set measurement pass requested by 'b' and add its results
+// to 'reports'. Failures are diagnosed but otherwise ignored.
+void AddWorkingSetCounters(const benchmark::internal::Benchmark::Instance& b,
+                           std::vector<BenchmarkReporter::Run>* reports) {
+  const size_t iters = b.working_set_iterations;
+  WorkingSetTracker tracker;
+  std::string error;
+  // The pages are only tracked during the benchmark loop, leaving out the
+  // threads, their fixture hooks and the reporting of their results.
+  bool started = false;
+  bool stopped = false;
+  WorkingSet ws;
+  internal::ThreadManager::Result results = RunThreads(
+      b, iters, nullptr, nullptr, 0, nullptr,
+      [&] { started = tracker.Start(&error); },
+      [&] { stopped = started && tracker.Stop(&ws, &error); });
+  if (results.has_error_) return;
+  if (!stopped) {
+    GetErrorLogInstance() << "Failed to measure the working set of " << b.name
+                          << ": " << error << "\n";
+    return;
+  }
+
+  const double total_iters = static_cast<double>(iters);
+  for (BenchmarkReporter::Run& report : *reports) {
+    if (report.error_occurred) continue;
+    report.counters["ws_written"] =
+        static_cast<double>(ws.written_pages * ws.page_size) / total_iters;
+    if (ws.accessed_pages >= 0) {
+      report.counters["ws_accessed"] =
+          static_cast<double>(ws.accessed_pages * ws.page_size) / total_iters;
+    }
+  }
+}
+
+// The most called functions reported for each benchmark.
+const std::size_t kTopCalledFunctions = 5;
+
+// Run the call counting pass requested by 'b' and add its results to
+// 'reports'. Failures are diagnosed but otherwise ignored.
+void AddCallCountCounters(const benchmark::internal::Benchmark::Instance& b,
+                          std::vector<BenchmarkReporter::Run>* reports) {
+  internal::CallCounter* call_counter = internal::GetCallCounter();
+  if (call_counter == nullptr) {
+    GetErrorLogInstance()
+        << "Failed to count the calls of " << b.name
+        << ": link with the benchmark_instrument library and compile the "
+           "benchmarked code with -finstrument-functions\n";
+    return;
+  }
+  const size_t iters = b.call_count_iterations;
+  internal::ThreadManager::Result results = RunThreads(b, iters, call_counter);
+  const std::map<std::string, int64_t> counts = call_counter->TakeCounts();
+  if (results.has_error_) return;
+
+  std::vector<std::pair<int64_t, std::string> > functions;
+  int64_t total = 0;
+  for (const auto& count : counts) {
+    total += count.second;
+    if (count.first != "[other]")
+      functions.push_back(std::make_pair(count.second, count.first));
+  }
+  const std::size_t top = std::min(functions.size(), kTopCalledFunctions);
+  std::partial_sort(
+      functions.begin(), functions.begin() + top, functions.end(),
+      [](const std::pair<int64_t, std::string>& lhs,
+         const std::pair<int64_t, std::string>& rhs) {
+        return lhs.first > rhs.first ||
+               (lhs.first == rhs.first && lhs.second < rhs.second);
+      });
+
+  const double total_iters = static_cast<double>(iters * b.threads);
+  for (BenchmarkReporter::Run& report : *reports) {
+    if (report.error_occurred) continue;
+    report.counters["calls"] = static_cast<double>(total) / total_iters;
+    for (std::size_t i = 0; i < top; ++i) {
+      report.counters["calls:" + functions[i].second] =
+          static_cast<double>(functions[i].first) / total_iters;
+    }
+  }
+}
+
+// The victims of --benchmark_interference_cpus are run beside a benchmark for
+// at least this long.
+const double kMinInterferenceTime = 0.1;
+// The last level cache assumed if its size is not known.
+const size_t kDefaultLastLevelCacheBytes = 8 << 20;
+
+// Returns the size of the largest data or unified cache, or
+// kDefaultLastLevelCacheBytes if there is none.
+size_t LastLevelCacheBytes() {
+  size_t bytes = 0;
+  for (const CPUInfo::CacheInfo& cache : CPUInfo::Get().caches) {
+    if (cache.type != "Instruction" && cache.size > 0)
+      bytes = std::max(bytes, static_cast<size_t>(cache.size));
+  }
+  return bytes != 0 ? bytes : kDefaultLastLevelCacheBytes;
+}
+
+// Returns the CPUs of --benchmark_interference_cpus.
+const std::vector<int>& InterferenceCPUs() {
+  static const std::vector<int>* cpus = [] {
+    std::vector<int>* list = new std::vector<int>;
+    ParseCPUList(FLAGS_benchmark_interference_cpus, list);
+    return list;
+  }();
+  return *cpus;
+}
+
+// Returns the victims of --benchmark_interference_cpus, creating them and
+// measuring their idle rates the first time.
+internal::InterferenceProbe& GetInterferenceProbe() {
+  static internal::InterferenceProbe* probe = new internal::InterferenceProbe(
+      InterferenceCPUs(), LastLevelCacheBytes());
+  return *probe;
+}
+
+// Run 'b' again, with the iteration count of its last run in 'reports', while
+// the victims of --benchmark_interference_cpus run beside it, on the other
+// CPUs, and add to 'reports' how much it slowed them down. Failures are
+// ignored.
+void AddInterferenceCounters(const benchmark::internal::Benchmark::Instance& b,
+                             std::vector<BenchmarkReporter::Run>* reports) {
+  size_t iters = 0;
+  for (const BenchmarkReporter::Run& report : *reports) {
+    if (!report.error_occurred)
+      iters = static_cast<size_t>(report.iterations / b.threads);
+  }
+  if (iters == 0) return;
+  internal::InterferenceProbe& probe = GetInterferenceProbe();
+  probe.Start();
+  // Short runs are repeated so that the victims sample enough of them.
+  const double start = ChronoClockNow();
+  bool failed = false;
+  do {
+    failed = RunThreads(b, iters, nullptr, nullptr, 0, &InterferenceCPUs())
+                 .has_error_;
+  } while (!failed && ChronoClockNow() - start < kMinInterferenceTime);
+  const internal::VictimRates rates = probe.Stop();
+  const internal::VictimRates& idle = probe.idle_rates();
+  if (failed || rates.lookups <= 0 || rates.stream_bytes <= 0) return;
+
+  const double llc = idle.lookups / rates.lookups;
+  const double bandwidth = idle.stream_bytes / rates.stream_bytes;
+  for (BenchmarkReporter::Run& report : *reports) {
+    if (report.error_occurred) continue;
+    report.counters["interference_llc"] = llc;
+    report.counters["interference_bandwidth"] = bandwidth;
+    report.counters["interference_score"] = std::sqrt(llc * bandwidth);
+  }
+}
+
+// The real time per iteration of a single thread in the 1-thread run of each
+// weakly scaled benchmark family and set of arguments.
+typedef std::map<std::pair<const Benchmark*, std::vector<int> >, double>
+    WeakScalingBaselines;
+
+// Return the real time per iteration of a single thread in 'report'.
+double ThreadTimePerIteration(const BenchmarkReporter::Run& report,
+                              int threads) {
+  return report.real_accumulated_time * threads /
+         static_cast<double>(report.iterations);
+}
+
+// Add the weak scaling efficiency of 'b' to 'reports'. The 1-thread instance
+// of each family and set of arguments, which runs first, becomes the baseline
+// of the others; nothing is added if it did not run, e.g. because of the
+// filter.
+void AddWeakScalingEfficiency(
+    const benchmark::internal::Benchmark::Instance& b,
+    std::vector<BenchmarkReporter::Run>* reports,
+    WeakScalingBaselines* baselines) {
+  const auto key = std::make_pair(b.benchmark, b.arg);
+  auto it = baselines->find(key);
+  if (it == baselines->end()) {
+    if (b.threads != 1) return;
+    double total = 0;
+    int count = 0;
+    for (const BenchmarkReporter::Run& report : *reports) {
+      if (report.error_occurred || report.iterations == 0) continue;
+      total += ThreadTimePerIteration(report, b.threads);
+      ++count;
+    }
+    if (count == 0 || total <= 0) return;
+    it = baselines->insert(std::make_pair(key, total / count)).first;
+  }
+  for (BenchmarkReporter::Run& report : *reports) {
+    if (report.error_occurred || report.iterations == 0) continue;
+    const double time = ThreadTimePerIteration(report, b.threads);
+    if (time > 0)
+      report.counters["weak_scaling_efficiency"] = it->second / time;
+  }
+}
+
+// The runs of each instance which another is compared to, by name, once it
+// has run.
+typedef std::map<std::string, std::vector<BenchmarkReporter::Run> >
+    RelativeBaselines;
+
+// Append the time per iteration, as measured for 'b', and the rates of items
+// and bytes of each successful run in 'runs' to 'times', 'items' and 'bytes'.
+void CollectRelativeSamples(const benchmark::internal::Benchmark::Instance& b,
+                            const std::vector<BenchmarkReporter::Run>& runs,
+                            std::vector<double>* times,
+                            std::vector<double>* items,
+                            std::vector<double>* bytes) {
+  for (const BenchmarkReporter::Run& run : runs) {
+    if (run.error_occurred || run.iterations == 0) continue;
+    const double time = b.use_real_time || b.use_manual_time
+                            ? run.real_accumulated_time
+                            : run.cpu_accumulated_time;
+    times->push_back(time / static_cast<double>(run.iterations));
+    items->push_back(run.items_per_second);
+    bytes->push_back(run.bytes_per_second);
+  }
+}
+
+// Add the counters comparing 'reports', the runs of 'b', and 'stat_reports',
+// their aggregates, to 'baseline', the runs of the baseline of 'b', which is
+// timed with the same clock. If 'baseline' is null 'b' is a baseline and the
+// ratios are 1.
+void AddRelativeCounters(const benchmark::internal::Benchmark::Instance& b,
+                         const std::vector<BenchmarkReporter::Run>* baseline,
+                         std::vector<BenchmarkReporter::Run>* reports,
+                         std::vector<BenchmarkReporter::Run>* stat_reports) {
+  std::vector<double> times, items, bytes;
+  CollectRelativeSamples(b, *reports, &times, &items, &bytes);
+  std::vector<double> base_times = times, base_items = items,
+                      base_bytes = bytes;
+  if (baseline != nullptr) {
+    base_times.clear();
+    base_items.clear();
+    base_bytes.clear();
+    CollectRelativeSamples(b, *baseline, &base_times, &base_items,
+                           &base_bytes);
+  }
+  if (times.empty() || base_times.empty()) return;
+
+  // The throughput is compared in items if both process items, else in bytes.
+  const std::vector<double>* rates = nullptr;
+  const std::vector<double>* base_rates = nullptr;
+  if (StatisticsMean(items) > 0 && StatisticsMean(base_items) > 0) {
+    rates = &items;
+    base_rates = &base_items;
+  } else if (StatisticsMean(bytes) > 0 && StatisticsMean(base_bytes) > 0) {
+    rates = &bytes;
+    base_rates = &base_bytes;
+  }
+
+  // The ratios of each run to the mean of the baseline.
+  std::vector<double> speedup, throughput;
+  for (size_t i = 0; i < times.size(); ++i) {
+    speedup.push_back(baseline ? StatisticsMean(base_times) / times[i] : 1);
+    if (rates == nullptr) continue;
+    throughput.push_back(
+        baseline ? (*rates)[i] / StatisticsMean(*base_rates) : 1);
+  }
+  size_t run = 0;
+  for (BenchmarkReporter::Run& report : *reports) {
+    if (report.error_occurred || report.iterations == 0) continue;
+    report.counters["speedup"] = speedup[run];
+    if (rates != nullptr) report.counters["throughput_ratio"] = throughput[run];
+    ++run;
+  }
+
+  // The aggregates are those of the ratios of the runs, except for the mean
+  // which is the ratio of the means. Only the mean has a confidence
+  // interval, from both samples.
+  if (stat_reports->empty()) return;
+  CHECK_EQ(stat_reports->size(), b.statistics->size());
+  for (size_t i = 0; i < stat_reports->size(); ++i) {
+    const Statistics& stat = (*b.statistics)[i];
+    UserCounters& counters = (*stat_reports)[i].counters;
+    if (stat.name_ == "mean") {
+      counters["speedup"] =
+          baseline ? StatisticsMean(base_times) / StatisticsMean(times) : 1;
+      counters["speedup_ci"] =
+          baseline ? RatioOfMeansCI95(base_times, times) : 0;
+      if (rates != nullptr) {
+        counters["throughput_ratio"] =
+            baseline ? StatisticsMean(*rates) / StatisticsMean(*base_rates)
+                     : 1;
+        counters["throughput_ratio_ci"] =
+            baseline ? RatioOfMeansCI95(*rates, *base_rates) : 0;
+      }
+      continue;
+    }
+    counters["speedup"] = stat.compute_(speedup);
+    if (rates != nullptr)
+      counters["throughput_ratio"] = stat.compute_(throughput);
+  }
+}
+
+// Return the cost of a run of 'b' of 'iters' iterations, as checked for
+// suspicious results.
+TrialRun MakeTrialRun(const benchmark::internal::Benchmark::Instance& b,
+                      const internal::ThreadManager::Result& results,
+                      size_t iters) {
+  TrialRun run;
+  run.iterations = static_cast<double>(iters);
+  if (b.use_manual_time) {
+    run.seconds = results.manual_time_used;
+  } else if (b.use_real_time) {
+    run.seconds = results.real_time_used;
+  } else {
+    run.seconds = results.cpu_time_used / b.threads;
+  }
+  if (results.perf_event_threads == b.threads)
+    run.events = results.perf_event_count / b.threads;
+  return run;
+}
+
+// Measure the cost of an empty benchmark loop on the calling thread.
+TrialRun MeasureEmptyLoop() {
+  for (size_t iters = 1000;; iters *= 10) {
+    internal::ThreadManager manager(1);
+    internal::ThreadTimer timer(false, PrimaryPerfEvent());
+    State st(iters, std::vector<int>(), 0, 1, &timer, &manager);
+    for (auto _ : st) {
+    }
+    TrialRun run;
+    run.iterations = static_cast<double>(iters);
+    run.seconds = timer.cpu_time_used();
+    if (timer.has_perf_event()) run.events = timer.perf_event_count();
+    if (run.seconds >= 100 * kMinLinearityTime || iters >= kMaxIterations)
+      return run;
+  }
+}
+
+const TrialRun& EmptyLoopCost() {
+  static const TrialRun cost = MeasureEmptyLoop();
+  return cost;
+}
+
+// Explain in 'reports' why they do not seem to measure the work of 'b', if
+// its cost per iteration changed between its runs, 'runs', or if that of a
+// reported run, the corresponding element of 'reported', is close to the cost
+// of an empty loop.
+void MarkSuspiciousRuns(const benchmark::internal::Benchmark::Instance& b,
+                        const std::vector<TrialRun>& runs,
+                        const std::vector<TrialRun>& reported,
+                        std::vector<BenchmarkReporter::Run>* reports) {
+  const std::string nonlinear = CheckLinearity(runs);
+  for (size_t i = 0; i < reports->size(); ++i) {
+    BenchmarkReporter::Run& report = (*reports)[i];
+    if (report.error_occurred) continue;
+    if (!nonlinear.empty()) {
+      report.suspicious = nonlinear;
+    } else {
+      report.suspicious =
+          CheckAgainstEmptyLoop(reported[i], EmptyLoopCost(),
+                                !b.use_manual_time,
+                                PrimaryPerfEvent() == "instructions");
+    }
+  }
+}
+
+// The runs of the instances of a benchmark family analyzed by
+// AnalyzeSensitivity(), with the arguments and thread count of each.
+struct SensitivityRuns {
+  std::vector<std::vector<int> > configs;
+  std::vector<BenchmarkReporter::Run> runs;
+};
+
+// Return the time per iteration of 'report', as measured for 'b'.
+double MeasuredTimePerIteration(
+    const benchmark::internal::Benchmark::Instance& b,
+    const BenchmarkReporter::Run& report) {
+  const double time = b.use_real_time || b.use_manual_time
+                          ? report.real_accumulated_time
+                          : report.cpu_accumulated_time;
+  return time / static_cast<double>(report.iterations);
+}
+
+// Return the "<family>_Sensitivity" entry of the family of 'b', whose runs
+// are 'runs', or nothing if they have less than two configurations.
+std::vector<BenchmarkReporter::Run> ComputeSensitivity(
+    const benchmark::internal::Benchmark::Instance& b,
+    const SensitivityRuns& runs) {
+  typedef BenchmarkReporter::Run Run;
+  std::vector<Run> results;
+  std::set<std::vector<int> > distinct(runs.configs.begin(),
+                                       runs.configs.end());
+  if (distinct.size() < 2) return results;
+
+  std::vector<double> times;
+  for (const Run& run : runs.runs)
+    times.push_back(MeasuredTimePerIteration(b, run));
+  const Sensitivity sensitivity = AnalyzeSensitivity(runs.configs, times);
+
+  // The entry shows the geometric mean times of the best configuration.
+  Run result;
+  double log_real_time = 0;
+  double log_cpu_time = 0;
+  int best_runs = 0;
+  for (size_t i = 0; i < runs.runs.size(); ++i) {
+    if (runs.configs[i] != sensitivity.best) continue;
+    const Run& run = runs.runs[i];
+    if (best_runs == 0) result.report_label = run.benchmark_name;
+    const double iterations = static_cast<double>(run.iterations);
+    log_real_time += std::log(run.real_accumulated_time / iterations);
+    log_cpu_time += std::log(run.cpu_accumulated_time / iterations);
+    ++best_runs;
+  }
+  const std::string& name = runs.runs[0].benchmark_name;
+  result.benchmark_name = name.substr(0, name.find('/')) + "_Sensitivity";
+  result.iterations = 0;
+  result.time_unit = b.time_unit;
+  result.real_accumulated_time = std::exp(log_real_time / best_runs);
+  result.cpu_accumulated_time = std::exp(log_cpu_time / best_runs);
+
+  // Only the parameters which vary are reported.
+  const size_t num_args = b.arg.size();
+  for (size_t p = 0; p <= num_args; ++p) {
+    std::set<int> levels;
+    for (const std::vector<int>& config : runs.configs)
+      levels.insert(config[p]);
+    if (levels.size() < 2) continue;
+    std::string param = "threads";
+    if (p < num_args) {
+      param = p < b.arg_names->size() && !(*b.arg_names)[p].empty()
+                  ? (*b.arg_names)[p]
+                  : StrCat("arg", p);
+    }
+    result.counters["var:" + param] = sensitivity.main_effects[p];
+  }
+  result.counters["var:interactions"] = sensitivity.interactions;
+  result.counters["var:noise"] = sensitivity.noise;
+  if (sensitivity.has_ci) {
+    const double multiplier = GetTimeUnitMultiplier(b.time_unit);
+    result.counters["best_ci_low"] = sensitivity.ci_low * multiplier;
+    result.counters["best_ci_high"] = sensitivity.ci_high * multiplier;
+  }
+  results.push_back(result);
+  return results;
+}
+
+// Return the time taken by the run of 'b' whose results are 'results', as
+// measured for 'b'.
+double MeasuredSeconds(const benchmark::internal::Benchmark::Instance& b,
+                       const internal::ThreadManager::Result& results) {
+  if (b.use_manual_time) return results.manual_time_used;
+  if (b.use_real_time) return results.real_time_used;
+  return results.cpu_time_used;
+}
+
+// A probe runs for the minimum time, and for at least long enough for this
+// many requests to be slower than the target if it is just met, but each
+// attempt at it for no longer than this many times the minimum time, which
+// bounds the low rates of the search, where the requests come slowly.
+const double kMinCapacityTailRequests = 10;
+const double kMaxCapacityProbeTimeFactor = 10;
+// A probe which is not decided with 95% confidence is repeated with twice
+// as many requests, within the bound above, at most this many times.
+const int kMaxCapacityRetries = 3;
+const double kCapacityConfidenceZ = 1.645;  // One-sided 95%.
+
+// Return the one-sided 95% Wilson score bounds of the proportion of which
+// 'count' out of 'total' were observed.
+void ProportionBounds(double count, double total, double* low, double* high) {
+  const double z2 = kCapacityConfidenceZ * kCapacityConfidenceZ;
+  const double p = count / total;
+  const double denominator = 1 + z2 / total;
+  const double center = (p + z2 / (2 * total)) / denominator;
+  const double half_width =
+      kCapacityConfidenceZ *
+      std::sqrt(p * (1 - p) / total + z2 / (4 * total * total)) / denominator;
+  *low = center - half_width;
+  *high = center + half_width;
+}
+
+// Run 'b' with its requests paced at 'rate' per second and return the
+// report of the run, setting 'met' to whether it met the latency target.
+BenchmarkReporter::Run RunCapacityProbe(
+    const benchmark::internal::Benchmark::Instance& b, double rate,
+    double min_time, bool* met) {
+  const double allowed = 1 - b.capacity_percentile;
+  const double max_requests = rate * min_time * kMaxCapacityProbeTimeFactor;
+  double requests = std::min(
+      std::max(rate * min_time, kMinCapacityTailRequests / allowed),
+      max_requests);
+  BenchmarkReporter::Run report;
+  for (int attempt = 0;; ++attempt) {
+    const size_t iters =
+        static_cast<size_t>(std::ceil(requests / b.threads));
+    internal::ThreadManager::Result results =
+        RunThreads(b, iters, nullptr, nullptr, rate);
+    report = CreateRunReport(b, results, iters, MeasuredSeconds(b, results));
+    if (report.error_occurred) break;
+    if (results.latency.count() == 0) {
+      report.error_occurred = true;
+      report.error_message =
+          "FindCapacity() requires the latency of each request to be "
+          "recorded with State::RecordLatencySince(state.WaitForArrival())";
+      break;
+    }
+    const double total = static_cast<double>(results.latency.count());
+    const double late =
+        static_cast<double>(results.latency.CountAbove(b.capacity_target));
+    double low, high;
+    ProportionBounds(late, total, &low, &high);
+    *met = late / total <= allowed;
+    if (high <= allowed || low > allowed || attempt == kMaxCapacityRetries ||
+        requests >= max_requests)
+      break;
+    requests = std::min(requests * 2, max_requests);
+  }
+  report.benchmark_name =
+      StrCat(b.name, "/rate:", static_cast<int64_t>(rate + 0.5));
+  report.counters["offered_rate"] = rate;
+  if (!report.error_occurred) report.counters["slo_met"] = *met ? 1 : 0;
+  return report;
+}
+
+// Search for the capacity of 'b', see Benchmark::FindCapacity(), starting
+// from the rate of its ordinary runs, 'reports', and return a report for
+// each probe, by rate, followed by "<name>_capacity". Returns nothing if no
+// ordinary run succeeded.
+std::vector<BenchmarkReporter::Run> FindCapacity(
+    const benchmark::internal::Benchmark::Instance& b,
+    const std::vector<BenchmarkReporter::Run>& reports) {
+  typedef BenchmarkReporter::Run Run;
+  std::vector<Run> results;
+  double service_rate = 0;
+  int rated = 0;
+  for (const Run& report : reports) {
+    if (report.error_occurred || report.real_accumulated_time <= 0) continue;
+    service_rate +=
+        static_cast<double>(report.iterations) / report.real_accumulated_time;
+    ++rated;
+  }
+  if (rated == 0) return results;
+  service_rate /= rated;
+  const double min_time =
+      !IsZero(b.min_time) ? b.min_time : FLAGS_benchmark_min_time;
+
+  // The last rate met is the highest, see SearchCapacity().
+  Run capacity;
+  const internal::CapacityBounds bounds =
+      internal::SearchCapacity(service_rate, [&](double rate) {
+        bool met = false;
+        results.push_back(RunCapacityProbe(b, rate, min_time, &met));
+        if (results.back().error_occurred) return internal::kProbeFailed;
+        if (!met) return internal::kTargetMissed;
+        capacity = results.back();
+        return internal::kTargetMet;
+      });
+  if (bounds.failed) capacity = results.back();
+  std::stable_sort(results.begin(), results.end(),
+                   [](const Run& lhs, const Run& rhs) {
+                     return lhs.counters.at("offered_rate") <
+                            rhs.counters.at("offered_rate");
+                   });
+
+  if (bounds.failed) {
+    capacity.counters.clear();
+  } else if (IsZero(bounds.met_rate)) {
+    capacity.error_occurred = true;
+    capacity.error_message = StrCat(
+        "the target is missed at ", static_cast<int64_t>(bounds.missed_rate),
+        " requests/s, the lowest rate tried");
+  } else {
+    capacity.counters.erase("offered_rate");
+    capacity.counters.erase("slo_met");
+    capacity.counters["capacity"] = bounds.met_rate;
+    // The target was met at every rate tried.
+    if (IsZero(bounds.missed_rate)) capacity.report_label = "lower bound";
+  }
+  capacity.benchmark_name = b.name + "_capacity";
+  results.push_back(capacity);
+  return results;
+}
+
 std::vector<BenchmarkReporter::Run> RunBenchmark(
     const benchmark::internal::Benchmark::Instance& b,
-    std::vector<BenchmarkReporter::Run>* complexity_reports) {
+    std::vector<BenchmarkReporter::Run>* complexity_reports,
+    WeakScalingBaselines* weak_scaling_baselines,
+    RelativeBaselines* relative_baselines,
+    SensitivityRuns* sensitivity_runs, const std::vector<PlannedRun>* replay,
+    std::vector<PlannedRun>* measured_runs) {
   std::vector<BenchmarkReporter::Run> reports;  // return value
 
   const bool has_explicit_iteration_count = b.iterations != 0;
   size_t iters = has_explicit_iteration_count ? b.iterations : 1;
-  std::unique_ptr<internal::ThreadManager> manager;
-  std::vector<std::thread> pool(b.threads - 1);
-  const int repeats =
+  int repeats =
       b.repetitions != 0 ? b.repetitions : FLAGS_benchmark_repetitions;
+  if (replay != nullptr) repeats = static_cast<int>(replay->size());
+
+  // The run-wide hooks run once around all the runs below and get a State of
+  // their own. Errors reported through it fail the instance.
+  internal::ThreadManager once_manager(1);
+  internal::ThreadTimer once_timer;
+  State once_state(iters, b.arg, 0, b.threads, &once_timer, &once_manager,
+                   replay != nullptr && !replay->empty() ? replay->front().seed
+                                                         : NextRunSeed());
+  const double setup_start = ChronoClockNow();
+  b.benchmark->SetUpOnce(once_state);
+  const double setup_once_time = ChronoClockNow() - setup_start;
+  {
+    MutexLock l(once_manager.GetBenchmarkMutex());
+    if (once_manager.results.has_error_) {
+      reports.push_back(CreateRunReport(b, once_manager.results, 0, 0));
+      return reports;
+    }
+  }
   const bool report_aggregates_only =
       repeats != 1 &&
       (b.report_mode == internal::RM_Unspecified
            ? FLAGS_benchmark_report_aggregates_only
            : b.report_mode == internal::RM_ReportAggregatesOnly);
+  // All the runs, in order, and those reported, for the suspicious results
+  // checks.
+  std::vector<TrialRun> runs;
+  std::vector<TrialRun> reported_runs;
   for (int repetition_num = 0; repetition_num < repeats; repetition_num++) {
+    double prev_perf_events_per_iter = 0;
+    // A replayed run is measured once, with the iteration count it had.
+    const PlannedRun* planned = nullptr;
+    if (replay != nullptr) {
+      planned = &(*replay)[repetition_num];
+      iters = planned->iterations;
+    }
     for (;;) {
       // Try benchmark
       VLOG(2) << "Running " << b.name << " for " << iters << "\n";
 
-      manager.reset(new internal::ThreadManager(b.threads));
-      for (std::size_t ti = 0; ti < pool.size(); ++ti) {
-        pool[ti] = std::thread(&RunInThread, &b, iters,
-                               static_cast<int>(ti + 1), manager.get());
-      }
-      RunInThread(&b, iters, 0, manager.get());
-      manager->WaitForAllThreads();
-      for (std::thread& thread : pool) thread.join();
-      internal::ThreadManager::Result results;
-      {
-        MutexLock l(manager->GetBenchmarkMutex());
-        results = manager->results;
-      }
-      manager.reset();
-      // Adjust real/manual time stats since they were reported per thread.
-      results.real_time_used /= b.threads;
-      results.manual_time_used /= b.threads;
+      internal::ThreadManager::Result results =
+          RunThreads(b, iters, nullptr, planned);
 
       VLOG(2) << "Ran in " << results.cpu_time_used << "/"
               << results.real_time_used << "\n";
+      if (!results.has_error_) runs.push_back(MakeTrialRun(b, results, iters));
 
       // Base decisions off of real time if requested by this benchmark.
-      double seconds = results.cpu_time_used;
-      if (b.use_manual_time) {
-        seconds = results.manual_time_used;
-      } else if (b.use_real_time) {
-        seconds = results.real_time_used;
-      }
+      const double seconds = MeasuredSeconds(b, results);
 
       const double min_time =
           !IsZero(b.min_time) ? b.min_time : FLAGS_benchmark_min_time;
 
+      // With a perf event as the primary metric the run is also significant
+      // as soon as the event count per iteration has converged.
+      bool perf_event_converged = false;
+      if (results.perf_event_threads == b.threads) {
+        const double per_iter =
+            results.perf_event_count / (static_cast<double>(iters) * b.threads);
+        perf_event_converged = internal::PerfEventCountConverged(
+            results.perf_event_count, per_iter, prev_perf_events_per_iter);
+        prev_perf_events_per_iter = per_iter;
+      }
+
       // Determine if this run should be reported; Either it has
       // run for a sufficient amount of time or because an error was reported.
       const bool should_report =  repetition_num > 0
         || has_explicit_iteration_count // An exact iteration count was requested
+        || planned != nullptr // The iteration count is replayed
         || results.has_error_
         || iters >= kMaxIterations
         || seconds >= min_time // the elapsed time is large enough
+        || perf_event_converged // the primary perf event count is stable
         // CPU time is specified but the elapsed real time greatly exceeds the
         // minimum time. Note that user provided timers are except from this
         // sanity check.
@@ -355,6 +1716,13 @@ std::vector<BenchmarkReporter::Run> RunBenchmark(
         if (!report.error_occurred && b.complexity != oNone)
           complexity_reports->push_back(report);
         reports.push_back(report);
+        reported_runs.push_back(MakeTrialRun(b, results, iters));
+        PlannedRun measured;
+        measured.name = b.name;
+        measured.iterations = iters;
+        measured.seed = results.seed;
+        measured.cpus = results.cpus;
+        measured_runs->push_back(measured);
         break;
       }
 
@@ -370,6 +1738,14 @@ std::vector<BenchmarkReporter::Run> RunBenchmark(
       multiplier = is_significant ? multiplier : std::min(10.0, multiplier);
       if (multiplier <= 1.0) multiplier = 2.0;
       double next_iters = std::max(multiplier * iters, iters + 1.0);
+      // With a perf event as the primary metric, run just long enough to
+      // count enough events if that comes before the minimum time.
+      if (results.perf_event_threads == b.threads) {
+        const double event_iters = internal::NextPerfEventIterations(
+            static_cast<double>(iters), results.perf_event_count);
+        if (event_iters > 0)
+          next_iters = std::max(std::min(next_iters, event_iters), iters + 1.0);
+      }
       if (next_iters > kMaxIterations) {
         next_iters = kMaxIterations;
       }
@@ -377,14 +1753,94 @@ std::vector<BenchmarkReporter::Run> RunBenchmark(
       iters = static_cast<int>(next_iters + 0.5);
     }
   }
+  if (FLAGS_benchmark_check_suspicious)
+    MarkSuspiciousRuns(b, runs, reported_runs, &reports);
+  if (b.working_set_iterations != 0) AddWorkingSetCounters(b, &reports);
+  if (b.call_count_iterations != 0) AddCallCountCounters(b, &reports);
+  if (!FLAGS_benchmark_interference_cpus.empty())
+    AddInterferenceCounters(b, &reports);
+  std::vector<BenchmarkReporter::Run> capacity;
+  if (b.capacity_percentile > 0) capacity = FindCapacity(b, reports);
+
+  const double teardown_start = ChronoClockNow();
+  b.benchmark->TearDownOnce(once_state);
+  const double teardown_once_time = ChronoClockNow() - teardown_start;
+  {
+    MutexLock l(once_manager.GetBenchmarkMutex());
+    for (BenchmarkReporter::Run& report : reports) {
+      if (report.error_occurred) continue;
+      if (once_manager.results.has_error_) {
+        report.error_occurred = true;
+        report.error_message = once_manager.results.error_message_;
+      } else if (b.report_hook_times) {
+        report.counters["setup_once"] = setup_once_time;
+        report.counters["teardown_once"] = teardown_once_time;
+      }
+    }
+  }
+  if (b.weak_scaling)
+    AddWeakScalingEfficiency(b, &reports, weak_scaling_baselines);
+
   // Calculate additional statistics
   auto stat_reports = ComputeStats(reports);
+  if (!b.baseline.empty()) {
+    auto it = relative_baselines->find(b.baseline);
+    if (it != relative_baselines->end())
+      AddRelativeCounters(b, &it->second, &reports, &stat_reports);
+  } else if (b.is_baseline) {
+    AddRelativeCounters(b, nullptr, &reports, &stat_reports);
+  }
+  if (b.is_baseline) (*relative_baselines)[b.name] = reports;
+
+  // The aggregates are as suspicious as the runs they summarize.
+  for (const BenchmarkReporter::Run& report : reports) {
+    if (report.suspicious.empty()) continue;
+    for (BenchmarkReporter::Run& stat : stat_reports)
+      stat.suspicious = report.suspicious;
+    break;
+  }
+  stat_reports.insert(stat_reports.end(), capacity.begin(), capacity.end());
+  // The runs which describe the whole family, as opposed to this instance.
+  const size_t family_begin = stat_reports.size();
   if ((b.complexity != oNone) && b.last_benchmark_instance) {
     auto additional_run_stats = ComputeBigO(*complexity_reports);
     stat_reports.insert(stat_reports.end(), additional_run_stats.begin(),
                         additional_run_stats.end());
+    if (b.piecewise_complexity) {
+      auto segment_stats =
+          ComputePiecewiseBigO(*complexity_reports, b.complexity_bytes_per_n,
+                               CPUInfo::Get().caches);
+      stat_reports.insert(stat_reports.end(), segment_stats.begin(),
+                          segment_stats.end());
+    }
     complexity_reports->clear();
   }
+  if (b.analyze_sensitivity) {
+    std::vector<int> config = b.arg;
+    config.push_back(b.threads);
+    for (const BenchmarkReporter::Run& report : reports) {
+      if (report.error_occurred || report.iterations == 0 ||
+          MeasuredTimePerIteration(b, report) <= 0) {
+        continue;
+      }
+      sensitivity_runs->configs.push_back(config);
+      sensitivity_runs->runs.push_back(report);
+    }
+    if (b.last_benchmark_instance) {
+      auto sensitivity = ComputeSensitivity(b, *sensitivity_runs);
+      stat_reports.insert(stat_reports.end(), sensitivity.begin(),
+                          sensitivity.end());
+      *sensitivity_runs = SensitivityRuns();
+    }
+  }
+
+  if (b.core_type != nullptr) {
+    for (size_t i = 0; i < stat_reports.size(); ++i) {
+      stat_reports[i].core_type = b.core_type->name;
+      if (i >= family_begin)
+        stat_reports[i].benchmark_name += "/core_type:" + b.core_type->name;
+    }
+  }
 
   if (report_aggregates_only) reports.clear();
   reports.insert(reports.end(), stat_reports.begin(), stat_reports.end());
@@ -396,10 +1852,15 @@ std::vector<BenchmarkReporter::Run> RunBenchmark(
 
 State::State(size_t max_iters, const std::vector<int>& ranges, int thread_i,
              int n_threads, internal::ThreadTimer* timer,
-             internal::ThreadManager* manager)
+             internal::ThreadManager* manager, uint64_t run_seed)
     : started_(false),
       finished_(false),
-      total_iterations_(max_iters + 1),
+      // With shared iterations the first KeepRunning() claims the first
+      // chunk.
+      total_iterations_(manager->shares_iterations() ? 1 : max_iters + 1),
+      shared_iterations_(manager->shares_iterations()),
+      arrival_interval_(0),
+      next_arrival_(0),
       range_(ranges),
       bytes_processed_(0),
       items_processed_(0),
@@ -409,11 +1870,21 @@ State::State(size_t max_iters, const std::vector<int>& ranges, int thread_i,
       thread_index(thread_i),
       threads(n_threads),
       max_iterations(max_iters),
+      seed(run_seed),
       timer_(timer),
       manager_(manager) {
   CHECK(max_iterations != 0) << "At least one iteration must be run";
   CHECK(total_iterations_ != 0) << "max iterations wrapped around";
   CHECK_LT(thread_index, threads) << "thread_index must be less than threads";
+  if (manager->arrival_rate() > 0) {
+    arrival_interval_ = std::max<int64_t>(
+        SecondsToStampTicks(threads / manager->arrival_rate()), 1);
+  }
+}
+
+uint64_t State::thread_seed() const {
+  return internal::MixSeed(seed ^ (static_cast<uint64_t>(thread_index + 1) *
+                                   0x9E3779B97F4A7C15ull));
 }
 
 void State::PauseTiming() {
@@ -441,10 +1912,61 @@ void State::SkipWithError(const char* msg) {
   if (timer_->running()) timer_->StopTimer();
 }
 
+size_t State::ClaimIterations() {
+  if (!shared_iterations_ || error_occurred_) return 0;
+  return manager_->ClaimIterations(thread_index);
+}
+
 void State::SetIterationTime(double seconds) {
   timer_->SetIterationTime(seconds);
 }
 
+void State::RecordLatency(double seconds) { timer_->RecordLatency(seconds); }
+
+void State::RecordLatency(const std::string& name, double seconds) {
+  timer_->RecordLatency(timer_->LatencyIndex(name), seconds);
+}
+
+int State::LatencyIndex(const std::string& name) {
+  return timer_->LatencyIndex(name);
+}
+
+void State::RecordLatency(int index, double seconds) {
+  timer_->RecordLatency(index, seconds);
+}
+
+void State::RecordLatencySince(int64_t stamp) {
+  timer_->RecordLatency(SecondsSinceStamp(stamp));
+}
+
+void State::RecordLatencySince(const std::string& name, int64_t stamp) {
+  timer_->RecordLatency(timer_->LatencyIndex(name), SecondsSinceStamp(stamp));
+}
+
+int64_t State::WaitForArrival() {
+  if (arrival_interval_ == 0) return Stamp();
+  const int64_t arrival = next_arrival_;
+  next_arrival_ += arrival_interval_;
+  // Sleep through long waits and spin through the end of them, well ahead of
+  // the arrival since waking up late would delay the request.
+  for (int64_t now = Stamp(); now < arrival; now = Stamp()) {
+    const double remaining = StampTicksToSeconds(arrival - now);
+    if (remaining > kArrivalSleepMargin * 2) {
+      std::this_thread::sleep_for(
+          std::chrono::duration<double>(remaining - kArrivalSleepMargin));
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  return arrival;
+}
+
+Executor& State::executor() {
+  std::vector<int> cpus;
+  ParseCPUList(FLAGS_benchmark_executor_cpus, &cpus);
+  return internal::GetExecutor(FLAGS_benchmark_executor_workers, cpus);
+}
+
 void State::SetLabel(const char* label) {
   MutexLock l(manager_->GetBenchmarkMutex());
   manager_->results.report_label_ = label;
@@ -453,7 +1975,10 @@ void State::SetLabel(const char* label) {
 void State::StartKeepRunning() {
   CHECK(!started_ && !finished_);
   started_ = true;
-  manager_->StartStopBarrier();
+  manager_->StartStopBarrier(true);
+  // The threads take turns, so that the requests arrive evenly spaced.
+  if (arrival_interval_ != 0)
+    next_arrival_ = Stamp() + arrival_interval_ * thread_index / threads;
   if (!error_occurred_) ResumeTiming();
 }
 
@@ -464,16 +1989,227 @@ void State::FinishKeepRunning() {
   }
   // Total iterations has now wrapped around zero. Fix this.
   total_iterations_ = 1;
+  if (shared_iterations_) {
+    total_iterations_ +=
+        max_iterations - manager_->claimed_iterations(thread_index);
+  }
   finished_ = true;
-  manager_->StartStopBarrier();
+  manager_->StartStopBarrier(false);
 }
 
 namespace internal {
 namespace {
 
-void RunBenchmarks(const std::vector<Benchmark::Instance>& benchmarks,
-                           BenchmarkReporter* console_reporter,
-                           BenchmarkReporter* file_reporter) {
+// Returns the flags which affect the measurements, as recorded in a
+// manifest.
+std::vector<std::pair<std::string, std::string> > MeasurementFlags() {
+  std::vector<std::pair<std::string, std::string> > flags;
+  flags.emplace_back("benchmark_filter", FLAGS_benchmark_filter);
+  flags.emplace_back("benchmark_min_time", StrCat(FLAGS_benchmark_min_time));
+  flags.emplace_back("benchmark_repetitions",
+                     StrCat(FLAGS_benchmark_repetitions));
+  flags.emplace_back("benchmark_report_schedstat",
+                     StrCat(FLAGS_benchmark_report_schedstat));
+  flags.emplace_back("benchmark_primary_metric",
+                     FLAGS_benchmark_primary_metric);
+  flags.emplace_back("benchmark_topdown", StrCat(FLAGS_benchmark_topdown));
+  flags.emplace_back("benchmark_check_suspicious",
+                     StrCat(FLAGS_benchmark_check_suspicious));
+  flags.emplace_back("benchmark_allocator", FLAGS_benchmark_allocator);
+  flags.emplace_back("benchmark_executor_workers",
+                     StrCat(FLAGS_benchmark_executor_workers));
+  flags.emplace_back("benchmark_executor_cpus", FLAGS_benchmark_executor_cpus);
+  flags.emplace_back("benchmark_core_types", FLAGS_benchmark_core_types);
+  flags.emplace_back("benchmark_sweep_file", FLAGS_benchmark_sweep_file);
+  flags.emplace_back("benchmark_timer", FLAGS_benchmark_timer);
+  flags.emplace_back("benchmark_interference_cpus",
+                     FLAGS_benchmark_interference_cpus);
+  return flags;
+}
+
+// The instances to run, in order, with the runs to replay for each if a
+// manifest is replayed.
+typedef std::vector<std::pair<const Benchmark::Instance*,
+                              std::vector<PlannedRun> > >
+    Schedule;
+
+Schedule ScheduleReplay(const std::vector<Benchmark::Instance>& benchmarks,
+                        const Manifest& replay) {
+  // The runs to replay do not depend on the flags which choose the
+  // benchmarks and their iteration counts, but their results do on the
+  // others.
+  const auto current_flags = MeasurementFlags();
+  for (const auto& flag : replay.flags) {
+    if (flag.first == "benchmark_filter" ||
+        flag.first == "benchmark_min_time" ||
+        flag.first == "benchmark_repetitions")
+      continue;
+    for (const auto& current : current_flags) {
+      if (current.first == flag.first && current.second != flag.second) {
+        GetErrorLogInstance()
+            << "--" << flag.first << " was '" << flag.second
+            << "' when the replayed manifest was written and is '"
+            << current.second << "' now.\n";
+      }
+    }
+  }
+  Schedule schedule;
+  std::set<std::string> missing;
+  for (const PlannedRun& planned : replay.runs) {
+    if (!schedule.empty() && schedule.back().first->name == planned.name) {
+      schedule.back().second.push_back(planned);
+      continue;
+    }
+    auto it = std::find_if(benchmarks.begin(), benchmarks.end(),
+                           [&](const Benchmark::Instance& instance) {
+                             return instance.name == planned.name;
+                           });
+    if (it == benchmarks.end()) {
+      if (missing.insert(planned.name).second) {
+        GetErrorLogInstance()
+            << "The replayed benchmark '" << planned.name
+            << "' is not registered or does not match the filter; its runs "
+               "are skipped.\n";
+      }
+      continue;
+    }
+    schedule.emplace_back(&*it, std::vector<PlannedRun>(1, planned));
+  }
+  return schedule;
+}
+
+// Splits the value of --benchmark_core_types into the names of the core
+// types. Returns false if one is empty.
+bool ParseCoreTypes(const std::string& list, std::vector<std::string>* types) {
+  types->clear();
+  std::istringstream ss(list);
+  std::string type;
+  while (std::getline(ss, type, ',')) {
+    if (type.empty()) return false;
+    types->push_back(type);
+  }
+  return !list.empty() && list.back() != ',';
+}
+
+// Replaces 'benchmarks' with a copy of them for each core type chosen by
+// --benchmark_core_types, see ExpandByCoreType().
+void ExpandByChosenCoreTypes(std::vector<Benchmark::Instance>* benchmarks) {
+  const std::vector<CPUInfo::CoreType>& detected = CPUInfo::Get().core_types;
+  std::vector<std::string> names;
+  ParseCoreTypes(FLAGS_benchmark_core_types, &names);
+  const bool all = names.size() == 1 && names[0] == "all";
+  std::vector<const CPUInfo::CoreType*> types;
+  for (const CPUInfo::CoreType& type : detected) {
+    if (all || std::find(names.begin(), names.end(), type.name) != names.end())
+      types.push_back(&type);
+  }
+  for (const std::string& name : names) {
+    if (all) break;
+    const bool found = std::any_of(
+        detected.begin(), detected.end(),
+        [&](const CPUInfo::CoreType& type) { return type.name == name; });
+    if (!found) {
+      GetErrorLogInstance() << "The core type '" << name
+                            << "' is not found on this CPU; it is skipped.\n";
+    }
+  }
+  if (types.empty()) {
+    GetErrorLogInstance()
+        << "No core type to run on was found: the CPU is not hybrid or its "
+           "core types are not known. The benchmarks are run once, "
+           "unpinned.\n";
+    return;
+  }
+  ExpandByCoreType(types, benchmarks);
+}
+
+// Returns the names of the counters which the library may add to the runs of
+// 'benchmarks', see BenchmarkReporter::Context::library_counters.
+std::set<std::string> LibraryCounterNames(
+    const std::vector<Benchmark::Instance>& benchmarks) {
+  std::set<std::string> names;
+  if (FLAGS_benchmark_report_schedstat) {
+    names.insert("sched_wait");
+    names.insert("off_cpu");
+  }
+  if (!PrimaryPerfEvent().empty()) names.insert(PrimaryPerfEvent());
+  if (FLAGS_benchmark_topdown) {
+    names.insert({"topdown_frontend", "topdown_bad_speculation",
+                  "topdown_backend", "topdown_retiring"});
+    if (TopdownCounter::HasLevel2()) {
+      names.insert({"topdown_fetch_latency", "topdown_fetch_bandwidth",
+                    "topdown_branch_mispredicts", "topdown_machine_clears",
+                    "topdown_heavy_operations", "topdown_light_operations",
+                    "topdown_memory_bound", "topdown_core_bound"});
+    }
+  }
+  if (!FLAGS_benchmark_interference_cpus.empty()) {
+    names.insert({"interference_llc", "interference_bandwidth",
+                  "interference_score"});
+  }
+  // The levels of each parameter of each benchmark analyzed for sensitivity.
+  typedef std::pair<const Benchmark*, const CPUInfo::CoreType*> FamilyKey;
+  std::map<FamilyKey, std::vector<std::set<int> > > levels;
+  for (const Benchmark::Instance& b : benchmarks) {
+    if (b.measure_process_cpu_time) names.insert("extra_threads");
+    if (SelectedAllocator(b) != kDefaultAllocator)
+      names.insert({"allocs", "alloc_bytes"});
+    if (b.shared_iterations)
+      names.insert({"thread_iterations_min", "thread_iterations_max"});
+    if (b.report_hook_times) {
+      names.insert({"setup_once", "teardown_once", "setup_thread",
+                    "teardown_thread"});
+    }
+    if (b.working_set_iterations != 0)
+      names.insert({"ws_written", "ws_accessed"});
+    if (b.call_count_iterations != 0) names.insert("calls");
+    if (b.weak_scaling) names.insert("weak_scaling_efficiency");
+    if (!b.baseline.empty() || b.is_baseline) {
+      names.insert({"speedup", "speedup_ci", "throughput_ratio",
+                    "throughput_ratio_ci"});
+    }
+    if (b.capacity_percentile > 0) {
+      names.insert({"latency_mean", "latency_p50", "latency_p90",
+                    "latency_p99", "latency_p999", "latency_max",
+                    "offered_rate", "slo_met", "capacity"});
+    }
+    if (b.analyze_sensitivity) {
+      std::vector<std::set<int> >& family =
+          levels[FamilyKey(b.benchmark, b.core_type)];
+      family.resize(b.arg.size() + 1);
+      for (size_t p = 0; p < b.arg.size(); ++p) family[p].insert(b.arg[p]);
+      family.back().insert(b.threads);
+      names.insert({"var:interactions", "var:noise", "best_ci_low",
+                    "best_ci_high"});
+    }
+  }
+  // Only the parameters which vary are reported, as in ComputeSensitivity().
+  for (const Benchmark::Instance& b : benchmarks) {
+    if (!b.analyze_sensitivity) continue;
+    const std::vector<std::set<int> >& family =
+        levels[FamilyKey(b.benchmark, b.core_type)];
+    for (size_t p = 0; p < family.size(); ++p) {
+      if (family[p].size() < 2) continue;
+      std::string param = "threads";
+      if (p < b.arg.size()) {
+        param = p < b.arg_names->size() && !(*b.arg_names)[p].empty()
+                    ? (*b.arg_names)[p]
+                    : StrCat("arg", p);
+      }
+      names.insert("var:" + param);
+    }
+  }
+  return names;
+}
+
+// Returns false if the preflight checks failed and
+// --benchmark_preflight=fail, in which case no benchmark is run. If 'replay'
+// is not null its runs are replayed instead of running 'benchmarks', and if
+// 'manifest_out' is not null the manifest of the run is written to it.
+bool RunBenchmarks(const std::vector<Benchmark::Instance>& benchmarks,
+                   BenchmarkReporter* console_reporter,
+                   BenchmarkReporter* file_reporter, const Manifest* replay,
+                   std::ostream* manifest_out) {
   // Note the file_reporter can be null.
   CHECK(console_reporter != nullptr);
 
@@ -494,9 +2230,70 @@ void RunBenchmarks(const std::vector<Benchmark::Instance>& benchmarks,
   // Print header here
   BenchmarkReporter::Context context;
   context.name_field_width = name_field_width;
+  context.check_suspicious = FLAGS_benchmark_check_suspicious;
+  context.library_counters = LibraryCounterNames(benchmarks);
+  bool preflight_failed = false;
+  if (!FLAGS_benchmark_preflight.empty()) {
+    context.preflight = FLAGS_benchmark_preflight;
+    context.preflight_checks = CheckHostState(
+        ReadHostState(context.cpu_info, context.timer_info));
+    for (const PreflightCheck& check : context.preflight_checks)
+      preflight_failed |= !check.ok;
+  }
+  const bool run = !preflight_failed || FLAGS_benchmark_preflight != "fail";
+  if (!PrimaryPerfEvent().empty()) {
+    if (PerfCounter(PrimaryPerfEvent()).ok()) {
+      context.primary_metric = PrimaryPerfEvent();
+    } else {
+      GetErrorLogInstance()
+          << "Failed to open the perf event '" << PrimaryPerfEvent()
+          << "'; using time as the primary metric instead.\n";
+    }
+  }
+  if (FLAGS_benchmark_topdown) {
+    std::string error;
+    if (!TopdownCounter::IsSupported(&error)) {
+      GetErrorLogInstance() << "Top-down analysis is not available: " << error
+                            << ". The topdown_* counters are not reported.\n";
+    } else if (!TopdownCounter().ok()) {
+      GetErrorLogInstance()
+          << "Failed to open the top-down events; perf may be restricted by "
+             "/proc/sys/kernel/perf_event_paranoid. The topdown_* counters "
+             "are not reported.\n";
+    }
+  }
 
-  // Keep track of runing times of all instances of current benchmark
-  std::vector<BenchmarkReporter::Run> complexity_reports;
+  if (!IsAllocatorDispatched()) {
+    bool selects_allocator = !FLAGS_benchmark_allocator.empty();
+    for (const Benchmark::Instance& benchmark : benchmarks)
+      selects_allocator |= benchmark.allocator != kDefaultAllocator;
+    if (selects_allocator) {
+      GetErrorLogInstance()
+          << "An allocator was selected but operator new is not dispatched; "
+             "link with the benchmark_allocator library to use it. The "
+             "system allocator is used instead.\n";
+    }
+  }
+
+  // Keep track of runing times of all instances of each benchmark, on each
+  // core type. Those of different benchmarks may be interleaved when
+  // compared to one another.
+  typedef std::pair<const Benchmark*, const CPUInfo::CoreType*> FamilyKey;
+  std::map<FamilyKey, std::vector<BenchmarkReporter::Run> > complexity_reports;
+  std::map<const CPUInfo::CoreType*, WeakScalingBaselines>
+      weak_scaling_baselines;
+  RelativeBaselines relative_baselines;
+  std::map<FamilyKey, SensitivityRuns> sensitivity_runs;
+  Manifest manifest;
+  manifest.flags = MeasurementFlags();
+
+  Schedule schedule;
+  if (replay != nullptr) {
+    schedule = ScheduleReplay(benchmarks, *replay);
+  } else {
+    for (const Benchmark::Instance& benchmark : benchmarks)
+      schedule.emplace_back(&benchmark, std::vector<PlannedRun>());
+  }
 
   // We flush streams after invoking reporter methods that write to them. This
   // ensures users get timely updates even when streams are not line-buffered.
@@ -510,21 +2307,37 @@ void RunBenchmarks(const std::vector<Benchmark::Instance>& benchmarks,
       (!file_reporter || file_reporter->ReportContext(context))) {
     flushStreams(console_reporter);
     flushStreams(file_reporter);
-    for (const auto& benchmark : benchmarks) {
-      std::vector<BenchmarkReporter::Run> reports =
-          RunBenchmark(benchmark, &complexity_reports);
-      console_reporter->ReportRuns(reports);
-      if (file_reporter) file_reporter->ReportRuns(reports);
-      flushStreams(console_reporter);
-      flushStreams(file_reporter);
+    if (!run) {
+      GetErrorLogInstance() << "The preflight checks failed; not running the "
+                               "benchmarks (--benchmark_preflight=fail).\n";
+    } else {
+      for (const auto& scheduled : schedule) {
+        const Benchmark::Instance& benchmark = *scheduled.first;
+        const FamilyKey family(benchmark.benchmark, benchmark.core_type);
+        std::vector<BenchmarkReporter::Run> reports = RunBenchmark(
+            benchmark, &complexity_reports[family],
+            &weak_scaling_baselines[benchmark.core_type], &relative_baselines,
+            &sensitivity_runs[family],
+            replay != nullptr ? &scheduled.second : nullptr, &manifest.runs);
+        console_reporter->ReportRuns(reports);
+        if (file_reporter) file_reporter->ReportRuns(reports);
+        flushStreams(console_reporter);
+        flushStreams(file_reporter);
+      }
     }
   }
   console_reporter->Finalize();
   if (file_reporter) file_reporter->Finalize();
   flushStreams(console_reporter);
   flushStreams(file_reporter);
+  if (manifest_out != nullptr) {
+    WriteManifest(*manifest_out, manifest);
+    std::flush(*manifest_out);
+  }
+  return run;
 }
 
+// Returns the reporter for the format 'name', or null if there is none.
 std::unique_ptr<BenchmarkReporter> CreateReporter(
     std::string const& name, ConsoleReporter::OutputOptions output_opts) {
   typedef std::unique_ptr<BenchmarkReporter> PtrType;
@@ -535,13 +2348,29 @@ std::unique_ptr<BenchmarkReporter> CreateReporter(
   } else if (name == "csv") {
     return PtrType(new CSVReporter);
   } else {
-    std::cerr << "Unexpected format: '" << name << "'\n";
-    std::exit(1);
+    return PtrType();
   }
 }
 
 }  // end namespace
 
+void ExpandByCoreType(const std::vector<const CPUInfo::CoreType*>& types,
+                      std::vector<Benchmark::Instance>* benchmarks) {
+  std::vector<Benchmark::Instance> expanded;
+  expanded.reserve(benchmarks->size() * types.size());
+  for (const Benchmark::Instance& benchmark : *benchmarks) {
+    for (const CPUInfo::CoreType* type : types) {
+      const std::string suffix = "/core_type:" + type->name;
+      Benchmark::Instance instance = benchmark;
+      instance.name += suffix;
+      if (!instance.baseline.empty()) instance.baseline += suffix;
+      instance.core_type = type;
+      expanded.push_back(instance);
+    }
+  }
+  benchmarks->swap(expanded);
+}
+
 bool IsZero(double n) {
   return std::abs(n) < std::numeric_limits<double>::epsilon();
 }
@@ -567,6 +2396,21 @@ ConsoleReporter::OutputOptions GetOutputOptions(bool force_no_color) {
 
 }  // end namespace internal
 
+namespace {
+
+// Whether the last call to RunSpecifiedBenchmarks() stopped on an error.
+bool run_failed = false;
+
+// Report 'message' on 'err', record the failure and return the number of
+// benchmarks run.
+size_t FailRun(std::ostream& err, const std::string& message) {
+  err << message << std::endl;
+  run_failed = true;
+  return 0;
+}
+
+}  // end namespace
+
 size_t RunSpecifiedBenchmarks() {
   return RunSpecifiedBenchmarks(nullptr, nullptr);
 }
@@ -575,8 +2419,11 @@ size_t RunSpecifiedBenchmarks(BenchmarkReporter* console_reporter) {
   return RunSpecifiedBenchmarks(console_reporter, nullptr);
 }
 
+bool RunSpecifiedBenchmarksFailed() { return run_failed; }
+
 size_t RunSpecifiedBenchmarks(BenchmarkReporter* console_reporter,
                               BenchmarkReporter* file_reporter) {
+  run_failed = false;
   std::string spec = FLAGS_benchmark_filter;
   if (spec.empty() || spec == "all")
     spec = ".";  // Regexp that matches all benchmarks
@@ -588,6 +2435,10 @@ size_t RunSpecifiedBenchmarks(BenchmarkReporter* console_reporter,
   if (!console_reporter) {
     default_console_reporter = internal::CreateReporter(
           FLAGS_benchmark_format, internal::GetOutputOptions());
+    if (!default_console_reporter) {
+      return FailRun(std::cerr,
+                     "Unexpected format: '" + FLAGS_benchmark_format + "'");
+    }
     console_reporter = default_console_reporter.get();
   }
   auto& Out = console_reporter->GetOutputStream();
@@ -595,38 +2446,93 @@ size_t RunSpecifiedBenchmarks(BenchmarkReporter* console_reporter,
 
   std::string const& fname = FLAGS_benchmark_out;
   if (fname.empty() && file_reporter) {
-    Err << "A custom file reporter was provided but "
-           "--benchmark_out=<file> was not specified."
-        << std::endl;
-    std::exit(1);
+    return FailRun(Err,
+                   "A custom file reporter was provided but "
+                   "--benchmark_out=<file> was not specified.");
   }
   if (!fname.empty()) {
     output_file.open(fname);
-    if (!output_file.is_open()) {
-      Err << "invalid file name: '" << fname << std::endl;
-      std::exit(1);
-    }
+    if (!output_file.is_open())
+      return FailRun(Err, "invalid file name: '" + fname);
     if (!file_reporter) {
       default_file_reporter = internal::CreateReporter(
           FLAGS_benchmark_out_format, ConsoleReporter::OO_None);
+      if (!default_file_reporter) {
+        return FailRun(
+            Err, "Unexpected format: '" + FLAGS_benchmark_out_format + "'");
+      }
       file_reporter = default_file_reporter.get();
     }
     file_reporter->SetOutputStream(&output_file);
     file_reporter->SetErrorStream(&output_file);
   }
 
+  Manifest replay;
+  if (!FLAGS_benchmark_replay.empty()) {
+    std::ifstream replay_file(FLAGS_benchmark_replay);
+    std::string error;
+    if (!replay_file.is_open()) {
+      return FailRun(Err, "cannot open the manifest to replay '" +
+                              FLAGS_benchmark_replay + "'");
+    }
+    if (!ReadManifest(replay_file, &replay, &error)) {
+      return FailRun(Err, "invalid manifest '" + FLAGS_benchmark_replay +
+                              "': " + error);
+    }
+  }
+  std::ofstream manifest_file;
+  if (!FLAGS_benchmark_manifest.empty()) {
+    manifest_file.open(FLAGS_benchmark_manifest);
+    if (!manifest_file.is_open()) {
+      return FailRun(Err, "invalid manifest file name: '" +
+                              FLAGS_benchmark_manifest + "'");
+    }
+  }
+
+  // The sweep changes the registered families, so it is only applied once.
+  static bool sweep_applied = false;
+  if (!FLAGS_benchmark_sweep_file.empty() && !sweep_applied) {
+    std::ifstream sweep_file(FLAGS_benchmark_sweep_file);
+    Sweep sweep;
+    std::string error;
+    if (!sweep_file.is_open()) {
+      return FailRun(Err, "cannot open the sweep file '" +
+                              FLAGS_benchmark_sweep_file + "'");
+    }
+    if (!ReadSweep(sweep_file, &sweep, &error)) {
+      return FailRun(Err, "invalid sweep file '" +
+                              FLAGS_benchmark_sweep_file + "': " + error);
+    }
+    if (!internal::ApplySweepInternal(sweep, &Err)) {
+      run_failed = true;
+      return 0;
+    }
+    sweep_applied = true;
+  }
+
   std::vector<internal::Benchmark::Instance> benchmarks;
-  if (!FindBenchmarksInternal(spec, &benchmarks, &Err)) return 0;
+  if (!FindBenchmarksInternal(spec, &benchmarks, &Err)) {
+    run_failed = true;
+    return 0;
+  }
 
   if (benchmarks.empty()) {
     Err << "Failed to match any benchmarks against regex: " << spec << "\n";
     return 0;
   }
+  if (!FLAGS_benchmark_core_types.empty())
+    internal::ExpandByChosenCoreTypes(&benchmarks);
 
   if (FLAGS_benchmark_list_tests) {
     for (auto const& benchmark : benchmarks) Out << benchmark.name << "\n";
   } else {
-    internal::RunBenchmarks(benchmarks, console_reporter, file_reporter);
+    if (!internal::RunBenchmarks(
+            benchmarks, console_reporter, file_reporter,
+            FLAGS_benchmark_replay.empty() ? nullptr : &replay,
+            FLAGS_benchmark_manifest.empty() ? nullptr : &manifest_file)) {
+      run_failed = true;
+      return 0;
+    }
   }
 
   return benchmarks.size();
@@ -647,6 +2553,20 @@ void PrintUsageAndExit() {
           "          [--benchmark_out_format=<json|console|csv>]\n"
           "          [--benchmark_color={auto|true|false}]\n"
           "          [--benchmark_counters_tabular={true|false}]\n"
+          "          [--benchmark_report_schedstat={true|false}]\n"
+          "          [--benchmark_primary_metric=<time|perf event>]\n"
+          "          [--benchmark_topdown={true|false}]\n"
+          "          [--benchmark_check_suspicious={true|false}]\n"
+          "          [--benchmark_allocator=<system|thread_cache|arena|slab>]\n"
+          "          [--benchmark_preflight=<warn|fail>]\n"
+          "          [--benchmark_manifest=<filename>]\n"
+          "          [--benchmark_replay=<manifest>]\n"
+          "          [--benchmark_executor_workers=<num_workers>]\n"
+          "          [--benchmark_executor_cpus=<cpu list>]\n"
+          "          [--benchmark_core_types=<all|type,...>]\n"
+          "          [--benchmark_sweep_file=<filename>]\n"
+          "          [--benchmark_interference_cpus=<cpu list>]\n"
+          "          [--benchmark_timer=<auto|chrono|tsc>]\n"
           "          [--v=<verbosity>]\n");
   exit(0);
 }
@@ -673,6 +2593,32 @@ void ParseCommandLineFlags(int* argc, char** argv) {
         ParseStringFlag(argv[i], "color_print", &FLAGS_benchmark_color) ||
         ParseBoolFlag(argv[i], "benchmark_counters_tabular",
                         &FLAGS_benchmark_counters_tabular) ||
+        ParseBoolFlag(argv[i], "benchmark_report_schedstat",
+                      &FLAGS_benchmark_report_schedstat) ||
+        ParseStringFlag(argv[i], "benchmark_primary_metric",
+                        &FLAGS_benchmark_primary_metric) ||
+        ParseBoolFlag(argv[i], "benchmark_topdown", &FLAGS_benchmark_topdown) ||
+        ParseBoolFlag(argv[i], "benchmark_check_suspicious",
+                      &FLAGS_benchmark_check_suspicious) ||
+        ParseStringFlag(argv[i], "benchmark_allocator",
+                        &FLAGS_benchmark_allocator) ||
+        ParseStringFlag(argv[i], "benchmark_preflight",
+                        &FLAGS_benchmark_preflight) ||
+        ParseStringFlag(argv[i], "benchmark_manifest",
+                        &FLAGS_benchmark_manifest) ||
+        ParseStringFlag(argv[i], "benchmark_replay",
+                        &FLAGS_benchmark_replay) ||
+        ParseInt32Flag(argv[i], "benchmark_executor_workers",
+                       &FLAGS_benchmark_executor_workers) ||
+        ParseStringFlag(argv[i], "benchmark_executor_cpus",
+                        &FLAGS_benchmark_executor_cpus) ||
+        ParseStringFlag(argv[i], "benchmark_core_types",
+                        &FLAGS_benchmark_core_types) ||
+        ParseStringFlag(argv[i], "benchmark_sweep_file",
+                        &FLAGS_benchmark_sweep_file) ||
+        ParseStringFlag(argv[i], "benchmark_interference_cpus",
+                        &FLAGS_benchmark_interference_cpus) ||
+        ParseStringFlag(argv[i], "benchmark_timer", &FLAGS_benchmark_timer) ||
         ParseInt32Flag(argv[i], "v", &FLAGS_v)) {
       for (int j = i; j != *argc - 1; ++j) argv[j] = argv[j + 1];
 
@@ -690,6 +2636,41 @@ void ParseCommandLineFlags(int* argc, char** argv) {
   if (FLAGS_benchmark_color.empty()) {
     PrintUsageAndExit();
   }
+  if (FLAGS_benchmark_primary_metric != "time" &&
+      !PerfCounter::IsValidEvent(FLAGS_benchmark_primary_metric)) {
+    PrintUsageAndExit();
+  }
+  AllocatorKind allocator;
+  if (!FLAGS_benchmark_allocator.empty() &&
+      !ParseAllocatorKind(FLAGS_benchmark_allocator, &allocator)) {
+    PrintUsageAndExit();
+  }
+  if (!FLAGS_benchmark_preflight.empty() &&
+      FLAGS_benchmark_preflight != "warn" &&
+      FLAGS_benchmark_preflight != "fail") {
+    PrintUsageAndExit();
+  }
+  std::vector<int> executor_cpus;
+  std::vector<int> interference_cpus;
+  std::vector<std::string> core_types;
+  if (FLAGS_benchmark_executor_workers < 0 ||
+      (!FLAGS_benchmark_executor_cpus.empty() &&
+       !ParseCPUList(FLAGS_benchmark_executor_cpus, &executor_cpus))) {
+    PrintUsageAndExit();
+  }
+  if (!FLAGS_benchmark_interference_cpus.empty() &&
+      !ParseCPUList(FLAGS_benchmark_interference_cpus, &interference_cpus)) {
+    PrintUsageAndExit();
+  }
+  if (!FLAGS_benchmark_core_types.empty() &&
+      !ParseCoreTypes(FLAGS_benchmark_core_types, &core_types)) {
+    PrintUsageAndExit();
+  }
+  if (FLAGS_benchmark_timer != "auto" && FLAGS_benchmark_timer != "chrono" &&
+      FLAGS_benchmark_timer != "tsc") {
+    PrintUsageAndExit();
+  }
+  requested_timer = FLAGS_benchmark_timer;
 }
 
 int InitializeStreams() {
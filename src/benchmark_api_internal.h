@@ -2,6 +2,7 @@
 #define BENCHMARK_API_INTERNAL_H
 
 #include "benchmark/benchmark.h"
+#include "sweep.h"
 
 #include <cmath>
 #include <iosfwd>
@@ -22,21 +23,50 @@ struct Benchmark::Instance {
   int range_multiplier;
   bool use_real_time;
   bool use_manual_time;
+  bool measure_process_cpu_time;
+  AllocatorKind allocator;
   BigO complexity;
   BigOFunc* complexity_lambda;
+  bool piecewise_complexity;
+  double complexity_bytes_per_n;
+  bool analyze_sensitivity;
+  const std::vector<std::string>* arg_names;
   UserCounters counters;
   const std::vector<Statistics>* statistics;
   bool last_benchmark_instance;
   int repetitions;
   double min_time;
   size_t iterations;
+  size_t working_set_iterations;
+  size_t call_count_iterations;
   int threads;  // Number of concurrent threads to us
+  bool weak_scaling;
+  bool shared_iterations;
+  double capacity_percentile;  // Zero unless the capacity is searched for.
+  double capacity_target;
+  bool report_hook_times;
+  std::string baseline;  // The name of the instance compared to, if any.
+  bool is_baseline;      // Whether another instance is compared to it.
+  // The core type whose CPUs the instance is run on, if it is run once per
+  // core type; see --benchmark_core_types.
+  const CPUInfo::CoreType* core_type;
 };
 
 bool FindBenchmarksInternal(const std::string& re,
                             std::vector<Benchmark::Instance>* benchmarks,
                             std::ostream* Err);
 
+// Overrides the settings of the registered families named in 'sweep', as
+// read from --benchmark_sweep_file. Returns false if it does not fit them.
+bool ApplySweepInternal(const Sweep& sweep, std::ostream* Err);
+
+// Replaces 'benchmarks' with a copy of each of them for each of 'types',
+// named after the type and run on its CPUs only. The copies of an instance
+// are run one after the other, so that the core types are compared under the
+// same conditions.
+void ExpandByCoreType(const std::vector<const CPUInfo::CoreType*>& types,
+                      std::vector<Benchmark::Instance>* benchmarks);
+
 bool IsZero(double n);
 
 ConsoleReporter::OutputOptions GetOutputOptions(bool force_no_color = false);
@@ -29,11 +29,14 @@
 #include <cstdlib>
 #include <cstring>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <set>
 #include <sstream>
 #include <thread>
 
+#include "allocator.h"
 #include "check.h"
 #include "commandlineflags.h"
 #include "complexity.h"
@@ -42,6 +45,7 @@
 #include "mutex.h"
 #include "re.h"
 #include "string_util.h"
+#include "sweep.h"
 #include "timers.h"
 
 namespace benchmark {
@@ -78,9 +82,18 @@ class BenchmarkFamilies {
                       std::vector<Benchmark::Instance>* benchmarks,
                       std::ostream* Err);
 
+  // Overrides the settings of the families named in 'sweep'. Returns false
+  // if the arguments of a family do not match its registered ones.
+  bool ApplySweep(const Sweep& sweep, std::ostream& Err);
+
  private:
   BenchmarkFamilies() {}
 
+  // Find the baseline of each instance in 'benchmarks' compared to one, and
+  // move the instance right after it.
+  static void OrderByBaseline(std::vector<Benchmark::Instance>* benchmarks,
+                              std::ostream& Err);
+
   std::vector<std::unique_ptr<Benchmark>> families_;
   Mutex mutex_;
 };
@@ -103,6 +116,66 @@ void BenchmarkFamilies::ClearBenchmarks() {
   families_.shrink_to_fit();
 }
 
+bool BenchmarkFamilies::ApplySweep(const Sweep& sweep, std::ostream& Err) {
+  MutexLock l(mutex_);
+  // Check the arguments of the whole sweep first, so that a sweep which does
+  // not fit leaves every family as it was registered.
+  for (const auto& entry : sweep) {
+    const FamilySweep& settings = entry.second;
+    for (const std::unique_ptr<Benchmark>& family : families_) {
+      if (!family || family->name_ != entry.first) continue;
+      // Replaced arguments need only match the names of the arguments, if
+      // any, and added ones the registered arguments as well.
+      int count = family->arg_names_.empty()
+                      ? -1
+                      : static_cast<int>(family->arg_names_.size());
+      if (settings.args.empty()) count = family->ArgsCnt();
+      std::vector<SweepArgs> swept = settings.args;
+      swept.insert(swept.end(), settings.added_args.begin(),
+                   settings.added_args.end());
+      for (const SweepArgs& args : swept) {
+        if (count == -1) count = static_cast<int>(args.size());
+        if (count != static_cast<int>(args.size())) {
+          Err << "The sweep of " << entry.first << " has " << args.size()
+              << " arguments but it takes " << count << "." << std::endl;
+          return false;
+        }
+      }
+    }
+  }
+
+  for (const auto& entry : sweep) {
+    const FamilySweep& settings = entry.second;
+    bool found = false;
+    for (std::unique_ptr<Benchmark>& family : families_) {
+      if (!family || family->name_ != entry.first) continue;
+      found = true;
+      if (!settings.args.empty()) family->args_.clear();
+      for (const SweepArgs& args : settings.args) family->Ranges(args);
+      for (const SweepArgs& args : settings.added_args) family->Ranges(args);
+      if (!settings.threads.empty()) {
+        family->thread_counts_.clear();
+        for (const auto& threads : settings.threads)
+          family->ThreadRange(threads.first, threads.second);
+      }
+      if (!IsZero(settings.min_time)) {
+        if (family->iterations_ != 0) {
+          Err << entry.first << " runs a fixed number of iterations; the "
+              << "min_time of its sweep is ignored." << std::endl;
+        } else {
+          family->MinTime(settings.min_time);
+        }
+      }
+      if (settings.repetitions != 0) family->Repetitions(settings.repetitions);
+    }
+    if (!found) {
+      Err << "The swept benchmark " << entry.first
+          << " is not registered; its sweep is ignored." << std::endl;
+    }
+  }
+  return true;
+}
+
 bool BenchmarkFamilies::FindBenchmarks(
     const std::string& spec, std::vector<Benchmark::Instance>* benchmarks,
     std::ostream* ErrStream) {
@@ -131,6 +204,15 @@ bool BenchmarkFamilies::FindBenchmarks(
         (family->thread_counts_.empty()
              ? &one_thread
              : &static_cast<const std::vector<int>&>(family->thread_counts_));
+    // A weakly scaled benchmark runs on 1 thread first, as the baseline of
+    // the efficiency of the other thread counts.
+    std::vector<int> weak_thread_counts;
+    if (family->weak_scaling_ && thread_counts->front() != 1) {
+      weak_thread_counts.push_back(1);
+      for (int num_threads : *thread_counts)
+        if (num_threads != 1) weak_thread_counts.push_back(num_threads);
+      thread_counts = &weak_thread_counts;
+    }
     const size_t family_size = family->args_.size() * thread_counts->size();
     // The benchmark will be run at least 'family_size' different inputs.
     // If 'family_size' is very large warn the user.
@@ -153,13 +235,28 @@ bool BenchmarkFamilies::FindBenchmarks(
         instance.range_multiplier = family->range_multiplier_;
         instance.min_time = family->min_time_;
         instance.iterations = family->iterations_;
+        instance.working_set_iterations = family->working_set_iterations_;
+        instance.call_count_iterations = family->call_count_iterations_;
         instance.repetitions = family->repetitions_;
         instance.use_real_time = family->use_real_time_;
         instance.use_manual_time = family->use_manual_time_;
+        instance.measure_process_cpu_time = family->measure_process_cpu_time_;
+        instance.allocator = family->allocator_;
         instance.complexity = family->complexity_;
         instance.complexity_lambda = family->complexity_lambda_;
+        instance.piecewise_complexity = family->piecewise_complexity_;
+        instance.complexity_bytes_per_n = family->complexity_bytes_per_n_;
+        instance.analyze_sensitivity = family->analyze_sensitivity_;
+        instance.arg_names = &family->arg_names_;
         instance.statistics = &family->statistics_;
         instance.threads = num_threads;
+        instance.weak_scaling = family->weak_scaling_;
+        instance.shared_iterations = family->shared_iterations_;
+        instance.capacity_percentile = family->capacity_percentile_;
+        instance.capacity_target = family->capacity_target_;
+        instance.report_hook_times = family->report_hook_times_;
+        instance.is_baseline = false;
+        instance.core_type = nullptr;
 
         // Add arguments to instance name
         size_t arg_i = 0;
@@ -185,6 +282,15 @@ bool BenchmarkFamilies::FindBenchmarks(
         if (family->repetitions_ != 0)
           instance.name += StringPrintF("/repeats:%d", family->repetitions_);
 
+        if (family->allocator_ != kDefaultAllocator) {
+          instance.name += StringPrintF(
+              "/allocator:%s", AllocatorKindName(family->allocator_));
+        }
+
+        if (family->measure_process_cpu_time_) {
+          instance.name += "/process_time";
+        }
+
         if (family->use_manual_time_) {
           instance.name += "/manual_time";
         } else if (family->use_real_time_) {
@@ -203,9 +309,81 @@ bool BenchmarkFamilies::FindBenchmarks(
       }
     }
   }
+  OrderByBaseline(benchmarks, Err);
   return true;
 }
 
+void BenchmarkFamilies::OrderByBaseline(
+    std::vector<Benchmark::Instance>* benchmarks, std::ostream& Err) {
+  std::vector<Benchmark::Instance>& instances = *benchmarks;
+  // The instances compared to each instance.
+  std::vector<std::vector<size_t> > dependents(instances.size());
+  std::vector<bool> has_baseline(instances.size(), false);
+  for (size_t i = 0; i < instances.size(); ++i) {
+    Benchmark::Instance& instance = instances[i];
+    const std::string& relative_to = instance.benchmark->relative_to_;
+    if (relative_to.empty()) continue;
+    // Times measured with different clocks are not compared.
+    bool other_clock = false;
+    for (size_t j = 0; j < instances.size(); ++j) {
+      const Benchmark::Instance& baseline = instances[j];
+      if (j != i && baseline.benchmark->name_ == relative_to &&
+          baseline.arg == instance.arg &&
+          baseline.threads == instance.threads) {
+        if (baseline.use_real_time != instance.use_real_time ||
+            baseline.use_manual_time != instance.use_manual_time) {
+          other_clock = true;
+          continue;
+        }
+        instance.baseline = baseline.name;
+        dependents[j].push_back(i);
+        has_baseline[i] = true;
+        break;
+      }
+    }
+    if (!has_baseline[i]) {
+      Err << instance.name << " is not compared to " << relative_to << ": "
+          << (other_clock ? "its instance with the same arguments and "
+                            "threads is timed with another clock."
+                          : "no instance of it with the same arguments and "
+                            "threads is run.")
+          << std::endl;
+    }
+  }
+  bool reordered = false;
+  for (auto const& d : dependents) reordered |= !d.empty();
+  if (!reordered) return;
+
+  std::vector<Benchmark::Instance> ordered;
+  ordered.reserve(instances.size());
+  std::vector<bool> placed(instances.size(), false);
+  std::function<void(size_t)> place = [&](size_t i) {
+    if (placed[i]) return;
+    placed[i] = true;
+    instances[i].is_baseline = !dependents[i].empty();
+    ordered.push_back(instances[i]);
+    for (size_t d : dependents[i]) place(d);
+  };
+  for (size_t i = 0; i < instances.size(); ++i) {
+    if (!has_baseline[i]) place(i);
+  }
+  // Instances which are baselines of each other.
+  for (size_t i = 0; i < instances.size(); ++i) place(i);
+
+  // The complexity of a family is computed after its last instance, which
+  // may have moved.
+  std::set<const Benchmark*> moved;
+  for (size_t i = 0; i < instances.size(); ++i) {
+    if (has_baseline[i]) moved.insert(instances[i].benchmark);
+  }
+  std::set<const Benchmark*> seen;
+  for (auto it = ordered.rbegin(); it != ordered.rend(); ++it) {
+    if (moved.count(it->benchmark) == 0) continue;
+    it->last_benchmark_instance = seen.insert(it->benchmark).second;
+  }
+  instances.swap(ordered);
+}
+
 Benchmark* RegisterBenchmarkInternal(Benchmark* bench) {
   std::unique_ptr<Benchmark> bench_ptr(bench);
   BenchmarkFamilies* families = BenchmarkFamilies::GetInstance();
@@ -221,6 +399,10 @@ bool FindBenchmarksInternal(const std::string& re,
   return BenchmarkFamilies::GetInstance()->FindBenchmarks(re, benchmarks, Err);
 }
 
+bool ApplySweepInternal(const Sweep& sweep, std::ostream* Err) {
+  return BenchmarkFamilies::GetInstance()->ApplySweep(sweep, *Err);
+}
+
 //=============================================================================//
 //                               Benchmark
 //=============================================================================//
@@ -232,11 +414,23 @@ Benchmark::Benchmark(const char* name)
       range_multiplier_(kRangeMultiplier),
       min_time_(0),
       iterations_(0),
+      working_set_iterations_(0),
+      call_count_iterations_(0),
       repetitions_(0),
       use_real_time_(false),
       use_manual_time_(false),
+      measure_process_cpu_time_(false),
+      allocator_(kDefaultAllocator),
       complexity_(oNone),
-      complexity_lambda_(nullptr) {
+      complexity_lambda_(nullptr),
+      piecewise_complexity_(false),
+      complexity_bytes_per_n_(0),
+      analyze_sensitivity_(false),
+      weak_scaling_(false),
+      shared_iterations_(false),
+      capacity_percentile_(0),
+      capacity_target_(0),
+      report_hook_times_(false) {
   ComputeStatistics("mean", StatisticsMean);
   ComputeStatistics("median", StatisticsMedian);
   ComputeStatistics("stddev", StatisticsStdDev);
@@ -377,6 +571,18 @@ Benchmark* Benchmark::Iterations(size_t n) {
   return this;
 }
 
+Benchmark* Benchmark::MeasureWorkingSet(size_t iterations) {
+  CHECK(iterations > 0);
+  working_set_iterations_ = iterations;
+  return this;
+}
+
+Benchmark* Benchmark::CountCalls(size_t iterations) {
+  CHECK(iterations > 0);
+  call_count_iterations_ = iterations;
+  return this;
+}
+
 Benchmark* Benchmark::Repetitions(int n) {
   CHECK(n > 0);
   repetitions_ = n;
@@ -402,6 +608,16 @@ Benchmark* Benchmark::UseManualTime() {
   return this;
 }
 
+Benchmark* Benchmark::MeasureProcessCPUTime() {
+  measure_process_cpu_time_ = true;
+  return this;
+}
+
+Benchmark* Benchmark::Allocator(AllocatorKind kind) {
+  allocator_ = kind;
+  return this;
+}
+
 Benchmark* Benchmark::Complexity(BigO complexity) {
   complexity_ = complexity;
   return this;
@@ -413,6 +629,18 @@ Benchmark* Benchmark::Complexity(BigOFunc* complexity) {
   return this;
 }
 
+Benchmark* Benchmark::PiecewiseComplexity(double bytes_per_n) {
+  CHECK_GE(bytes_per_n, 0);
+  piecewise_complexity_ = true;
+  complexity_bytes_per_n_ = bytes_per_n;
+  return this;
+}
+
+Benchmark* Benchmark::AnalyzeSensitivity() {
+  analyze_sensitivity_ = true;
+  return this;
+}
+
 Benchmark* Benchmark::ComputeStatistics(std::string name,
                                         StatisticsFunc* statistics) {
   statistics_.emplace_back(name, statistics);
@@ -451,6 +679,42 @@ Benchmark* Benchmark::ThreadPerCpu() {
   return this;
 }
 
+void Benchmark::SetUpOnce(State&) {}
+
+void Benchmark::TearDownOnce(State&) {}
+
+void Benchmark::SetUpThread(State&) {}
+
+void Benchmark::TearDownThread(State&) {}
+
+Benchmark* Benchmark::WeakScaling() {
+  weak_scaling_ = true;
+  return this;
+}
+
+Benchmark* Benchmark::SharedIterations() {
+  shared_iterations_ = true;
+  return this;
+}
+
+Benchmark* Benchmark::FindCapacity(double percentile, double target_latency) {
+  CHECK(percentile > 0 && percentile < 1) << "percentile must be in (0, 1)";
+  CHECK(target_latency > 0);
+  capacity_percentile_ = percentile;
+  capacity_target_ = target_latency;
+  return this;
+}
+
+Benchmark* Benchmark::RelativeTo(const std::string& baseline) {
+  relative_to_ = baseline;
+  return this;
+}
+
+Benchmark* Benchmark::ReportHookTimes() {
+  report_hook_times_ = true;
+  return this;
+}
+
 void Benchmark::SetName(const char* name) { name_ = name; }
 
 int Benchmark::ArgsCnt() const {
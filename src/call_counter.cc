@@ -0,0 +1,34 @@
+// Copyright 2018 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "call_counter.h"
+
+#include "check.h"
+
+namespace benchmark {
+namespace internal {
+
+namespace {
+CallCounter* registered_counter = nullptr;
+}  // end namespace
+
+void RegisterCallCounter(CallCounter* counter) {
+  CHECK(registered_counter == nullptr);
+  registered_counter = counter;
+}
+
+CallCounter* GetCallCounter() { return registered_counter; }
+
+}  // end namespace internal
+}  // end namespace benchmark
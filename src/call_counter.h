@@ -0,0 +1,38 @@
+#ifndef BENCHMARK_CALL_COUNTER_H_
+#define BENCHMARK_CALL_COUNTER_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace benchmark {
+namespace internal {
+
+// Counts the calls of the functions compiled with -finstrument-functions. It
+// is implemented by the benchmark_instrument library, which registers it
+// when the program is linked with it.
+class CallCounter {
+ public:
+  virtual ~CallCounter() {}
+
+  // Count the calls made by the calling thread until StopThread().
+  virtual void StartThread() = 0;
+  virtual void StopThread() = 0;
+
+  // Return the calls counted since the last call by all threads, by function
+  // name, and forget them. Calls which could not be attributed to a function
+  // are counted under "[other]".
+  // REQUIRES: No thread is counting.
+  virtual std::map<std::string, int64_t> TakeCounts() = 0;
+};
+
+// Called once by the benchmark_instrument library when it is linked in.
+void RegisterCallCounter(CallCounter* counter);
+
+// Returns nullptr unless the benchmark_instrument library is linked in.
+CallCounter* GetCallCounter();
+
+}  // end namespace internal
+}  // end namespace benchmark
+
+#endif  // BENCHMARK_CALL_COUNTER_H_
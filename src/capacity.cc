@@ -0,0 +1,79 @@
+// Copyright 2018 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "capacity.h"
+
+#include <cmath>
+
+namespace benchmark {
+namespace internal {
+
+namespace {
+
+// The search starts at this fraction of the service rate, near enough for
+// the first probes to be short, and goes no further than these bounds.
+const double kCapacityStartFraction = 1.0 / 4;
+const double kCapacityMinFraction = 1.0 / 32;
+const double kCapacityMaxFactor = 2;
+// The search stops once the highest rate known to meet the target and the
+// lowest known to miss it are this close, or after this many probes.
+const double kCapacityTolerance = 0.05;
+const int kMaxCapacityProbes = 20;
+
+}  // end namespace
+
+CapacityBounds SearchCapacity(
+    double service_rate, const std::function<CapacityProbe(double)>& probe) {
+  CapacityBounds bounds;
+  int probes = 0;
+  auto run = [&](double rate) {
+    ++probes;
+    switch (probe(rate)) {
+      case kTargetMet:
+        bounds.met_rate = rate;
+        return true;
+      case kTargetMissed:
+        bounds.missed_rate = rate;
+        return true;
+      case kProbeFailed:
+        break;
+    }
+    bounds.failed = true;
+    return false;
+  };
+  double rate = service_rate * kCapacityStartFraction;
+  if (!run(rate)) return bounds;
+  if (bounds.met_rate > 0) {
+    while (bounds.missed_rate <= 0 &&
+           rate * 2 <= service_rate * kCapacityMaxFactor) {
+      rate *= 2;
+      if (!run(rate)) return bounds;
+    }
+  } else {
+    while (bounds.met_rate <= 0 &&
+           rate / 2 >= service_rate * kCapacityMinFraction) {
+      rate /= 2;
+      if (!run(rate)) return bounds;
+    }
+  }
+  while (bounds.met_rate > 0 && bounds.missed_rate > 0 &&
+         bounds.missed_rate > bounds.met_rate * (1 + kCapacityTolerance) &&
+         probes < kMaxCapacityProbes) {
+    if (!run(std::sqrt(bounds.met_rate * bounds.missed_rate))) break;
+  }
+  return bounds;
+}
+
+}  // end namespace internal
+}  // end namespace benchmark
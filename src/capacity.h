@@ -0,0 +1,34 @@
+#ifndef BENCHMARK_CAPACITY_H_
+#define BENCHMARK_CAPACITY_H_
+
+#include <functional>
+
+namespace benchmark {
+namespace internal {
+
+// The outcome of a probe of Benchmark::FindCapacity() at one rate.
+enum CapacityProbe { kTargetMet, kTargetMissed, kProbeFailed };
+
+// What SearchCapacity() learned about the capacity.
+struct CapacityBounds {
+  CapacityBounds() : met_rate(0), missed_rate(0), failed(false) {}
+
+  double met_rate;     // The highest rate which met the target, or zero.
+  double missed_rate;  // The lowest rate which missed it, or zero.
+  bool failed;         // Whether the search stopped at a failed probe.
+};
+
+// Search for the highest rate at which 'probe' meets the latency target,
+// given the rate at which the ordinary runs completed iterations. The search
+// starts at a quarter of 'service_rate' and doubles the rate until the target
+// is missed, up to twice 'service_rate', or halves it until the target is
+// met, down to 1/32 of 'service_rate'. It then bisects between the two to
+// within 5%, and stops at the first probe which fails. The rates only go up
+// once one is met, so the last rate met is always the highest.
+CapacityBounds SearchCapacity(
+    double service_rate, const std::function<CapacityProbe(double)>& probe);
+
+}  // end namespace internal
+}  // end namespace benchmark
+
+#endif  // BENCHMARK_CAPACITY_H_
@@ -19,8 +19,10 @@
 
 #include <algorithm>
 #include <cmath>
+#include <map>
 #include "check.h"
 #include "complexity.h"
+#include "string_util.h"
 
 namespace benchmark {
 
@@ -149,13 +151,42 @@ LeastSq MinimalLeastSq(const std::vector<int>& n,
   return best_fit;
 }
 
-std::vector<BenchmarkReporter::Run> ComputeBigO(
-    const std::vector<BenchmarkReporter::Run>& reports) {
-  typedef BenchmarkReporter::Run Run;
-  std::vector<Run> results;
+namespace {
 
-  if (reports.size() < 2) return results;
+typedef BenchmarkReporter::Run Run;
+
+// A segment is only split if its RMS is at least kMinSplitRms and fitting its
+// two parts separately reduces the sum of their squared RMS, weighted by their
+// number of points, to less than kMaxSplitErrorRatio of its own. Each part
+// must have at least kMinSegmentPoints points.
+const double kMinSplitRms = 0.05;
+const double kMaxSplitErrorRatio = 0.25;
+const size_t kMinSegmentPoints = 3;
+const size_t kMaxSegments = 4;
+
+LeastSq Fit(const std::vector<int>& n, const std::vector<double>& time,
+            BigO complexity, BigOFunc* complexity_lambda) {
+  if (complexity == oLambda) return MinimalLeastSq(n, time, complexity_lambda);
+  return MinimalLeastSq(n, time, complexity);
+}
+
+// The weighted squared RMS of the fit of the points [begin, end).
+double FitError(const std::vector<int>& n, const std::vector<double>& time,
+                size_t begin, size_t end, BigO complexity,
+                BigOFunc* complexity_lambda) {
+  const std::vector<int> sub_n(n.begin() + begin, n.begin() + end);
+  const std::vector<double> sub_time(time.begin() + begin, time.begin() + end);
+  const double rms = Fit(sub_n, sub_time, complexity, complexity_lambda).rms;
+  return rms * rms * static_cast<double>(end - begin);
+}
 
+// Fit the complexity of 'reports' and append their BigO and RMS entries to
+// 'results', named after 'name' followed by 'suffix' and labeled 'label'.
+// 'complexity' and 'complexity_lambda' override those of the reports.
+void AppendBigO(const std::vector<Run>& reports, const std::string& name,
+                const std::string& suffix, const std::string& label,
+                BigO complexity, BigOFunc* complexity_lambda,
+                std::vector<Run>* results) {
   // Accumulators.
   std::vector<int> n;
   std::vector<double> real_time;
@@ -169,22 +200,13 @@ std::vector<BenchmarkReporter::Run> ComputeBigO(
     cpu_time.push_back(run.cpu_accumulated_time / run.iterations);
   }
 
-  LeastSq result_cpu;
-  LeastSq result_real;
-
-  if (reports[0].complexity == oLambda) {
-    result_cpu = MinimalLeastSq(n, cpu_time, reports[0].complexity_lambda);
-    result_real = MinimalLeastSq(n, real_time, reports[0].complexity_lambda);
-  } else {
-    result_cpu = MinimalLeastSq(n, cpu_time, reports[0].complexity);
-    result_real = MinimalLeastSq(n, real_time, result_cpu.complexity);
-  }
-  std::string benchmark_name =
-      reports[0].benchmark_name.substr(0, reports[0].benchmark_name.find('/'));
+  LeastSq result_cpu = Fit(n, cpu_time, complexity, complexity_lambda);
+  LeastSq result_real =
+      Fit(n, real_time, result_cpu.complexity, complexity_lambda);
 
   // Get the data from the accumulator to BenchmarkReporter::Run's.
   Run big_o;
-  big_o.benchmark_name = benchmark_name + "_BigO";
+  big_o.benchmark_name = name + "_BigO" + suffix;
   big_o.iterations = 0;
   big_o.real_accumulated_time = result_real.coef;
   big_o.cpu_accumulated_time = result_cpu.coef;
@@ -198,10 +220,9 @@ std::vector<BenchmarkReporter::Run> ComputeBigO(
   // correct one.
   double multiplier = GetTimeUnitMultiplier(reports[0].time_unit);
 
-  // Only add label to mean/stddev if it is same for all runs
   Run rms;
-  big_o.report_label = reports[0].report_label;
-  rms.benchmark_name = benchmark_name + "_RMS";
+  big_o.report_label = label;
+  rms.benchmark_name = name + "_RMS" + suffix;
   rms.report_label = big_o.report_label;
   rms.iterations = 0;
   rms.real_accumulated_time = result_real.rms / multiplier;
@@ -212,8 +233,134 @@ std::vector<BenchmarkReporter::Run> ComputeBigO(
   // recover the correct value.
   rms.time_unit = reports[0].time_unit;
 
-  results.push_back(big_o);
-  results.push_back(rms);
+  results->push_back(big_o);
+  results->push_back(rms);
+}
+
+std::string FamilyName(const std::vector<Run>& reports) {
+  return reports[0].benchmark_name.substr(
+      0, reports[0].benchmark_name.find('/'));
+}
+
+}  // end namespace
+
+std::vector<BenchmarkReporter::Run> ComputeBigO(
+    const std::vector<BenchmarkReporter::Run>& reports) {
+  std::vector<Run> results;
+
+  if (reports.size() < 2) return results;
+
+  // Only add label to mean/stddev if it is same for all runs
+  AppendBigO(reports, FamilyName(reports), "", reports[0].report_label,
+             reports[0].complexity, reports[0].complexity_lambda, &results);
+  return results;
+}
+
+std::vector<size_t> FindComplexitySegments(const std::vector<int>& n,
+                                           const std::vector<double>& time,
+                                           BigO complexity,
+                                           BigOFunc* complexity_lambda) {
+  CHECK_EQ(n.size(), time.size());
+  // The first point of each segment, and the end.
+  std::vector<size_t> bounds = {0, n.size()};
+  while (bounds.size() <= kMaxSegments) {
+    double best_ratio = kMaxSplitErrorRatio;
+    size_t best_split = 0;
+    for (size_t i = 0; i + 1 < bounds.size(); ++i) {
+      const size_t begin = bounds[i];
+      const size_t end = bounds[i + 1];
+      if (end - begin < 2 * kMinSegmentPoints) continue;
+      const double error =
+          FitError(n, time, begin, end, complexity, complexity_lambda);
+      if (error < kMinSplitRms * kMinSplitRms * (end - begin)) continue;
+      for (size_t split = begin + kMinSegmentPoints;
+           split + kMinSegmentPoints <= end; ++split) {
+        const double split_error =
+            FitError(n, time, begin, split, complexity, complexity_lambda) +
+            FitError(n, time, split, end, complexity, complexity_lambda);
+        if (split_error < best_ratio * error) {
+          best_ratio = split_error / error;
+          best_split = split;
+        }
+      }
+    }
+    if (best_split == 0) break;
+    bounds.insert(std::upper_bound(bounds.begin(), bounds.end(), best_split),
+                  best_split);
+  }
+  return std::vector<size_t>(bounds.begin() + 1, bounds.end() - 1);
+}
+
+std::vector<BenchmarkReporter::Run> ComputePiecewiseBigO(
+    const std::vector<BenchmarkReporter::Run>& reports, double bytes_per_n,
+    const std::vector<CPUInfo::CacheInfo>& caches) {
+  std::vector<Run> results;
+
+  if (reports.size() < 2) return results;
+
+  std::vector<Run> sorted(reports);
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const Run& a, const Run& b) {
+                     return a.complexity_n < b.complexity_n;
+                   });
+  // Each segment is fitted to the curve which suits it best, unless the
+  // complexity is given by a lambda.
+  BigO complexity = sorted[0].complexity == oLambda ? oLambda : oAuto;
+  BigOFunc* complexity_lambda = sorted[0].complexity_lambda;
+
+  // The first run of each segment, and its label.
+  std::vector<size_t> begins;
+  std::vector<std::string> labels;
+  if (bytes_per_n > 0) {
+    // The size of the largest data cache of each level.
+    std::map<int, int> sizes;
+    for (const CPUInfo::CacheInfo& cache : caches) {
+      if (cache.type == "Instruction") continue;
+      sizes[cache.level] = std::max(sizes[cache.level], cache.size);
+    }
+    size_t i = 0;
+    for (const auto& level : sizes) {
+      const size_t begin = i;
+      while (i < sorted.size() &&
+             sorted[i].complexity_n * bytes_per_n <= level.second)
+        ++i;
+      if (i > begin) {
+        begins.push_back(begin);
+        labels.push_back(StrCat("L", level.first));
+      }
+    }
+    if (i < sorted.size()) {
+      begins.push_back(i);
+      labels.push_back("memory");
+    }
+  } else {
+    std::vector<int> n;
+    std::vector<double> cpu_time;
+    for (const Run& run : sorted) {
+      CHECK_GT(run.complexity_n, 0) << "Did you forget to call SetComplexityN?";
+      n.push_back(run.complexity_n);
+      cpu_time.push_back(run.cpu_accumulated_time / run.iterations);
+    }
+    begins.push_back(0);
+    for (size_t begin : FindComplexitySegments(n, cpu_time, complexity,
+                                               complexity_lambda))
+      begins.push_back(begin);
+    labels.assign(begins.size(), sorted[0].report_label);
+  }
+
+  const std::string name = FamilyName(sorted);
+  for (size_t i = 0; i < begins.size(); ++i) {
+    const size_t end = i + 1 < begins.size() ? begins[i + 1] : sorted.size();
+    // A single run cannot be fitted.
+    if (end - begins[i] < 2) continue;
+    const std::vector<Run> segment(sorted.begin() + begins[i],
+                                   sorted.begin() + end);
+    const std::string suffix =
+        StrCat("[", segment.front().complexity_n, "-",
+               segment.back().complexity_n, "]");
+    AppendBigO(segment, name, suffix, labels[i], complexity,
+               complexity_lambda, &results);
+  }
   return results;
 }
 
@@ -30,6 +30,23 @@ namespace benchmark {
 std::vector<BenchmarkReporter::Run> ComputeBigO(
     const std::vector<BenchmarkReporter::Run>& reports);
 
+// Return the bigO and RMS information of each segment of the range of N of
+// the specified list of reports, as set by Benchmark::PiecewiseComplexity().
+// Segments of less than two reports are omitted.
+std::vector<BenchmarkReporter::Run> ComputePiecewiseBigO(
+    const std::vector<BenchmarkReporter::Run>& reports, double bytes_per_n,
+    const std::vector<CPUInfo::CacheInfo>& caches);
+
+// Return the index of the first point of each segment but the first of the
+// points of a complexity fit, sorted by 'n', such that fitting each segment
+// separately reduces the error the most. Only splits which reduce it
+// substantially are made, so an empty vector is returned if the points fit a
+// single curve. 'complexity_lambda' is only used if 'complexity' is oLambda.
+std::vector<size_t> FindComplexitySegments(const std::vector<int>& n,
+                                           const std::vector<double>& time,
+                                           BigO complexity,
+                                           BigOFunc* complexity_lambda);
+
 // This data structure will contain the result returned by MinimalLeastSq
 //   - coef        : Estimated coeficient for the high-order term as
 //                   interpolated from data.
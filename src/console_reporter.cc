@@ -37,6 +37,7 @@ bool ConsoleReporter::ReportContext(const Context& context) {
   name_field_width_ = context.name_field_width;
   printed_header_ = false;
   prev_counters_.clear();
+  primary_metric_ = context.primary_metric;
 
   PrintBasicContext(&GetErrorStream(), context);
 
@@ -138,9 +139,11 @@ void ConsoleReporter::PrintRunData(const Run& result) {
     printer(Out, COLOR_YELLOW, "%10.0f %% %10.0f %% ", real_time * 100,
             cpu_time * 100);
   } else {
+    // Highlight the primary metric; times are secondary when it is a perf
+    // event.
     const char* timeLabel = GetTimeUnitString(result.time_unit);
-    printer(Out, COLOR_YELLOW, "%10.0f %s %10.0f %s ", real_time, timeLabel,
-            cpu_time, timeLabel);
+    printer(Out, primary_metric_ == "time" ? COLOR_YELLOW : COLOR_DEFAULT,
+            "%10.0f %s %10.0f %s ", real_time, timeLabel, cpu_time, timeLabel);
   }
 
   if (!result.report_big_o && !result.report_rms) {
@@ -151,16 +154,17 @@ void ConsoleReporter::PrintRunData(const Run& result) {
     const std::size_t cNameLen = std::max(std::string::size_type(10),
                                           c.first.length());
     auto const& s = HumanReadableNumber(c.second.value, 1000);
+    const LogColor color =
+        c.first == primary_metric_ ? COLOR_YELLOW : COLOR_DEFAULT;
     if (output_options_ & OO_Tabular) {
       if (c.second.flags & Counter::kIsRate) {
-        printer(Out, COLOR_DEFAULT, " %*s/s", cNameLen - 2, s.c_str());
+        printer(Out, color, " %*s/s", cNameLen - 2, s.c_str());
       } else {
-        printer(Out, COLOR_DEFAULT, " %*s", cNameLen, s.c_str());
+        printer(Out, color, " %*s", cNameLen, s.c_str());
       }
     } else {
       const char* unit = (c.second.flags & Counter::kIsRate) ? "/s" : "";
-      printer(Out, COLOR_DEFAULT, " %s=%s%s", c.first.c_str(), s.c_str(),
-              unit);
+      printer(Out, color, " %s=%s%s", c.first.c_str(), s.c_str(), unit);
     }
   }
 
@@ -176,6 +180,10 @@ void ConsoleReporter::PrintRunData(const Run& result) {
     printer(Out, COLOR_DEFAULT, " %s", result.report_label.c_str());
   }
 
+  if (!result.suspicious.empty()) {
+    printer(Out, COLOR_RED, " SUSPICIOUS: %s", result.suspicious.c_str());
+  }
+
   printer(Out, COLOR_DEFAULT, "\n");
 }
 
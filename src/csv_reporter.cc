@@ -35,9 +35,20 @@ std::vector<std::string> elements = {
     "name",           "iterations",       "real_time",        "cpu_time",
     "time_unit",      "bytes_per_second", "items_per_second", "label",
     "error_occurred", "error_message"};
+
+// The counters of the functions counted by CountCalls() are named after the
+// functions each run found, so they cannot have columns of their own. Only
+// their total, "calls", is printed.
+bool IsCalledFunctionCounter(const std::string& name) {
+  return name.compare(0, 6, "calls:") == 0;
+}
 }  // namespace
 
 bool CSVReporter::ReportContext(const Context& context) {
+  check_suspicious_ = context.check_suspicious;
+  // The counters added by the library have columns even if the first runs do
+  // not have them.
+  user_counter_names_ = context.library_counters;
   PrintBasicContext(&GetErrorStream(), context);
   return true;
 }
@@ -49,7 +60,8 @@ void CSVReporter::ReportRuns(const std::vector<Run> & reports) {
     // save the names of all the user counters
     for (const auto& run : reports) {
       for (const auto& cnt : run.counters) {
-        user_counter_names_.insert(cnt.first);
+        if (!IsCalledFunctionCounter(cnt.first))
+          user_counter_names_.insert(cnt.first);
       }
     }
 
@@ -58,6 +70,7 @@ void CSVReporter::ReportRuns(const std::vector<Run> & reports) {
       Out << *B++;
       if (B != elements.end()) Out << ",";
     }
+    if (check_suspicious_) Out << ",suspicious";
     for (auto B = user_counter_names_.begin(); B != user_counter_names_.end();) {
       Out << ",\"" << *B++ << "\"";
     }
@@ -68,6 +81,7 @@ void CSVReporter::ReportRuns(const std::vector<Run> & reports) {
     // check that all the current counters are saved in the name set
     for (const auto& run : reports) {
       for (const auto& cnt : run.counters) {
+        if (IsCalledFunctionCounter(cnt.first)) continue;
         CHECK(user_counter_names_.find(cnt.first) != user_counter_names_.end())
               << "All counters must be present in each run. "
               << "Counter named \"" << cnt.first
@@ -134,6 +148,15 @@ void CSVReporter::PrintRunData(const Run & run) {
   }
   Out << ",,";  // for error_occurred and error_message
 
+  if (check_suspicious_) {
+    Out << ",";
+    if (!run.suspicious.empty()) {
+      std::string suspicious = run.suspicious;
+      ReplaceAll(&suspicious, "\"", "\"\"");
+      Out << "\"" << suspicious << "\"";
+    }
+  }
+
   // Print user counters
   for (const auto &ucn : user_counter_names_) {
     auto it = run.counters.find(ucn);
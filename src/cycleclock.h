@@ -41,6 +41,18 @@ extern "C" uint64_t __rdtsc();
 #pragma intrinsic(__rdtsc)
 #endif
 
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+    defined(_M_IX86)
+#if !defined(BENCHMARK_OS_MACOSX) && !defined(BENCHMARK_OS_EMSCRIPTEN)
+// cycleclock::Now() reads the time stamp counter.
+#define BENCHMARK_HAS_TSC
+#if defined(COMPILER_MSVC)
+extern "C" uint64_t __rdtscp(unsigned int*);
+#pragma intrinsic(__rdtscp)
+#endif
+#endif
+#endif
+
 #ifndef BENCHMARK_OS_WINDOWS
 #include <sys/time.h>
 #include <time.h>
@@ -166,6 +178,24 @@ inline BENCHMARK_ALWAYS_INLINE int64_t Now() {
 #error You need to define CycleTimer for your OS and CPU
 #endif
 }
+
+#ifdef BENCHMARK_HAS_TSC
+// Read the time stamp counter once all previous instructions have executed,
+// with rdtscp, and store the processor id in 'aux'. Linux sets its low 12
+// bits to the number of the CPU. Only valid on CPUs supporting rdtscp.
+inline BENCHMARK_ALWAYS_INLINE int64_t NowAndProcessorId(uint32_t* aux) {
+#if defined(COMPILER_MSVC)
+  unsigned int id;
+  const int64_t ticks = static_cast<int64_t>(__rdtscp(&id));
+  *aux = id;
+  return ticks;
+#else
+  uint32_t low, high;
+  __asm__ volatile("rdtscp" : "=a"(low), "=d"(high), "=c"(*aux));
+  return static_cast<int64_t>((static_cast<uint64_t>(high) << 32) | low);
+#endif
+}
+#endif
 }  // end namespace cycleclock
 }  // end namespace benchmark
 
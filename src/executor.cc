@@ -0,0 +1,298 @@
+// Copyright 2018 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "executor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <thread>
+
+#include "check.h"
+#include "manifest.h"
+#include "mutex.h"
+#include "timers.h"
+
+namespace benchmark {
+
+namespace internal {
+namespace {
+
+// An idle worker checks for new tasks for this long before it sleeps, so
+// that tasks queued in quick succession do not pay for waking it up.
+const double kSpinTime = 50e-6;
+
+class WorkStealingExecutor : public Executor {
+ public:
+  WorkStealingExecutor(int workers, const std::vector<int>& cpus)
+      : helper_tasks_(0),
+        queued_(0),
+        sleepers_(0),
+        started_(0),
+        next_queue_(0) {
+    CHECK_GT(workers, 0);
+    for (int i = 0; i < workers; ++i) workers_.emplace_back(new Worker);
+    for (int i = 0; i < workers; ++i) {
+      std::vector<int> cpu;
+      if (!cpus.empty()) cpu.push_back(cpus[i % cpus.size()]);
+      std::thread(&WorkStealingExecutor::WorkerMain, this, i, cpu).detach();
+    }
+    while (started_.load() < workers) std::this_thread::yield();
+  }
+
+  int num_workers() const override {
+    return static_cast<int>(workers_.size());
+  }
+
+  void Submit(std::function<void()> task) override {
+    int queue = current_worker;
+    if (current_executor != this)
+      queue = static_cast<int>(next_queue_.fetch_add(1) % workers_.size());
+    {
+      Worker& worker = *workers_[queue];
+      MutexLock l(worker.mutex);
+      worker.tasks.push_back(std::move(task));
+    }
+    queued_.fetch_add(1);
+    if (sleepers_.load() > 0) {
+      { MutexLock l(sleep_mutex_); }
+      wake_.notify_one();
+    }
+  }
+
+  bool RunQueuedTask() override {
+    const int self = current_executor == this ? current_worker : -1;
+    std::function<void()> task;
+    bool stolen;
+    if (!TakeTask(self, &task, &stolen)) return false;
+    if (self >= 0) {
+      CountTask(workers_[self].get(), stolen);
+    } else {
+      helper_tasks_.fetch_add(1, std::memory_order_relaxed);
+    }
+    task();
+    return true;
+  }
+
+  ExecutorStats Stats() const {
+    ExecutorStats stats;
+    stats.workers = num_workers();
+    stats.tasks = helper_tasks_.load(std::memory_order_relaxed);
+    int64_t busy_ns = 0;
+    for (const auto& worker : workers_) {
+      stats.tasks += worker->tasks_run.load(std::memory_order_relaxed);
+      stats.steals += worker->steals.load(std::memory_order_relaxed);
+      busy_ns += worker->busy_ns.load(std::memory_order_relaxed);
+    }
+    stats.busy_time = static_cast<double>(busy_ns) * 1e-9;
+    return stats;
+  }
+
+  // See internal::CountBusyTime().
+  static void CountBusyTime() {
+    if (current_executor == nullptr) return;
+    Worker& worker = *current_executor->workers_[current_worker];
+    const double now = ChronoClockNow();
+    worker.busy_ns.fetch_add(static_cast<int64_t>((now - task_start) * 1e9),
+                             std::memory_order_relaxed);
+    task_start = now;
+  }
+
+ private:
+  struct Worker {
+    Worker() : tasks_run(0), steals(0), busy_ns(0) {}
+
+    Mutex mutex;
+    std::deque<std::function<void()> > tasks GUARDED_BY(mutex);
+    std::atomic<int64_t> tasks_run;
+    std::atomic<int64_t> steals;
+    std::atomic<int64_t> busy_ns;
+  };
+
+  // Tasks are counted before they run, so that whoever waits for them sees
+  // them counted once they have returned.
+  static void CountTask(Worker* worker, bool stolen) {
+    worker->tasks_run.fetch_add(1, std::memory_order_relaxed);
+    if (stolen) worker->steals.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Takes the newest task of worker 'self', or else the oldest task of the
+  // first other worker which has one. 'self' is -1 for threads which are
+  // not workers.
+  bool TakeTask(int self, std::function<void()>* task, bool* stolen) {
+    if (queued_.load() == 0) return false;
+    const int n = num_workers();
+    if (self >= 0) {
+      Worker& worker = *workers_[self];
+      MutexLock l(worker.mutex);
+      if (!worker.tasks.empty()) {
+        *task = std::move(worker.tasks.back());
+        worker.tasks.pop_back();
+        queued_.fetch_sub(1);
+        *stolen = false;
+        return true;
+      }
+    }
+    const int start = self >= 0 ? self : 0;
+    for (int i = 1; i <= n; ++i) {
+      const int victim = (start + i) % n;
+      if (victim == self) continue;
+      Worker& worker = *workers_[victim];
+      MutexLock l(worker.mutex);
+      if (!worker.tasks.empty()) {
+        *task = std::move(worker.tasks.front());
+        worker.tasks.pop_front();
+        queued_.fetch_sub(1);
+        *stolen = self >= 0;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void WorkerMain(int index, std::vector<int> cpu) {
+    ScopedCPUPin pin(cpu);
+    current_executor = this;
+    current_worker = index;
+    started_.fetch_add(1);
+    Worker& worker = *workers_[index];
+    for (;;) {
+      std::function<void()> task;
+      bool stolen;
+      if (!TakeTask(index, &task, &stolen)) {
+        WaitForTask();
+        continue;
+      }
+      CountTask(&worker, stolen);
+      // The busy time is mostly counted by the task itself, see
+      // internal::CountBusyTime(), and the rest once it returns.
+      task_start = ChronoClockNow();
+      task();
+      CountBusyTime();
+    }
+  }
+
+  void WaitForTask() {
+    const double deadline = ChronoClockNow() + kSpinTime;
+    while (queued_.load() == 0) {
+      if (ChronoClockNow() < deadline) continue;
+      MutexLock l(sleep_mutex_);
+      sleepers_.fetch_add(1);
+      while (queued_.load() == 0) wake_.wait(l.native_handle());
+      sleepers_.fetch_sub(1);
+      return;
+    }
+  }
+
+  static thread_local WorkStealingExecutor* current_executor;
+  static thread_local int current_worker;
+  // When the busy time of the current task was last counted.
+  static thread_local double task_start;
+
+  std::vector<std::unique_ptr<Worker> > workers_;
+  std::atomic<int64_t> helper_tasks_;
+  // The number of queued tasks, over all queues.
+  std::atomic<int> queued_;
+  std::atomic<int> sleepers_;
+  std::atomic<int> started_;
+  std::atomic<unsigned> next_queue_;
+  Mutex sleep_mutex_;
+  Condition wake_;
+};
+
+thread_local WorkStealingExecutor* WorkStealingExecutor::current_executor =
+    nullptr;
+thread_local int WorkStealingExecutor::current_worker = -1;
+thread_local double WorkStealingExecutor::task_start = 0;
+
+std::atomic<WorkStealingExecutor*> started_executor(nullptr);
+// The stats of the warm-up of the executor, left out of ReadExecutorStats().
+// Written before 'started_executor' is set, once the warm-up tasks have
+// returned and so have all been counted.
+ExecutorStats warmup_stats;
+
+WorkStealingExecutor* StartExecutor(int workers,
+                                    const std::vector<int>& cpus) {
+  if (workers <= 0) workers = std::max(CPUInfo::Get().num_cpus, 1);
+  // The executor is never destroyed: its workers may still be waiting for
+  // tasks when the program exits.
+  WorkStealingExecutor* executor = new WorkStealingExecutor(workers, cpus);
+  // Warm up the workers and the paths taken by ParallelFor().
+  std::atomic<int64_t> sum(0);
+  executor->ParallelFor(0, 1024 * workers, 16, [&](int64_t b, int64_t e) {
+    sum.fetch_add(e - b);
+  });
+  warmup_stats = executor->Stats();
+  started_executor.store(executor);
+  return executor;
+}
+
+// Calls 'body' for [begin, end) in chunks of at most 'grain' indices: the
+// upper halves are queued as tasks, which idle workers steal, and the first
+// chunk is run on the calling thread.
+void SplitRange(TaskGroup* group, int64_t begin, int64_t end, int64_t grain,
+                const std::function<void(int64_t, int64_t)>& body) {
+  while (end - begin > grain) {
+    const int64_t middle = begin + (end - begin) / 2;
+    group->Run([=, &body] { SplitRange(group, middle, end, grain, body); });
+    end = middle;
+  }
+  if (begin < end) body(begin, end);
+}
+
+}  // end namespace
+
+Executor& GetExecutor(int workers, const std::vector<int>& cpus) {
+  static WorkStealingExecutor* executor = StartExecutor(workers, cpus);
+  return *executor;
+}
+
+void CountBusyTime() { WorkStealingExecutor::CountBusyTime(); }
+
+bool ReadExecutorStats(ExecutorStats* stats) {
+  WorkStealingExecutor* executor = started_executor.load();
+  if (executor == nullptr) return false;
+  *stats = executor->Stats();
+  stats->tasks -= warmup_stats.tasks;
+  stats->steals -= warmup_stats.steals;
+  stats->busy_time -= warmup_stats.busy_time;
+  return true;
+}
+
+}  // end namespace internal
+
+void Executor::ParallelFor(int64_t begin, int64_t end, int64_t grain,
+                           const std::function<void(int64_t, int64_t)>& body) {
+  TaskGroup group(*this);
+  internal::SplitRange(&group, begin, end, std::max<int64_t>(grain, 1), body);
+  group.Wait();
+}
+
+void TaskGroup::Run(std::function<void()> task) {
+  pending_.fetch_add(1);
+  executor_.Submit([this, task] {
+    task();
+    internal::CountBusyTime();
+    pending_.fetch_sub(1);
+  });
+}
+
+void TaskGroup::Wait() {
+  while (pending_.load() > 0) {
+    if (!executor_.RunQueuedTask()) std::this_thread::yield();
+  }
+}
+
+}  // end namespace benchmark
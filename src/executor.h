@@ -0,0 +1,42 @@
+#ifndef BENCHMARK_EXECUTOR_H_
+#define BENCHMARK_EXECUTOR_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+namespace benchmark {
+namespace internal {
+
+// What the workers of the executor have done since it was started, leaving
+// out the tasks with which it warms itself up.
+struct ExecutorStats {
+  ExecutorStats() : workers(0), tasks(0), steals(0), busy_time(0) {}
+
+  int workers;
+  int64_t tasks;     // Run by the workers or by threads waiting for them.
+  int64_t steals;    // Taken by a worker from another worker's queue.
+  double busy_time;  // Spent by the workers running tasks, in seconds.
+};
+
+// Returns the executor shared by all benchmarks, starting it with 'workers'
+// threads, or one per CPU if it is 0, on the first call. The i-th worker is
+// pinned to cpus[i % cpus.size()] unless 'cpus' is empty. Later calls ignore
+// their arguments.
+Executor& GetExecutor(int workers, const std::vector<int>& cpus);
+
+// Returns false if the executor has not been started, or else true and the
+// stats of its workers.
+bool ReadExecutorStats(ExecutorStats* stats);
+
+// Adds the time the calling worker has spent on its current task so far to
+// its busy time. Called before a task of a TaskGroup is seen to have
+// returned, so that whoever waits for it sees its busy time counted. Does
+// nothing on threads which are not workers.
+void CountBusyTime();
+
+}  // end namespace internal
+}  // end namespace benchmark
+
+#endif  // BENCHMARK_EXECUTOR_H_
@@ -0,0 +1,169 @@
+// Copyright 2018 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// The hooks called on entry to and exit from every function compiled with
+// -finstrument-functions, which are linked into programs using the
+// benchmark_instrument library, and the CallCounter counting their calls.
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "call_counter.h"
+#include "mutex.h"
+#include "string_util.h"
+
+#define NO_INSTRUMENT __attribute__((no_instrument_function))
+
+namespace benchmark {
+namespace internal {
+namespace {
+
+// The calls counted by one thread, in an open addressing hash table which
+// only the thread writes to.
+struct CallTable {
+  static const std::size_t kCapacityLog2 = 14;
+  static const std::size_t kCapacity = std::size_t(1) << kCapacityLog2;
+  // Functions which are not found after this many probes are counted in
+  // 'other'.
+  static const std::size_t kMaxProbes = 16;
+
+  struct Entry {
+    void* function;
+    int64_t calls;
+  };
+  Entry entries[kCapacity];
+  int64_t other;
+};
+
+// The table of the calling thread while it is counting.
+thread_local CallTable* counting_table = nullptr;
+
+inline NO_INSTRUMENT void CountCall(CallTable* table, void* function) {
+  const uint64_t address =
+      static_cast<uint64_t>(reinterpret_cast<uintptr_t>(function));
+  std::size_t i = static_cast<std::size_t>(
+      (address * 0x9E3779B97F4A7C15ull) >> (64 - CallTable::kCapacityLog2));
+  for (std::size_t probe = 0; probe < CallTable::kMaxProbes; ++probe) {
+    CallTable::Entry& entry = table->entries[i];
+    if (entry.function == function) {
+      ++entry.calls;
+      return;
+    }
+    if (entry.function == nullptr) {
+      entry.function = function;
+      entry.calls = 1;
+      return;
+    }
+    i = (i + 1) & (CallTable::kCapacity - 1);
+  }
+  ++table->other;
+}
+
+// Returns the demangled name of 'function' if it is in the dynamic symbol
+// table, e.g. because the program is linked with -rdynamic, or else its
+// module and offset.
+std::string Symbolize(void* function) {
+  Dl_info info;
+  if (dladdr(function, &info) == 0)
+    return StringPrintF("%p", function);
+  if (info.dli_sname != nullptr) {
+    int status = 0;
+    char* demangled =
+        abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+    if (status == 0 && demangled != nullptr) {
+      std::string name(demangled);
+      std::free(demangled);
+      return name;
+    }
+    return info.dli_sname;
+  }
+  const char* module = info.dli_fname != nullptr ? info.dli_fname : "";
+  const char* slash = std::strrchr(module, '/');
+  if (slash != nullptr) module = slash + 1;
+  return StringPrintF(
+      "%s+0x%llx", module,
+      static_cast<unsigned long long>(reinterpret_cast<uintptr_t>(function) -
+                                      reinterpret_cast<uintptr_t>(
+                                          info.dli_fbase)));
+}
+
+class InstrumentCallCounter : public CallCounter {
+ public:
+  void StartThread() override {
+    CallTable* table =
+        static_cast<CallTable*>(std::calloc(1, sizeof(CallTable)));
+    if (table == nullptr) return;
+    {
+      MutexLock l(mutex_);
+      tables_.push_back(table);
+    }
+    counting_table = table;
+  }
+
+  void StopThread() override { counting_table = nullptr; }
+
+  std::map<std::string, int64_t> TakeCounts() override {
+    std::vector<CallTable*> tables;
+    {
+      MutexLock l(mutex_);
+      tables.swap(tables_);
+    }
+    std::map<void*, int64_t> by_address;
+    int64_t other = 0;
+    for (CallTable* table : tables) {
+      for (const CallTable::Entry& entry : table->entries) {
+        if (entry.function != nullptr)
+          by_address[entry.function] += entry.calls;
+      }
+      other += table->other;
+      std::free(table);
+    }
+    std::map<std::string, int64_t> counts;
+    for (const auto& function : by_address)
+      counts[Symbolize(function.first)] += function.second;
+    if (other > 0) counts["[other]"] += other;
+    return counts;
+  }
+
+ private:
+  Mutex mutex_;
+  std::vector<CallTable*> tables_;
+};
+
+struct RegisterCounter {
+  RegisterCounter() { RegisterCallCounter(new InstrumentCallCounter); }
+} register_counter;
+
+}  // end namespace
+}  // end namespace internal
+}  // end namespace benchmark
+
+extern "C" {
+
+NO_INSTRUMENT void __cyg_profile_func_enter(void* function, void*) {
+  benchmark::internal::CallTable* table =
+      benchmark::internal::counting_table;
+  if (table != nullptr) benchmark::internal::CountCall(table, function);
+}
+
+NO_INSTRUMENT void __cyg_profile_func_exit(void*, void*) {}
+
+}  // extern "C"
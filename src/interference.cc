@@ -0,0 +1,167 @@
+// Copyright 2018 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "interference.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <thread>
+
+#include "benchmark/benchmark.h"
+#include "check.h"
+#include "manifest.h"
+#include "sleep.h"
+#include "timers.h"
+
+namespace benchmark {
+namespace internal {
+
+namespace {
+
+// The lookups touch one cache line each.
+const size_t kCacheLineWords = 64 / sizeof(uint32_t);
+// The stream buffer, which the victims share, is this many times the last
+// level cache, within these bounds.
+const size_t kStreamCacheMultiple = 4;
+const size_t kMinStreamBytes = 64 << 20;
+const size_t kMaxStreamBytes = 512 << 20;
+// The work of a slice, short enough for the victims to sample a benchmark
+// run many times.
+const int kLookupsPerSlice = 4096;
+const size_t kStreamWordsPerSlice = (256 << 10) / sizeof(uint64_t);
+// The victims warm up their buffers for this long before their idle rates
+// are measured for this long.
+const double kIdleWarmupTime = 0.05;
+const double kIdleMeasureTime = 0.2;
+
+}  // end namespace
+
+struct InterferenceProbe::Victim {
+  Victim()
+      : stream(nullptr),
+        stream_start(0),
+        lookups(0),
+        lookup_time(0),
+        stream_bytes(0),
+        stream_time(0) {}
+
+  std::vector<int> cpu;
+  // Each cache line holds the index of the next line to look up in its first
+  // word; the lines form a single random cycle.
+  std::vector<uint32_t> table;
+  // The shared stream buffer, which the victim starts reading at
+  // 'stream_start' so that the victims do not read the same lines at once.
+  const std::vector<uint64_t>* stream;
+  size_t stream_start;
+  std::thread thread;
+  // Written by the thread, read once it has been joined.
+  double lookups;
+  double lookup_time;
+  double stream_bytes;
+  double stream_time;
+};
+
+void InterferenceProbe::RunVictim(Victim* victim,
+                                  const std::atomic<bool>* stop) {
+  ScopedCPUPin pin(victim->cpu);
+  const std::vector<uint32_t>& table = victim->table;
+  const std::vector<uint64_t>& stream = *victim->stream;
+  uint32_t line = 0;
+  uint64_t sum = 0;
+  size_t offset = victim->stream_start;
+  while (!stop->load(std::memory_order_relaxed)) {
+    const double start = ChronoClockNow();
+    for (int i = 0; i < kLookupsPerSlice; ++i)
+      line = table[line * kCacheLineWords];
+    const double middle = ChronoClockNow();
+    const size_t end = std::min(offset + kStreamWordsPerSlice, stream.size());
+    for (size_t i = offset; i < end; ++i) sum += stream[i];
+    const double finish = ChronoClockNow();
+    victim->lookups += kLookupsPerSlice;
+    victim->lookup_time += middle - start;
+    victim->stream_bytes += static_cast<double>((end - offset) * sizeof(sum));
+    victim->stream_time += finish - middle;
+    offset = end == stream.size() ? 0 : end;
+  }
+  DoNotOptimize(line);
+  DoNotOptimize(sum);
+}
+
+InterferenceProbe::InterferenceProbe(const std::vector<int>& cpus,
+                                     size_t llc_bytes)
+    : stop_(false) {
+  CHECK(!cpus.empty());
+  const size_t lines = std::max<size_t>(
+      llc_bytes / 2 / cpus.size() / (kCacheLineWords * sizeof(uint32_t)), 2);
+  const size_t stream_bytes =
+      std::min(std::max(llc_bytes * kStreamCacheMultiple, kMinStreamBytes),
+               kMaxStreamBytes);
+  // A buffer per victim would take up to the maximum times the number of
+  // victims; shared, it is still much larger than the cache.
+  stream_.assign(stream_bytes / sizeof(uint64_t), 1);
+  // The victims are the same in every program run.
+  std::mt19937 rng(0);
+  for (int cpu : cpus) {
+    victims_.emplace_back(new Victim);
+    Victim& victim = *victims_.back();
+    victim.cpu.assign(1, cpu);
+    // Sattolo's algorithm, for a single cycle through all the lines.
+    std::vector<uint32_t> order(lines);
+    for (size_t i = 0; i < lines; ++i) order[i] = static_cast<uint32_t>(i);
+    for (size_t i = lines - 1; i > 0; --i) {
+      std::uniform_int_distribution<size_t> pick(0, i - 1);
+      std::swap(order[i], order[pick(rng)]);
+    }
+    victim.table.assign(lines * kCacheLineWords, 0);
+    for (size_t i = 0; i < lines; ++i)
+      victim.table[order[i] * kCacheLineWords] = order[(i + 1) % lines];
+    victim.stream = &stream_;
+    victim.stream_start = stream_.size() / cpus.size() * (victims_.size() - 1);
+  }
+  Start();
+  SleepForSeconds(kIdleWarmupTime);
+  Stop();
+  Start();
+  SleepForSeconds(kIdleMeasureTime);
+  idle_ = Stop();
+}
+
+InterferenceProbe::~InterferenceProbe() {}
+
+void InterferenceProbe::Start() {
+  stop_.store(false);
+  for (const auto& victim : victims_) {
+    CHECK(!victim->thread.joinable());
+    victim->lookups = victim->lookup_time = 0;
+    victim->stream_bytes = victim->stream_time = 0;
+    victim->thread = std::thread(&RunVictim, victim.get(), &stop_);
+  }
+}
+
+VictimRates InterferenceProbe::Stop() {
+  stop_.store(true);
+  VictimRates rates;
+  for (const auto& victim : victims_) {
+    victim->thread.join();
+    if (victim->lookup_time > 0)
+      rates.lookups += victim->lookups / victim->lookup_time;
+    if (victim->stream_time > 0)
+      rates.stream_bytes += victim->stream_bytes / victim->stream_time;
+  }
+  return rates;
+}
+
+}  // end namespace internal
+}  // end namespace benchmark
@@ -0,0 +1,64 @@
+#ifndef BENCHMARK_INTERFERENCE_H_
+#define BENCHMARK_INTERFERENCE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace benchmark {
+namespace internal {
+
+// The rates at which the victims of an InterferenceProbe worked, summed over
+// all victims.
+struct VictimRates {
+  VictimRates() : lookups(0), stream_bytes(0) {}
+
+  double lookups;       // Random lookups per second in a cache-sized table.
+  double stream_bytes;  // Bytes per second read by a sequential stream.
+};
+
+// A fixed workload run on other CPUs while a benchmark runs, to measure how
+// much the benchmark slows its neighbours down through the shared last level
+// cache and memory bandwidth. Each victim alternates between slices of random
+// lookups in a table sized for the tables of all victims to fill half the
+// last level cache, and of a sequential read of a buffer several times its
+// size, shared by all victims, and times each kind of slice separately.
+class InterferenceProbe {
+ public:
+  // Allocates a victim for each of 'cpus', to be pinned to it, for a last
+  // level cache of 'llc_bytes', and measures their rates with nothing else
+  // running.
+  InterferenceProbe(const std::vector<int>& cpus, size_t llc_bytes);
+  ~InterferenceProbe();
+
+  // The rates of the victims measured on their own.
+  const VictimRates& idle_rates() const { return idle_; }
+
+  // Starts the victims. REQUIRES: they are not running.
+  void Start();
+
+  // Stops the victims and returns their rates since Start(). The rates are
+  // zero if no slice of that kind completed.
+  VictimRates Stop();
+
+ private:
+  struct Victim;
+
+  // Runs slices of the workload of 'victim' until 'stop' is set.
+  static void RunVictim(Victim* victim, const std::atomic<bool>* stop);
+
+  std::vector<uint64_t> stream_;
+  std::vector<std::unique_ptr<Victim> > victims_;
+  std::atomic<bool> stop_;
+  VictimRates idle_;
+
+  InterferenceProbe(const InterferenceProbe&);
+  InterferenceProbe& operator=(const InterferenceProbe&);
+};
+
+}  // end namespace internal
+}  // end namespace benchmark
+
+#endif  // BENCHMARK_INTERFERENCE_H_
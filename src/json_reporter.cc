@@ -107,6 +107,51 @@ bool JSONReporter::ReportContext(const Context& context) {
   }
   indent = std::string(4, ' ');
   out << indent << "],\n";
+  if (!info.core_types.empty()) {
+    out << indent << "\"core_types\": [\n";
+    std::string type_indent(6, ' ');
+    std::string field_indent(8, ' ');
+    for (size_t i = 0; i < info.core_types.size(); ++i) {
+      const CPUInfo::CoreType& type = info.core_types[i];
+      out << type_indent << "{\n";
+      out << field_indent << FormatKV("name", type.name) << ",\n";
+      out << field_indent << "\"cpus\": [";
+      for (size_t j = 0; j < type.cpus.size(); ++j)
+        out << (j == 0 ? "" : ", ") << type.cpus[j];
+      out << "]\n";
+      out << type_indent << "}";
+      if (i != info.core_types.size() - 1) out << ",";
+      out << "\n";
+    }
+    out << indent << "],\n";
+  }
+  TimerInfo const& timer = context.timer_info;
+  out << indent << FormatKV("clocksource", timer.clocksource) << ",\n";
+  out << indent << FormatKV("timer", timer.backend) << ",\n";
+  out << indent << FormatKV("timer_overhead_ns", timer.call_overhead * 1e9)
+      << ",\n";
+  out << indent << FormatKV("primary_metric", context.primary_metric) << ",\n";
+  if (!context.preflight.empty()) {
+    out << indent << "\"preflight\": {\n";
+    std::string check_indent(6, ' ');
+    std::string item_indent(8, ' ');
+    std::string field_indent(10, ' ');
+    out << check_indent << FormatKV("policy", context.preflight) << ",\n";
+    out << check_indent << "\"checks\": [\n";
+    const std::vector<PreflightCheck>& checks = context.preflight_checks;
+    for (size_t i = 0; i < checks.size(); ++i) {
+      out << item_indent << "{\n";
+      out << field_indent << FormatKV("name", checks[i].name) << ",\n";
+      out << field_indent << FormatKV("value", checks[i].value) << ",\n";
+      out << field_indent << FormatKV("expected", checks[i].expected) << ",\n";
+      out << field_indent << FormatKV("ok", checks[i].ok) << "\n";
+      out << item_indent << "}";
+      if (i != checks.size() - 1) out << ",";
+      out << "\n";
+    }
+    out << check_indent << "]\n";
+    out << indent << "},\n";
+  }
 
 #if defined(NDEBUG)
   const char build_type[] = "release";
@@ -195,6 +240,12 @@ void JSONReporter::PrintRunData(Run const& run) {
   if (!run.report_label.empty()) {
     out << ",\n" << indent << FormatKV("label", run.report_label);
   }
+  if (!run.core_type.empty()) {
+    out << ",\n" << indent << FormatKV("core_type", run.core_type);
+  }
+  if (!run.suspicious.empty()) {
+    out << ",\n" << indent << FormatKV("suspicious", run.suspicious);
+  }
   out << '\n';
 }
 
@@ -0,0 +1,137 @@
+// Copyright 2018 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "latency_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "check.h"
+
+namespace benchmark {
+
+namespace {
+
+// Each power of two is split into 2^kSubBucketBits buckets. Values below
+// 2^(kSubBucketBits + 1) have a bucket of their own.
+const int kSubBucketBits = 5;
+const uint64_t kSubBuckets = 1ull << kSubBucketBits;
+
+int MostSignificantBit(uint64_t v) {
+  int msb = 0;
+  while (v >>= 1) ++msb;
+  return msb;
+}
+
+size_t BucketIndex(uint64_t ns) {
+  if (ns < 2 * kSubBuckets) return static_cast<size_t>(ns);
+  const int shift = MostSignificantBit(ns) - kSubBucketBits;
+  return static_cast<size_t>((static_cast<uint64_t>(shift + 1)
+                              << kSubBucketBits) |
+                             ((ns >> shift) & (kSubBuckets - 1)));
+}
+
+// Return the smallest value, in nanoseconds, of bucket 'index' and the
+// number of values it spans.
+void BucketBounds(size_t index, uint64_t* lo, uint64_t* width) {
+  if (index < 2 * kSubBuckets) {
+    *lo = index;
+    *width = 1;
+    return;
+  }
+  const int shift = static_cast<int>(index >> kSubBucketBits) - 1;
+  *lo = ((index & (kSubBuckets - 1)) | kSubBuckets) << shift;
+  *width = 1ull << shift;
+}
+
+}  // end namespace
+
+LatencyHistogram::LatencyHistogram()
+    : count_(0),
+      sum_(0),
+      min_ns_(std::numeric_limits<uint64_t>::max()),
+      max_ns_(0) {}
+
+void LatencyHistogram::Record(double seconds) {
+  const double ns = std::max(seconds * 1e9, 0.0);
+  const uint64_t value =
+      ns >= static_cast<double>(std::numeric_limits<uint64_t>::max() / 2)
+          ? std::numeric_limits<uint64_t>::max() / 2
+          : static_cast<uint64_t>(ns + 0.5);
+  const size_t index = BucketIndex(value);
+  if (index >= buckets_.size()) buckets_.resize(index + 1, 0);
+  ++buckets_[index];
+  ++count_;
+  sum_ += static_cast<double>(value);
+  min_ns_ = std::min(min_ns_, value);
+  max_ns_ = std::max(max_ns_, value);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+  if (other.buckets_.size() > buckets_.size())
+    buckets_.resize(other.buckets_.size(), 0);
+  for (size_t i = 0; i < other.buckets_.size(); ++i)
+    buckets_[i] += other.buckets_[i];
+  count_ += other.count_;
+  sum_ += other.sum_;
+  min_ns_ = std::min(min_ns_, other.min_ns_);
+  max_ns_ = std::max(max_ns_, other.max_ns_);
+}
+
+double LatencyHistogram::mean() const {
+  CHECK(count_ > 0);
+  return sum_ / static_cast<double>(count_) * 1e-9;
+}
+
+double LatencyHistogram::min() const {
+  CHECK(count_ > 0);
+  return static_cast<double>(min_ns_) * 1e-9;
+}
+
+double LatencyHistogram::max() const {
+  CHECK(count_ > 0);
+  return static_cast<double>(max_ns_) * 1e-9;
+}
+
+double LatencyHistogram::Percentile(double q) const {
+  CHECK(count_ > 0);
+  CHECK(q >= 0 && q <= 1) << "percentile must be in [0, 1]";
+  const int64_t rank = std::max<int64_t>(
+      1, static_cast<int64_t>(std::ceil(q * static_cast<double>(count_))));
+  int64_t seen = 0;
+  for (size_t i = 0; i < buckets_.size(); ++i) {
+    seen += buckets_[i];
+    if (seen < rank) continue;
+    // Report the middle of the bucket, within the observed range.
+    uint64_t lo, width;
+    BucketBounds(i, &lo, &width);
+    const uint64_t mid = std::min(std::max(lo + width / 2, min_ns_), max_ns_);
+    return static_cast<double>(mid) * 1e-9;
+  }
+  return max();
+}
+
+int64_t LatencyHistogram::CountAbove(double seconds) const {
+  const double ns = std::max(seconds * 1e9, 0.0);
+  if (ns >= static_cast<double>(std::numeric_limits<uint64_t>::max() / 2))
+    return 0;
+  int64_t count = 0;
+  for (size_t i = BucketIndex(static_cast<uint64_t>(ns)) + 1;
+       i < buckets_.size(); ++i)
+    count += buckets_[i];
+  return count;
+}
+
+}  // end namespace benchmark
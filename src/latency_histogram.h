@@ -0,0 +1,49 @@
+#ifndef BENCHMARK_LATENCY_HISTOGRAM_H_
+#define BENCHMARK_LATENCY_HISTOGRAM_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace benchmark {
+
+// A log-linear histogram of latencies with a resolution of 1ns and a relative
+// error of at most 1/32 (about 3%). Each power of two is split into 32
+// equally sized buckets.
+class LatencyHistogram {
+ public:
+  LatencyHistogram();
+
+  // Add a latency, in seconds. Negative values are recorded as 0.
+  void Record(double seconds);
+
+  // Add all the latencies recorded in 'other'.
+  void Merge(const LatencyHistogram& other);
+
+  int64_t count() const { return count_; }
+
+  // REQUIRES: count() > 0
+  double mean() const;
+  double min() const;
+  double max() const;
+
+  // Return the latency, in seconds, below which the fraction 'q' of the
+  // recorded latencies fall, e.g. Percentile(0.99) for the 99th percentile.
+  // REQUIRES: count() > 0 and 0 <= q <= 1
+  double Percentile(double q) const;
+
+  // Return the number of recorded latencies above 'seconds'. Latencies in the
+  // bucket of 'seconds' are not counted, so this is exact to within the
+  // relative error of the histogram.
+  int64_t CountAbove(double seconds) const;
+
+ private:
+  std::vector<int64_t> buckets_;  // Grown on demand.
+  int64_t count_;
+  double sum_;
+  uint64_t min_ns_;
+  uint64_t max_ns_;
+};
+
+}  // end namespace benchmark
+
+#endif  // BENCHMARK_LATENCY_HISTOGRAM_H_
@@ -0,0 +1,486 @@
+// Copyright 2018 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "benchmark/loopback.h"
+#include "internal_macros.h"
+
+#ifndef BENCHMARK_OS_WINDOWS
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+#ifdef BENCHMARK_OS_LINUX
+#include <sys/prctl.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <random>
+#include <thread>
+
+#include "check.h"
+#include "mutex.h"
+#include "timers.h"
+
+namespace benchmark {
+
+#ifndef BENCHMARK_OS_WINDOWS
+namespace {
+
+#ifdef MSG_NOSIGNAL
+const int kSendFlags = MSG_NOSIGNAL;
+#else
+const int kSendFlags = 0;
+#endif
+
+const size_t kChunkSize = 64 << 10;
+// Stop reading from a side of the connection while this many chunks are
+// waiting to be delivered to the other.
+const size_t kMaxQueuedChunks = 64;
+// The links of a shaped connection, one in each direction.
+const size_t kNumLinks = 2;
+
+// Waits up to 'timeout' seconds, or indefinitely if it is negative, for one of
+// 'fds' to be ready, like poll(). The milliseconds of poll() would dwarf short
+// latencies, so ppoll() is used where it exists.
+int Poll(pollfd* fds, nfds_t nfds, double timeout) {
+#ifdef BENCHMARK_OS_LINUX
+  timespec ts;
+  ts.tv_sec = static_cast<time_t>(timeout);
+  ts.tv_nsec = static_cast<long>((timeout - static_cast<double>(ts.tv_sec)) *
+                                 1e9);
+  return ppoll(fds, nfds, timeout < 0 ? nullptr : &ts, nullptr);
+#else
+  // Round up so as not to wake up before the deadline.
+  return poll(fds, nfds,
+              timeout < 0 ? -1 : static_cast<int>(std::ceil(timeout * 1e3)));
+#endif
+}
+
+// Configure a new socket: never raise SIGPIPE, and disable Nagle's algorithm
+// on TCP sockets so that small requests are not delayed.
+void ConfigureSocket(int fd, bool tcp) {
+  int one = 1;
+#ifdef SO_NOSIGPIPE
+  setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+  if (tcp) setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+}
+
+bool WriteAll(int fd, const char* data, size_t size) {
+  while (size > 0) {
+    ssize_t n = send(fd, data, size, kSendFlags);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    data += n;
+    size -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+bool ReadAll(int fd, char* data, size_t size) {
+  while (size > 0) {
+    ssize_t n = recv(fd, data, size, 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    data += n;
+    size -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+// Frames are a 4 byte little-endian length followed by the payload.
+bool WriteFrame(int fd, const std::string& payload) {
+  const uint32_t size = static_cast<uint32_t>(payload.size());
+  char header[4];
+  for (int i = 0; i < 4; ++i) header[i] = static_cast<char>(size >> (8 * i));
+  // Send small frames with a single call.
+  if (payload.size() <= kChunkSize) {
+    std::string frame(header, sizeof(header));
+    frame += payload;
+    return WriteAll(fd, frame.data(), frame.size());
+  }
+  return WriteAll(fd, header, sizeof(header)) &&
+         WriteAll(fd, payload.data(), payload.size());
+}
+
+bool ReadFrame(int fd, std::string* payload) {
+  unsigned char header[4];
+  if (!ReadAll(fd, reinterpret_cast<char*>(header), sizeof(header)))
+    return false;
+  uint32_t size = 0;
+  for (int i = 0; i < 4; ++i)
+    size |= static_cast<uint32_t>(header[i]) << (8 * i);
+  payload->resize(size);
+  return size == 0 || ReadAll(fd, &(*payload)[0], size);
+}
+
+// Forwards the bytes of a connection in both directions, delaying each chunk
+// according to a LinkShape. Each direction models a link which sends one
+// chunk at a time at 'bandwidth' bytes per second; a chunk is delivered
+// 'latency' plus up to 'jitter' seconds after it has been sent, but never
+// before a chunk sent earlier in the same direction.
+class Shaper {
+ public:
+  Shaper(int a, int b, const LinkShape& shape, unsigned seed)
+      : shape_(shape), random_(seed), jitter_(0.0, 1.0) {
+    links_[0].src = links_[1].dst = a;
+    links_[0].dst = links_[1].src = b;
+    fcntl(a, F_SETFL, fcntl(a, F_GETFL) | O_NONBLOCK);
+    fcntl(b, F_SETFL, fcntl(b, F_GETFL) | O_NONBLOCK);
+    thread_ = std::thread(&Shaper::Run, this);
+  }
+
+  // Both ends are closed by the shaper once either of them is.
+  ~Shaper() { thread_.join(); }
+
+ private:
+  struct Chunk {
+    double release;  // When the chunk reaches the far end of the link.
+    std::string data;
+    size_t offset;   // Bytes already written to 'dst'.
+  };
+
+  struct Link {
+    Link() : src(-1), dst(-1), free_at(0), last_release(0) {}
+
+    int src;
+    int dst;
+    double free_at;  // When the link has sent all the queued chunks.
+    double last_release;
+    std::deque<Chunk> queue;
+  };
+
+  // Returns false if 'link.src' was closed.
+  bool Receive(Link& link, char* buf) {
+    ssize_t n = recv(link.src, buf, kChunkSize, 0);
+    if (n < 0) return errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK;
+    if (n == 0) return false;
+    const double now = RealClockNow();
+    double sent = std::max(now, link.free_at);
+    if (shape_.bandwidth > 0) sent += static_cast<double>(n) / shape_.bandwidth;
+    link.free_at = sent;
+    double release = sent + shape_.latency + shape_.jitter * jitter_(random_);
+    release = std::max(release, link.last_release);
+    link.last_release = release;
+    Chunk chunk;
+    chunk.release = release;
+    chunk.data.assign(buf, static_cast<size_t>(n));
+    chunk.offset = 0;
+    link.queue.push_back(chunk);
+    return true;
+  }
+
+  // Write the chunks due by 'now'. Returns false if 'link.dst' was closed.
+  bool Deliver(Link& link, double now) {
+    while (!link.queue.empty() && link.queue.front().release <= now) {
+      Chunk& chunk = link.queue.front();
+      ssize_t n = send(link.dst, chunk.data.data() + chunk.offset,
+                       chunk.data.size() - chunk.offset, kSendFlags);
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+      }
+      chunk.offset += static_cast<size_t>(n);
+      if (chunk.offset == chunk.data.size()) link.queue.pop_front();
+    }
+    return true;
+  }
+
+  void Run() {
+#ifdef BENCHMARK_OS_LINUX
+    // The default timer slack of 50us would dwarf short latencies.
+    prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL);
+#endif
+    std::vector<char> buf(kChunkSize);
+    bool running = true;
+    while (running) {
+      // Each link polls its source for reading and its destination for
+      // writing; a negative fd is ignored by poll().
+      pollfd fds[2 * kNumLinks];
+      double wake = -1;
+      const double now = RealClockNow();
+      for (size_t i = 0; i < kNumLinks; ++i) {
+        const Link& link = links_[i];
+        pollfd& readable = fds[2 * i];
+        pollfd& writable = fds[2 * i + 1];
+        readable.fd = link.queue.size() < kMaxQueuedChunks ? link.src : -1;
+        readable.events = POLLIN;
+        writable.fd = -1;
+        writable.events = POLLOUT;
+        if (link.queue.empty()) continue;
+        if (link.queue.front().release <= now) {
+          writable.fd = link.dst;
+        } else if (wake < 0 || link.queue.front().release < wake) {
+          wake = link.queue.front().release;
+        }
+      }
+      if (Poll(fds, 2 * kNumLinks, wake < 0 ? -1 : wake - now) < 0 &&
+          errno != EINTR)
+        break;
+      for (size_t i = 0; i < kNumLinks; ++i) {
+        Link& link = links_[i];
+        // Like select(), treat a hang-up or an error as readable, so that
+        // Receive() sees it.
+        if ((fds[2 * i].revents & (POLLIN | POLLHUP | POLLERR)) &&
+            !Receive(link, buf.data()))
+          running = false;
+        if (!Deliver(link, RealClockNow())) running = false;
+      }
+    }
+    // Closing both ends makes the client and the server see the connection
+    // go away, whichever side closed it first.
+    close(links_[0].src);
+    close(links_[0].dst);
+  }
+
+  const LinkShape shape_;
+  std::mt19937 random_;
+  std::uniform_real_distribution<double> jitter_;
+  Link links_[kNumLinks];
+  std::thread thread_;
+
+  Shaper(const Shaper&);
+  Shaper& operator=(const Shaper&);
+};
+
+}  // end namespace
+
+struct LoopbackFixture::Listener {
+  Listener() : fd(-1) {}
+
+  int fd;
+  std::string dir;   // The temporary directory of a kUnixSocket.
+  std::string path;  // The path of a kUnixSocket.
+  // Held while a client connects and the server accepts it, so that each
+  // accepted socket is paired with the right client.
+  Mutex mu;
+};
+
+struct LoopbackFixture::Connection {
+  Connection() : client_fd(-1), server_fd(-1), shaper(nullptr) {}
+
+  int client_fd;
+  int server_fd;
+  std::thread server;
+  Shaper* shaper;
+};
+
+LoopbackFixture::LoopbackFixture(LoopbackTransport transport, LinkShape shape)
+    : transport_(transport), shape_(shape), listener_(nullptr) {
+  CHECK(shape.latency >= 0 && shape.jitter >= 0 && shape.bandwidth >= 0);
+}
+
+LoopbackFixture::~LoopbackFixture() { CHECK(listener_ == nullptr); }
+
+void LoopbackFixture::SetUpOnce(State& st) {
+  connections_.assign(st.threads, nullptr);
+  if (transport_ == kSocketPair) return;
+
+  std::unique_ptr<Listener> listener(new Listener);
+  const char* error = nullptr;
+  if (transport_ == kTcpSocket) {
+    listener->fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if (listener->fd < 0 ||
+        bind(listener->fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)))
+      error = "cannot bind a TCP socket to 127.0.0.1";
+  } else {
+    const char* tmp = std::getenv("TMPDIR");
+    std::string dir = std::string(tmp ? tmp : "/tmp") + "/benchmark.XXXXXX";
+    if (mkdtemp(&dir[0]) == nullptr) {
+      error = "cannot create a directory for the Unix-domain socket";
+    } else {
+      listener->dir = dir;
+      listener->path = dir + "/socket";
+      listener->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+      sockaddr_un addr;
+      std::memset(&addr, 0, sizeof(addr));
+      addr.sun_family = AF_UNIX;
+      if (listener->path.size() >= sizeof(addr.sun_path)) {
+        error = "the path of the Unix-domain socket is too long";
+      } else {
+        std::strcpy(addr.sun_path, listener->path.c_str());
+        if (listener->fd < 0 ||
+            bind(listener->fd, reinterpret_cast<sockaddr*>(&addr),
+                 sizeof(addr)))
+          error = "cannot bind a Unix-domain socket";
+      }
+    }
+  }
+  if (error == nullptr && listen(listener->fd, SOMAXCONN) != 0)
+    error = "cannot listen on the loopback socket";
+  listener_ = listener.release();
+  if (error != nullptr) {
+    // TearDownOnce() is not called when SetUpOnce() fails.
+    TearDownOnce(st);
+    st.SkipWithError(error);
+  }
+}
+
+void LoopbackFixture::TearDownOnce(State&) {
+  CHECK(std::all_of(connections_.begin(), connections_.end(),
+                    [](Connection* conn) { return conn == nullptr; }))
+      << "a connection was not closed";
+  connections_.clear();
+  if (listener_ == nullptr) return;
+  if (listener_->fd >= 0) close(listener_->fd);
+  if (!listener_->path.empty()) unlink(listener_->path.c_str());
+  if (!listener_->dir.empty()) rmdir(listener_->dir.c_str());
+  delete listener_;
+  listener_ = nullptr;
+}
+
+void LoopbackFixture::SetUpThread(State& st) {
+  int client = -1, server = -1;
+  if (transport_ == kSocketPair) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0) {
+      client = fds[0];
+      server = fds[1];
+    }
+  } else {
+    MutexLock l(listener_->mu);
+    sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    if (getsockname(listener_->fd, reinterpret_cast<sockaddr*>(&addr), &len) ==
+        0) {
+      client = socket(addr.ss_family, SOCK_STREAM, 0);
+      if (client >= 0 &&
+          connect(client, reinterpret_cast<sockaddr*>(&addr), len) == 0) {
+        server = accept(listener_->fd, nullptr, nullptr);
+      }
+    }
+  }
+  if (client < 0 || server < 0) {
+    if (client >= 0) close(client);
+    st.SkipWithError("cannot connect to the loopback server");
+    return;
+  }
+  const bool tcp = transport_ == kTcpSocket;
+  ConfigureSocket(client, tcp);
+  ConfigureSocket(server, tcp);
+
+  Connection* conn = new Connection;
+  conn->client_fd = client;
+  conn->server_fd = server;
+  if (shape_.latency > 0 || shape_.jitter > 0 || shape_.bandwidth > 0) {
+    // The client keeps its end of the real transport and the shaper relays
+    // the accepted end to the server through a socket pair.
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+      close(client);
+      close(server);
+      delete conn;
+      st.SkipWithError("cannot create the socket pair of the link shaper");
+      return;
+    }
+    ConfigureSocket(fds[0], false);
+    ConfigureSocket(fds[1], false);
+    conn->shaper = new Shaper(server, fds[0], shape_,
+                              static_cast<unsigned>(st.thread_index));
+    conn->server_fd = fds[1];
+  }
+  conn->server = std::thread(&LoopbackFixture::ServeConnection, this, conn);
+  connections_[st.thread_index] = conn;
+}
+
+void LoopbackFixture::TearDownThread(State& st) {
+  Connection* conn = connections_[st.thread_index];
+  if (conn == nullptr) return;
+  // The server and the shaper exit once they see the client go away.
+  close(conn->client_fd);
+  conn->server.join();
+  delete conn->shaper;
+  delete conn;
+  connections_[st.thread_index] = nullptr;
+}
+
+void LoopbackFixture::ServeConnection(Connection* conn) {
+  std::string request, response;
+  while (ReadFrame(conn->server_fd, &request)) {
+    response.clear();
+    HandleRequest(request, &response);
+    if (!WriteFrame(conn->server_fd, response)) break;
+  }
+  close(conn->server_fd);
+}
+
+bool LoopbackFixture::Call(State& st, const std::string& request,
+                           std::string* response) {
+  Connection* conn = connections_[st.thread_index];
+  if (conn == nullptr) return false;
+  const double start = RealClockNow();
+  if (!WriteFrame(conn->client_fd, request) ||
+      !ReadFrame(conn->client_fd, response)) {
+    st.SkipWithError("the loopback connection was closed");
+    return false;
+  }
+  st.RecordLatency(RealClockNow() - start);
+  return true;
+}
+
+int LoopbackFixture::client_fd(const State& st) const {
+  Connection* conn = connections_[st.thread_index];
+  return conn ? conn->client_fd : -1;
+}
+
+#else  // BENCHMARK_OS_WINDOWS
+
+struct LoopbackFixture::Listener {};
+struct LoopbackFixture::Connection {};
+
+LoopbackFixture::LoopbackFixture(LoopbackTransport transport, LinkShape shape)
+    : transport_(transport), shape_(shape), listener_(nullptr) {}
+
+LoopbackFixture::~LoopbackFixture() {}
+
+void LoopbackFixture::SetUpOnce(State& st) {
+  st.SkipWithError("LoopbackFixture is not supported on Windows");
+}
+
+void LoopbackFixture::TearDownOnce(State&) {}
+void LoopbackFixture::SetUpThread(State&) {}
+void LoopbackFixture::TearDownThread(State&) {}
+void LoopbackFixture::ServeConnection(Connection*) {}
+
+bool LoopbackFixture::Call(State&, const std::string&, std::string*) {
+  return false;
+}
+
+int LoopbackFixture::client_fd(const State&) const { return -1; }
+
+#endif  // BENCHMARK_OS_WINDOWS
+
+void LoopbackFixture::HandleRequest(const std::string& request,
+                                    std::string* response) {
+  *response = request;
+}
+
+}  // end namespace benchmark
@@ -0,0 +1,158 @@
+// Copyright 2018 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "manifest.h"
+#include "internal_macros.h"
+
+#if defined(BENCHMARK_OS_LINUX)
+#include <sched.h>
+#endif
+
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <sstream>
+
+#include "string_util.h"
+
+namespace benchmark {
+
+namespace {
+
+const char kManifestMagic[] = "benchmark_manifest";
+const int kManifestVersion = 1;
+
+std::vector<std::string> SplitFields(const std::string& line, char sep) {
+  std::vector<std::string> fields;
+  std::string::size_type start = 0;
+  for (;;) {
+    const std::string::size_type end = line.find(sep, start);
+    fields.push_back(line.substr(start, end - start));
+    if (end == std::string::npos) return fields;
+    start = end + 1;
+  }
+}
+
+template <class T>
+bool ParseNumber(const std::string& str, T* value) {
+  std::istringstream ss(str);
+  return static_cast<bool>(ss >> *value) && ss.peek() == EOF;
+}
+
+}  // end namespace
+
+void WriteManifest(std::ostream& out, const Manifest& manifest) {
+  out << kManifestMagic << '\t' << kManifestVersion << '\n';
+  for (const auto& flag : manifest.flags)
+    out << "flag\t" << flag.first << '\t' << flag.second << '\n';
+  for (const PlannedRun& run : manifest.runs) {
+    out << "run\t" << run.name << '\t' << run.iterations << '\t' << run.seed
+        << '\t';
+    for (size_t i = 0; i < run.cpus.size(); ++i)
+      out << (i == 0 ? "" : ",") << run.cpus[i];
+    out << '\n';
+  }
+}
+
+bool ReadManifest(std::istream& in, Manifest* manifest, std::string* error) {
+  *manifest = Manifest();
+  std::string line;
+  int line_num = 0;
+  while (std::getline(in, line)) {
+    ++line_num;
+    if (line.empty()) continue;
+    const std::vector<std::string> fields = SplitFields(line, '\t');
+    bool ok = false;
+    if (line_num == 1) {
+      int version;
+      ok = fields.size() == 2 && fields[0] == kManifestMagic &&
+           ParseNumber(fields[1], &version) && version == kManifestVersion;
+    } else if (fields[0] == "flag") {
+      ok = fields.size() == 3;
+      if (ok) manifest->flags.push_back(std::make_pair(fields[1], fields[2]));
+    } else if (fields[0] == "run" && fields.size() == 5) {
+      PlannedRun run;
+      run.name = fields[1];
+      ok = !run.name.empty() && ParseNumber(fields[2], &run.iterations) &&
+           run.iterations > 0 && ParseNumber(fields[3], &run.seed);
+      if (!fields[4].empty()) {
+        for (const std::string& cpu : SplitFields(fields[4], ',')) {
+          run.cpus.push_back(-1);
+          ok = ok && ParseNumber(cpu, &run.cpus.back());
+        }
+      }
+      if (ok) manifest->runs.push_back(run);
+    }
+    if (!ok) {
+      *error = StrCat("line ", line_num, " is malformed: '", line, "'");
+      return false;
+    }
+  }
+  if (line_num == 0) {
+    *error = "it is empty";
+    return false;
+  }
+  return true;
+}
+
+int CurrentCPU() {
+#if defined(BENCHMARK_OS_LINUX)
+  return sched_getcpu();
+#else
+  return -1;
+#endif
+}
+
+std::vector<int> AllowedCPUs() {
+  std::vector<int> cpus;
+#if defined(BENCHMARK_OS_LINUX)
+  cpu_set_t allowed;
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+      if (CPU_ISSET(cpu, &allowed)) cpus.push_back(cpu);
+  }
+#endif
+  return cpus;
+}
+
+ScopedCPUPin::ScopedCPUPin(const std::vector<int>& cpus) : pinned_(false) {
+#if defined(BENCHMARK_OS_LINUX)
+  if (cpus.empty()) return;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return;
+    CPU_SET(cpu, &set);
+  }
+  cpu_set_t saved;
+  if (sched_getaffinity(0, sizeof(saved), &saved) != 0) return;
+  if (sched_setaffinity(0, sizeof(set), &set) != 0) return;
+  saved_.resize(sizeof(saved));
+  std::memcpy(saved_.data(), &saved, sizeof(saved));
+  pinned_ = true;
+#else
+  ((void)cpus);
+#endif
+}
+
+ScopedCPUPin::~ScopedCPUPin() {
+#if defined(BENCHMARK_OS_LINUX)
+  if (!pinned_) return;
+  cpu_set_t saved;
+  std::memcpy(&saved, saved_.data(), sizeof(saved));
+  sched_setaffinity(0, sizeof(saved), &saved);
+#endif
+}
+
+}  // end namespace benchmark
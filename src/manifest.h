@@ -0,0 +1,72 @@
+#ifndef BENCHMARK_MANIFEST_H_
+#define BENCHMARK_MANIFEST_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace benchmark {
+
+// One measured run of a benchmark instance: the run whose results are
+// reported for a repetition, after the iteration count has been chosen.
+struct PlannedRun {
+  PlannedRun() : iterations(0), seed(0) {}
+
+  std::string name;  // The name of the instance.
+  size_t iterations;
+  uint64_t seed;     // See State::seed.
+  // The CPU each thread started on, by thread index, or -1 if unknown. Empty
+  // if the run failed before starting its threads.
+  std::vector<int> cpus;
+};
+
+// The plan of a whole program run, from which it can be reproduced: the
+// flags which affect the measurements, and the measured runs in the order in
+// which they were run.
+struct Manifest {
+  std::vector<std::pair<std::string, std::string> > flags;
+  std::vector<PlannedRun> runs;
+};
+
+// Writes 'manifest' as lines of tab separated fields:
+//   benchmark_manifest  1
+//   flag  <name>  <value>
+//   run   <name>  <iterations>  <seed>  <cpu>,<cpu>,...
+void WriteManifest(std::ostream& out, const Manifest& manifest);
+
+// Reads a manifest written by WriteManifest(). Returns false and sets
+// 'error' if it is malformed.
+bool ReadManifest(std::istream& in, Manifest* manifest, std::string* error);
+
+// Returns the CPU the calling thread is running on, or -1 if it cannot be
+// determined on this system.
+int CurrentCPU();
+
+// Returns the CPUs the calling thread may run on, or an empty list if they
+// cannot be determined on this system.
+std::vector<int> AllowedCPUs();
+
+// Pins the calling thread to the CPUs 'cpus', unless it is empty, and
+// restores the CPUs it may run on when destroyed. Only supported on Linux.
+class ScopedCPUPin {
+ public:
+  explicit ScopedCPUPin(const std::vector<int>& cpus);
+  ~ScopedCPUPin();
+
+  // Whether the thread was pinned.
+  bool ok() const { return pinned_; }
+
+ private:
+  bool pinned_;
+  std::vector<unsigned char> saved_;
+
+  ScopedCPUPin(const ScopedCPUPin&);
+  ScopedCPUPin& operator=(const ScopedCPUPin&);
+};
+
+}  // end namespace benchmark
+
+#endif  // BENCHMARK_MANIFEST_H_
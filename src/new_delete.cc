@@ -0,0 +1,85 @@
+// Copyright 2018 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// The replacements of the global operator new and delete which are linked
+// into programs using the benchmark_allocator library. They dispatch to the
+// allocator selected for the running benchmark.
+
+#include <cstdlib>
+#include <new>
+
+#include "allocator.h"
+#include "internal_macros.h"
+
+namespace {
+
+void* Allocate(std::size_t size) {
+  for (;;) {
+    void* ptr = benchmark::internal::DispatchAllocate(size);
+    if (ptr != nullptr) return ptr;
+    std::new_handler handler = std::get_new_handler();
+    if (handler == nullptr) {
+#ifdef BENCHMARK_HAS_NO_EXCEPTIONS
+      std::abort();
+#else
+      throw std::bad_alloc();
+#endif
+    }
+    handler();
+  }
+}
+
+struct RegisterDispatch {
+  RegisterDispatch() { benchmark::internal::RegisterAllocatorDispatch(); }
+} register_dispatch;
+
+}  // end namespace
+
+void* operator new(std::size_t size) { return Allocate(size); }
+
+void* operator new[](std::size_t size) { return Allocate(size); }
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return benchmark::internal::DispatchAllocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return benchmark::internal::DispatchAllocate(size);
+}
+
+void operator delete(void* ptr) noexcept {
+  benchmark::internal::DispatchFree(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  benchmark::internal::DispatchFree(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+  benchmark::internal::DispatchFree(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+  benchmark::internal::DispatchFree(ptr);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void* ptr, std::size_t) noexcept {
+  benchmark::internal::DispatchFree(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+  benchmark::internal::DispatchFree(ptr);
+}
+#endif
@@ -0,0 +1,423 @@
+// Copyright 2018 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "perf_counters.h"
+#include "internal_macros.h"
+
+#if defined(BENCHMARK_OS_LINUX)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "check.h"
+#include "string_util.h"
+
+namespace benchmark {
+
+namespace {
+
+struct EventInfo {
+  const char* name;
+  uint32_t type;
+  uint64_t config;
+};
+
+// The type and config of the events are only known on Linux.
+#if defined(BENCHMARK_OS_LINUX)
+#define BENCHMARK_PERF_EVENT(name, type, config) {name, type, config}
+#else
+#define BENCHMARK_PERF_EVENT(name, type, config) {name, 0, 0}
+#endif
+
+const EventInfo kEvents[] = {
+    BENCHMARK_PERF_EVENT("instructions", PERF_TYPE_HARDWARE,
+                         PERF_COUNT_HW_INSTRUCTIONS),
+    BENCHMARK_PERF_EVENT("cycles", PERF_TYPE_HARDWARE,
+                         PERF_COUNT_HW_CPU_CYCLES),
+    BENCHMARK_PERF_EVENT("ref-cycles", PERF_TYPE_HARDWARE,
+                         PERF_COUNT_HW_REF_CPU_CYCLES),
+    BENCHMARK_PERF_EVENT("branches", PERF_TYPE_HARDWARE,
+                         PERF_COUNT_HW_BRANCH_INSTRUCTIONS),
+    BENCHMARK_PERF_EVENT("branch-misses", PERF_TYPE_HARDWARE,
+                         PERF_COUNT_HW_BRANCH_MISSES),
+    BENCHMARK_PERF_EVENT("cache-references", PERF_TYPE_HARDWARE,
+                         PERF_COUNT_HW_CACHE_REFERENCES),
+    BENCHMARK_PERF_EVENT("cache-misses", PERF_TYPE_HARDWARE,
+                         PERF_COUNT_HW_CACHE_MISSES),
+    BENCHMARK_PERF_EVENT("page-faults", PERF_TYPE_SOFTWARE,
+                         PERF_COUNT_SW_PAGE_FAULTS),
+};
+
+#undef BENCHMARK_PERF_EVENT
+
+const EventInfo* FindEvent(const std::string& name) {
+  for (const EventInfo& ev : kEvents)
+    if (name == ev.name) return &ev;
+  return nullptr;
+}
+
+// The names of the top-down events in the 'events' directory of a PMU, in
+// the order described by internal::TopdownEventSet.
+const char* const kTopdownPerfMetricNames[] = {
+    "slots", "topdown-retiring", "topdown-bad-spec", "topdown-fe-bound",
+    "topdown-be-bound"};
+const char* const kTopdownLevel2MetricNames[] = {
+    "topdown-heavy-ops", "topdown-br-mispredict", "topdown-fetch-lat",
+    "topdown-mem-bound"};
+const char* const kTopdownLegacyNames[] = {
+    "topdown-total-slots", "topdown-slots-issued", "topdown-slots-retired",
+    "topdown-fetch-bubbles", "topdown-recovery-bubbles"};
+
+bool ReadFirstLine(const std::string& path, std::string* line) {
+  std::ifstream f(path.c_str());
+  return f.is_open() && std::getline(f, *line);
+}
+
+// Set the bits of 'value' in 'config' according to a format such as
+// "config:0-7" or "config:0-7,32-35", as found in the 'format' directory of a
+// PMU. The lowest bits of 'value' go to the first range.
+bool ApplyFormat(const std::string& format, uint64_t value, uint64_t* config) {
+  const std::string prefix = "config:";
+  if (format.compare(0, prefix.size(), prefix) != 0) return false;
+  std::istringstream ranges(format.substr(prefix.size()));
+  std::string range;
+  while (std::getline(ranges, range, ',')) {
+    const size_t dash = range.find('-');
+    const int lo = std::atoi(range.c_str());
+    const int hi =
+        dash == std::string::npos ? lo : std::atoi(range.c_str() + dash + 1);
+    if (lo < 0 || hi < lo || hi > 63) return false;
+    for (int bit = lo; bit <= hi; ++bit) {
+      if (value & 1) *config |= 1ull << bit;
+      value >>= 1;
+    }
+  }
+  return value == 0;
+}
+
+// Encode the event 'name' of the PMU described in 'pmu_dir' as the next event
+// of 'events'. Returns false if the PMU does not export the event, or sets
+// 'error' as well if the event cannot be encoded.
+bool AddTopdownEvent(const std::string& pmu_dir, const char* name,
+                     internal::TopdownEvents* events, std::string* error) {
+  const std::string event = pmu_dir + "/events/" + name;
+  std::string line;
+  if (!ReadFirstLine(event, &line)) return false;
+  // The event is described by terms such as "event=0x3c,umask=0x0,any=1"; a
+  // term without a value is set to 1.
+  const int i = events->num_events;
+  events->config[i] = 0;
+  std::istringstream terms(line);
+  std::string term;
+  while (std::getline(terms, term, ',')) {
+    const size_t eq = term.find('=');
+    const std::string term_name = term.substr(0, eq);
+    const uint64_t value =
+        eq == std::string::npos
+            ? 1
+            : std::strtoull(term.c_str() + eq + 1, nullptr, 0);
+    std::string format;
+    if (!ReadFirstLine(pmu_dir + "/format/" + term_name, &format) ||
+        !ApplyFormat(format, value, &events->config[i])) {
+      *error = StrCat("cannot encode the term '", term, "' of the event ",
+                      name);
+      return false;
+    }
+  }
+  events->scale[i] = 1;
+  if (ReadFirstLine(event + ".scale", &line))
+    events->scale[i] = std::strtod(line.c_str(), nullptr);
+  events->num_events = i + 1;
+  return true;
+}
+
+// Encode all of 'names' as the next events of 'events'. Returns false if one
+// of them is not exported, or sets 'error' as well if one cannot be encoded.
+template <size_t N>
+bool AddTopdownEvents(const std::string& pmu_dir, const char* const (&names)[N],
+                      internal::TopdownEvents* events, std::string* error) {
+  for (const char* name : names)
+    if (!AddTopdownEvent(pmu_dir, name, events, error)) return false;
+  return true;
+}
+
+}  // end namespace
+
+namespace internal {
+
+bool PerfEventCountConverged(double count, double per_iter,
+                             double prev_per_iter) {
+  return count >= kMinPerfEventCount &&
+         std::abs(per_iter - prev_per_iter) <=
+             kPerfEventTolerance * prev_per_iter;
+}
+
+double NextPerfEventIterations(double iters, double count) {
+  if (count <= 0) return 0;
+  if (count >= kMinPerfEventCount) return 2 * iters;
+  // The same margin as the ramp-up by time.
+  return iters * kMinPerfEventCount * 1.4 / count;
+}
+
+bool LoadTopdownEvents(const std::string& pmu_dir, TopdownEvents* events,
+                       std::string* error) {
+  std::string line;
+  if (!ReadFirstLine(pmu_dir + "/type", &line)) {
+    *error = "the CPU has no performance monitoring unit exposed by the kernel";
+    return false;
+  }
+  events->type = static_cast<uint32_t>(std::strtoul(line.c_str(), nullptr, 10));
+  error->clear();
+  events->set = kTopdownPerfMetrics;
+  events->num_events = 0;
+  if (AddTopdownEvents(pmu_dir, kTopdownPerfMetricNames, events, error)) {
+    // The level 2 metrics are only counted if all of them are exported.
+    const int level1_events = events->num_events;
+    if (!AddTopdownEvents(pmu_dir, kTopdownLevel2MetricNames, events, error)) {
+      events->num_events = level1_events;
+      error->clear();
+    }
+    return true;
+  }
+  if (!error->empty()) return false;
+  events->set = kTopdownLegacySlots;
+  events->num_events = 0;
+  if (AddTopdownEvents(pmu_dir, kTopdownLegacyNames, events, error))
+    return true;
+  if (error->empty()) {
+    *error = "the kernel does not export the top-down events for this CPU "
+             "(only Intel CPUs from Sandy Bridge on are supported)";
+  }
+  return false;
+}
+
+void AddTopdownSlots(const TopdownEvents& events, const double* slots,
+                     TopdownCounts* counts) {
+  if (events.set == kTopdownLegacySlots) {
+    // slots[1] - slots[2] are the slots issued but not retired.
+    const double frontend = slots[3];
+    const double bad_speculation = slots[1] - slots[2] + slots[4];
+    const double retiring = slots[2];
+    counts->total_slots += slots[0];
+    counts->frontend_slots += frontend;
+    counts->bad_speculation_slots += bad_speculation;
+    counts->retiring_slots += retiring;
+    counts->backend_slots += slots[0] - frontend - bad_speculation - retiring;
+    return;
+  }
+  counts->total_slots += slots[0];
+  counts->retiring_slots += slots[1];
+  counts->bad_speculation_slots += slots[2];
+  counts->frontend_slots += slots[3];
+  counts->backend_slots += slots[4];
+  if (events.num_events > 5) {
+    counts->heavy_operations_slots += slots[5];
+    counts->branch_mispredict_slots += slots[6];
+    counts->fetch_latency_slots += slots[7];
+    counts->memory_bound_slots += slots[8];
+  }
+}
+
+}  // end namespace internal
+
+TopdownCounts& TopdownCounts::operator+=(const TopdownCounts& other) {
+  total_slots += other.total_slots;
+  frontend_slots += other.frontend_slots;
+  bad_speculation_slots += other.bad_speculation_slots;
+  retiring_slots += other.retiring_slots;
+  backend_slots += other.backend_slots;
+  fetch_latency_slots += other.fetch_latency_slots;
+  branch_mispredict_slots += other.branch_mispredict_slots;
+  heavy_operations_slots += other.heavy_operations_slots;
+  memory_bound_slots += other.memory_bound_slots;
+  return *this;
+}
+
+bool PerfCounter::IsValidEvent(const std::string& name) {
+  return FindEvent(name) != nullptr;
+}
+
+#if defined(BENCHMARK_OS_LINUX)
+PerfCounter::PerfCounter(const std::string& name) : fd_(-1) {
+  const EventInfo* ev = FindEvent(name);
+  CHECK(ev != nullptr) << "unknown perf event '" << name << "'";
+  struct perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = ev->type;
+  attr.config = ev->config;
+  // Only count the user mode part of the timed region; the kernel work done
+  // to start and stop the timers would otherwise dominate short benchmarks.
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  fd_ = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1,
+                                 PERF_FLAG_FD_CLOEXEC));
+}
+
+PerfCounter::~PerfCounter() {
+  if (fd_ >= 0) close(fd_);
+}
+
+bool PerfCounter::Read(uint64_t* value) const {
+  CHECK(ok());
+  return read(fd_, value, sizeof(*value)) == sizeof(*value);
+}
+
+namespace {
+
+struct CachedTopdownEvents {
+  bool ok;
+  internal::TopdownEvents events;
+  std::string error;
+};
+
+// The top-down events are looked up once. Hybrid CPUs have no "cpu" PMU and
+// only count them on the big cores, in "cpu_core".
+const CachedTopdownEvents& GetTopdownEvents() {
+  static const CachedTopdownEvents* cached = [] {
+    CachedTopdownEvents* c = new CachedTopdownEvents;
+    std::string pmu_dir = "/sys/bus/event_source/devices/cpu";
+    std::string type;
+    if (!ReadFirstLine(pmu_dir + "/type", &type) &&
+        ReadFirstLine(pmu_dir + "_core/type", &type))
+      pmu_dir += "_core";
+    c->ok = internal::LoadTopdownEvents(pmu_dir, &c->events, &c->error);
+    return c;
+  }();
+  return *cached;
+}
+
+}  // end namespace
+
+bool TopdownCounter::IsSupported(std::string* error) {
+  const CachedTopdownEvents& events = GetTopdownEvents();
+  if (!events.ok) *error = events.error;
+  return events.ok;
+}
+
+bool TopdownCounter::HasLevel2() {
+  const CachedTopdownEvents& events = GetTopdownEvents();
+  return events.ok && events.events.num_events > 5;
+}
+
+TopdownCounter::TopdownCounter() {
+  for (int& fd : fds_) fd = -1;
+  const CachedTopdownEvents& events = GetTopdownEvents();
+  if (!events.ok) return;
+  for (int i = 0; i < events.events.num_events; ++i) {
+    struct perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = events.events.type;
+    attr.config = events.events.config[i];
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // The first event leads the group and reads all of them at once. The
+    // perf metrics can only be counted in a group led by the slots.
+    if (i == 0) {
+      attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                         PERF_FORMAT_TOTAL_TIME_RUNNING;
+    }
+    fds_[i] = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1,
+                                       fds_[0], PERF_FLAG_FD_CLOEXEC));
+    if (fds_[i] < 0) {
+      for (int& fd : fds_) {
+        if (fd >= 0) close(fd);
+        fd = -1;
+      }
+      return;
+    }
+  }
+}
+
+TopdownCounter::~TopdownCounter() {
+  for (int fd : fds_)
+    if (fd >= 0) close(fd);
+}
+
+bool TopdownCounter::Read(Sample* sample) const {
+  CHECK(ok());
+  const int num_events = GetTopdownEvents().events.num_events;
+  // struct read_format { nr, time_enabled, time_running, values[nr] }
+  uint64_t buf[3 + kMaxEvents];
+  const ssize_t size = static_cast<ssize_t>((3 + num_events) * sizeof(buf[0]));
+  if (read(fds_[0], buf, sizeof(buf)) != size ||
+      buf[0] != static_cast<uint64_t>(num_events))
+    return false;
+  sample->time_enabled = buf[1];
+  sample->time_running = buf[2];
+  for (int i = 0; i < num_events; ++i) sample->values[i] = buf[3 + i];
+  return true;
+}
+
+bool TopdownCounter::Accumulate(const Sample& start, const Sample& end,
+                                TopdownCounts* counts) const {
+  const uint64_t running = end.time_running - start.time_running;
+  if (running == 0) return false;
+  const double multiplexing =
+      static_cast<double>(end.time_enabled - start.time_enabled) /
+      static_cast<double>(running);
+  const internal::TopdownEvents& events = GetTopdownEvents().events;
+  double slots[kMaxEvents];
+  for (int i = 0; i < events.num_events; ++i) {
+    slots[i] = static_cast<double>(end.values[i] - start.values[i]) *
+               events.scale[i] * multiplexing;
+  }
+  internal::AddTopdownSlots(events, slots, counts);
+  return true;
+}
+#else
+PerfCounter::PerfCounter(const std::string& name) : fd_(-1) {
+  CHECK(IsValidEvent(name)) << "unknown perf event '" << name << "'";
+}
+
+PerfCounter::~PerfCounter() {}
+
+bool PerfCounter::Read(uint64_t*) const {
+  CHECK(ok());
+  return false;
+}
+
+bool TopdownCounter::IsSupported(std::string* error) {
+  *error = "top-down analysis is only supported on Linux";
+  return false;
+}
+
+bool TopdownCounter::HasLevel2() { return false; }
+
+TopdownCounter::TopdownCounter() {
+  for (int& fd : fds_) fd = -1;
+}
+
+TopdownCounter::~TopdownCounter() {}
+
+bool TopdownCounter::Read(Sample*) const {
+  CHECK(ok());
+  return false;
+}
+
+bool TopdownCounter::Accumulate(const Sample&, const Sample&,
+                                TopdownCounts*) const {
+  return false;
+}
+#endif
+
+}  // end namespace benchmark
@@ -0,0 +1,202 @@
+#ifndef BENCHMARK_PERF_COUNTERS_H_
+#define BENCHMARK_PERF_COUNTERS_H_
+
+#include <cstdint>
+#include <string>
+
+namespace benchmark {
+
+// Counts a performance monitoring event, such as retired instructions, for
+// the thread which constructed it. Only events occurring in user mode are
+// counted. On Linux the counter is opened with perf_event_open(2); it is not
+// supported on other systems.
+class PerfCounter {
+ public:
+  // Returns true if 'name' is the name of a supported event, e.g.
+  // "instructions" or "cycles". The names follow the perf(1) tool.
+  static bool IsValidEvent(const std::string& name);
+
+  // REQUIRES: IsValidEvent(name)
+  explicit PerfCounter(const std::string& name);
+  ~PerfCounter();
+
+  // Returns false if the counter could not be opened, e.g. because the
+  // system does not expose hardware counters or because of the value of
+  // /proc/sys/kernel/perf_event_paranoid.
+  bool ok() const { return fd_ >= 0; }
+
+  // REQUIRES: ok()
+  bool Read(uint64_t* value) const;
+
+ private:
+  int fd_;
+
+  PerfCounter(const PerfCounter&);
+  PerfCounter& operator=(const PerfCounter&);
+};
+
+// The issue slots counted by a top-down analysis in each category. See "A
+// Top-Down Method for Performance Analysis and Counters Architecture" (A.
+// Yasin, 2014). The level 2 slots are only counted where the PMU exports
+// their events, see TopdownCounter::HasLevel2().
+struct TopdownCounts {
+  TopdownCounts()
+      : total_slots(0),
+        frontend_slots(0),
+        bad_speculation_slots(0),
+        retiring_slots(0),
+        backend_slots(0),
+        fetch_latency_slots(0),
+        branch_mispredict_slots(0),
+        heavy_operations_slots(0),
+        memory_bound_slots(0) {}
+
+  TopdownCounts& operator+=(const TopdownCounts& other);
+
+  // The level 1 fraction of the slots in each of the four categories, which
+  // add up to about one. REQUIRES: total_slots > 0
+  double frontend_bound() const { return frontend_slots / total_slots; }
+  double bad_speculation() const {
+    return bad_speculation_slots / total_slots;
+  }
+  double retiring() const { return retiring_slots / total_slots; }
+  double backend_bound() const { return backend_slots / total_slots; }
+
+  // The level 2 fractions, which split each level 1 category in two.
+  // REQUIRES: total_slots > 0
+  double fetch_latency() const { return fetch_latency_slots / total_slots; }
+  double fetch_bandwidth() const { return frontend_bound() - fetch_latency(); }
+  double branch_mispredicts() const {
+    return branch_mispredict_slots / total_slots;
+  }
+  double machine_clears() const {
+    return bad_speculation() - branch_mispredicts();
+  }
+  double heavy_operations() const {
+    return heavy_operations_slots / total_slots;
+  }
+  double light_operations() const { return retiring() - heavy_operations(); }
+  double memory_bound() const { return memory_bound_slots / total_slots; }
+  double core_bound() const { return backend_bound() - memory_bound(); }
+
+  double total_slots;
+  double frontend_slots;
+  double bad_speculation_slots;
+  double retiring_slots;
+  double backend_slots;
+  double fetch_latency_slots;
+  double branch_mispredict_slots;
+  double heavy_operations_slots;
+  double memory_bound_slots;
+};
+
+// Counts the top-down events for the thread which constructed it, in user
+// mode, using the events which Linux exports for the CPU model in the
+// 'events' directory of its PMU, /sys/bus/event_source/devices/cpu, or
+// cpu_core on hybrid CPUs: the slots and topdown-* metrics of Ice Lake and
+// later, or else the topdown-* events of Sandy Bridge to Cascade Lake. The
+// events are counted as a group so that they cover the same time, and scaled
+// up if the PMU had to multiplex them.
+class TopdownCounter {
+ public:
+  // Returns false and sets 'error' if top-down analysis is not supported on
+  // this system.
+  static bool IsSupported(std::string* error);
+
+  // Returns true if the level 2 categories are counted, which takes the
+  // level 2 metrics of Sapphire Rapids and later.
+  static bool HasLevel2();
+
+  TopdownCounter();
+  ~TopdownCounter();
+
+  // Returns false if the events could not be opened, e.g. because of the
+  // value of /proc/sys/kernel/perf_event_paranoid.
+  bool ok() const { return fds_[0] >= 0; }
+
+  // The most events in a group: the slots and eight metrics.
+  static const int kMaxEvents = 9;
+
+  struct Sample {
+    uint64_t values[kMaxEvents];
+    uint64_t time_enabled;
+    uint64_t time_running;
+  };
+
+  // REQUIRES: ok()
+  bool Read(Sample* sample) const;
+
+  // Add the counts between 'start' and 'end' to 'counts'. Returns false if
+  // the events were not scheduled on the PMU in the meantime.
+  bool Accumulate(const Sample& start, const Sample& end,
+                  TopdownCounts* counts) const;
+
+ private:
+  int fds_[kMaxEvents];
+
+  TopdownCounter(const TopdownCounter&);
+  TopdownCounter& operator=(const TopdownCounter&);
+};
+
+namespace internal {
+
+// When a perf event is the primary metric, a ramp-up run is significant once
+// it has counted at least kMinPerfEventCount events and its count per
+// iteration is within kPerfEventTolerance of the previous run's.
+const double kMinPerfEventCount = 1e6;
+const double kPerfEventTolerance = 0.01;
+
+// Returns true if a run which counted 'count' events in total, 'per_iter' per
+// iteration, is significant after a run which counted 'prev_per_iter' per
+// iteration.
+bool PerfEventCountConverged(double count, double per_iter,
+                             double prev_per_iter);
+
+// Returns the iteration count of the ramp-up run which follows a run of
+// 'iters' iterations that counted 'count' events: enough to count
+// kMinPerfEventCount events with a margin or, if that run already did, twice
+// its iterations so the next count per iteration can be compared to it.
+// Returns 0 if nothing was counted.
+double NextPerfEventIterations(double iters, double count);
+
+// The set of top-down events which a PMU exports.
+enum TopdownEventSet {
+  // Ice Lake and later: "slots", which leads the group, and the level 1
+  // metrics "topdown-retiring", "topdown-bad-spec", "topdown-fe-bound" and
+  // "topdown-be-bound", followed on Sapphire Rapids and later by the level 2
+  // "topdown-heavy-ops", "topdown-br-mispredict", "topdown-fetch-lat" and
+  // "topdown-mem-bound". The kernel reads each metric in slots.
+  kTopdownPerfMetrics,
+  // Sandy Bridge to Cascade Lake: "topdown-total-slots",
+  // "topdown-slots-issued", "topdown-slots-retired", "topdown-fetch-bubbles"
+  // and "topdown-recovery-bubbles".
+  kTopdownLegacySlots
+};
+
+// The perf_event_attr type and config of the top-down events, in the order
+// listed above, and the factor by which their counts are multiplied to
+// obtain slots.
+struct TopdownEvents {
+  TopdownEventSet set;
+  int num_events;
+  uint32_t type;
+  uint64_t config[TopdownCounter::kMaxEvents];
+  double scale[TopdownCounter::kMaxEvents];
+};
+
+// Read the top-down events of the PMU described in 'pmu_dir', e.g.
+// "/sys/bus/event_source/devices/cpu", preferring the perf metrics. Exposed
+// for testing.
+bool LoadTopdownEvents(const std::string& pmu_dir, TopdownEvents* events,
+                       std::string* error);
+
+// Converts the slots counted by each event of 'events', in their order, to
+// the categories of 'counts', adding to them.
+void AddTopdownSlots(const TopdownEvents& events, const double* slots,
+                     TopdownCounts* counts);
+
+}  // end namespace internal
+
+}  // end namespace benchmark
+
+#endif  // BENCHMARK_PERF_COUNTERS_H_
@@ -0,0 +1,246 @@
+// Copyright 2018 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "preflight.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "sleep.h"
+#include "string_util.h"
+#include "sysinfo.h"
+
+namespace benchmark {
+
+namespace {
+
+// The interval over which swap activity is sampled.
+const int kSwapSampleMillis = 100;
+
+// Reads the value of 'key' from a file of "key value" lines, such as
+// /proc/vmstat or /proc/meminfo, in which the key may end with a colon.
+bool ReadKeyFromFile(std::string const& fname, std::string const& key,
+                     double* value) {
+  std::ifstream f(fname.c_str());
+  std::string line;
+  while (std::getline(f, line)) {
+    std::istringstream ss(line);
+    std::string name;
+    ss >> name;
+    if (!name.empty() && name.back() == ':') name.pop_back();
+    if (name == key) return static_cast<bool>(ss >> *value);
+  }
+  return false;
+}
+
+// Returns "on" or "off" for a file holding 'on_value' or another number, or
+// the empty string if it cannot be read.
+std::string ReadSwitch(std::string const& fname, int on_value) {
+  int value;
+  if (!ReadFromFile(fname, &value)) return std::string();
+  return value == on_value ? "on" : "off";
+}
+
+// Returns the mode marked as selected in a file such as
+// "always [madvise] never".
+std::string ReadSelectedMode(std::string const& fname) {
+  std::ifstream f(fname.c_str());
+  std::string mode;
+  while (f >> mode) {
+    if (mode.size() > 2 && mode.front() == '[' && mode.back() == ']')
+      return mode.substr(1, mode.size() - 2);
+  }
+  return std::string();
+}
+
+double ReadSwappedPages() {
+  double in, out;
+  if (!ReadKeyFromFile("/proc/vmstat", "pswpin", &in) ||
+      !ReadKeyFromFile("/proc/vmstat", "pswpout", &out))
+    return -1;
+  return in + out;
+}
+
+// Returns the CPUs per period allowed by the CPU controller whose files are
+// in 'dir', 0 if there is no quota, or -1 if the files cannot be read.
+double ReadCgroupCpuQuota(std::string const& dir, bool v2) {
+  double quota, period;
+  if (v2) {
+    // "max 100000" or "<quota> <period>".
+    std::ifstream f((dir + "/cpu.max").c_str());
+    std::string max;
+    if (!(f >> max >> period)) return -1;
+    if (max == "max") return 0;
+    std::istringstream ss(max);
+    if (!(ss >> quota)) return -1;
+  } else {
+    if (!ReadFromFile(dir + "/cpu.cfs_quota_us", &quota) ||
+        !ReadFromFile(dir + "/cpu.cfs_period_us", &period))
+      return -1;
+    if (quota < 0) return 0;
+  }
+  return period > 0 ? quota / period : -1;
+}
+
+// Returns the CPU quota of the cgroup of the process, looking it up in
+// either version of the cgroup hierarchy. Inside a container the cgroup of
+// the process may be the root of what is mounted.
+double ReadCpuQuota() {
+  std::ifstream f("/proc/self/cgroup");
+  std::string line;
+  while (std::getline(f, line)) {
+    // "<hierarchy>:<controllers>:<path>"
+    const size_t first = line.find(':');
+    const size_t second = line.find(':', first + 1);
+    if (first == std::string::npos || second == std::string::npos) continue;
+    const std::string controllers =
+        line.substr(first + 1, second - first - 1);
+    const std::string path = line.substr(second + 1);
+    std::vector<std::string> dirs;
+    bool v2 = false;
+    if (controllers.empty()) {
+      v2 = true;
+      dirs.push_back("/sys/fs/cgroup");
+    } else if (("," + controllers + ",").find(",cpu,") != std::string::npos) {
+      dirs.push_back("/sys/fs/cgroup/cpu");
+      dirs.push_back("/sys/fs/cgroup/cpu,cpuacct");
+    } else {
+      continue;
+    }
+    for (const std::string& dir : dirs) {
+      double quota = ReadCgroupCpuQuota(dir + path, v2);
+      if (quota < 0) quota = ReadCgroupCpuQuota(dir, v2);
+      if (quota >= 0) return quota;
+    }
+  }
+  return -1;
+}
+
+PreflightCheck MakeCheck(const char* name, bool known, std::string value,
+                         bool ok, std::string expected) {
+  PreflightCheck check;
+  check.name = name;
+  check.value = known ? value : "unknown";
+  check.expected = expected;
+  check.ok = !known || ok;
+  return check;
+}
+
+std::string FormatMiB(double bytes) {
+  return StringPrintF("%.0f MiB", bytes / (1024 * 1024));
+}
+
+}  // end namespace
+
+HostState ReadHostState(const CPUInfo& cpu_info, const TimerInfo& timer_info) {
+  HostState host;
+  host.num_cpus = cpu_info.num_cpus;
+  host.clocksource = timer_info.clocksource;
+
+  for (int cpu = 0; cpu < cpu_info.num_cpus; ++cpu) {
+    std::string governor;
+    if (ReadFromFile(StrCat("/sys/devices/system/cpu/cpu", cpu,
+                            "/cpufreq/scaling_governor"),
+                     &governor) &&
+        std::find(host.governors.begin(), host.governors.end(), governor) ==
+            host.governors.end())
+      host.governors.push_back(governor);
+  }
+
+  // intel_pstate has its own switch, other drivers the generic one.
+  host.turbo =
+      ReadSwitch("/sys/devices/system/cpu/intel_pstate/no_turbo", 0);
+  if (host.turbo.empty())
+    host.turbo = ReadSwitch("/sys/devices/system/cpu/cpufreq/boost", 1);
+  host.smt = ReadSwitch("/sys/devices/system/cpu/smt/active", 1);
+
+  if (!ReadFromFile("/proc/sys/kernel/randomize_va_space", &host.aslr))
+    host.aslr = -1;
+  host.thp = ReadSelectedMode("/sys/kernel/mm/transparent_hugepage/enabled");
+
+  if (!ReadFromFile("/proc/loadavg", &host.load_average))
+    host.load_average = -1;
+
+  host.cpu_quota = ReadCpuQuota();
+
+  double kb;
+  if (ReadKeyFromFile("/proc/meminfo", "MemAvailable", &kb))
+    host.mem_available = kb * 1024;
+  if (ReadKeyFromFile("/proc/meminfo", "MemTotal", &kb))
+    host.mem_total = kb * 1024;
+
+  const double swapped_before = ReadSwappedPages();
+  if (swapped_before >= 0) {
+    SleepForMilliseconds(kSwapSampleMillis);
+    const double swapped_after = ReadSwappedPages();
+    if (swapped_after >= 0) {
+      host.swap_pages_per_second = (swapped_after - swapped_before) *
+                                   kNumMillisPerSecond / kSwapSampleMillis;
+    }
+  }
+  return host;
+}
+
+std::vector<PreflightCheck> CheckHostState(const HostState& host) {
+  std::vector<PreflightCheck> checks;
+
+  std::string governors;
+  for (const std::string& governor : host.governors)
+    governors += (governors.empty() ? "" : ",") + governor;
+  checks.push_back(MakeCheck(
+      "governor", !host.governors.empty(), governors,
+      host.governors.size() == 1 && host.governors[0] == "performance",
+      "performance"));
+
+  checks.push_back(MakeCheck("turbo", !host.turbo.empty(), host.turbo,
+                             host.turbo == "off", "off"));
+  checks.push_back(MakeCheck("smt", !host.smt.empty(), host.smt,
+                             host.smt == "off", "off"));
+  checks.push_back(MakeCheck("aslr", host.aslr >= 0, StrCat(host.aslr),
+                             host.aslr == 0, "0"));
+  checks.push_back(MakeCheck("thp", !host.thp.empty(), host.thp,
+                             host.thp != "always", "madvise or never"));
+  checks.push_back(MakeCheck(
+      "swap", host.swap_pages_per_second >= 0,
+      StringPrintF("%.0f pages/s", host.swap_pages_per_second),
+      host.swap_pages_per_second <= 0, "0 pages/s"));
+
+  const double max_load = std::max(1.0, 0.1 * host.num_cpus);
+  checks.push_back(MakeCheck("load_average", host.load_average >= 0,
+                             StringPrintF("%.2f", host.load_average),
+                             host.load_average < max_load,
+                             StringPrintF("< %.2f", max_load)));
+
+  checks.push_back(MakeCheck(
+      "cgroup_quota", host.cpu_quota >= 0,
+      host.cpu_quota > 0 ? StringPrintF("%.2f CPUs", host.cpu_quota)
+                         : std::string("none"),
+      host.cpu_quota <= 0 || host.cpu_quota >= host.num_cpus,
+      StringPrintF("none or >= %d CPUs", host.num_cpus)));
+
+  checks.push_back(MakeCheck("clocksource", !host.clocksource.empty(),
+                             host.clocksource,
+                             !IsSlowClocksource(host.clocksource),
+                             "not hpet, acpi_pm or jiffies"));
+
+  const bool memory_known = host.mem_available >= 0 && host.mem_total > 0;
+  checks.push_back(MakeCheck(
+      "free_memory", memory_known, FormatMiB(host.mem_available),
+      host.mem_available >= 0.1 * host.mem_total,
+      ">= " + FormatMiB(0.1 * host.mem_total)));
+  return checks;
+}
+
+}  // end namespace benchmark
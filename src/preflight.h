@@ -0,0 +1,68 @@
+#ifndef BENCHMARK_PREFLIGHT_H_
+#define BENCHMARK_PREFLIGHT_H_
+
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+namespace benchmark {
+
+// The properties of the host which make benchmark results noisy or
+// unrepresentative. Strings are empty and numbers negative when unknown.
+struct HostState {
+  HostState()
+      : num_cpus(-1),
+        aslr(-1),
+        swap_pages_per_second(-1),
+        load_average(-1),
+        cpu_quota(-1),
+        mem_available(-1),
+        mem_total(-1) {}
+
+  int num_cpus;
+  // The distinct CPU frequency governors of the CPUs.
+  std::vector<std::string> governors;
+  // Whether turbo/boost frequencies and simultaneous multithreading are
+  // enabled: "on" or "off".
+  std::string turbo;
+  std::string smt;
+  // The value of kernel.randomize_va_space, 0 if ASLR is disabled.
+  int aslr;
+  // The transparent huge page mode: "always", "madvise" or "never".
+  std::string thp;
+  // The pages swapped in and out per second, sampled over a short interval.
+  double swap_pages_per_second;
+  // The load average over the last minute.
+  double load_average;
+  // The CPUs the cgroup of the process may use per period, or 0 if it has no
+  // CPU quota.
+  double cpu_quota;
+  std::string clocksource;
+  // In bytes.
+  double mem_available;
+  double mem_total;
+};
+
+// Reads the state of the host. Only supported on Linux; elsewhere all is
+// unknown but the number of CPUs and the clocksource, which are taken from
+// 'cpu_info' and 'timer_info'. Takes about 100ms to sample swap activity.
+HostState ReadHostState(const CPUInfo& cpu_info, const TimerInfo& timer_info);
+
+// Returns the result of checking each property of 'host' against the
+// preflight policy, which requires:
+//   governor      all CPUs use "performance"
+//   turbo         off
+//   smt           off
+//   aslr          0
+//   thp           madvise or never
+//   swap          no pages swapped in or out
+//   load_average  below a tenth of the CPUs, or below 1
+//   cgroup_quota  none, or at least one period per CPU
+//   clocksource   not hpet, acpi_pm or jiffies, which are slow to read
+//   free_memory   at least a tenth of the memory available
+std::vector<PreflightCheck> CheckHostState(const HostState& host);
+
+}  // end namespace benchmark
+
+#endif  // BENCHMARK_PREFLIGHT_H_
@@ -22,8 +22,15 @@
 #include <vector>
 
 #include "check.h"
+#include "colorprint.h"
 
 namespace benchmark {
+namespace {
+
+// Reading the clock more slowly than this noticeably distorts the results.
+const double kSlowTimerOverhead = 100e-9;
+
+}  // end namespace
 
 BenchmarkReporter::BenchmarkReporter()
     : output_stream_(&std::cout), error_stream_(&std::cerr) {}
@@ -51,6 +58,23 @@ void BenchmarkReporter::PrintBasicContext(std::ostream *out,
       Out << "\n";
     }
   }
+  if (!info.core_types.empty()) {
+    Out << "CPU Core Types:\n";
+    for (auto &type : info.core_types)
+      Out << "  " << type.name << " (x" << type.cpus.size() << ")\n";
+  }
+
+  const TimerInfo &timer = context.timer_info;
+  Out << "Timer: " << timer.backend << ", "
+      << FormatString("%.1f", timer.call_overhead * 1e9) << " ns per call";
+  if (!timer.clocksource.empty())
+    Out << " (clocksource " << timer.clocksource << ")";
+  Out << "\n";
+  if (timer.call_overhead > kSlowTimerOverhead) {
+    Out << "***WARNING*** Reading the clock is slow; the timings of short "
+           "benchmarks and of PauseTiming()/ResumeTiming() will be "
+           "distorted.\n";
+  }
 
   if (info.scaling_enabled) {
     Out << "***WARNING*** CPU scaling is enabled, the benchmark "
@@ -58,13 +82,24 @@ void BenchmarkReporter::PrintBasicContext(std::ostream *out,
            "overhead.\n";
   }
 
+  for (const PreflightCheck &check : context.preflight_checks) {
+    if (check.ok) continue;
+    Out << "***WARNING*** Preflight check '" << check.name << "' failed: "
+        << check.value << " (expected " << check.expected << ").\n";
+  }
+
 #ifndef NDEBUG
   Out << "***WARNING*** Library was built as DEBUG. Timings may be "
          "affected.\n";
 #endif
 }
 
-BenchmarkReporter::Context::Context() : cpu_info(CPUInfo::Get()) {}
+BenchmarkReporter::Context::Context()
+    : cpu_info(CPUInfo::Get()),
+      timer_info(TimerInfo::Get()),
+      name_field_width(0),
+      primary_metric("time"),
+      check_suspicious(false) {}
 
 double BenchmarkReporter::Run::GetAdjustedRealTime() const {
   double new_time = real_accumulated_time * GetTimeUnitMultiplier(time_unit);
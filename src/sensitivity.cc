@@ -0,0 +1,140 @@
+// Copyright 2018 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sensitivity.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <utility>
+
+#include "check.h"
+#include "statistics.h"
+
+namespace benchmark {
+
+namespace {
+
+// The sum and the number of the values of a group of observations.
+struct Group {
+  Group() : sum(0), count(0) {}
+
+  double mean() const { return sum / count; }
+
+  double sum;
+  size_t count;
+};
+
+// The sum of squares between the groups of observations, around 'mean'.
+template <class Key>
+double SumOfSquares(const std::map<Key, Group>& groups, double mean) {
+  double sum = 0;
+  for (const auto& group : groups) {
+    const double d = group.second.mean() - mean;
+    sum += group.second.count * d * d;
+  }
+  return sum;
+}
+
+}  // end namespace
+
+Sensitivity AnalyzeSensitivity(const std::vector<std::vector<int> >& configs,
+                               const std::vector<double>& times) {
+  CHECK_EQ(configs.size(), times.size());
+  Sensitivity result;
+  if (configs.empty()) return result;
+  const size_t num_params = configs[0].size();
+  result.main_effects.assign(num_params, 0);
+
+  std::vector<double> y;
+  y.reserve(times.size());
+  Group all;
+  for (double time : times) {
+    CHECK_GT(time, 0);
+    y.push_back(std::log(time));
+    all.sum += y.back();
+    ++all.count;
+  }
+  const double mean = all.mean();
+
+  std::map<std::vector<int>, Group> cells;
+  std::vector<std::map<int, Group> > levels(num_params);
+  double total = 0;
+  for (size_t i = 0; i < y.size(); ++i) {
+    CHECK_EQ(configs[i].size(), num_params);
+    Group& cell = cells[configs[i]];
+    cell.sum += y[i];
+    ++cell.count;
+    for (size_t p = 0; p < num_params; ++p) {
+      Group& level = levels[p][configs[i][p]];
+      level.sum += y[i];
+      ++level.count;
+    }
+    total += (y[i] - mean) * (y[i] - mean);
+  }
+
+  // The variance between configurations is split into the main effects and
+  // the interactions, the rest is noise.
+  const double between_cells = SumOfSquares(cells, mean);
+  double main_effects = 0;
+  std::vector<double> effects(num_params);
+  size_t main_effects_dof = 0;
+  for (size_t p = 0; p < num_params; ++p) {
+    effects[p] = SumOfSquares(levels[p], mean);
+    main_effects += effects[p];
+    main_effects_dof += levels[p].size() - 1;
+  }
+  const double interactions = std::max(between_cells - main_effects, 0.0);
+  const double noise = std::max(total - between_cells, 0.0);
+  const double explained = main_effects + interactions + noise;
+  if (explained > 0) {
+    for (size_t p = 0; p < num_params; ++p)
+      result.main_effects[p] = effects[p] / explained;
+    result.interactions = interactions / explained;
+    result.noise = noise / explained;
+  }
+
+  auto best = cells.begin();
+  for (auto it = cells.begin(); it != cells.end(); ++it)
+    if (it->second.mean() < best->second.mean()) best = it;
+  result.best = best->first;
+  result.best_time = std::exp(best->second.mean());
+
+  // The error of the best configuration is estimated from the differences
+  // between repeated runs if there are any, or else from the interactions,
+  // which the main effects model leaves unexplained.
+  const size_t noise_dof = y.size() - cells.size();
+  const size_t interactions_dof =
+      cells.size() - 1 > main_effects_dof ? cells.size() - 1 - main_effects_dof
+                                          : 0;
+  double variance = 0;
+  size_t dof = 0;
+  if (noise_dof > 0) {
+    variance = noise / noise_dof;
+    dof = noise_dof;
+  } else if (interactions_dof > 0) {
+    variance = interactions / interactions_dof;
+    dof = interactions_dof;
+  }
+  if (dof > 0) {
+    const double half_width =
+        StudentT975(dof) * std::sqrt(variance / best->second.count);
+    result.ci_low = std::exp(best->second.mean() - half_width);
+    result.ci_high = std::exp(best->second.mean() + half_width);
+    result.has_ci = true;
+  }
+  return result;
+}
+
+}  // end namespace benchmark
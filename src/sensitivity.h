@@ -0,0 +1,49 @@
+#ifndef BENCHMARK_SENSITIVITY_H_
+#define BENCHMARK_SENSITIVITY_H_
+
+#include <vector>
+
+namespace benchmark {
+
+// The result of a sensitivity analysis of the times of a benchmark family
+// over its parameters, see AnalyzeSensitivity().
+struct Sensitivity {
+  Sensitivity()
+      : interactions(0),
+        noise(0),
+        best_time(0),
+        ci_low(0),
+        ci_high(0),
+        has_ci(false) {}
+
+  // The fraction of the variance of the logarithm of the time explained by
+  // each parameter alone, by their interactions, and by the differences
+  // between repeated runs of the same configuration. They add up to 1.
+  std::vector<double> main_effects;
+  double interactions;
+  double noise;
+
+  // The configuration with the lowest mean logarithm of the time, its
+  // geometric mean time, and the 95% confidence interval of the latter if
+  // there are enough runs to estimate it.
+  std::vector<int> best;
+  double best_time;
+  double ci_low;
+  double ci_high;
+  bool has_ci;
+};
+
+// Fit a log-linear main effects model to the times 'times[i]' measured in
+// the configurations 'configs[i]', each a value of every parameter, and
+// return how much each parameter contributes to the variance of the times
+// and the best configuration. Configurations may be repeated. With
+// unbalanced designs the main effects are not orthogonal, and their
+// interactions are clamped at 0.
+// REQUIRES: all configurations have as many parameters, all times are
+// positive.
+Sensitivity AnalyzeSensitivity(const std::vector<std::vector<int> >& configs,
+                               const std::vector<double>& times);
+
+}  // end namespace benchmark
+
+#endif  // BENCHMARK_SENSITIVITY_H_
@@ -72,6 +72,42 @@ double StatisticsStdDev(const std::vector<double>& v) {
   return Sqrt(v.size() / (v.size() - 1.0) * (avg_squares - Sqr(mean)));
 }
 
+namespace {
+
+// The 97.5th percentile of Student's t distribution with 1 to 30 degrees of
+// freedom. Beyond, the normal distribution is close enough.
+const double kStudentT975[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+
+}  // end namespace
+
+double StudentT975(size_t dof) {
+  CHECK_GT(dof, 0);
+  const size_t kMaxTableDof = sizeof(kStudentT975) / sizeof(kStudentT975[0]);
+  return dof <= kMaxTableDof ? kStudentT975[dof - 1] : 1.96;
+}
+
+double RatioOfMeansCI95(const std::vector<double>& numerator,
+                        const std::vector<double>& denominator) {
+  const double num_mean = StatisticsMean(numerator);
+  const double den_mean = StatisticsMean(denominator);
+  if (num_mean <= 0 || den_mean <= 0) return 0.0;
+  // The squared relative standard error of the ratio, and the degrees of
+  // freedom of the smallest sample of more than one value.
+  double rel_var = 0;
+  size_t dof = 0;
+  for (const std::vector<double>* v : {&numerator, &denominator}) {
+    if (v->size() < 2) continue;
+    const double mean = StatisticsMean(*v);
+    rel_var += Sqr(StatisticsStdDev(*v) / mean) / v->size();
+    if (dof == 0 || v->size() - 1 < dof) dof = v->size() - 1;
+  }
+  if (dof == 0) return 0.0;
+  return StudentT975(dof) * num_mean / den_mean * Sqrt(rel_var);
+}
+
 std::vector<BenchmarkReporter::Run> ComputeStats(
     const std::vector<BenchmarkReporter::Run>& reports) {
   typedef BenchmarkReporter::Run Run;
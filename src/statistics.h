@@ -32,6 +32,18 @@ double StatisticsMean(const std::vector<double>& v);
 double StatisticsMedian(const std::vector<double>& v);
 double StatisticsStdDev(const std::vector<double>& v);
 
+// Return the 97.5th percentile of Student's t distribution with 'dof'
+// degrees of freedom, which bounds 95% confidence intervals.
+// REQUIRES: 'dof > 0'
+double StudentT975(size_t dof);
+
+// Return the half-width of the 95% confidence interval of the ratio of the
+// means of two independent samples of positive values, estimated with the
+// delta method and Student's t distribution. A sample of a single value is
+// taken to be exact, so 0 is returned if both are.
+double RatioOfMeansCI95(const std::vector<double>& numerator,
+                        const std::vector<double>& denominator);
+
 }  // end namespace benchmark
 
 #endif  // STATISTICS_H_
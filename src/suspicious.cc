@@ -0,0 +1,104 @@
+// Copyright 2018 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "suspicious.h"
+
+#include "string_util.h"
+
+namespace benchmark {
+
+const double kMinLinearityTime = 100e-6;
+
+namespace {
+
+// A run must count at least this many events for the counts to be checked
+// for linearity.
+const double kMinLinearityEvents = 1e5;
+
+// The largest acceptable ratio between two costs which should be the same.
+const double kMaxCostRatio = 2;
+
+bool CostsDiffer(double a, double b) {
+  return a > kMaxCostRatio * b || b > kMaxCostRatio * a;
+}
+
+std::string FormatTime(double seconds) {
+  return StringPrintF("%.3g ns", seconds * 1e9);
+}
+
+std::string FormatEvents(double events) {
+  return StringPrintF("%.3g events", events);
+}
+
+}  // end namespace
+
+std::string CheckLinearity(const std::vector<TrialRun>& runs) {
+  const TrialRun* prev_time = nullptr;
+  const TrialRun* prev_events = nullptr;
+  for (const TrialRun& run : runs) {
+    if (run.iterations <= 0) continue;
+    if (run.seconds >= kMinLinearityTime) {
+      if (prev_time != nullptr &&
+          CostsDiffer(run.seconds / run.iterations,
+                      prev_time->seconds / prev_time->iterations)) {
+        return StrCat("time per iteration went from ",
+                      FormatTime(prev_time->seconds / prev_time->iterations),
+                      " at ", prev_time->iterations, " iterations to ",
+                      FormatTime(run.seconds / run.iterations), " at ",
+                      run.iterations, " iterations");
+      }
+      prev_time = &run;
+    }
+    if (run.events >= kMinLinearityEvents) {
+      if (prev_events != nullptr &&
+          CostsDiffer(run.events / run.iterations,
+                      prev_events->events / prev_events->iterations)) {
+        return StrCat(
+            "perf events per iteration went from ",
+            FormatEvents(prev_events->events / prev_events->iterations),
+            " at ", prev_events->iterations, " iterations to ",
+            FormatEvents(run.events / run.iterations), " at ", run.iterations,
+            " iterations");
+      }
+      prev_events = &run;
+    }
+  }
+  return std::string();
+}
+
+std::string CheckAgainstEmptyLoop(const TrialRun& run,
+                                  const TrialRun& empty_loop,
+                                  bool compare_time, bool compare_events) {
+  if (run.iterations <= 0 || empty_loop.iterations <= 0) return std::string();
+  if (compare_time) {
+    const double time = run.seconds / run.iterations;
+    const double empty_time = empty_loop.seconds / empty_loop.iterations;
+    if (time <= kMaxCostRatio * empty_time) {
+      return StrCat(FormatTime(time), " per iteration, an empty loop takes ",
+                    FormatTime(empty_time));
+    }
+  }
+  if (compare_events && run.events >= 0 && empty_loop.events >= 0) {
+    const double events = run.events / run.iterations;
+    const double empty_events = empty_loop.events / empty_loop.iterations;
+    if (events <= kMaxCostRatio * empty_events) {
+      return StrCat(FormatEvents(events),
+                    " per iteration, an empty loop counts ",
+                    FormatEvents(empty_events));
+    }
+  }
+  return std::string();
+}
+
+}  // end namespace benchmark
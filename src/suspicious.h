@@ -0,0 +1,40 @@
+#ifndef BENCHMARK_SUSPICIOUS_H_
+#define BENCHMARK_SUSPICIOUS_H_
+
+#include <string>
+#include <vector>
+
+namespace benchmark {
+
+// One run of a benchmark, as seen by the checks for results which do not
+// measure the work the benchmark meant to do, e.g. because the optimizer
+// removed it or because it is only done by the first iteration.
+struct TrialRun {
+  TrialRun() : iterations(0), seconds(0), events(-1) {}
+
+  double iterations;  // Per thread.
+  double seconds;     // The time the run is measured by, per thread.
+  double events;      // The primary perf event count per thread, or -1.
+};
+
+// A run must take at least this long to be checked for linearity.
+extern const double kMinLinearityTime;
+
+// Returns why the cost per iteration of 'runs', in the order in which they
+// were run, is not constant, or the empty string if it is. Only runs long
+// enough to be meaningful are compared, each with the previous one; their
+// cost per iteration may differ by up to a factor of 2. The perf event counts
+// are compared as well when all runs have them.
+std::string CheckLinearity(const std::vector<TrialRun>& runs);
+
+// Returns why 'run' costs about as much per iteration as 'empty_loop', an
+// empty benchmark loop, or the empty string if it costs more than twice as
+// much. The time is only compared if 'compare_time' and the perf event
+// counts only if 'compare_events' and both runs have them.
+std::string CheckAgainstEmptyLoop(const TrialRun& run,
+                                  const TrialRun& empty_loop,
+                                  bool compare_time, bool compare_events);
+
+}  // end namespace benchmark
+
+#endif  // BENCHMARK_SUSPICIOUS_H_
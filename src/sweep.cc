@@ -0,0 +1,98 @@
+// Copyright 2018 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sweep.h"
+
+#include <istream>
+#include <sstream>
+
+#include "string_util.h"
+
+namespace benchmark {
+
+namespace {
+
+template <class T>
+bool ParseNumber(const std::string& str, T* value) {
+  std::istringstream ss(str);
+  return static_cast<bool>(ss >> *value) && ss.peek() == EOF;
+}
+
+// Parses "<lo>:<hi>" or "<value>", for which lo and hi are the value.
+bool ParseRange(const std::string& str, int min, std::pair<int, int>* range) {
+  const std::string::size_type colon = str.find(':');
+  if (colon == std::string::npos) {
+    if (!ParseNumber(str, &range->first)) return false;
+    range->second = range->first;
+  } else if (!ParseNumber(str.substr(0, colon), &range->first) ||
+             !ParseNumber(str.substr(colon + 1), &range->second)) {
+    return false;
+  }
+  return range->first >= min && range->second >= range->first;
+}
+
+// Parses a comma separated list of ranges.
+bool ParseRanges(const std::string& str, int min,
+                 std::vector<std::pair<int, int> >* ranges) {
+  std::istringstream ss(str);
+  std::string field;
+  while (std::getline(ss, field, ',')) {
+    ranges->push_back(std::pair<int, int>());
+    if (!ParseRange(field, min, &ranges->back())) return false;
+  }
+  return !ranges->empty() && str[str.size() - 1] != ',';
+}
+
+}  // end namespace
+
+bool ReadSweep(std::istream& in, Sweep* sweep, std::string* error) {
+  sweep->clear();
+  std::string line;
+  int line_num = 0;
+  while (std::getline(in, line)) {
+    ++line_num;
+    std::istringstream ss(line);
+    std::string family, setting, value, extra;
+    if (!(ss >> family) || family[0] == '#') continue;
+    bool ok = static_cast<bool>(ss >> setting >> value) && !(ss >> extra);
+    if (ok) {
+      FamilySweep& entry = (*sweep)[family];
+      if (setting == "args" || setting == "add_args") {
+        std::vector<SweepArgs>& args =
+            setting == "args" ? entry.args : entry.added_args;
+        args.push_back(SweepArgs());
+        ok = ParseRanges(value, 0, &args.back());
+        const size_t count = args.front().size();
+        for (const SweepArgs& other : entry.args) ok &= other.size() == count;
+        for (const SweepArgs& other : entry.added_args)
+          ok &= other.size() == count;
+      } else if (setting == "threads") {
+        ok = ParseRanges(value, 1, &entry.threads);
+      } else if (setting == "min_time") {
+        ok = ParseNumber(value, &entry.min_time) && entry.min_time > 0;
+      } else if (setting == "repetitions") {
+        ok = ParseNumber(value, &entry.repetitions) && entry.repetitions > 0;
+      } else {
+        ok = false;
+      }
+    }
+    if (!ok) {
+      *error = StrCat("line ", line_num, " is malformed: '", line, "'");
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // end namespace benchmark
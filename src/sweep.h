@@ -0,0 +1,48 @@
+#ifndef BENCHMARK_SWEEP_H_
+#define BENCHMARK_SWEEP_H_
+
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace benchmark {
+
+// A list of arguments, each of which is a range [first, second] expanded as
+// by Benchmark::Ranges(). A single argument is a range of one value.
+typedef std::vector<std::pair<int, int> > SweepArgs;
+
+// The settings of a benchmark family set by a sweep file.
+struct FamilySweep {
+  FamilySweep() : min_time(0), repetitions(0) {}
+
+  // Replace the arguments the family was registered with, if not empty.
+  std::vector<SweepArgs> args;
+  // Are added to the arguments of the family.
+  std::vector<SweepArgs> added_args;
+  // Replace the thread counts of the family, if not empty. Each range is
+  // expanded as by Benchmark::ThreadRange().
+  std::vector<std::pair<int, int> > threads;
+  double min_time;  // Zero if not set.
+  int repetitions;  // Zero if not set.
+};
+
+// The settings of each family, by name.
+typedef std::map<std::string, FamilySweep> Sweep;
+
+// Reads a sweep file: lines of whitespace separated fields, each of which
+// sets one setting of a family. Empty lines and those starting with '#' are
+// skipped.
+//   <family>  args         <arg>,<arg>,...
+//   <family>  add_args     <arg>,<arg>,...
+//   <family>  threads      <threads>,<threads>,...
+//   <family>  min_time     <seconds>
+//   <family>  repetitions  <count>
+// where an argument or a thread count is a number or a range '<lo>:<hi>'.
+// Returns false and sets 'error' if it is malformed.
+bool ReadSweep(std::istream& in, Sweep* sweep, std::string* error);
+
+}  // end namespace benchmark
+
+#endif  // BENCHMARK_SWEEP_H_
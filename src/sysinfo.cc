@@ -30,9 +30,13 @@
 #include <sys/sysctl.h>
 #endif
 #endif
+#if defined(BENCHMARK_OS_LINUX)
+#include <sched.h>
+#endif
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <bitset>
 #include <cerrno>
 #include <climits>
@@ -46,6 +50,8 @@
 #include <limits>
 #include <memory>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 #include "check.h"
 #include "cycleclock.h"
@@ -53,6 +59,16 @@
 #include "log.h"
 #include "sleep.h"
 #include "string_util.h"
+#include "sysinfo.h"
+#include "timers.h"
+
+#ifdef BENCHMARK_HAS_TSC
+#if defined(COMPILER_MSVC)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
 
 namespace benchmark {
 namespace {
@@ -168,15 +184,6 @@ bool GetSysctl(std::string const& Name, std::array<Tp, N>* Out) {
 }
 #endif
 
-template <class ArgT>
-bool ReadFromFile(std::string const& fname, ArgT* arg) {
-  *arg = ArgT();
-  std::ifstream f(fname.c_str());
-  if (!f.is_open()) return false;
-  f >> *arg;
-  return f.good();
-}
-
 bool CpuScalingEnabled(int num_cpus) {
   // We don't have a valid CPU count, so don't even bother.
   if (num_cpus <= 0) return false;
@@ -501,8 +508,324 @@ double GetCPUCyclesPerSecond() {
   return static_cast<double>(cycleclock::Now() - start_ticks);
 }
 
+std::string GetClocksource() {
+  std::string res;
+  ReadFromFile(
+      "/sys/devices/system/clocksource/clocksource0/current_clocksource", &res);
+  return res;
+}
+
+// Return the smallest observed cost of calling 'clock' once, in seconds.
+template <class Clock>
+double MeasureCallOverhead(Clock clock) {
+  const int kCalls = 1000;
+  const int kRounds = 10;
+  double best = std::numeric_limits<double>::max();
+  for (int round = 0; round < kRounds; ++round) {
+    const double start = ChronoClockNow();
+    for (int i = 0; i < kCalls; ++i) clock();
+    best = std::min(best, (ChronoClockNow() - start) / kCalls);
+  }
+  return best;
+}
+
+#ifdef BENCHMARK_HAS_TSC
+// Returns true if the time stamp counter ticks at a constant rate, regardless
+// of frequency scaling and sleep states, and can be compared across CPUs.
+bool HasInvariantTSC() {
+  unsigned int regs[4] = {0, 0, 0, 0};
+#if defined(COMPILER_MSVC)
+  __cpuid(reinterpret_cast<int*>(regs), 0x80000000);
+  if (regs[0] < 0x80000007) return false;
+  __cpuid(reinterpret_cast<int*>(regs), 0x80000007);
+#else
+  if (__get_cpuid_max(0x80000000, nullptr) < 0x80000007) return false;
+  __get_cpuid(0x80000007, &regs[0], &regs[1], &regs[2], &regs[3]);
+#endif
+  if (!(regs[3] & (1u << 8))) return false;
+#if defined(BENCHMARK_OS_LINUX)
+  // The kernel removes the TSC from the available clocksources when it finds
+  // it to be unsynchronized between CPUs, which happens on some VMs.
+  std::ifstream f(
+      "/sys/devices/system/clocksource/clocksource0/available_clocksource");
+  std::string source;
+  while (f >> source)
+    if (source == "tsc") return true;
+  return false;
+#else
+  return true;
+#endif
+}
+
+// Return the length of a time stamp counter tick in seconds.
+double CalibrateTSC() {
+  const double kCalibrationTime = 0.02;
+  const double start_time = ChronoClockNow();
+  const int64_t start_ticks = cycleclock::Now();
+  double now;
+  while ((now = ChronoClockNow()) - start_time < kCalibrationTime) {
+  }
+  const int64_t ticks = cycleclock::Now() - start_ticks;
+  return (now - start_time) / static_cast<double>(ticks);
+}
+
+// Returns true if the CPU supports the rdtscp instruction.
+bool HasRdtscp() {
+  unsigned int regs[4] = {0, 0, 0, 0};
+#if defined(COMPILER_MSVC)
+  __cpuid(reinterpret_cast<int*>(regs), 0x80000000);
+  if (regs[0] < 0x80000001) return false;
+  __cpuid(reinterpret_cast<int*>(regs), 0x80000001);
+#else
+  if (__get_cpuid_max(0x80000000, nullptr) < 0x80000001) return false;
+  __get_cpuid(0x80000001, &regs[0], &regs[1], &regs[2], &regs[3]);
+#endif
+  return (regs[3] & (1u << 27)) != 0;
+}
+
+#if defined(BENCHMARK_OS_LINUX)
+bool PinToCPU(int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+// The longest the measurement of the offset of a CPU may take. A thread which
+// cannot run, e.g. because the CPU is busy with another one, gives up then.
+const double kTSCOffsetTimeout = 0.1;
+
+// Spins until 'done()' is true, and returns false if 'deadline' on the chrono
+// clock passes first. The clock is only read now and then, so as not to delay
+// noticing 'done()'.
+template <class Predicate>
+bool SpinUntil(Predicate done, double deadline) {
+  for (unsigned spins = 1; !done(); ++spins) {
+    if (spins % 1024 == 0 && ChronoClockNow() > deadline) return false;
+  }
+  return true;
+}
+
+// Measure the offset of the time stamp counter of 'cpu' from that of the CPU
+// which the calling thread is pinned to, by exchanging messages with a thread
+// pinned to 'cpu' and assuming that they take as long both ways. Returns
+// false if no thread can run on 'cpu' or the exchange takes longer than
+// kTSCOffsetTimeout. Otherwise stores the offset and its error, half the
+// shortest round trip, in ticks.
+bool MeasureTSCOffset(int cpu, int64_t* offset, int64_t* error) {
+  const int kRounds = 100;
+  const double deadline = ChronoClockNow() + kTSCOffsetTimeout;
+  std::atomic<int> pinned(0);
+  std::atomic<int> request(0);
+  std::atomic<int> response(0);
+  std::atomic<int64_t> remote_ticks(0);
+  std::thread remote([&]() {
+    if (!PinToCPU(cpu)) {
+      pinned.store(-1, std::memory_order_release);
+      return;
+    }
+    pinned.store(1, std::memory_order_release);
+    for (int round = 1; round <= kRounds; ++round) {
+      if (!SpinUntil(
+              [&] { return request.load(std::memory_order_acquire) == round; },
+              deadline))
+        return;
+      uint32_t aux;
+      remote_ticks.store(cycleclock::NowAndProcessorId(&aux),
+                         std::memory_order_relaxed);
+      response.store(round, std::memory_order_release);
+    }
+  });
+  bool ok = SpinUntil(
+      [&] { return pinned.load(std::memory_order_acquire) != 0; }, deadline);
+  ok = ok && pinned.load(std::memory_order_relaxed) > 0;
+  int64_t shortest = std::numeric_limits<int64_t>::max();
+  for (int round = 1; ok && round <= kRounds; ++round) {
+    uint32_t aux;
+    const int64_t start = cycleclock::NowAndProcessorId(&aux);
+    request.store(round, std::memory_order_release);
+    ok = SpinUntil(
+        [&] { return response.load(std::memory_order_acquire) == round; },
+        deadline);
+    const int64_t end = cycleclock::NowAndProcessorId(&aux);
+    if (ok && end - start < shortest) {
+      shortest = end - start;
+      *offset = remote_ticks.load(std::memory_order_relaxed) -
+                (start + shortest / 2);
+    }
+  }
+  remote.join();
+  *error = shortest / 2;
+  return ok;
+}
+
+// Returns the CPUs which the process may run on, as found the first time,
+// i.e. before any thread pins itself.
+const std::vector<int>& StartupCPUs() {
+  // rdtscp reports the CPU number in 12 bits.
+  const int kMaxCPUs = 4096;
+  static const std::vector<int>* cpus = [] {
+    std::vector<int>* allowed_cpus = new std::vector<int>;
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+      for (int cpu = 0; cpu < CPU_SETSIZE && cpu < kMaxCPUs; ++cpu)
+        if (CPU_ISSET(cpu, &allowed)) allowed_cpus->push_back(cpu);
+    }
+    return allowed_cpus;
+  }();
+  return *cpus;
+}
+
+// Measure the offsets of the time stamp counters of the CPUs which the
+// process may run on from that of the first one. Offsets smaller than their
+// error are taken to be 0.
+std::vector<int64_t> MeasureTSCOffsets() {
+  std::vector<int64_t> offsets;
+  const std::vector<int>& cpus = StartupCPUs();
+  if (cpus.size() < 2) return offsets;
+
+  bool any_offset = false;
+  std::vector<int64_t> measured(cpus.back() + 1, 0);
+  // Pin a thread of our own rather than the caller.
+  std::thread reference([&]() {
+    if (!PinToCPU(cpus[0])) return;
+    for (std::size_t i = 1; i < cpus.size(); ++i) {
+      int64_t offset, error;
+      if (MeasureTSCOffset(cpus[i], &offset, &error) &&
+          std::abs(offset) > error) {
+        measured[cpus[i]] = offset;
+        any_offset = true;
+      }
+    }
+  });
+  reference.join();
+  if (any_offset) offsets.swap(measured);
+  return offsets;
+}
+#endif
+#endif
+
 }  // end namespace
 
+bool ParseCPUList(const std::string& list, std::vector<int>* cpus) {
+  cpus->clear();
+  std::istringstream ss(list);
+  std::string range;
+  while (std::getline(ss, range, ',')) {
+    int first, last;
+    char dash;
+    std::istringstream rs(range);
+    if (!(rs >> first) || first < 0) return false;
+    last = first;
+    if (rs >> dash && (dash != '-' || !(rs >> last) || last < first))
+      return false;
+    if (!rs.eof()) return false;
+    for (int cpu = first; cpu <= last; ++cpu) cpus->push_back(cpu);
+  }
+  return !cpus->empty();
+}
+
+namespace internal {
+
+std::vector<CPUInfo::CoreType> GetCoreTypes(const std::string& sysfs_dir,
+                                            int num_cpus) {
+  std::vector<CPUInfo::CoreType> types;
+  // Hybrid Intel CPUs have a PMU per core type, which lists its CPUs.
+  const char* const kPMUs[] = {"cpu_core", "cpu_atom", "cpu_lowpower"};
+  for (const char* pmu : kPMUs) {
+    std::string list;
+    CPUInfo::CoreType type;
+    if (!ReadFromFile(StrCat(sysfs_dir, "/bus/event_source/devices/", pmu,
+                             "/cpus"),
+                      &list) ||
+        !ParseCPUList(list, &type.cpus))
+      continue;
+    type.name = pmu + 4;  // Drop the "cpu_" prefix.
+    types.push_back(type);
+  }
+  if (types.size() > 1) return types;
+  types.clear();
+
+  // Otherwise, e.g. on ARM big.LITTLE, the cores are told apart by their
+  // relative capacity.
+  std::vector<std::pair<int, int> > capacities;  // (capacity, cpu)
+  for (int cpu = 0; cpu < num_cpus; ++cpu) {
+    int capacity;
+    if (!ReadFromFile(
+            StrCat(sysfs_dir, "/devices/system/cpu/cpu", cpu,
+                   "/cpu_capacity"),
+            &capacity))
+      return types;
+    capacities.push_back(std::make_pair(-capacity, cpu));
+  }
+  std::sort(capacities.begin(), capacities.end());
+  for (const auto& capacity : capacities) {
+    const std::string name = StrCat("capacity_", -capacity.first);
+    if (types.empty() || types.back().name != name) {
+      types.push_back(CPUInfo::CoreType());
+      types.back().name = name;
+    }
+    types.back().cpus.push_back(capacity.second);
+  }
+  if (types.size() < 2) types.clear();
+  return types;
+}
+
+std::string requested_timer = "auto";
+
+const std::vector<int64_t>& TSCCPUOffsets() {
+  static const std::vector<int64_t>* offsets = [] {
+#if defined(BENCHMARK_HAS_TSC) && defined(BENCHMARK_OS_LINUX)
+    if (tsc_has_rdtscp) return new std::vector<int64_t>(MeasureTSCOffsets());
+#endif
+    return new std::vector<int64_t>();
+  }();
+  return *offsets;
+}
+}  // end namespace internal
+
+bool IsSlowClocksource(const std::string& clocksource) {
+  return clocksource == "hpet" || clocksource == "acpi_pm" ||
+         clocksource == "jiffies";
+}
+
+std::string ChooseTimerBackend(const std::string& requested,
+                               bool invariant_tsc,
+                               const std::string& clocksource,
+                               double chrono_overhead, double tsc_overhead) {
+  if (requested == "chrono" || !invariant_tsc) return "chrono";
+  if (requested == "tsc" || IsSlowClocksource(clocksource) ||
+      tsc_overhead < chrono_overhead)
+    return "tsc";
+  return "chrono";
+}
+
+const TimerInfo& TimerInfo::Get() {
+  static const TimerInfo* info = new TimerInfo();
+  return *info;
+}
+
+TimerInfo::TimerInfo()
+    : clocksource(GetClocksource()),
+      backend("chrono"),
+      call_overhead(MeasureCallOverhead(ChronoClockNow)) {
+#ifdef BENCHMARK_HAS_TSC
+  if (internal::requested_timer != "chrono" && HasInvariantTSC()) {
+    const double tsc_overhead = MeasureCallOverhead(cycleclock::Now);
+    backend = ChooseTimerBackend(internal::requested_timer, true, clocksource,
+                                 call_overhead, tsc_overhead);
+    if (backend == "tsc") {
+      call_overhead = tsc_overhead;
+      internal::tsc_seconds_per_tick = CalibrateTSC();
+      internal::tsc_has_rdtscp = HasRdtscp();
+      // The offsets between the CPUs are measured now, before any benchmark
+      // runs, rather than by the first Stamp() in a timed loop.
+      if (internal::tsc_has_rdtscp) internal::TSCCPUOffsets();
+    }
+  }
+#endif
+}
+
 const CPUInfo& CPUInfo::Get() {
   static const CPUInfo* info = new CPUInfo();
   return *info;
@@ -512,6 +835,7 @@ CPUInfo::CPUInfo()
     : num_cpus(GetNumCPUs()),
       cycles_per_second(GetCPUCyclesPerSecond()),
       caches(GetCacheSizes()),
-      scaling_enabled(CpuScalingEnabled(num_cpus)) {}
+      scaling_enabled(CpuScalingEnabled(num_cpus)),
+      core_types(internal::GetCoreTypes("/sys", num_cpus)) {}
 
 }  // end namespace benchmark
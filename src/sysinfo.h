@@ -0,0 +1,59 @@
+#ifndef BENCHMARK_SYSINFO_H_
+#define BENCHMARK_SYSINFO_H_
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+namespace benchmark {
+
+namespace internal {
+// The clock requested with --benchmark_timer: "auto", "chrono" or "tsc". Only
+// read the first time TimerInfo::Get() is called.
+extern std::string requested_timer;
+}  // end namespace internal
+
+// Returns true if reading the kernel clocksource 'clocksource' is slow, as it
+// is for hpet, acpi_pm and jiffies, which read a device or trap to the
+// hypervisor.
+bool IsSlowClocksource(const std::string& clocksource);
+
+// Returns the backend which TimerInfo picks to measure real time for the clock
+// 'requested' with --benchmark_timer. "chrono" if it was requested or the time
+// stamp counter is not invariant, "tsc" if it was requested, and otherwise
+// "tsc" if the kernel 'clocksource' is slow or reading the counter costs less
+// than reading the chrono clock.
+std::string ChooseTimerBackend(const std::string& requested,
+                               bool invariant_tsc,
+                               const std::string& clocksource,
+                               double chrono_overhead, double tsc_overhead);
+
+// Reads the first whitespace separated value in the file 'fname', such as a
+// sysfs or procfs setting, into 'arg'. Returns false if the file cannot be
+// read or does not start with a value of type ArgT.
+template <class ArgT>
+bool ReadFromFile(std::string const& fname, ArgT* arg) {
+  *arg = ArgT();
+  std::ifstream f(fname.c_str());
+  if (!f.is_open()) return false;
+  f >> *arg;
+  return !f.fail();
+}
+
+// Parses a list of CPUs such as "0-3,8,10-11", in the format of the kernel's
+// sysfs files and of the CPU list flags. Returns false if it is malformed.
+bool ParseCPUList(const std::string& list, std::vector<int>* cpus);
+
+namespace internal {
+// Returns the core types of the first 'num_cpus' CPUs, fastest first, as
+// found in the sysfs mounted at 'sysfs_dir', or none if they are all of the
+// same type. Exposed for testing; see CPUInfo::core_types.
+std::vector<CPUInfo::CoreType> GetCoreTypes(const std::string& sysfs_dir,
+                                            int num_cpus);
+}  // end namespace internal
+
+}  // end namespace benchmark
+
+#endif  // BENCHMARK_SYSINFO_H_
@@ -31,7 +31,12 @@
 #if defined(BENCHMARK_OS_MACOSX)
 #include <mach/mach_init.h>
 #include <mach/mach_port.h>
+#include <mach/task.h>
 #include <mach/thread_act.h>
+#include <mach/vm_map.h>
+#endif
+#if defined(BENCHMARK_OS_LINUX)
+#include <sys/syscall.h>
 #endif
 #endif
 
@@ -39,6 +44,7 @@
 #include <emscripten.h>
 #endif
 
+#include <algorithm>
 #include <cerrno>
 #include <cstdint>
 #include <cstdio>
@@ -171,6 +177,122 @@ double ThreadCPUUsage() {
 #endif
 }
 
+int ProcessThreadCount() {
+#if defined(BENCHMARK_OS_LINUX)
+  // The number of threads is the 20th field of /proc/self/stat. The second
+  // one, the command name in parentheses, may contain spaces.
+  char buf[1024];
+  int fd = open("/proc/self/stat", O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return -1;
+  const ssize_t len = read(fd, buf, sizeof(buf) - 1);
+  close(fd);
+  if (len <= 0) return -1;
+  buf[len] = '\0';
+  const char* p = std::strrchr(buf, ')');
+  int field = 2;
+  while (p != nullptr && field < 20) {
+    p = std::strchr(p + 1, ' ');
+    ++field;
+  }
+  return p ? std::atoi(p + 1) : -1;
+#elif defined(BENCHMARK_OS_MACOSX)
+  thread_act_array_t threads;
+  mach_msg_type_number_t count = 0;
+  if (task_threads(mach_task_self(), &threads, &count) != KERN_SUCCESS)
+    return -1;
+  for (mach_msg_type_number_t i = 0; i < count; ++i)
+    mach_port_deallocate(mach_task_self(), threads[i]);
+  vm_deallocate(mach_task_self(), reinterpret_cast<vm_address_t>(threads),
+                count * sizeof(thread_act_t));
+  return static_cast<int>(count);
+#else
+  return -1;
+#endif
+}
+
+bool ParseSchedStat(const char* line, SchedStat* stat) {
+  unsigned long long run_ns, wait_ns, timeslices;
+  if (std::sscanf(line, "%llu %llu %llu", &run_ns, &wait_ns, &timeslices) != 3)
+    return false;
+  stat->run_time = static_cast<double>(run_ns) * 1e-9;
+  stat->wait_time = static_cast<double>(wait_ns) * 1e-9;
+  stat->timeslices = static_cast<int64_t>(timeslices);
+  return true;
+}
+
+#if defined(BENCHMARK_OS_LINUX)
+SchedStatReader::SchedStatReader() : fd_(-1) {
+  std::string fname =
+      StrCat("/proc/self/task/", syscall(SYS_gettid), "/schedstat");
+  fd_ = open(fname.c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+SchedStatReader::~SchedStatReader() {
+  if (fd_ >= 0) close(fd_);
+}
+
+bool SchedStatReader::Read(SchedStat* stat) const {
+  CHECK(ok());
+  // The file consists of a single line.
+  char buff[128];
+  ssize_t len = pread(fd_, buff, sizeof(buff) - 1, 0);
+  if (len <= 0) return false;
+  buff[len] = '\0';
+  return ParseSchedStat(buff, stat);
+}
+#else
+SchedStatReader::SchedStatReader() : fd_(-1) {}
+
+SchedStatReader::~SchedStatReader() {}
+
+bool SchedStatReader::Read(SchedStat*) const {
+  CHECK(ok());
+  return false;
+}
+#endif
+
+namespace internal {
+double tsc_seconds_per_tick = 0;
+bool tsc_has_rdtscp = false;
+}  // end namespace internal
+
+int64_t Stamp() {
+#ifdef BENCHMARK_HAS_TSC
+  if (internal::tsc_seconds_per_tick > 0) {
+    if (!internal::tsc_has_rdtscp) return cycleclock::Now();
+    uint32_t aux;
+    const int64_t ticks = cycleclock::NowAndProcessorId(&aux);
+    const uint32_t cpu = aux & 0xfff;
+    const std::vector<int64_t>& offsets = internal::TSCCPUOffsets();
+    return cpu < offsets.size() ? ticks - offsets[cpu] : ticks;
+  }
+#endif
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             ChooseClockType::type::now().time_since_epoch())
+      .count();
+}
+
+namespace {
+
+double SecondsPerStampTick() {
+  return internal::tsc_seconds_per_tick > 0 ? internal::tsc_seconds_per_tick
+                                            : 1e-9;
+}
+
+}  // end namespace
+
+double SecondsSinceStamp(int64_t stamp) {
+  return StampTicksToSeconds(std::max<int64_t>(Stamp() - stamp, 0));
+}
+
+double StampTicksToSeconds(int64_t ticks) {
+  return static_cast<double>(ticks) * SecondsPerStampTick();
+}
+
+int64_t SecondsToStampTicks(double seconds) {
+  return static_cast<int64_t>(seconds / SecondsPerStampTick() + 0.5);
+}
+
 namespace {
 
 std::string DateTimeString(bool local) {
@@ -2,7 +2,11 @@
 #define BENCHMARK_TIMERS_H
 
 #include <chrono>
+#include <cstdint>
 #include <string>
+#include <vector>
+
+#include "cycleclock.h"
 
 namespace benchmark {
 
@@ -15,6 +19,44 @@ double ChildrenCPUUsage();
 // Return the CPU usage of the current thread
 double ThreadCPUUsage();
 
+// Return the number of threads of the current process, or -1 if it cannot be
+// determined on this system.
+int ProcessThreadCount();
+
+// Scheduler statistics of a single thread as exported by the kernel in
+// /proc/<pid>/task/<tid>/schedstat. Times are in seconds.
+struct SchedStat {
+  SchedStat() : run_time(0), wait_time(0), timeslices(0) {}
+
+  double run_time;      // Time spent on the CPU.
+  double wait_time;     // Time spent runnable, waiting on a run-queue.
+  int64_t timeslices;   // Number of timeslices run on the CPU.
+};
+
+// Parses a line of a schedstat file, "<run ns> <wait ns> <timeslices>", into
+// 'stat'. Returns false if it is malformed.
+bool ParseSchedStat(const char* line, SchedStat* stat);
+
+// Reads the scheduler statistics of the thread which constructed it. The
+// underlying file is kept open so that each read costs a single syscall.
+class SchedStatReader {
+ public:
+  SchedStatReader();
+  ~SchedStatReader();
+
+  // Returns false if scheduler statistics are not available on this system.
+  bool ok() const { return fd_ >= 0; }
+
+  // REQUIRES: ok()
+  bool Read(SchedStat* stat) const;
+
+ private:
+  int fd_;
+
+  SchedStatReader(const SchedStatReader&);
+  SchedStatReader& operator=(const SchedStatReader&);
+};
+
 #if defined(HAVE_STEADY_CLOCK)
 template <bool HighResIsSteady = std::chrono::high_resolution_clock::is_steady>
 struct ChooseSteadyClock {
@@ -41,6 +83,42 @@ inline double ChronoClockNow() {
   return FpSeconds(ClockType::now().time_since_epoch()).count();
 }
 
+namespace internal {
+// The length of a cycleclock::Now() tick in seconds if TimerInfo selected the
+// time stamp counter to measure real time, or 0 if it selected the chrono
+// clock. Only written before any benchmark thread is started.
+extern double tsc_seconds_per_tick;
+
+// Whether the CPU supports rdtscp. Only written before any benchmark thread is
+// started.
+extern bool tsc_has_rdtscp;
+
+// Returns the offsets of the time stamp counters of the CPUs from that of the
+// first one the process may run on, indexed by CPU number, which Stamp()
+// subtracts. Empty if they could not be measured or are all smaller than the
+// error of the measurement. They are measured by the first call, which
+// takes a few milliseconds per CPU, and which TimerInfo::Get() makes when it
+// picks the time stamp counter, before any benchmark runs.
+const std::vector<int64_t>& TSCCPUOffsets();
+}  // end namespace internal
+
+// Return the time elapsed since 'stamp' was returned by Stamp(), in seconds.
+// Never negative.
+double SecondsSinceStamp(int64_t stamp);
+
+// Convert between a difference of two stamps returned by Stamp() and seconds.
+double StampTicksToSeconds(int64_t ticks);
+int64_t SecondsToStampTicks(double seconds);
+
+// Return the current real time in seconds, as measured by the backend chosen
+// by TimerInfo::Get().
+inline double RealClockNow() {
+  if (internal::tsc_seconds_per_tick > 0)
+    return static_cast<double>(cycleclock::Now()) *
+           internal::tsc_seconds_per_tick;
+  return ChronoClockNow();
+}
+
 std::string LocalDateTimeString();
 
 }  // end namespace benchmark
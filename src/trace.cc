@@ -0,0 +1,392 @@
+// Copyright 2018 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "benchmark/trace.h"
+#include "internal_macros.h"
+
+#ifndef BENCHMARK_OS_WINDOWS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <thread>
+
+#include "check.h"
+#include "string_util.h"
+#include "timers.h"
+
+namespace benchmark {
+namespace {
+
+const char kBinaryMagic[8] = {'B', 'M', 'T', 'R', 'A', 'C', 'E', '1'};
+
+// Size of the fixed part of the header of a binary trace.
+const size_t kBinaryHeaderSize = 24;
+
+// Returns the unsigned integer stored in little-endian byte order in the
+// 'bytes' bytes at 'p'.
+uint64_t LoadLittleEndian(const char* p, size_t bytes) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < bytes; ++i)
+    value |= static_cast<uint64_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+  return value;
+}
+
+bool IsLittleEndianHost() {
+  const uint32_t one = 1;
+  char first;
+  std::memcpy(&first, &one, 1);
+  return first == 1;
+}
+
+uint64_t HashString(const char* begin, const char* end) {
+  // FNV-1a
+  uint64_t hash = 14695981039346656037ull;
+  for (const char* p = begin; p != end; ++p) {
+    hash ^= static_cast<unsigned char>(*p);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+// Mix the bits of a key so that consecutive keys are spread over the
+// partitions (the finalizer of SplitMix64).
+uint64_t MixKey(uint64_t key) {
+  key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ull;
+  key = (key ^ (key >> 27)) * 0x94d049bb133111ebull;
+  return key ^ (key >> 31);
+}
+
+// Split [begin, end) at commas into at most 'max_fields' fields, with
+// surrounding blanks removed.
+size_t SplitFields(const char* begin, const char* end, size_t max_fields,
+                   std::pair<const char*, const char*>* fields) {
+  size_t n = 0;
+  while (n < max_fields) {
+    const char* comma = static_cast<const char*>(
+        std::memchr(begin, ',', static_cast<size_t>(end - begin)));
+    const char* field_end = comma ? comma : end;
+    const char* b = begin;
+    const char* e = field_end;
+    while (b != e && (*b == ' ' || *b == '\t')) ++b;
+    while (e != b && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\r')) --e;
+    fields[n++] = std::make_pair(b, e);
+    if (!comma) break;
+    begin = comma + 1;
+  }
+  return n;
+}
+
+bool ParseUnsigned(const std::pair<const char*, const char*>& field,
+                   uint64_t* value) {
+  if (field.first == field.second) return false;
+  uint64_t v = 0;
+  for (const char* p = field.first; p != field.second; ++p) {
+    if (*p < '0' || *p > '9') return false;
+    v = v * 10 + static_cast<uint64_t>(*p - '0');
+  }
+  *value = v;
+  return true;
+}
+
+}  // end namespace
+
+Trace::Trace()
+    : data_(nullptr),
+      data_size_(0),
+      mapped_(false),
+      records_(nullptr),
+      size_(0) {}
+
+Trace::~Trace() {
+#ifndef BENCHMARK_OS_WINDOWS
+  if (mapped_) {
+    munmap(const_cast<char*>(data_), data_size_);
+    return;
+  }
+#endif
+  delete[] reinterpret_cast<const uint64_t*>(data_);
+}
+
+Trace* Trace::Load(const std::string& path, std::string* error) {
+  std::unique_ptr<Trace> trace(new Trace);
+  if (!trace->Map(path, error)) return nullptr;
+  const bool binary = trace->data_size_ >= sizeof(kBinaryMagic) &&
+                      std::memcmp(trace->data_, kBinaryMagic,
+                                  sizeof(kBinaryMagic)) == 0;
+  if (!(binary ? trace->ParseBinary(error) : trace->ParseCSV(error))) {
+    *error = StrCat(path, ": ", *error);
+    return nullptr;
+  }
+  for (size_t i = 0; i < trace->size_; ++i) {
+    if (trace->records_[i].op >= trace->op_names_.size()) {
+      *error = StrCat(path, ": record ", i, " has an invalid op");
+      return nullptr;
+    }
+    if (i > 0 &&
+        trace->records_[i].timestamp_ns < trace->records_[i - 1].timestamp_ns) {
+      *error = StrCat(path, ": the records are not sorted by timestamp");
+      return nullptr;
+    }
+  }
+  return trace.release();
+}
+
+bool Trace::Map(const std::string& path, std::string* error) {
+#ifndef BENCHMARK_OS_WINDOWS
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    if (fd >= 0) close(fd);
+    *error = StrCat("cannot open ", path);
+    return false;
+  }
+  data_size_ = static_cast<size_t>(st.st_size);
+  if (data_size_ > 0) {
+    void* addr = mmap(nullptr, data_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr != MAP_FAILED) {
+      data_ = static_cast<const char*>(addr);
+      mapped_ = true;
+    }
+  }
+  close(fd);
+  if (mapped_ || data_size_ == 0) return true;
+#endif
+  // Read the whole file instead.
+  std::ifstream f(path.c_str(), std::ios::binary);
+  if (!f.is_open()) {
+    *error = StrCat("cannot open ", path);
+    return false;
+  }
+  f.seekg(0, std::ios::end);
+  data_size_ = static_cast<size_t>(f.tellg());
+  f.seekg(0, std::ios::beg);
+  // Allocated as uint64_t so that the records of binary traces are aligned.
+  char* data = reinterpret_cast<char*>(new uint64_t[data_size_ / 8 + 1]);
+  data_ = data;
+  if (!f.read(data, static_cast<std::streamsize>(data_size_))) {
+    *error = StrCat("cannot read ", path);
+    return false;
+  }
+  return true;
+}
+
+bool Trace::ParseBinary(std::string* error) {
+  uint32_t num_ops = 0;
+  uint64_t num_records = 0;
+  if (data_size_ >= kBinaryHeaderSize) {
+    num_ops = static_cast<uint32_t>(LoadLittleEndian(data_ + 8, 4));
+    num_records = LoadLittleEndian(data_ + 16, 8);
+  }
+  const char* p = data_ + kBinaryHeaderSize;
+  const char* const end = data_ + data_size_;
+  for (uint32_t i = 0; i < num_ops && p < end; ++i) {
+    const char* name_end = static_cast<const char*>(
+        std::memchr(p, '\0', static_cast<size_t>(end - p)));
+    if (name_end == nullptr) break;
+    op_names_.push_back(std::string(p, name_end));
+    p = name_end + 1;
+  }
+  const size_t names_size =
+      (static_cast<size_t>(p - data_) - kBinaryHeaderSize + 7) / 8 * 8;
+  const size_t records_offset = kBinaryHeaderSize + names_size;
+  if (data_size_ < kBinaryHeaderSize || op_names_.size() != num_ops ||
+      records_offset > data_size_ ||
+      (data_size_ - records_offset) / sizeof(TraceRecord) < num_records) {
+    *error = "the binary trace is truncated";
+    return false;
+  }
+  size_ = static_cast<size_t>(num_records);
+  if (IsLittleEndianHost()) {
+    records_ = reinterpret_cast<const TraceRecord*>(data_ + records_offset);
+    return true;
+  }
+  // The records cannot be used in place; decode a copy of them.
+  parsed_.resize(size_);
+  for (size_t i = 0; i < size_; ++i) {
+    const char* record = data_ + records_offset + i * sizeof(TraceRecord);
+    parsed_[i].timestamp_ns = LoadLittleEndian(record, 8);
+    parsed_[i].key = LoadLittleEndian(record + 8, 8);
+    parsed_[i].size = LoadLittleEndian(record + 16, 8);
+    parsed_[i].op = static_cast<uint32_t>(LoadLittleEndian(record + 24, 4));
+    parsed_[i].reserved = 0;
+  }
+  records_ = parsed_.data();
+  return true;
+}
+
+bool Trace::ParseCSV(std::string* error) {
+  std::map<std::string, uint32_t> ops;
+  const char* p = data_;
+  const char* const end = data_ + data_size_;
+  for (size_t line = 1; p < end; ++line) {
+    const char* eol = static_cast<const char*>(
+        std::memchr(p, '\n', static_cast<size_t>(end - p)));
+    if (eol == nullptr) eol = end;
+    std::pair<const char*, const char*> fields[4];
+    const size_t n = SplitFields(p, eol, 4, fields);
+    const char* const begin = p;
+    p = eol + 1;
+    // Skip blank lines and the header.
+    if (n == 1 && fields[0].first == fields[0].second) continue;
+    const std::string ts_field(fields[0].first, fields[0].second);
+    char* ts_end = nullptr;
+    const double ts = std::strtod(ts_field.c_str(), &ts_end);
+    const bool ts_ok = !ts_field.empty() && *ts_end == '\0' && ts >= 0;
+    if (line == 1 && !ts_ok) continue;
+    TraceRecord record;
+    std::memset(&record, 0, sizeof(record));
+    if (n != 4 || !ts_ok || fields[1].first == fields[1].second ||
+        !ParseUnsigned(fields[3], &record.size)) {
+      *error = StrCat("line ", line, " of the trace is not a valid "
+                      "\"timestamp,op,key,size\" record: ",
+                      std::string(begin, eol));
+      return false;
+    }
+    record.timestamp_ns = static_cast<uint64_t>(std::llround(ts * 1e9));
+    if (!ParseUnsigned(fields[2], &record.key))
+      record.key = HashString(fields[2].first, fields[2].second);
+    const std::string op(fields[1].first, fields[1].second);
+    auto it = ops.find(op);
+    if (it == ops.end()) {
+      it = ops.insert(std::make_pair(
+                          op, static_cast<uint32_t>(op_names_.size())))
+               .first;
+      op_names_.push_back(op);
+    }
+    record.op = it->second;
+    parsed_.push_back(record);
+  }
+  records_ = parsed_.data();
+  size_ = parsed_.size();
+  return true;
+}
+
+TraceReplayFixture::TraceReplayFixture(const std::string& path,
+                                       ReplayMode mode)
+    : path_(path), mode_(mode), trace_(nullptr) {}
+
+TraceReplayFixture::~TraceReplayFixture() { delete trace_; }
+
+void TraceReplayFixture::Handle(const std::string& op, Handler handler) {
+  handlers_.push_back(std::make_pair(op, handler));
+}
+
+void TraceReplayFixture::SetUpOnce(State& st) {
+  // The trace is kept for all the runs of the benchmark.
+  if (trace_ == nullptr) {
+    std::string error;
+    trace_ = Trace::Load(path_, &error);
+    if (trace_ == nullptr) {
+      st.SkipWithError(error.c_str());
+      return;
+    }
+  }
+  op_handlers_.assign(trace_->op_names().size(), nullptr);
+  for (size_t op = 0; op < op_handlers_.size(); ++op) {
+    for (const auto& handler : handlers_) {
+      if (handler.first == trace_->op_names()[op])
+        op_handlers_[op] = &handler.second;
+    }
+    if (op_handlers_[op] == nullptr) {
+      const std::string error = StrCat("no handler for the operation '",
+                                       trace_->op_names()[op], "'");
+      st.SkipWithError(error.c_str());
+      return;
+    }
+  }
+  partitions_.assign(st.threads, std::vector<size_t>());
+}
+
+void TraceReplayFixture::SetUpThread(State& st) {
+  // Each thread builds its own partition, in its own memory, again in each
+  // run.
+  std::vector<size_t>& partition = partitions_[st.thread_index];
+  partition.clear();
+  const uint64_t threads = static_cast<uint64_t>(st.threads);
+  for (size_t i = 0; i < trace_->size(); ++i) {
+    if (MixKey((*trace_)[i].key) % threads ==
+        static_cast<uint64_t>(st.thread_index))
+      partition.push_back(i);
+  }
+}
+
+void TraceReplayFixture::TearDownOnce(State&) { partitions_.clear(); }
+
+void TraceReplayFixture::Replay(State& st) {
+  const std::vector<size_t>& partition = partitions_[st.thread_index];
+  const Trace& trace = *trace_;
+  const std::vector<std::string>& op_names = trace.op_names();
+  // Each restart of the trace is delayed by one average inter-arrival time
+  // past its last record.
+  double first = 0, period = 0;
+  if (trace.size() > 0) {
+    first = static_cast<double>(trace[0].timestamp_ns) * 1e-9;
+    const double duration =
+        static_cast<double>(trace[trace.size() - 1].timestamp_ns) * 1e-9 -
+        first;
+    period = trace.size() > 1 ? duration * static_cast<double>(trace.size()) /
+                                    static_cast<double>(trace.size() - 1)
+                              : 0;
+  }
+  // The latencies of each operation, looked up once.
+  std::vector<int> op_latencies(op_names.size());
+  for (size_t op = 0; op < op_names.size(); ++op)
+    op_latencies[op] = st.LatencyIndex(op_names[op]);
+  size_t next = 0;
+  double lap_start = RealClockNow();
+  int64_t ops = 0;
+  for (auto _ : st) {
+    if (partition.empty()) continue;
+    const TraceRecord& record = trace[partition[next]];
+    double issued;
+    if (mode_ == kReplayOpenLoop) {
+      issued =
+          lap_start + static_cast<double>(record.timestamp_ns) * 1e-9 - first;
+      // Sleep through long waits and spin through the end of them.
+      double now = RealClockNow();
+      if (issued - now > 200e-6) {
+        std::this_thread::sleep_for(
+            std::chrono::duration<double>(issued - now - 100e-6));
+      }
+      while (now < issued) {
+        std::this_thread::yield();
+        now = RealClockNow();
+      }
+    } else {
+      issued = RealClockNow();
+    }
+    (*op_handlers_[record.op])(record);
+    const double latency = RealClockNow() - issued;
+    st.RecordLatency(latency);
+    st.RecordLatency(op_latencies[record.op], latency);
+    ++ops;
+    if (++next == partition.size()) {
+      next = 0;
+      lap_start += period;
+    }
+  }
+  st.SetItemsProcessed(ops);
+}
+
+}  // end namespace benchmark
@@ -0,0 +1,245 @@
+// Copyright 2018 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "working_set.h"
+#include "internal_macros.h"
+
+#if defined(BENCHMARK_OS_LINUX)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <bitset>
+#include <cstdio>
+#include <fstream>
+#include <map>
+
+#include "check.h"
+
+namespace benchmark {
+
+namespace {
+
+// Layout of the 64-bit entries of /proc/<pid>/pagemap.
+const uint64_t kPagePresent = 1ull << 63;
+const uint64_t kPageSoftDirty = 1ull << 55;
+const uint64_t kPageFrameMask = (1ull << 55) - 1;
+
+}  // end namespace
+
+PagemapEntry DecodePagemapEntry(uint64_t entry) {
+  PagemapEntry decoded;
+  decoded.present = (entry & kPagePresent) != 0;
+  decoded.soft_dirty = (entry & kPageSoftDirty) != 0;
+  decoded.frame = entry & kPageFrameMask;
+  return decoded;
+}
+
+bool ParseMapsLine(const std::string& line, MemoryMapping* mapping) {
+  unsigned long long start, end;
+  char perms[5];
+  if (std::sscanf(line.c_str(), "%llx-%llx %4s", &start, &end, perms) != 3)
+    return false;
+  // The vsyscall page lives outside of the process' address space and
+  // cannot be looked up in the pagemap.
+  if (line.find("[vsyscall]") != std::string::npos) return false;
+  mapping->start = static_cast<uintptr_t>(start);
+  mapping->end = static_cast<uintptr_t>(end);
+  mapping->writable = perms[1] == 'w';
+  return true;
+}
+
+#if defined(BENCHMARK_OS_LINUX)
+namespace {
+
+const size_t kBufferEntries = 4096;
+
+bool ReadMappings(std::vector<MemoryMapping>* mappings) {
+  std::ifstream f("/proc/self/maps");
+  if (!f.is_open()) return false;
+  std::string ln;
+  while (std::getline(f, ln)) {
+    MemoryMapping m;
+    if (ParseMapsLine(ln, &m)) mappings->push_back(m);
+  }
+  return !f.bad();
+}
+
+// Invoke 'fn' with the pagemap entry of every page in 'mappings'. Only the
+// writable mappings are visited if 'writable_only' is true.
+template <class Fn>
+void ForEachPage(int pagemap_fd, size_t page_size,
+                 const std::vector<MemoryMapping>& mappings, bool writable_only,
+                 std::vector<uint64_t>* buffer, Fn fn) {
+  for (const MemoryMapping& m : mappings) {
+    if (writable_only && !m.writable) continue;
+    uintptr_t page = m.start / page_size;
+    const uintptr_t end_page = m.end / page_size;
+    while (page < end_page) {
+      const size_t count = std::min<size_t>(
+          buffer->size(), static_cast<size_t>(end_page - page));
+      ssize_t len = pread(pagemap_fd, buffer->data(), count * sizeof(uint64_t),
+                          static_cast<off_t>(page * sizeof(uint64_t)));
+      // Some special mappings cannot be read; skip the rest of them.
+      if (len <= 0) break;
+      const size_t got = static_cast<size_t>(len) / sizeof(uint64_t);
+      for (size_t i = 0; i < got; ++i) fn((*buffer)[i]);
+      page += got;
+    }
+  }
+}
+
+// Collect the page frame numbers of all the pages currently mapped by the
+// process, grouped by their 64-bit word in the idle page bitmap.
+std::map<uint64_t, uint64_t> CollectFrameBits(int pagemap_fd,
+                                              size_t page_size,
+                                              std::vector<uint64_t>* buffer) {
+  std::map<uint64_t, uint64_t> frames;
+  std::vector<MemoryMapping> mappings;
+  if (!ReadMappings(&mappings)) return frames;
+  ForEachPage(pagemap_fd, page_size, mappings, false, buffer,
+              [&](uint64_t entry) {
+                const PagemapEntry page = DecodePagemapEntry(entry);
+                if (!page.present || page.frame == 0) return;
+                frames[page.frame / 64] |= 1ull << (page.frame % 64);
+              });
+  return frames;
+}
+
+}  // end namespace
+
+WorkingSetTracker::WorkingSetTracker()
+    : page_size_(0), pagemap_fd_(-1), idle_fd_(-1) {}
+
+WorkingSetTracker::~WorkingSetTracker() {
+  if (pagemap_fd_ >= 0) close(pagemap_fd_);
+  if (idle_fd_ >= 0) close(idle_fd_);
+}
+
+bool WorkingSetTracker::MarkPagesIdle() {
+  // The page frame numbers are only exposed to privileged processes. Without
+  // them idle page tracking cannot be used.
+  std::map<uint64_t, uint64_t> frames =
+      CollectFrameBits(pagemap_fd_, page_size_, &buffer_);
+  if (frames.empty()) return false;
+  for (const auto& word : frames) {
+    if (pwrite(idle_fd_, &word.second, sizeof(word.second),
+               static_cast<off_t>(word.first * sizeof(uint64_t))) !=
+        static_cast<ssize_t>(sizeof(word.second)))
+      return false;
+  }
+  return true;
+}
+
+bool WorkingSetTracker::Start(std::string* error) {
+  CHECK(pagemap_fd_ < 0) << "Start() called twice";
+  page_size_ = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  buffer_.assign(kBufferEntries, 0);
+  pagemap_fd_ = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+  if (pagemap_fd_ < 0) {
+    *error = "cannot open /proc/self/pagemap";
+    return false;
+  }
+  // 'buffer_' has just been written, so its page must be soft-dirty unless
+  // the kernel was built without CONFIG_MEM_SOFT_DIRTY.
+  uint64_t entry = 0;
+  const uintptr_t page =
+      reinterpret_cast<uintptr_t>(buffer_.data()) / page_size_;
+  if (pread(pagemap_fd_, &entry, sizeof(entry),
+            static_cast<off_t>(page * sizeof(uint64_t))) !=
+          static_cast<ssize_t>(sizeof(entry)) ||
+      !DecodePagemapEntry(entry).soft_dirty) {
+    *error = "the kernel does not track soft-dirty pages";
+    return false;
+  }
+
+  idle_fd_ = open("/sys/kernel/mm/page_idle/bitmap", O_RDWR | O_CLOEXEC);
+  if (idle_fd_ >= 0 && !MarkPagesIdle()) {
+    close(idle_fd_);
+    idle_fd_ = -1;
+  }
+
+  // Writing "4" clears the soft-dirty bits of all the pages of the process.
+  // Do this last so the setup above is not counted.
+  int fd = open("/proc/self/clear_refs", O_WRONLY | O_CLOEXEC);
+  const bool cleared = fd >= 0 && write(fd, "4", 1) == 1;
+  if (fd >= 0) close(fd);
+  if (!cleared) {
+    *error = "cannot reset the soft-dirty bits through /proc/self/clear_refs";
+    return false;
+  }
+  return true;
+}
+
+bool WorkingSetTracker::Stop(WorkingSet* ws, std::string* error) {
+  CHECK(pagemap_fd_ >= 0) << "Start() must be called first";
+  std::vector<MemoryMapping> mappings;
+  if (!ReadMappings(&mappings)) {
+    *error = "cannot read /proc/self/maps";
+    return false;
+  }
+  ws->page_size = page_size_;
+  ws->written_pages = 0;
+  ForEachPage(pagemap_fd_, page_size_, mappings, true, &buffer_,
+              [&](uint64_t entry) {
+                if (DecodePagemapEntry(entry).soft_dirty) ++ws->written_pages;
+              });
+
+  ws->accessed_pages = -1;
+  if (idle_fd_ >= 0) {
+    // A page is accessed if its idle bit was cleared since Start(). Pages
+    // which were not mapped at the time are never marked idle, and so are
+    // counted as well.
+    int64_t accessed = 0;
+    bool ok = true;
+    for (const auto& word :
+         CollectFrameBits(pagemap_fd_, page_size_, &buffer_)) {
+      uint64_t idle = 0;
+      if (pread(idle_fd_, &idle, sizeof(idle),
+                static_cast<off_t>(word.first * sizeof(uint64_t))) !=
+          static_cast<ssize_t>(sizeof(idle))) {
+        ok = false;
+        break;
+      }
+      accessed += static_cast<int64_t>(
+          std::bitset<64>(word.second & ~idle).count());
+    }
+    if (ok) ws->accessed_pages = accessed;
+  }
+  return true;
+}
+
+#else  // BENCHMARK_OS_LINUX
+
+WorkingSetTracker::WorkingSetTracker()
+    : page_size_(0), pagemap_fd_(-1), idle_fd_(-1) {}
+
+WorkingSetTracker::~WorkingSetTracker() {}
+
+bool WorkingSetTracker::MarkPagesIdle() { return false; }
+
+bool WorkingSetTracker::Start(std::string* error) {
+  *error = "working set measurement is only supported on Linux";
+  return false;
+}
+
+bool WorkingSetTracker::Stop(WorkingSet*, std::string* error) {
+  *error = "working set measurement is only supported on Linux";
+  return false;
+}
+
+#endif  // BENCHMARK_OS_LINUX
+
+}  // end namespace benchmark
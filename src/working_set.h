@@ -0,0 +1,79 @@
+#ifndef BENCHMARK_WORKING_SET_H_
+#define BENCHMARK_WORKING_SET_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace benchmark {
+
+// The pages touched by the process while a WorkingSetTracker was running.
+struct WorkingSet {
+  WorkingSet() : page_size(0), written_pages(0), accessed_pages(-1) {}
+
+  size_t page_size;
+  // Number of distinct pages written, as reported by the soft-dirty bits.
+  int64_t written_pages;
+  // Number of distinct pages read or written, as reported by idle page
+  // tracking. This is -1 if idle page tracking is not available, which is
+  // usually the case unless the process runs with CAP_SYS_ADMIN.
+  int64_t accessed_pages;
+};
+
+// The fields of a 64-bit entry of /proc/<pid>/pagemap used by the tracker
+// (see the kernel's Documentation/admin-guide/mm/pagemap.rst).
+struct PagemapEntry {
+  bool present;
+  bool soft_dirty;
+  // The page frame number, which reads as zero without CAP_SYS_ADMIN.
+  uint64_t frame;
+};
+
+PagemapEntry DecodePagemapEntry(uint64_t entry);
+
+// A mapping listed in /proc/<pid>/maps.
+struct MemoryMapping {
+  uintptr_t start;
+  uintptr_t end;
+  bool writable;
+};
+
+// Parses a line of /proc/<pid>/maps into 'mapping'. Returns false if the line
+// is malformed or describes a mapping which has no pagemap entries.
+bool ParseMapsLine(const std::string& line, MemoryMapping* mapping);
+
+// Counts the pages touched by the whole process between Start() and Stop()
+// using the soft-dirty bits in /proc/self/pagemap (see the kernel's
+// Documentation/admin-guide/mm/soft-dirty.rst) and, when permitted, idle page
+// tracking. Pages touched by the tracker itself and by other threads of the
+// process are included, so the result is accurate to a few pages.
+class WorkingSetTracker {
+ public:
+  WorkingSetTracker();
+  ~WorkingSetTracker();
+
+  // Reset the tracking state. Returns false and sets 'error' if the working
+  // set cannot be measured on this system.
+  bool Start(std::string* error);
+
+  // REQUIRES: Start() returned true.
+  bool Stop(WorkingSet* ws, std::string* error);
+
+ private:
+  bool MarkPagesIdle();
+
+  size_t page_size_;
+  int pagemap_fd_;
+  int idle_fd_;
+  // Scratch space reserved by Start() so that Stop() does not have to dirty
+  // new memory while the pages are being counted.
+  std::vector<uint64_t> buffer_;
+
+  WorkingSetTracker(const WorkingSetTracker&);
+  WorkingSetTracker& operator=(const WorkingSetTracker&);
+};
+
+}  // end namespace benchmark
+
+#endif  // BENCHMARK_WORKING_SET_H_
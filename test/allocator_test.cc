@@ -0,0 +1,108 @@
+
+#undef NDEBUG
+#include <cassert>
+#include <cstring>
+#include <memory>
+
+#include "benchmark/benchmark.h"
+#include "output_test.h"
+
+// ========================================================================= //
+// ---------------------- Testing Prologue Output -------------------------- //
+// ========================================================================= //
+
+ADD_CASES(TC_ConsoleOut,
+          {{"^[-]+$", MR_Next},
+           {"^Benchmark %s Time %s CPU %s Iterations UserCounters...$", MR_Next},
+           {"^[-]+$", MR_Next}});
+ADD_CASES(TC_CSVOut, {{"%csv_header,\"alloc_bytes\",\"allocs\""}});
+
+// ========================================================================= //
+// ------------------------ Allocator Selection ---------------------------- //
+// ========================================================================= //
+
+// Allocates a small, a medium and a large block per iteration, the last one
+// too large for any allocator but the system one, and checks that they do
+// not overlap.
+void BM_Allocate(benchmark::State& state) {
+  for (auto _ : state) {
+    std::unique_ptr<char[]> small(new char[24]);
+    std::unique_ptr<char[]> medium(new char[1000]);
+    std::unique_ptr<char[]> large(new char[100000]);
+    std::memset(small.get(), 1, 24);
+    std::memset(medium.get(), 2, 1000);
+    std::memset(large.get(), 3, 100000);
+    assert(small[23] == 1 && medium[0] == 2 && medium[999] == 2);
+    assert(large[0] == 3 && large[99999] == 3);
+    benchmark::DoNotOptimize(small.get());
+  }
+}
+
+int AddAllocatorCases(const std::string& name) {
+  AddCases(TC_ConsoleOut, {{"^" + name +
+                            " %console_report alloc_bytes=101\\.024k "
+                            "allocs=3$"}});
+  AddCases(TC_JSONOut, {{"\"name\": \"" + name + "\",$"},
+                        {"\"iterations\": %int,$", MR_Next},
+                        {"\"real_time\": %float,$", MR_Next},
+                        {"\"cpu_time\": %float,$", MR_Next},
+                        {"\"time_unit\": \"ns\",$", MR_Next},
+                        {"\"alloc_bytes\": 1\\.010240*e\\+05,$", MR_Next},
+                        {"\"allocs\": 3\\.0+e\\+00$", MR_Next},
+                        {"}", MR_Next}});
+  AddCases(TC_CSVOut, {{"^\"" + name + "\",%csv_report,101024,3$"}});
+  return 0;
+}
+#define ADD_ALLOCATOR_CASES(name) \
+  int CONCAT(dummy, __LINE__) = AddAllocatorCases(name)
+
+BENCHMARK(BM_Allocate)->Allocator(benchmark::kSystemAllocator);
+ADD_ALLOCATOR_CASES("BM_Allocate/allocator:system");
+BENCHMARK(BM_Allocate)->Allocator(benchmark::kThreadCachingAllocator);
+ADD_ALLOCATOR_CASES("BM_Allocate/allocator:thread_cache");
+BENCHMARK(BM_Allocate)->Allocator(benchmark::kArenaAllocator);
+ADD_ALLOCATOR_CASES("BM_Allocate/allocator:arena");
+BENCHMARK(BM_Allocate)->Allocator(benchmark::kSlabAllocator);
+ADD_ALLOCATOR_CASES("BM_Allocate/allocator:slab");
+BENCHMARK(BM_Allocate)->Allocator(benchmark::kSlabAllocator)->Threads(2);
+ADD_ALLOCATOR_CASES("BM_Allocate/allocator:slab/threads:2");
+
+// Blocks allocated by one allocator are freed by it even when another one is
+// selected.
+std::unique_ptr<int> arena_block;
+
+void BM_AllocateInArena(benchmark::State& state) {
+  for (auto _ : state) {
+  }
+  arena_block.reset(new int(42));
+}
+BENCHMARK(BM_AllocateInArena)
+    ->Allocator(benchmark::kArenaAllocator)
+    ->Iterations(1);
+
+void BM_FreeFromArena(benchmark::State& state) {
+  for (auto _ : state) {
+  }
+  assert(arena_block && *arena_block == 42);
+  arena_block.reset();
+}
+BENCHMARK(BM_FreeFromArena)
+    ->Allocator(benchmark::kThreadCachingAllocator)
+    ->Iterations(1);
+
+// Without an allocator no allocations are counted.
+void BM_NoAllocator(benchmark::State& state) {
+  for (auto _ : state) {
+    std::unique_ptr<int> block(new int(0));
+    benchmark::DoNotOptimize(block.get());
+  }
+}
+BENCHMARK(BM_NoAllocator);
+ADD_CASES(TC_ConsoleOut, {{"^BM_NoAllocator %console_report$"}});
+ADD_CASES(TC_CSVOut, {{"^\"BM_NoAllocator\",%csv_report,,$"}});
+
+// ========================================================================= //
+// --------------------------- TEST CASES END ------------------------------ //
+// ========================================================================= //
+
+int main(int argc, char* argv[]) { RunOutputTests(argc, argv); }
@@ -4,6 +4,7 @@
 #include <math.h>
 #include <stdint.h>
 
+#include <atomic>
 #include <chrono>
 #include <cstdlib>
 #include <iostream>
@@ -11,6 +12,7 @@
 #include <list>
 #include <map>
 #include <mutex>
+#include <numeric>
 #include <set>
 #include <sstream>
 #include <string>
@@ -241,4 +243,88 @@ BENCHMARK(BM_DenseThreadRanges)->Arg(1)->DenseThreadRange(1, 3);
 BENCHMARK(BM_DenseThreadRanges)->Arg(2)->DenseThreadRange(1, 4, 2);
 BENCHMARK(BM_DenseThreadRanges)->Arg(3)->DenseThreadRange(5, 14, 3);
 
+// Thread 0 sends a stamped message per iteration to thread 1, which records
+// its latency.
+static std::mutex queue_mutex;
+static std::list<int64_t> queue;
+
+static void BM_QueueLatency(benchmark::State& st) {
+  for (auto _ : st) {
+    if (st.thread_index == 0) {
+      std::lock_guard<std::mutex> lock(queue_mutex);
+      queue.push_back(benchmark::Stamp());
+    } else {
+      for (;;) {
+        {
+          std::lock_guard<std::mutex> lock(queue_mutex);
+          if (!queue.empty()) {
+            st.RecordLatencySince(queue.front());
+            queue.pop_front();
+            break;
+          }
+        }
+        std::this_thread::yield();
+      }
+    }
+  }
+}
+BENCHMARK(BM_QueueLatency)->Threads(2)->UseRealTime();
+
+static void BM_SumVectors(benchmark::State& st) {
+  std::vector<int> v(static_cast<size_t>(st.range(0)));
+  for (auto _ : st) {
+    for (int i = 0; i < st.range(1); ++i)
+      benchmark::DoNotOptimize(std::accumulate(v.begin(), v.end(), i));
+  }
+}
+BENCHMARK(BM_SumVectors)
+    ->ArgNames({"size", "passes"})
+    ->Ranges({{64, 512}, {1, 4}})
+    ->AnalyzeSensitivity();
+
+static void BM_ParallelSum(benchmark::State& st) {
+  std::vector<int64_t> v(static_cast<size_t>(st.range(0)), 1);
+  benchmark::Executor& executor = st.executor();
+  for (auto _ : st) {
+    std::atomic<int64_t> sum(0);
+    executor.ParallelFor(0, st.range(0), 4096, [&](int64_t b, int64_t e) {
+      sum += std::accumulate(v.begin() + b, v.begin() + e, int64_t(0));
+    });
+    assert(sum == st.range(0));
+  }
+}
+BENCHMARK(BM_ParallelSum)->Range(1 << 12, 1 << 20)->UseRealTime();
+
+static std::mutex shared_map_mu;
+
+static void BM_ContendedInsert(benchmark::State& st) {
+  static std::map<int, int>* map = nullptr;
+  if (st.thread_index == 0) map = new std::map<int, int>;
+  int i = st.thread_index;
+  while (st.KeepRunning()) {
+    std::lock_guard<std::mutex> l(shared_map_mu);
+    (*map)[i] = i;
+    i += st.threads;
+  }
+  st.SetItemsProcessed(st.iterations());
+  if (st.thread_index == 0) {
+    delete map;
+    map = nullptr;
+  }
+}
+BENCHMARK(BM_ContendedInsert)->ThreadRange(1, 4)->SharedIterations();
+
+// A server taking st.range(0) microseconds to serve each request.
+static void BM_ServeRequests(benchmark::State& st) {
+  const auto service_time = std::chrono::microseconds(st.range(0));
+  for (auto _ : st) {
+    const int64_t arrival = st.WaitForArrival();
+    const auto done = std::chrono::steady_clock::now() + service_time;
+    while (std::chrono::steady_clock::now() < done) {
+    }
+    st.RecordLatencySince(arrival);
+  }
+}
+BENCHMARK(BM_ServeRequests)->Arg(1)->UseRealTime()->FindCapacity(0.99, 20e-6);
+
 BENCHMARK_MAIN();
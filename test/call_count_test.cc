@@ -0,0 +1,46 @@
+
+#undef NDEBUG
+
+#include "benchmark/benchmark.h"
+#include "output_test.h"
+
+// This file is compiled with -finstrument-functions and linked with
+// -rdynamic so that the instrumented functions can be symbolized.
+
+#if defined(__GNUC__)
+#define BENCHMARK_NOINLINE __attribute__((noinline))
+#else
+#define BENCHMARK_NOINLINE
+#endif
+
+int BENCHMARK_NOINLINE CountedLeaf(int x) {
+  benchmark::DoNotOptimize(x);
+  return x + 1;
+}
+
+// ========================================================================= //
+// ------------------------ Call Counting Output --------------------------- //
+// ========================================================================= //
+
+void BM_CountCalls(benchmark::State& state) {
+  for (auto _ : state) {
+    int x = 0;
+    for (int i = 0; i < 3; ++i) x = CountedLeaf(x);
+    benchmark::DoNotOptimize(x);
+  }
+}
+BENCHMARK(BM_CountCalls)->CountCalls(10);
+BENCHMARK(BM_CountCalls)->CountCalls(10)->Threads(2);
+
+ADD_CASES(TC_JSONOut, {{"\"name\": \"BM_CountCalls\",$"},
+                       {"\"calls\": %float,$"},
+                       {"\"calls:CountedLeaf\\(int\\)\": 3\\.0+e\\+00,$"}});
+ADD_CASES(TC_JSONOut, {{"\"name\": \"BM_CountCalls/threads:2\",$"},
+                       {"\"calls\": %float,$"},
+                       {"\"calls:CountedLeaf\\(int\\)\": 3\\.0+e\\+00,$"}});
+
+// ========================================================================= //
+// --------------------------- TEST CASES END ------------------------------ //
+// ========================================================================= //
+
+int main(int argc, char* argv[]) { RunOutputTests(argc, argv); }
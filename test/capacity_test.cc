@@ -0,0 +1,99 @@
+//===---------------------------------------------------------------------===//
+// capacity_test - Unit tests for src/capacity.cc
+//===---------------------------------------------------------------------===//
+
+#include <vector>
+
+#include "../src/capacity.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using benchmark::internal::CapacityBounds;
+using benchmark::internal::CapacityProbe;
+using benchmark::internal::SearchCapacity;
+
+// A server which meets the target at rates up to 'capacity', recording the
+// rates it is probed at.
+struct FakeServer {
+  explicit FakeServer(double c) : capacity(c) {}
+
+  CapacityProbe operator()(double rate) {
+    rates.push_back(rate);
+    return rate <= capacity ? benchmark::internal::kTargetMet
+                            : benchmark::internal::kTargetMissed;
+  }
+
+  double capacity;
+  std::vector<double> rates;
+};
+
+CapacityBounds Search(double service_rate, FakeServer* server) {
+  return SearchCapacity(service_rate,
+                        [server](double rate) { return (*server)(rate); });
+}
+
+TEST(SearchCapacityTest, BisectsAboveTheStart) {
+  FakeServer server(700);
+  const CapacityBounds bounds = Search(1000, &server);
+  EXPECT_FALSE(bounds.failed);
+  ASSERT_GE(server.rates.size(), 3u);
+  EXPECT_DOUBLE_EQ(server.rates[0], 250);
+  EXPECT_DOUBLE_EQ(server.rates[1], 500);
+  EXPECT_DOUBLE_EQ(server.rates[2], 1000);
+  EXPECT_LE(bounds.met_rate, 700);
+  EXPECT_GT(bounds.missed_rate, 700);
+  EXPECT_LE(bounds.missed_rate, bounds.met_rate * 1.05);
+}
+
+TEST(SearchCapacityTest, BisectsBelowTheStart) {
+  FakeServer server(100);
+  const CapacityBounds bounds = Search(1000, &server);
+  EXPECT_FALSE(bounds.failed);
+  ASSERT_GE(server.rates.size(), 3u);
+  EXPECT_DOUBLE_EQ(server.rates[0], 250);
+  EXPECT_DOUBLE_EQ(server.rates[1], 125);
+  EXPECT_DOUBLE_EQ(server.rates[2], 62.5);
+  EXPECT_LE(bounds.met_rate, 100);
+  EXPECT_GT(bounds.missed_rate, 100);
+  EXPECT_LE(bounds.missed_rate, bounds.met_rate * 1.05);
+  // Each rate met is higher than the ones before it.
+  double highest_met = 0;
+  for (double rate : server.rates) {
+    if (rate > server.capacity) continue;
+    EXPECT_GT(rate, highest_met);
+    highest_met = rate;
+  }
+  EXPECT_DOUBLE_EQ(highest_met, bounds.met_rate);
+}
+
+TEST(SearchCapacityTest, MissedAtEveryRate) {
+  FakeServer server(1);
+  const CapacityBounds bounds = Search(1000, &server);
+  EXPECT_FALSE(bounds.failed);
+  EXPECT_DOUBLE_EQ(bounds.met_rate, 0);
+  EXPECT_DOUBLE_EQ(bounds.missed_rate, 1000.0 / 32);
+  EXPECT_EQ(server.rates.size(), 4u);
+}
+
+TEST(SearchCapacityTest, MetAtEveryRate) {
+  FakeServer server(1e9);
+  const CapacityBounds bounds = Search(1000, &server);
+  EXPECT_FALSE(bounds.failed);
+  EXPECT_DOUBLE_EQ(bounds.met_rate, 2000);
+  EXPECT_DOUBLE_EQ(bounds.missed_rate, 0);
+  EXPECT_EQ(server.rates.size(), 4u);
+}
+
+TEST(SearchCapacityTest, StopsAtAFailedProbe) {
+  int probes = 0;
+  const CapacityBounds bounds = SearchCapacity(1000, [&probes](double) {
+    return ++probes == 1 ? benchmark::internal::kTargetMet
+                         : benchmark::internal::kProbeFailed;
+  });
+  EXPECT_TRUE(bounds.failed);
+  EXPECT_EQ(probes, 2);
+  EXPECT_DOUBLE_EQ(bounds.met_rate, 250);
+}
+
+}  // end namespace
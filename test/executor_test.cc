@@ -0,0 +1,81 @@
+//===---------------------------------------------------------------------===//
+// executor_test - Unit tests for src/executor.cc
+//===---------------------------------------------------------------------===//
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../src/executor.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+benchmark::Executor& TestExecutor() {
+  return benchmark::internal::GetExecutor(3, std::vector<int>());
+}
+
+TEST(ExecutorTest, ParallelForCoversRangeOnce) {
+  benchmark::Executor& executor = TestExecutor();
+  EXPECT_EQ(executor.num_workers(), 3);
+  std::vector<std::atomic<int> > hits(10007);
+  for (auto& hit : hits) hit = 0;
+  executor.ParallelFor(0, static_cast<int64_t>(hits.size()), 64,
+                       [&](int64_t begin, int64_t end) {
+                         EXPECT_LE(end - begin, 64);
+                         for (int64_t i = begin; i < end; ++i) ++hits[i];
+                       });
+  for (const auto& hit : hits) EXPECT_EQ(hit, 1);
+}
+
+TEST(ExecutorTest, NestedTaskGroups) {
+  benchmark::Executor& executor = TestExecutor();
+  std::atomic<int> count(0);
+  {
+    benchmark::TaskGroup outer(executor);
+    for (int i = 0; i < 8; ++i) {
+      outer.Run([&] {
+        benchmark::TaskGroup inner(executor);
+        for (int j = 0; j < 8; ++j) inner.Run([&] { ++count; });
+        inner.Wait();
+        ++count;
+      });
+    }
+  }
+  EXPECT_EQ(count, 72);
+}
+
+TEST(ExecutorTest, Stats) {
+  benchmark::Executor& executor = TestExecutor();
+  benchmark::internal::ExecutorStats before, after;
+  ASSERT_TRUE(benchmark::internal::ReadExecutorStats(&before));
+  executor.ParallelFor(0, 1000, 1, [](int64_t, int64_t) {});
+  ASSERT_TRUE(benchmark::internal::ReadExecutorStats(&after));
+  EXPECT_EQ(after.workers, 3);
+  // Each of the 999 splits queues a task.
+  EXPECT_EQ(after.tasks - before.tasks, 999);
+  EXPECT_GE(after.steals, before.steals);
+  EXPECT_GE(after.busy_time, before.busy_time);
+}
+
+// The busy time of a task is counted by the time its group has waited for it.
+TEST(ExecutorTest, BusyTimeCountedOnReturn) {
+  benchmark::Executor& executor = TestExecutor();
+  benchmark::internal::ExecutorStats before, after;
+  ASSERT_TRUE(benchmark::internal::ReadExecutorStats(&before));
+  std::atomic<bool> started(false);
+  {
+    benchmark::TaskGroup group(executor);
+    group.Run([&] {
+      started = true;
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    });
+    // Leave the task to a worker rather than to Wait().
+    while (!started) std::this_thread::yield();
+  }
+  ASSERT_TRUE(benchmark::internal::ReadExecutorStats(&after));
+  EXPECT_GE(after.busy_time - before.busy_time, 0.019);
+}
+
+}  // end namespace
@@ -3,6 +3,7 @@
 
 #include <cassert>
 #include <memory>
+#include <vector>
 
 class MyFixture : public ::benchmark::Fixture {
  public:
@@ -46,4 +47,50 @@ BENCHMARK_DEFINE_F(MyFixture, Bar)(benchmark::State& st) {
 BENCHMARK_REGISTER_F(MyFixture, Bar)->Arg(42);
 BENCHMARK_REGISTER_F(MyFixture, Bar)->Arg(42)->ThreadPerCpu();
 
+class HookFixture : public ::benchmark::Fixture {
+ public:
+  HookFixture() : runs(0) {}
+
+  void SetUpOnce(::benchmark::State& state) {
+    assert(buffers.empty());
+    buffers.resize(state.threads);
+    runs = 0;
+  }
+
+  void SetUpThread(::benchmark::State& state) {
+    assert(buffers.size() == static_cast<size_t>(state.threads));
+    buffers[state.thread_index].reset(new int(state.thread_index));
+    if (state.thread_index == 0) ++runs;
+  }
+
+  void TearDownThread(::benchmark::State& state) {
+    assert(buffers[state.thread_index] != nullptr);
+    buffers[state.thread_index].reset();
+  }
+
+  void TearDownOnce(::benchmark::State&) {
+    for (auto const& buffer : buffers) assert(buffer == nullptr);
+    buffers.clear();
+    // The search for the iteration count runs between the same hooks.
+    assert(runs > 1);
+  }
+
+  ~HookFixture() { assert(buffers.empty()); }
+
+  std::vector<std::unique_ptr<int> > buffers;
+  int runs;
+};
+
+BENCHMARK_DEFINE_F(HookFixture, PerThread)(benchmark::State& st) {
+  int* buffer = buffers[st.thread_index].get();
+  assert(buffer != nullptr && *buffer == st.thread_index);
+  for (auto _ : st) {
+    benchmark::DoNotOptimize(*buffer);
+  }
+}
+BENCHMARK_REGISTER_F(HookFixture, PerThread)
+    ->Threads(1)
+    ->Threads(2)
+    ->ReportHookTimes();
+
 BENCHMARK_MAIN();
@@ -0,0 +1,45 @@
+//===---------------------------------------------------------------------===//
+// interference_test - Unit tests for src/interference.cc
+//===---------------------------------------------------------------------===//
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../src/interference.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+TEST(InterferenceProbeTest, MeasuresIdleRates) {
+  benchmark::internal::InterferenceProbe probe(std::vector<int>(1, 0),
+                                               1 << 20);
+  EXPECT_GT(probe.idle_rates().lookups, 0);
+  EXPECT_GT(probe.idle_rates().stream_bytes, 0);
+}
+
+TEST(InterferenceProbeTest, MeasuresRatesBesideOtherWork) {
+  benchmark::internal::InterferenceProbe probe(std::vector<int>(2, 0),
+                                               1 << 20);
+  probe.Start();
+  std::atomic<bool> done(false);
+  std::thread antagonist([&] {
+    std::vector<char> buffer(32 << 20);
+    while (!done.load()) {
+      for (size_t i = 0; i < buffer.size(); i += 64) ++buffer[i];
+    }
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  const benchmark::internal::VictimRates rates = probe.Stop();
+  done = true;
+  antagonist.join();
+  EXPECT_GT(rates.lookups, 0);
+  EXPECT_GT(rates.stream_bytes, 0);
+  // The probe can be run again.
+  probe.Start();
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_GT(probe.Stop().lookups, 0);
+}
+
+}  // end namespace
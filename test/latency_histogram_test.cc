@@ -0,0 +1,58 @@
+//===---------------------------------------------------------------------===//
+// latency_histogram_test - Unit tests for src/latency_histogram.cc
+//===---------------------------------------------------------------------===//
+
+#include "../src/latency_histogram.h"
+#include "gtest/gtest.h"
+
+namespace {
+TEST(LatencyHistogramTest, Empty) {
+  benchmark::LatencyHistogram h;
+  EXPECT_EQ(h.count(), 0);
+}
+
+TEST(LatencyHistogramTest, SmallValuesAreExact) {
+  benchmark::LatencyHistogram h;
+  for (int i = 1; i <= 50; ++i) h.Record(i * 1e-9);
+  EXPECT_EQ(h.count(), 50);
+  EXPECT_DOUBLE_EQ(h.min(), 1e-9);
+  EXPECT_DOUBLE_EQ(h.max(), 50e-9);
+  EXPECT_DOUBLE_EQ(h.mean(), 25.5e-9);
+  EXPECT_DOUBLE_EQ(h.Percentile(0.5), 25e-9);
+  EXPECT_DOUBLE_EQ(h.Percentile(0.9), 45e-9);
+  EXPECT_DOUBLE_EQ(h.Percentile(1), 50e-9);
+  EXPECT_DOUBLE_EQ(h.Percentile(0), 1e-9);
+}
+
+TEST(LatencyHistogramTest, RelativeError) {
+  benchmark::LatencyHistogram h;
+  for (int i = 1; i <= 1000; ++i) h.Record(i * 1e-6);
+  EXPECT_NEAR(h.Percentile(0.5), 500e-6, 500e-6 / 32);
+  EXPECT_NEAR(h.Percentile(0.99), 990e-6, 990e-6 / 32);
+  EXPECT_DOUBLE_EQ(h.max(), 1000e-6);
+}
+
+TEST(LatencyHistogramTest, Merge) {
+  benchmark::LatencyHistogram a, b;
+  a.Record(1e-3);
+  b.Record(2e-3);
+  b.Record(3e-3);
+  a.Merge(b);
+  EXPECT_EQ(a.count(), 3);
+  EXPECT_DOUBLE_EQ(a.min(), 1e-3);
+  EXPECT_DOUBLE_EQ(a.max(), 3e-3);
+  EXPECT_NEAR(a.mean(), 2e-3, 1e-12);
+  EXPECT_NEAR(a.Percentile(0.5), 2e-3, 2e-3 / 32);
+}
+
+TEST(LatencyHistogramTest, CountAbove) {
+  benchmark::LatencyHistogram h;
+  EXPECT_EQ(h.CountAbove(1e-6), 0);
+  for (int i = 1; i <= 50; ++i) h.Record(i * 1e-9);
+  EXPECT_EQ(h.CountAbove(40e-9), 10);
+  EXPECT_EQ(h.CountAbove(0), 50);
+  EXPECT_EQ(h.CountAbove(1), 0);
+  for (int i = 1; i <= 1000; ++i) h.Record(i * 1e-6);
+  EXPECT_NEAR(static_cast<double>(h.CountAbove(900e-6)), 100, 100.0 / 32 * 9);
+}
+}  // end namespace
@@ -0,0 +1,369 @@
+
+#undef NDEBUG
+
+#include <chrono>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/working_set.h"
+#include "benchmark/benchmark.h"
+#include "output_test.h"
+
+// The counters added by the library have CSV columns from the start, even
+// when the first benchmark has none of them.
+
+// The counters which have a CSV column, in the order of the header: those of
+// the first benchmark and those the library may add to any of the benchmarks
+// below.
+const char* const kCSVCounters[] = {
+    "bar",          "capacity",        "extra_threads",
+    "foo",          "latency_max",     "latency_mean",
+    "latency_p50",  "latency_p90",     "latency_p99",
+    "latency_p999", "offered_rate",    "setup_once",
+    "setup_thread", "slo_met",         "speedup",
+    "speedup_ci",   "teardown_once",   "teardown_thread",
+    "thread_iterations_max", "thread_iterations_min", "throughput_ratio",
+    "throughput_ratio_ci",   "weak_scaling_efficiency", "ws_accessed",
+    "ws_written"};
+
+std::string CSVHeader() {
+  std::string header = "^%csv_header";
+  for (const char* counter : kCSVCounters)
+    header += std::string(",\"") + counter + "\"";
+  return header + "$";
+}
+
+// Returns the regex of the CSV row of 'name', whose fields up to the counters
+// match 'report' and which has a value in the columns of 'counters' only.
+std::string CSVRow(const std::string& name, const std::string& report,
+                   const std::set<std::string>& counters) {
+  std::string row = "^\"" + name + "\"," + report;
+  for (const char* counter : kCSVCounters)
+    row += counters.count(counter) != 0 ? ",%float" : ",";
+  return row + "$";
+}
+
+// ========================================================================= //
+// ---------------------- Testing Prologue Output -------------------------- //
+// ========================================================================= //
+
+ADD_CASES(TC_ConsoleOut,
+          {{"^[-]+$", MR_Next},
+           {"^Benchmark %s Time %s CPU %s Iterations UserCounters...$", MR_Next},
+           {"^[-]+$", MR_Next}});
+ADD_CASES(TC_CSVOut, {{CSVHeader()}});
+
+// ========================================================================= //
+// ------------------------ Weak Scaling Efficiency ------------------------ //
+// ========================================================================= //
+
+void BM_Counters_WeakScaling(benchmark::State& state) {
+  for (auto _ : state) {
+  }
+  state.counters["foo"] = 1;
+  state.counters["bar"] = 2;
+}
+BENCHMARK(BM_Counters_WeakScaling)->ThreadRange(1, 2)->WeakScaling();
+// The first thread count is the baseline of the others.
+ADD_CASES(TC_ConsoleOut, {{"^BM_Counters_WeakScaling/threads:1 %console_report "
+                           "bar=%hrfloat foo=%hrfloat "
+                           "weak_scaling_efficiency=1$"},
+                          {"^BM_Counters_WeakScaling/threads:2 %console_report "
+                           "bar=%hrfloat foo=%hrfloat "
+                           "weak_scaling_efficiency=%hrfloat$"}});
+ADD_CASES(TC_JSONOut, {{"\"name\": \"BM_Counters_WeakScaling/threads:1\",$"},
+                       {"\"iterations\": %int,$", MR_Next},
+                       {"\"real_time\": %float,$", MR_Next},
+                       {"\"cpu_time\": %float,$", MR_Next},
+                       {"\"time_unit\": \"ns\",$", MR_Next},
+                       {"\"bar\": %float,$", MR_Next},
+                       {"\"foo\": %float,$", MR_Next},
+                       {"\"weak_scaling_efficiency\": 1\\.0+e\\+00$", MR_Next},
+                       {"}", MR_Next}});
+ADD_CASES(TC_CSVOut,
+          {{CSVRow("BM_Counters_WeakScaling/threads:%int", "%csv_report",
+                   {"bar", "foo", "weak_scaling_efficiency"})}});
+
+void BM_Counters_WeakScalingAddsBaseline(benchmark::State& state) {
+  for (auto _ : state) {
+  }
+}
+BENCHMARK(BM_Counters_WeakScalingAddsBaseline)->Threads(2)->WeakScaling();
+// A 1-thread run is added first as the baseline.
+ADD_CASES(TC_ConsoleOut,
+          {{"^BM_Counters_WeakScalingAddsBaseline/threads:1 %console_report "
+            "weak_scaling_efficiency=1$"},
+           {"^BM_Counters_WeakScalingAddsBaseline/threads:2 %console_report "
+            "weak_scaling_efficiency=%hrfloat$"}});
+
+// ========================================================================= //
+// ------------------------- Process CPU Time ------------------------------ //
+// ========================================================================= //
+
+void BM_Counters_ProcessCPUTime(benchmark::State& state) {
+  // A thread of the benchmarked code, living long enough to be sampled.
+  std::thread helper(
+      [] { std::this_thread::sleep_for(std::chrono::milliseconds(50)); });
+  for (auto _ : state) {
+  }
+  helper.join();
+  state.counters["foo"] = 1;
+}
+BENCHMARK(BM_Counters_ProcessCPUTime)->MeasureProcessCPUTime()->UseRealTime();
+ADD_CASES(TC_ConsoleOut,
+          {{"^BM_Counters_ProcessCPUTime/process_time/real_time "
+            "%console_report extra_threads=1 foo=%hrfloat$"}});
+ADD_CASES(TC_JSONOut,
+          {{"\"name\": \"BM_Counters_ProcessCPUTime/process_time/real_time\",$"},
+           {"\"iterations\": %int,$", MR_Next},
+           {"\"real_time\": %float,$", MR_Next},
+           {"\"cpu_time\": %float,$", MR_Next},
+           {"\"time_unit\": \"ns\",$", MR_Next},
+           {"\"extra_threads\": 1\\.0+e\\+00,$", MR_Next},
+           {"\"foo\": %float$", MR_Next},
+           {"}", MR_Next}});
+ADD_CASES(TC_CSVOut,
+          {{CSVRow("BM_Counters_ProcessCPUTime/process_time/real_time",
+                   "%csv_report", {"extra_threads", "foo"})}});
+
+// ========================================================================= //
+// ---------------------------- Relative To -------------------------------- //
+// ========================================================================= //
+
+void BM_Counters_Baseline(benchmark::State& state) {
+  for (auto _ : state) {
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+void BM_Counters_RelativeTo(benchmark::State& state) {
+  for (auto _ : state) {
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+// Registered before its baseline, but run right after it.
+BENCHMARK(BM_Counters_RelativeTo)->Arg(8)->RelativeTo("BM_Counters_Baseline");
+BENCHMARK(BM_Counters_Baseline)->Arg(8);
+ADD_CASES(TC_ConsoleOut,
+          {{"^BM_Counters_Baseline/8 %console_report speedup=1 "
+            "throughput_ratio=1 +%hrfloat items/s$"},
+           {"^BM_Counters_RelativeTo/8 %console_report speedup=%hrfloat "
+            "throughput_ratio=%hrfloat +%hrfloat items/s$",
+            MR_Next}});
+ADD_CASES(TC_JSONOut, {{"\"name\": \"BM_Counters_RelativeTo/8\",$"},
+                       {"\"iterations\": %int,$", MR_Next},
+                       {"\"real_time\": %float,$", MR_Next},
+                       {"\"cpu_time\": %float,$", MR_Next},
+                       {"\"time_unit\": \"ns\",$", MR_Next},
+                       {"\"items_per_second\": %float,$", MR_Next},
+                       {"\"speedup\": %float,$", MR_Next},
+                       {"\"throughput_ratio\": %float$", MR_Next},
+                       {"}", MR_Next}});
+ADD_CASES(TC_CSVOut,
+          {{CSVRow("BM_Counters_Baseline/8", "%csv_items_report",
+                   {"speedup", "throughput_ratio"})},
+           {CSVRow("BM_Counters_RelativeTo/8", "%csv_items_report",
+                   {"speedup", "throughput_ratio"}),
+            MR_Next}});
+void CheckBaseline(Results const& e) {
+  CHECK_COUNTER_VALUE(e, int, "speedup", EQ, 1);
+  CHECK_COUNTER_VALUE(e, int, "throughput_ratio", EQ, 1);
+}
+CHECK_BENCHMARK_RESULTS("BM_Counters_Baseline/8", &CheckBaseline);
+// Both process one item per iteration, so their rates are in the ratio of
+// their times.
+void CheckRelativeTo(Results const& e) {
+  CHECK_FLOAT_COUNTER_VALUE(e, "throughput_ratio", EQ,
+                            e.GetAs<double>("speedup"), 0.001);
+}
+CHECK_BENCHMARK_RESULTS("BM_Counters_RelativeTo/8", &CheckRelativeTo);
+
+// With repetitions only the mean has confidence intervals, computed from the
+// runs of both.
+void BM_Counters_RepeatedBaseline(benchmark::State& state) {
+  for (auto _ : state) {
+  }
+}
+void BM_Counters_RepeatedRelativeTo(benchmark::State& state) {
+  for (auto _ : state) {
+  }
+}
+BENCHMARK(BM_Counters_RepeatedBaseline)->Repetitions(2);
+BENCHMARK(BM_Counters_RepeatedRelativeTo)
+    ->Repetitions(2)
+    ->RelativeTo("BM_Counters_RepeatedBaseline");
+ADD_CASES(TC_ConsoleOut,
+          {{"^BM_Counters_RepeatedRelativeTo/repeats:2 %console_report "
+            "speedup=%hrfloat$"},
+           {"^BM_Counters_RepeatedRelativeTo/repeats:2 %console_report "
+            "speedup=%hrfloat$",
+            MR_Next},
+           {"^BM_Counters_RepeatedRelativeTo/repeats:2_mean %console_report "
+            "speedup=%hrfloat speedup_ci=%hrfloat$",
+            MR_Next},
+           {"^BM_Counters_RepeatedRelativeTo/repeats:2_median "
+            "%console_report speedup=%hrfloat$",
+            MR_Next},
+           {"^BM_Counters_RepeatedRelativeTo/repeats:2_stddev "
+            "%console_report speedup=%hrfloat$",
+            MR_Next}});
+
+// ========================================================================= //
+// -------------------------- Shared Iterations ---------------------------- //
+// ========================================================================= //
+
+void BM_Counters_SharedIterations(benchmark::State& state) {
+  for (auto _ : state) {
+  }
+  state.counters["foo"] = static_cast<double>(state.iterations());
+}
+BENCHMARK(BM_Counters_SharedIterations)->Threads(2)->SharedIterations();
+ADD_CASES(TC_ConsoleOut,
+          {{"^BM_Counters_SharedIterations/threads:2 %console_report "
+            "foo=%hrfloat thread_iterations_max=%hrfloat "
+            "thread_iterations_min=%hrfloat$"}});
+ADD_CASES(TC_JSONOut,
+          {{"\"name\": \"BM_Counters_SharedIterations/threads:2\",$"},
+           {"\"iterations\": %int,$", MR_Next},
+           {"\"real_time\": %float,$", MR_Next},
+           {"\"cpu_time\": %float,$", MR_Next},
+           {"\"time_unit\": \"ns\",$", MR_Next},
+           {"\"foo\": %float,$", MR_Next},
+           {"\"thread_iterations_max\": %float,$", MR_Next},
+           {"\"thread_iterations_min\": %float$", MR_Next},
+           {"}", MR_Next}});
+ADD_CASES(TC_CSVOut,
+          {{CSVRow("BM_Counters_SharedIterations/threads:2", "%csv_report",
+                   {"foo", "thread_iterations_max", "thread_iterations_min"})}});
+// The threads run all the iterations between them, and each counts the
+// number it ran.
+void CheckSharedIterations(Results const& e) {
+  CHECK_FLOAT_COUNTER_VALUE(e, "foo", EQ, e.GetAs<double>("iterations"),
+                            0.001);
+}
+CHECK_BENCHMARK_RESULTS("BM_Counters_SharedIterations/threads:2",
+                        &CheckSharedIterations);
+
+// ========================================================================= //
+// ---------------------------- Find Capacity ------------------------------ //
+// ========================================================================= //
+
+void BM_Counters_Capacity(benchmark::State& state) {
+  for (auto _ : state) {
+    state.RecordLatencySince(state.WaitForArrival());
+  }
+}
+// The target is met at every rate tried.
+BENCHMARK(BM_Counters_Capacity)->MinTime(0.001)->FindCapacity(0.5, 1);
+ADD_CASES(TC_ConsoleOut,
+          {{"^BM_Counters_Capacity/min_time:0.001/rate:%int .* "
+            "offered_rate=%hrfloat slo_met=1$"},
+           {"^BM_Counters_Capacity/min_time:0.001_capacity .*capacity=%hrfloat "
+            ".* lower bound$"}});
+ADD_CASES(TC_JSONOut,
+          {{"\"name\": \"BM_Counters_Capacity/min_time:0.001_capacity\",$"},
+           {"\"iterations\": %int,$", MR_Next},
+           {"\"real_time\": %float,$", MR_Next},
+           {"\"cpu_time\": %float,$", MR_Next},
+           {"\"time_unit\": \"ns\",$", MR_Next},
+           {"\"capacity\": %float,$", MR_Next}});
+ADD_CASES(TC_CSVOut,
+          {{CSVRow("BM_Counters_Capacity/min_time:0.001", "%csv_report",
+                   {"latency_max", "latency_mean", "latency_p50",
+                    "latency_p90", "latency_p99", "latency_p999"})},
+           {CSVRow("BM_Counters_Capacity/min_time:0.001/rate:%int",
+                   "%csv_report",
+                   {"latency_max", "latency_mean", "latency_p50",
+                    "latency_p90", "latency_p99", "latency_p999",
+                    "offered_rate", "slo_met"}),
+            MR_Next},
+           {CSVRow("BM_Counters_Capacity/min_time:0.001_capacity",
+                   "%csv_label_report_begin\"lower bound\""
+                   "%csv_label_report_end",
+                   {"capacity", "latency_max", "latency_mean", "latency_p50",
+                    "latency_p90", "latency_p99", "latency_p999"})}});
+
+// ========================================================================= //
+// ------------------------------ Hook Times ------------------------------- //
+// ========================================================================= //
+
+void BM_Counters_HookTimes(benchmark::State& state) {
+  for (auto _ : state) {
+  }
+}
+BENCHMARK(BM_Counters_HookTimes)->Threads(2)->ReportHookTimes();
+ADD_CASES(TC_ConsoleOut,
+          {{"^BM_Counters_HookTimes/threads:2 %console_report "
+            "setup_once=%hrfloat setup_thread=%hrfloat "
+            "teardown_once=%hrfloat teardown_thread=%hrfloat$"}});
+ADD_CASES(TC_JSONOut, {{"\"name\": \"BM_Counters_HookTimes/threads:2\",$"},
+                       {"\"iterations\": %int,$", MR_Next},
+                       {"\"real_time\": %float,$", MR_Next},
+                       {"\"cpu_time\": %float,$", MR_Next},
+                       {"\"time_unit\": \"ns\",$", MR_Next},
+                       {"\"setup_once\": %float,$", MR_Next},
+                       {"\"setup_thread\": %float,$", MR_Next},
+                       {"\"teardown_once\": %float,$", MR_Next},
+                       {"\"teardown_thread\": %float$", MR_Next},
+                       {"}", MR_Next}});
+ADD_CASES(TC_CSVOut,
+          {{CSVRow("BM_Counters_HookTimes/threads:2", "%csv_report",
+                   {"setup_once", "setup_thread", "teardown_once",
+                    "teardown_thread"})}});
+
+// ========================================================================= //
+// ----------------------------- Working Set ------------------------------- //
+// ========================================================================= //
+
+// The working set is only measured where the soft-dirty bits can be reset
+// through /proc/self/clear_refs, and the accessed pages only where idle page
+// tracking can be used.
+std::set<std::string> WorkingSetCounters() {
+  std::set<std::string> counters;
+  benchmark::WorkingSetTracker tracker;
+  std::string error;
+  benchmark::WorkingSet ws;
+  if (!tracker.Start(&error) || !tracker.Stop(&ws, &error)) return counters;
+  counters.insert("ws_written");
+  if (ws.accessed_pages >= 0) counters.insert("ws_accessed");
+  return counters;
+}
+
+const size_t kWorkingSetBytes = 1 << 20;
+
+void BM_Counters_WorkingSet(benchmark::State& state) {
+  static std::vector<char> buffer(kWorkingSetBytes);
+  for (auto _ : state) {
+    for (size_t i = 0; i < buffer.size(); i += 512) buffer[i]++;
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK(BM_Counters_WorkingSet)->MeasureWorkingSet();
+// Touching the buffer may take longer than %console_report allows.
+int dummy_ws_console =
+    WorkingSetCounters().empty()
+        ? AddCases(TC_ConsoleOut,
+                   {{"^BM_Counters_WorkingSet +%hrfloat ns +%hrfloat ns "
+                     "+%int$"}})
+        : AddCases(TC_ConsoleOut,
+                   {{"^BM_Counters_WorkingSet +%hrfloat ns +%hrfloat ns "
+                     "+%int (ws_accessed=%hrfloat )?ws_written=%hrfloat$"}});
+int dummy_ws_csv =
+    AddCases(TC_CSVOut, {{CSVRow("BM_Counters_WorkingSet", "%csv_report",
+                                 WorkingSetCounters())}});
+
+// The pass writes every page of the buffer once.
+void CheckWorkingSet(Results const& e) {
+  CHECK_COUNTER_VALUE(e, double, "ws_written", GE, kWorkingSetBytes);
+}
+size_t dummy_ws_check =
+    WorkingSetCounters().empty()
+        ? 0
+        : AddChecker("BM_Counters_WorkingSet", &CheckWorkingSet);
+
+// ========================================================================= //
+// --------------------------- TEST CASES END ------------------------------ //
+// ========================================================================= //
+
+int main(int argc, char* argv[]) { RunOutputTests(argc, argv); }
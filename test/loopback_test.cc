@@ -0,0 +1,52 @@
+
+#include "benchmark/loopback.h"
+
+#include <cassert>
+#include <chrono>
+#include <string>
+
+template <benchmark::LoopbackTransport Transport, int LatencyUs = 0>
+class Echo : public ::benchmark::LoopbackFixture {
+ public:
+  Echo() : LoopbackFixture(Transport, Shape()) {}
+
+  static benchmark::LinkShape Shape() {
+    benchmark::LinkShape shape;
+    shape.latency = LatencyUs * 1e-6;
+    return shape;
+  }
+
+  void Exchange(benchmark::State& st) {
+    const std::string request(st.range(0), 'x');
+    std::string response;
+    for (auto _ : st) {
+      auto start = std::chrono::steady_clock::now();
+      if (!Call(st, request, &response)) break;
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      assert(response == request);
+      // The request and the response are both delayed.
+      assert(elapsed.count() >= 2 * Shape().latency);
+      ((void)elapsed);
+    }
+    st.SetItemsProcessed(st.iterations());
+  }
+};
+
+BENCHMARK_TEMPLATE_DEFINE_F(Echo, SocketPair, benchmark::kSocketPair)
+(benchmark::State& st) { this->Exchange(st); }
+BENCHMARK_REGISTER_F(Echo, SocketPair)->Arg(16)->Arg(1 << 20)->Threads(2);
+
+BENCHMARK_TEMPLATE_DEFINE_F(Echo, UnixSocket, benchmark::kUnixSocket)
+(benchmark::State& st) { this->Exchange(st); }
+BENCHMARK_REGISTER_F(Echo, UnixSocket)->Arg(16)->Threads(1)->Threads(2);
+
+BENCHMARK_TEMPLATE_DEFINE_F(Echo, TcpSocket, benchmark::kTcpSocket)
+(benchmark::State& st) { this->Exchange(st); }
+BENCHMARK_REGISTER_F(Echo, TcpSocket)->Arg(16)->Threads(1)->Threads(2);
+
+BENCHMARK_TEMPLATE_DEFINE_F(Echo, Shaped, benchmark::kTcpSocket, 100)
+(benchmark::State& st) { this->Exchange(st); }
+BENCHMARK_REGISTER_F(Echo, Shaped)->Arg(16)->Arg(1 << 20)->Threads(2);
+
+BENCHMARK_MAIN();
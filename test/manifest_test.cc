@@ -0,0 +1,67 @@
+//===---------------------------------------------------------------------===//
+// manifest_test - Unit tests for src/manifest.cc
+//===---------------------------------------------------------------------===//
+
+#include <sstream>
+
+#include "../src/manifest.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+benchmark::PlannedRun MakeRun(const std::string& name, size_t iterations,
+                              uint64_t seed, std::vector<int> cpus) {
+  benchmark::PlannedRun run;
+  run.name = name;
+  run.iterations = iterations;
+  run.seed = seed;
+  run.cpus = cpus;
+  return run;
+}
+
+bool Read(const std::string& text, benchmark::Manifest* manifest,
+          std::string* error) {
+  std::istringstream in(text);
+  return benchmark::ReadManifest(in, manifest, error);
+}
+
+TEST(ManifestTest, RoundTrip) {
+  benchmark::Manifest manifest;
+  manifest.flags.push_back(std::make_pair("benchmark_min_time", "0.5"));
+  manifest.flags.push_back(std::make_pair("benchmark_allocator", ""));
+  manifest.runs.push_back(MakeRun("BM_a/8", 1000, 18446744073709551615ull,
+                                  {3}));
+  manifest.runs.push_back(MakeRun("BM_b/threads:2", 7, 42, {0, -1}));
+  manifest.runs.push_back(MakeRun("BM a b", 1, 0, {}));
+  std::ostringstream out;
+  benchmark::WriteManifest(out, manifest);
+
+  benchmark::Manifest read;
+  std::string error;
+  ASSERT_TRUE(Read(out.str(), &read, &error)) << error;
+  EXPECT_EQ(read.flags, manifest.flags);
+  ASSERT_EQ(read.runs.size(), manifest.runs.size());
+  for (size_t i = 0; i < read.runs.size(); ++i) {
+    EXPECT_EQ(read.runs[i].name, manifest.runs[i].name);
+    EXPECT_EQ(read.runs[i].iterations, manifest.runs[i].iterations);
+    EXPECT_EQ(read.runs[i].seed, manifest.runs[i].seed);
+    EXPECT_EQ(read.runs[i].cpus, manifest.runs[i].cpus);
+  }
+}
+
+TEST(ManifestTest, Malformed) {
+  benchmark::Manifest manifest;
+  std::string error;
+  EXPECT_FALSE(Read("", &manifest, &error));
+  EXPECT_FALSE(Read("benchmark_manifest\t2\n", &manifest, &error));
+  EXPECT_FALSE(Read("run\tBM_a\t1\t0\t0\n", &manifest, &error));
+  EXPECT_FALSE(
+      Read("benchmark_manifest\t1\nrun\tBM_a\t0\t0\t0\n", &manifest, &error));
+  EXPECT_FALSE(
+      Read("benchmark_manifest\t1\nrun\tBM_a\t1\t0\tx\n", &manifest, &error));
+  EXPECT_FALSE(
+      Read("benchmark_manifest\t1\nrun\tBM_a\t1\n", &manifest, &error));
+  EXPECT_EQ(error, "line 2 is malformed: 'run\tBM_a\t1'");
+}
+
+}  // end namespace
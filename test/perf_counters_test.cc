@@ -0,0 +1,262 @@
+//===---------------------------------------------------------------------===//
+// perf_counters_test - Unit tests for src/perf_counters.cc
+//===---------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#include "../src/perf_counters.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+// A fake PMU in sysfs, with the top-down events of a Skylake CPU.
+class FakePMU : public ::testing::Test {
+ protected:
+  void SetUp() {
+    char dir[] = "/tmp/perf_counters_test.XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != nullptr);
+    dir_ = dir;
+    Mkdir(dir_ + "/events");
+    Mkdir(dir_ + "/format");
+    Write("type", "4");
+    Write("format/event", "config:0-7");
+    Write("format/umask", "config:8-15");
+    Write("format/any", "config:21");
+    Write("format/cmask", "config:24-31");
+    Write("events/topdown-total-slots", "event=0x3c,umask=0x0,any=1");
+    Write("events/topdown-total-slots.scale", "2");
+    Write("events/topdown-slots-issued", "event=0xe,umask=0x1");
+    Write("events/topdown-slots-retired", "event=0xc2,umask=0x2");
+    Write("events/topdown-fetch-bubbles", "event=0x9c,umask=0x1");
+    Write("events/topdown-recovery-bubbles",
+          "event=0xd,umask=0x3,any=1,cmask=1");
+    Write("events/topdown-recovery-bubbles.scale", "4");
+  }
+
+  void TearDown() {
+    std::system(("rm -rf " + dir_).c_str());
+  }
+
+  void Mkdir(const std::string& path) {
+    ASSERT_EQ(std::system(("mkdir " + path).c_str()), 0);
+  }
+
+  void Write(const std::string& name, const std::string& contents) {
+    std::ofstream f((dir_ + "/" + name).c_str());
+    f << contents << "\n";
+  }
+
+  std::string dir_;
+};
+
+TEST_F(FakePMU, LoadTopdownEvents) {
+  benchmark::internal::TopdownEvents events;
+  std::string error;
+  ASSERT_TRUE(benchmark::internal::LoadTopdownEvents(dir_, &events, &error))
+      << error;
+  EXPECT_EQ(events.type, 4u);
+  EXPECT_EQ(events.config[0], 0x20003cu);
+  EXPECT_EQ(events.config[1], 0x10eu);
+  EXPECT_EQ(events.config[2], 0x2c2u);
+  EXPECT_EQ(events.config[3], 0x19cu);
+  EXPECT_EQ(events.config[4], 0x120030du);
+  EXPECT_EQ(events.scale[0], 2);
+  EXPECT_EQ(events.scale[1], 1);
+  EXPECT_EQ(events.scale[4], 4);
+}
+
+TEST_F(FakePMU, SplitFormat) {
+  Write("format/umask", "config:8-11,32-35");
+  benchmark::internal::TopdownEvents events;
+  std::string error;
+  Write("events/topdown-slots-issued", "event=0xe,umask=0xa5");
+  ASSERT_TRUE(benchmark::internal::LoadTopdownEvents(dir_, &events, &error))
+      << error;
+  EXPECT_EQ(events.config[1], 0xa0000050eu);
+}
+
+TEST_F(FakePMU, MissingEvent) {
+  std::remove((dir_ + "/events/topdown-fetch-bubbles").c_str());
+  benchmark::internal::TopdownEvents events;
+  std::string error;
+  EXPECT_FALSE(benchmark::internal::LoadTopdownEvents(dir_, &events, &error));
+  EXPECT_NE(error.find("top-down events"), std::string::npos);
+}
+
+TEST_F(FakePMU, UnknownTerm) {
+  Write("events/topdown-slots-retired", "event=0xc2,period=2000003");
+  benchmark::internal::TopdownEvents events;
+  std::string error;
+  EXPECT_FALSE(benchmark::internal::LoadTopdownEvents(dir_, &events, &error));
+  EXPECT_NE(error.find("period=2000003"), std::string::npos);
+}
+
+// A fake PMU with the perf metrics of an Ice Lake CPU.
+class FakePerfMetricsPMU : public FakePMU {
+ protected:
+  void SetUp() {
+    FakePMU::SetUp();
+    Write("events/slots", "event=0x00,umask=0x4");
+    Write("events/topdown-retiring", "event=0x00,umask=0x80");
+    Write("events/topdown-bad-spec", "event=0x00,umask=0x81");
+    Write("events/topdown-fe-bound", "event=0x00,umask=0x82");
+    Write("events/topdown-be-bound", "event=0x00,umask=0x83");
+  }
+
+  // Add the level 2 metrics of a Sapphire Rapids CPU.
+  void AddLevel2() {
+    Write("events/topdown-heavy-ops", "event=0x00,umask=0x84");
+    Write("events/topdown-br-mispredict", "event=0x00,umask=0x85");
+    Write("events/topdown-fetch-lat", "event=0x00,umask=0x86");
+    Write("events/topdown-mem-bound", "event=0x00,umask=0x87");
+  }
+};
+
+TEST_F(FakePerfMetricsPMU, Level1) {
+  benchmark::internal::TopdownEvents events;
+  std::string error;
+  ASSERT_TRUE(benchmark::internal::LoadTopdownEvents(dir_, &events, &error))
+      << error;
+  EXPECT_EQ(events.set, benchmark::internal::kTopdownPerfMetrics);
+  ASSERT_EQ(events.num_events, 5);
+  EXPECT_EQ(events.config[0], 0x400u);
+  EXPECT_EQ(events.config[1], 0x8000u);
+  EXPECT_EQ(events.config[4], 0x8300u);
+  EXPECT_EQ(events.scale[0], 1);
+}
+
+TEST_F(FakePerfMetricsPMU, Level2) {
+  AddLevel2();
+  benchmark::internal::TopdownEvents events;
+  std::string error;
+  ASSERT_TRUE(benchmark::internal::LoadTopdownEvents(dir_, &events, &error))
+      << error;
+  EXPECT_EQ(events.set, benchmark::internal::kTopdownPerfMetrics);
+  ASSERT_EQ(events.num_events, 9);
+  EXPECT_EQ(events.config[5], 0x8400u);
+  EXPECT_EQ(events.config[8], 0x8700u);
+}
+
+TEST_F(FakePerfMetricsPMU, PartialLevel2) {
+  AddLevel2();
+  std::remove((dir_ + "/events/topdown-mem-bound").c_str());
+  benchmark::internal::TopdownEvents events;
+  std::string error;
+  ASSERT_TRUE(benchmark::internal::LoadTopdownEvents(dir_, &events, &error))
+      << error;
+  EXPECT_EQ(events.num_events, 5);
+}
+
+TEST_F(FakePerfMetricsPMU, FallBackToLegacy) {
+  std::remove((dir_ + "/events/slots").c_str());
+  benchmark::internal::TopdownEvents events;
+  std::string error;
+  ASSERT_TRUE(benchmark::internal::LoadTopdownEvents(dir_, &events, &error))
+      << error;
+  EXPECT_EQ(events.set, benchmark::internal::kTopdownLegacySlots);
+  EXPECT_EQ(events.num_events, 5);
+  EXPECT_EQ(events.config[0], 0x20003cu);
+}
+
+TEST(TopdownCountsTest, LegacySlots) {
+  benchmark::internal::TopdownEvents events;
+  events.set = benchmark::internal::kTopdownLegacySlots;
+  events.num_events = 5;
+  // Total, issued, retired, fetch bubbles and recovery bubbles.
+  const double slots[] = {1000, 600, 500, 200, 50};
+  benchmark::TopdownCounts counts;
+  benchmark::internal::AddTopdownSlots(events, slots, &counts);
+  EXPECT_DOUBLE_EQ(counts.frontend_bound(), 0.2);
+  EXPECT_DOUBLE_EQ(counts.bad_speculation(), 0.15);
+  EXPECT_DOUBLE_EQ(counts.retiring(), 0.5);
+  EXPECT_DOUBLE_EQ(counts.backend_bound(), 0.15);
+  benchmark::TopdownCounts sum = counts;
+  sum += counts;
+  EXPECT_DOUBLE_EQ(sum.total_slots, 2000);
+  EXPECT_DOUBLE_EQ(sum.retiring(), 0.5);
+}
+
+TEST(TopdownCountsTest, PerfMetrics) {
+  benchmark::internal::TopdownEvents events;
+  events.set = benchmark::internal::kTopdownPerfMetrics;
+  events.num_events = 9;
+  // Slots, retiring, bad speculation, frontend, backend, then heavy
+  // operations, branch mispredicts, fetch latency and memory bound.
+  const double slots[] = {1000, 400, 100, 200, 300, 100, 80, 150, 200};
+  benchmark::TopdownCounts counts;
+  benchmark::internal::AddTopdownSlots(events, slots, &counts);
+  EXPECT_DOUBLE_EQ(counts.retiring(), 0.4);
+  EXPECT_DOUBLE_EQ(counts.bad_speculation(), 0.1);
+  EXPECT_DOUBLE_EQ(counts.frontend_bound(), 0.2);
+  EXPECT_DOUBLE_EQ(counts.backend_bound(), 0.3);
+  EXPECT_DOUBLE_EQ(counts.heavy_operations(), 0.1);
+  EXPECT_DOUBLE_EQ(counts.light_operations(), 0.3);
+  EXPECT_DOUBLE_EQ(counts.branch_mispredicts(), 0.08);
+  EXPECT_DOUBLE_EQ(counts.machine_clears(), 0.02);
+  EXPECT_DOUBLE_EQ(counts.fetch_latency(), 0.15);
+  EXPECT_DOUBLE_EQ(counts.fetch_bandwidth(), 0.05);
+  EXPECT_DOUBLE_EQ(counts.memory_bound(), 0.2);
+  EXPECT_DOUBLE_EQ(counts.core_bound(), 0.1);
+}
+
+TEST(PerfCounterTest, IsValidEvent) {
+  EXPECT_TRUE(benchmark::PerfCounter::IsValidEvent("instructions"));
+  EXPECT_TRUE(benchmark::PerfCounter::IsValidEvent("cycles"));
+  EXPECT_TRUE(benchmark::PerfCounter::IsValidEvent("page-faults"));
+  EXPECT_FALSE(benchmark::PerfCounter::IsValidEvent("time"));
+  EXPECT_FALSE(benchmark::PerfCounter::IsValidEvent("Instructions"));
+  EXPECT_FALSE(benchmark::PerfCounter::IsValidEvent(""));
+}
+
+TEST(PerfEventRampUpTest, Converged) {
+  using benchmark::internal::PerfEventCountConverged;
+  const double kMin = benchmark::internal::kMinPerfEventCount;
+  EXPECT_TRUE(PerfEventCountConverged(kMin, 1000, 1000));
+  EXPECT_TRUE(PerfEventCountConverged(kMin, 1009, 1000));
+  EXPECT_TRUE(PerfEventCountConverged(kMin, 991, 1000));
+  // Too few events, or too far from the previous run.
+  EXPECT_FALSE(PerfEventCountConverged(kMin / 2, 1000, 1000));
+  EXPECT_FALSE(PerfEventCountConverged(kMin, 1020, 1000));
+  // There is no previous run.
+  EXPECT_FALSE(PerfEventCountConverged(kMin, 1000, 0));
+}
+
+TEST(PerfEventRampUpTest, NextIterations) {
+  using benchmark::internal::NextPerfEventIterations;
+  const double kMin = benchmark::internal::kMinPerfEventCount;
+  EXPECT_EQ(NextPerfEventIterations(10, 0), 0);
+  // Enough iterations to count the minimum with a margin.
+  EXPECT_DOUBLE_EQ(NextPerfEventIterations(10, 1000), kMin * 1.4 / 100);
+  EXPECT_DOUBLE_EQ(NextPerfEventIterations(1, kMin / 4), 5.6);
+  // The minimum was counted but had nothing to converge to.
+  EXPECT_DOUBLE_EQ(NextPerfEventIterations(10, kMin), 20);
+}
+
+// A benchmark whose iterations always count the same events converges on the
+// second run, whatever the first one counted.
+TEST(PerfEventRampUpTest, ConvergesInTwoRuns) {
+  using benchmark::internal::NextPerfEventIterations;
+  using benchmark::internal::PerfEventCountConverged;
+  for (double per_iter : {1.0, 37.0, 1e4, 1e7}) {
+    double iters = 1;
+    double prev_per_iter = 0;
+    int runs = 0;
+    for (;;) {
+      ++runs;
+      const double count = iters * per_iter;
+      if (PerfEventCountConverged(count, per_iter, prev_per_iter)) break;
+      prev_per_iter = per_iter;
+      iters = std::max(std::ceil(NextPerfEventIterations(iters, count)),
+                       iters + 1);
+      ASSERT_LT(runs, 10) << per_iter;
+    }
+    EXPECT_EQ(runs, 2) << per_iter;
+  }
+}
+
+}  // end namespace
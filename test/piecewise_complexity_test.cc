@@ -0,0 +1,88 @@
+//===---------------------------------------------------------------------===//
+// piecewise_complexity_test - Unit tests for the piecewise complexity fits
+// of src/complexity.cc
+//===---------------------------------------------------------------------===//
+
+#include "../src/complexity.h"
+#include "gtest/gtest.h"
+
+namespace {
+// The time per iteration, in ns: constant up to N = 1024, then linear.
+double StepTime(int n) { return n <= 1024 ? 10.0 : 10.0 + n / 100.0; }
+
+std::vector<benchmark::BenchmarkReporter::Run> StepRuns() {
+  std::vector<benchmark::BenchmarkReporter::Run> runs;
+  for (int n = 1 << 4; n <= 1 << 16; n *= 2) {
+    benchmark::BenchmarkReporter::Run run;
+    run.benchmark_name = "BM_Step/" + std::to_string(n);
+    run.iterations = 1000;
+    run.real_accumulated_time = StepTime(n) * 1e-9 * 1000;
+    run.cpu_accumulated_time = run.real_accumulated_time;
+    run.complexity = benchmark::oAuto;
+    run.complexity_n = n;
+    runs.push_back(run);
+  }
+  return runs;
+}
+
+TEST(FindComplexitySegmentsTest, SingleCurve) {
+  std::vector<int> n;
+  std::vector<double> time;
+  for (int i = 1; i <= 12; ++i) {
+    n.push_back(1 << i);
+    time.push_back((1 << i) * 3e-9);
+  }
+  EXPECT_TRUE(benchmark::FindComplexitySegments(n, time, benchmark::oAuto,
+                                                nullptr)
+                  .empty());
+}
+
+TEST(FindComplexitySegmentsTest, Step) {
+  std::vector<int> n;
+  std::vector<double> time;
+  for (const auto& run : StepRuns()) {
+    n.push_back(run.complexity_n);
+    time.push_back(run.cpu_accumulated_time / run.iterations);
+  }
+  const std::vector<size_t> segments =
+      benchmark::FindComplexitySegments(n, time, benchmark::oAuto, nullptr);
+  ASSERT_FALSE(segments.empty());
+  // The first segment ends at the last constant point, N = 1024.
+  EXPECT_EQ(n[segments[0] - 1], 1024);
+}
+
+TEST(ComputePiecewiseBigOTest, Automatic) {
+  const std::vector<benchmark::BenchmarkReporter::Run> results =
+      benchmark::ComputePiecewiseBigO(
+          StepRuns(), 0, std::vector<benchmark::CPUInfo::CacheInfo>());
+  ASSERT_GE(results.size(), 4u);
+  EXPECT_EQ(results[0].benchmark_name, "BM_Step_BigO[16-1024]");
+  EXPECT_TRUE(results[0].report_big_o);
+  EXPECT_EQ(results[0].complexity, benchmark::o1);
+  EXPECT_NEAR(results[0].cpu_accumulated_time, 10e-9, 1e-12);
+  EXPECT_EQ(results[1].benchmark_name, "BM_Step_RMS[16-1024]");
+  EXPECT_TRUE(results[1].report_rms);
+}
+
+TEST(ComputePiecewiseBigOTest, Caches) {
+  std::vector<benchmark::CPUInfo::CacheInfo> caches(3);
+  caches[0].type = "Data";
+  caches[0].level = 1;
+  caches[0].size = 1024 * 8;  // Up to N = 1024 with 8 bytes per N.
+  caches[1].type = "Instruction";
+  caches[1].level = 1;
+  caches[1].size = 1024 * 32;
+  caches[2].type = "Unified";
+  caches[2].level = 2;
+  caches[2].size = 8192 * 8;
+  const std::vector<benchmark::BenchmarkReporter::Run> results =
+      benchmark::ComputePiecewiseBigO(StepRuns(), 8, caches);
+  ASSERT_EQ(results.size(), 6u);
+  EXPECT_EQ(results[0].benchmark_name, "BM_Step_BigO[16-1024]");
+  EXPECT_EQ(results[0].report_label, "L1");
+  EXPECT_EQ(results[2].benchmark_name, "BM_Step_BigO[2048-8192]");
+  EXPECT_EQ(results[2].report_label, "L2");
+  EXPECT_EQ(results[4].benchmark_name, "BM_Step_BigO[16384-65536]");
+  EXPECT_EQ(results[4].report_label, "memory");
+}
+}  // end namespace
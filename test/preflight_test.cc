@@ -0,0 +1,83 @@
+//===---------------------------------------------------------------------===//
+// preflight_test - Unit tests for src/preflight.cc
+//===---------------------------------------------------------------------===//
+
+#include "../src/preflight.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+// A host which passes all the checks.
+benchmark::HostState TunedHost() {
+  benchmark::HostState host;
+  host.num_cpus = 16;
+  host.governors.push_back("performance");
+  host.turbo = "off";
+  host.smt = "off";
+  host.aslr = 0;
+  host.thp = "madvise";
+  host.swap_pages_per_second = 0;
+  host.load_average = 0.5;
+  host.cpu_quota = 0;
+  host.clocksource = "tsc";
+  host.mem_available = 8e9;
+  host.mem_total = 16e9;
+  return host;
+}
+
+const benchmark::PreflightCheck& FindCheck(
+    const std::vector<benchmark::PreflightCheck>& checks,
+    const std::string& name) {
+  for (const auto& check : checks)
+    if (check.name == name) return check;
+  ADD_FAILURE() << "no check named " << name;
+  return checks.front();
+}
+
+TEST(CheckHostStateTest, TunedHostPasses) {
+  const auto checks = benchmark::CheckHostState(TunedHost());
+  EXPECT_EQ(checks.size(), 10u);
+  for (const auto& check : checks) EXPECT_TRUE(check.ok) << check.name;
+  EXPECT_EQ(FindCheck(checks, "governor").value, "performance");
+  EXPECT_EQ(FindCheck(checks, "cgroup_quota").value, "none");
+}
+
+TEST(CheckHostStateTest, UnknownValuesPass) {
+  benchmark::HostState host;
+  host.num_cpus = 4;
+  for (const auto& check : benchmark::CheckHostState(host)) {
+    EXPECT_TRUE(check.ok) << check.name;
+    EXPECT_EQ(check.value, "unknown") << check.name;
+  }
+}
+
+TEST(CheckHostStateTest, MisconfiguredHostFails) {
+  benchmark::HostState host = TunedHost();
+  host.governors.push_back("powersave");
+  host.turbo = "on";
+  host.smt = "on";
+  host.aslr = 2;
+  host.thp = "always";
+  host.swap_pages_per_second = 20;
+  host.load_average = 3;
+  host.cpu_quota = 2;
+  host.clocksource = "hpet";
+  host.mem_available = 1e9;
+  const auto checks = benchmark::CheckHostState(host);
+  for (const auto& check : checks) EXPECT_FALSE(check.ok) << check.name;
+  EXPECT_EQ(FindCheck(checks, "governor").value, "performance,powersave");
+  EXPECT_EQ(FindCheck(checks, "cgroup_quota").value, "2.00 CPUs");
+  EXPECT_EQ(FindCheck(checks, "cgroup_quota").expected, "none or >= 16 CPUs");
+  EXPECT_EQ(FindCheck(checks, "load_average").expected, "< 1.60");
+}
+
+TEST(CheckHostStateTest, LoadAverageOnSmallHost) {
+  benchmark::HostState host = TunedHost();
+  host.num_cpus = 2;
+  host.load_average = 0.9;
+  EXPECT_TRUE(FindCheck(benchmark::CheckHostState(host), "load_average").ok);
+  host.load_average = 1.1;
+  EXPECT_FALSE(FindCheck(benchmark::CheckHostState(host), "load_average").ok);
+}
+
+}  // end namespace
@@ -0,0 +1,78 @@
+
+#undef NDEBUG
+
+#include <chrono>
+#include <fstream>
+#include <thread>
+
+#include "benchmark/benchmark.h"
+#include "output_test.h"
+
+// Run with --benchmark_report_schedstat=true.
+
+// The kernel only exports scheduler statistics with CONFIG_SCHED_INFO; the
+// counters are not reported without them.
+bool HasSchedStat() {
+  std::ifstream f("/proc/self/schedstat");
+  return f.good();
+}
+
+// ========================================================================= //
+// ---------------------- Testing Prologue Output -------------------------- //
+// ========================================================================= //
+
+ADD_CASES(TC_ConsoleOut,
+          {{"^[-]+$", MR_Next},
+           {"^Benchmark %s Time %s CPU %s Iterations UserCounters...$", MR_Next},
+           {"^[-]+$", MR_Next}});
+// The columns are there even if the counters are not reported.
+ADD_CASES(TC_CSVOut, {{"^%csv_header,\"off_cpu\",\"sched_wait\"$"}});
+
+// ========================================================================= //
+// ------------------------ Off-CPU Time Output ---------------------------- //
+// ========================================================================= //
+
+// Each iteration spends about a millisecond off the CPU, asleep.
+void BM_Sleep(benchmark::State& state) {
+  for (auto _ : state) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+BENCHMARK(BM_Sleep)->Iterations(10)->UseRealTime();
+
+int dummy_console = HasSchedStat()
+    ? AddCases(TC_ConsoleOut,
+               {{"^BM_Sleep/iterations:10/real_time .* "
+                 "off_cpu=%hrfloat sched_wait=%hrfloat$"}})
+    : AddCases(TC_ConsoleOut, {{"^BM_Sleep/iterations:10/real_time .*ns "
+                                "[ ]*10$"}});
+int dummy_json = HasSchedStat()
+    ? AddCases(TC_JSONOut,
+               {{"\"name\": \"BM_Sleep/iterations:10/real_time\",$"},
+                {"\"iterations\": 10,$", MR_Next},
+                {"\"real_time\": %float,$", MR_Next},
+                {"\"cpu_time\": %float,$", MR_Next},
+                {"\"time_unit\": \"ns\",$", MR_Next},
+                {"\"off_cpu\": %float,$", MR_Next},
+                {"\"sched_wait\": %float$", MR_Next},
+                {"}", MR_Next}})
+    : 0;
+int dummy_csv = HasSchedStat()
+    ? AddCases(TC_CSVOut, {{"^\"BM_Sleep/iterations:10/real_time\","
+                            "%csv_report,%float,%float$"}})
+    : AddCases(TC_CSVOut, {{"^\"BM_Sleep/iterations:10/real_time\","
+                            "%csv_report,,$"}});
+
+void CheckSleep(Results const& e) {
+  CHECK_COUNTER_VALUE(e, double, "off_cpu", GE, 0.0005);
+  CHECK_COUNTER_VALUE(e, double, "sched_wait", GE, 0);
+}
+size_t dummy_check = HasSchedStat()
+    ? AddChecker("BM_Sleep/iterations:10/real_time", &CheckSleep)
+    : 0;
+
+// ========================================================================= //
+// --------------------------- TEST CASES END ------------------------------ //
+// ========================================================================= //
+
+int main(int argc, char* argv[]) { RunOutputTests(argc, argv); }
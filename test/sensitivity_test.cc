@@ -0,0 +1,89 @@
+//===---------------------------------------------------------------------===//
+// sensitivity_test - Unit tests for src/sensitivity.cc
+//===---------------------------------------------------------------------===//
+
+#include <cmath>
+
+#include "../src/sensitivity.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+typedef std::vector<std::vector<int> > Configs;
+
+TEST(AnalyzeSensitivityTest, MainEffectsOnly) {
+  // The time doubles with the first parameter and triples with the second.
+  Configs configs;
+  std::vector<double> times;
+  for (int a = 0; a < 2; ++a) {
+    for (int b = 0; b < 2; ++b) {
+      configs.push_back({a, b});
+      times.push_back(std::pow(2.0, a) * std::pow(3.0, b) * 1e-6);
+    }
+  }
+  const benchmark::Sensitivity s =
+      benchmark::AnalyzeSensitivity(configs, times);
+  const double ln2 = std::log(2.0), ln3 = std::log(3.0);
+  ASSERT_EQ(s.main_effects.size(), 2u);
+  EXPECT_NEAR(s.main_effects[0], ln2 * ln2 / (ln2 * ln2 + ln3 * ln3), 1e-9);
+  EXPECT_NEAR(s.main_effects[1], ln3 * ln3 / (ln2 * ln2 + ln3 * ln3), 1e-9);
+  EXPECT_NEAR(s.interactions, 0.0, 1e-9);
+  EXPECT_NEAR(s.noise, 0.0, 1e-9);
+  EXPECT_EQ(s.best, std::vector<int>({0, 0}));
+  EXPECT_NEAR(s.best_time, 1e-6, 1e-15);
+  // The model fits exactly, so the interval is empty.
+  ASSERT_TRUE(s.has_ci);
+  EXPECT_NEAR(s.ci_low, 1e-6, 1e-12);
+  EXPECT_NEAR(s.ci_high, 1e-6, 1e-12);
+}
+
+TEST(AnalyzeSensitivityTest, InteractionOnly) {
+  Configs configs;
+  std::vector<double> times;
+  for (int a = 0; a < 2; ++a) {
+    for (int b = 0; b < 2; ++b) {
+      configs.push_back({a, b});
+      times.push_back(a == b ? 1.0 : 4.0);
+    }
+  }
+  const benchmark::Sensitivity s =
+      benchmark::AnalyzeSensitivity(configs, times);
+  EXPECT_NEAR(s.main_effects[0], 0.0, 1e-9);
+  EXPECT_NEAR(s.main_effects[1], 0.0, 1e-9);
+  EXPECT_NEAR(s.interactions, 1.0, 1e-9);
+  EXPECT_NEAR(s.best_time, 1.0, 1e-9);
+}
+
+TEST(AnalyzeSensitivityTest, RepetitionsGiveNoise) {
+  Configs configs;
+  std::vector<double> times;
+  for (int a = 0; a < 3; ++a) {
+    for (int rep = 0; rep < 4; ++rep) {
+      configs.push_back({a, 7});
+      times.push_back((a + 1) * (rep % 2 == 0 ? 1.1 : 0.9));
+    }
+  }
+  const benchmark::Sensitivity s =
+      benchmark::AnalyzeSensitivity(configs, times);
+  EXPECT_GT(s.main_effects[0], 0.9);
+  // The second parameter never changes.
+  EXPECT_NEAR(s.main_effects[1], 0.0, 1e-9);
+  EXPECT_GT(s.noise, 0.0);
+  EXPECT_NEAR(s.main_effects[0] + s.interactions + s.noise, 1.0, 1e-9);
+  EXPECT_EQ(s.best, std::vector<int>({0, 7}));
+  ASSERT_TRUE(s.has_ci);
+  EXPECT_LT(s.ci_low, s.best_time);
+  EXPECT_GT(s.ci_high, s.best_time);
+}
+
+TEST(AnalyzeSensitivityTest, NoErrorEstimate) {
+  // Two configurations differing in one parameter fit the model exactly,
+  // with no degree of freedom left to estimate the error.
+  const benchmark::Sensitivity s =
+      benchmark::AnalyzeSensitivity({{1}, {2}}, {2.0, 1.0});
+  EXPECT_NEAR(s.main_effects[0], 1.0, 1e-9);
+  EXPECT_EQ(s.best, std::vector<int>({2}));
+  EXPECT_FALSE(s.has_ci);
+}
+
+}  // end namespace
@@ -58,4 +58,22 @@ TEST(StatisticsTest, StdDev) {
   }
 }
 
+TEST(StatisticsTest, RatioOfMeansCI95) {
+  {
+    // Single values are exact.
+    double Res = benchmark::RatioOfMeansCI95({10}, {5});
+    EXPECT_DOUBLE_EQ(Res, 0.0);
+  }
+  {
+    double Res = benchmark::RatioOfMeansCI95({10, 10, 10}, {5, 5, 5});
+    EXPECT_DOUBLE_EQ(Res, 0.0);
+  }
+  {
+    // The relative standard error is sqrt(2) / 10 / sqrt(2) = 0.1, with one
+    // degree of freedom.
+    double Res = benchmark::RatioOfMeansCI95({9, 11}, {5});
+    EXPECT_NEAR(Res, 12.706 * 2 * 0.1, 1e-9);
+  }
+}
+
 }  // end namespace
@@ -0,0 +1,91 @@
+//===---------------------------------------------------------------------===//
+// suspicious_test - Unit tests for src/suspicious.cc
+//===---------------------------------------------------------------------===//
+
+#include "../src/suspicious.h"
+#include "gtest/gtest.h"
+
+namespace {
+benchmark::TrialRun MakeRun(double iterations, double seconds,
+                            double events = -1) {
+  benchmark::TrialRun run;
+  run.iterations = iterations;
+  run.seconds = seconds;
+  run.events = events;
+  return run;
+}
+
+TEST(CheckLinearityTest, Linear) {
+  std::vector<benchmark::TrialRun> runs;
+  runs.push_back(MakeRun(1, 2e-6));
+  runs.push_back(MakeRun(1000, 1e-3));
+  runs.push_back(MakeRun(10000, 11e-3));
+  runs.push_back(MakeRun(100000, 0.09));
+  runs.push_back(MakeRun(100000, 0.1));
+  EXPECT_EQ(benchmark::CheckLinearity(runs), "");
+}
+
+TEST(CheckLinearityTest, IgnoresShortRuns) {
+  // Most of the cost of the first run is a one-time overhead, but the run is
+  // too short to say.
+  std::vector<benchmark::TrialRun> runs;
+  runs.push_back(MakeRun(10, 20e-6));
+  runs.push_back(MakeRun(100000, 0.1));
+  EXPECT_EQ(benchmark::CheckLinearity(runs), "");
+}
+
+TEST(CheckLinearityTest, CachedResult) {
+  // The first iteration does all the work.
+  std::vector<benchmark::TrialRun> runs;
+  runs.push_back(MakeRun(1, 1e-3));
+  runs.push_back(MakeRun(10, 1e-3));
+  runs.push_back(MakeRun(100, 1.1e-3));
+  EXPECT_NE(benchmark::CheckLinearity(runs), "");
+}
+
+TEST(CheckLinearityTest, Repetitions) {
+  std::vector<benchmark::TrialRun> runs;
+  runs.push_back(MakeRun(1000, 1e-3));
+  runs.push_back(MakeRun(1000, 0.3e-3));
+  EXPECT_NE(benchmark::CheckLinearity(runs), "");
+}
+
+TEST(CheckLinearityTest, Events) {
+  // The time is noisy enough to hide it, but the instructions are not.
+  std::vector<benchmark::TrialRun> runs;
+  runs.push_back(MakeRun(1000, 1e-3, 1e6));
+  runs.push_back(MakeRun(10000, 6e-3, 3e6));
+  EXPECT_NE(benchmark::CheckLinearity(runs), "");
+  runs[1].events = 9e6;
+  EXPECT_EQ(benchmark::CheckLinearity(runs), "");
+}
+
+TEST(CheckAgainstEmptyLoopTest, Time) {
+  const benchmark::TrialRun empty = MakeRun(1000000, 1e-3);
+  EXPECT_NE(benchmark::CheckAgainstEmptyLoop(MakeRun(100, 150e-9), empty, true,
+                                             false),
+            "");
+  EXPECT_EQ(benchmark::CheckAgainstEmptyLoop(MakeRun(100, 150e-9), empty, false,
+                                             false),
+            "");
+  EXPECT_EQ(benchmark::CheckAgainstEmptyLoop(MakeRun(100, 250e-9), empty, true,
+                                             false),
+            "");
+}
+
+TEST(CheckAgainstEmptyLoopTest, Events) {
+  const benchmark::TrialRun empty = MakeRun(1000000, 1e-3, 4e6);
+  EXPECT_NE(benchmark::CheckAgainstEmptyLoop(MakeRun(100, 1e-6, 500), empty,
+                                             false, true),
+            "");
+  EXPECT_EQ(benchmark::CheckAgainstEmptyLoop(MakeRun(100, 1e-6, 500), empty,
+                                             false, false),
+            "");
+  EXPECT_EQ(benchmark::CheckAgainstEmptyLoop(MakeRun(100, 1e-6, 1000), empty,
+                                             false, true),
+            "");
+  EXPECT_EQ(benchmark::CheckAgainstEmptyLoop(MakeRun(100, 1e-6), empty, false,
+                                             true),
+            "");
+}
+}  // end namespace
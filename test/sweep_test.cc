@@ -0,0 +1,159 @@
+//===---------------------------------------------------------------------===//
+// sweep_test - Unit tests for src/sweep.cc and for applying a sweep to the
+// registered benchmarks
+//===---------------------------------------------------------------------===//
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../src/benchmark_api_internal.h"
+#include "../src/sweep.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+typedef std::pair<int, int> Range;
+
+bool Read(const std::string& text, benchmark::Sweep* sweep,
+          std::string* error) {
+  std::istringstream in(text);
+  return benchmark::ReadSweep(in, sweep, error);
+}
+
+TEST(SweepTest, Settings) {
+  benchmark::Sweep sweep;
+  std::string error;
+  ASSERT_TRUE(Read("# A comment\n"
+                   "\n"
+                   "BM_a  args  8:1024,3\n"
+                   "BM_a  args  5,6\n"
+                   "BM_a  add_args  7,7\n"
+                   "BM_a  threads  1:8,16\n"
+                   "BM_b\tmin_time\t0.25\n"
+                   "BM_b repetitions 3\n",
+                   &sweep, &error))
+      << error;
+  ASSERT_EQ(sweep.size(), 2u);
+
+  const benchmark::FamilySweep& a = sweep["BM_a"];
+  ASSERT_EQ(a.args.size(), 2u);
+  EXPECT_EQ(a.args[0], benchmark::SweepArgs({Range(8, 1024), Range(3, 3)}));
+  EXPECT_EQ(a.args[1], benchmark::SweepArgs({Range(5, 5), Range(6, 6)}));
+  ASSERT_EQ(a.added_args.size(), 1u);
+  EXPECT_EQ(a.added_args[0], benchmark::SweepArgs({Range(7, 7), Range(7, 7)}));
+  EXPECT_EQ(a.threads, std::vector<Range>({Range(1, 8), Range(16, 16)}));
+  EXPECT_EQ(a.repetitions, 0);
+
+  const benchmark::FamilySweep& b = sweep["BM_b"];
+  EXPECT_TRUE(b.args.empty());
+  EXPECT_TRUE(b.threads.empty());
+  EXPECT_DOUBLE_EQ(b.min_time, 0.25);
+  EXPECT_EQ(b.repetitions, 3);
+}
+
+TEST(SweepTest, Malformed) {
+  benchmark::Sweep sweep;
+  std::string error;
+  EXPECT_FALSE(Read("BM_a args\n", &sweep, &error));
+  EXPECT_FALSE(Read("BM_a args 1 2\n", &sweep, &error));
+  EXPECT_FALSE(Read("BM_a args 8:1\n", &sweep, &error));
+  EXPECT_FALSE(Read("BM_a args 1,\n", &sweep, &error));
+  EXPECT_FALSE(Read("BM_a args 1,2\nBM_a add_args 3\n", &sweep, &error));
+  EXPECT_FALSE(Read("BM_a threads 0\n", &sweep, &error));
+  EXPECT_FALSE(Read("BM_a min_time 0\n", &sweep, &error));
+  EXPECT_FALSE(Read("BM_a repetitions x\n", &sweep, &error));
+  EXPECT_FALSE(Read("BM_a\nBM_a ranges 1:8\n", &sweep, &error));
+  EXPECT_EQ(error, "line 1 is malformed: 'BM_a'");
+}
+
+void BM_Nop(benchmark::State& state) {
+  for (auto _ : state) {
+  }
+}
+
+// Registers benchmarks of its own, and removes them again.
+class ApplySweepTest : public ::testing::Test {
+ protected:
+  void SetUp() { benchmark::ClearRegisteredBenchmarks(); }
+  void TearDown() { benchmark::ClearRegisteredBenchmarks(); }
+
+  std::vector<std::string> InstanceNames() {
+    std::vector<benchmark::internal::Benchmark::Instance> instances;
+    std::ostringstream err;
+    EXPECT_TRUE(
+        benchmark::internal::FindBenchmarksInternal(".", &instances, &err));
+    std::vector<std::string> names;
+    for (const auto& instance : instances) names.push_back(instance.name);
+    return names;
+  }
+
+  bool Apply(const std::string& text, std::string* err) {
+    benchmark::Sweep sweep;
+    std::string error;
+    EXPECT_TRUE(Read(text, &sweep, &error)) << error;
+    std::ostringstream err_stream;
+    const bool ok = benchmark::internal::ApplySweepInternal(sweep, &err_stream);
+    *err = err_stream.str();
+    return ok;
+  }
+};
+
+TEST_F(ApplySweepTest, OverridesTheSettings) {
+  benchmark::RegisterBenchmark("BM_a", &BM_Nop)->Args({1, 2})->Threads(4);
+  benchmark::RegisterBenchmark("BM_b", &BM_Nop)->Arg(1)->Repetitions(5);
+  std::string err;
+  ASSERT_TRUE(Apply("BM_a args 8:16,3\n"
+                    "BM_a add_args 7,7\n"
+                    "BM_a threads 1:2\n"
+                    "BM_b min_time 0.25\n"
+                    "BM_b repetitions 3\n",
+                    &err));
+  EXPECT_EQ(err, "");
+  EXPECT_EQ(InstanceNames(),
+            std::vector<std::string>(
+                {"BM_a/8/3/threads:1", "BM_a/8/3/threads:2",
+                 "BM_a/16/3/threads:1", "BM_a/16/3/threads:2",
+                 "BM_a/7/7/threads:1", "BM_a/7/7/threads:2",
+                 "BM_b/1/min_time:0.250/repeats:3"}));
+
+  std::vector<benchmark::internal::Benchmark::Instance> instances;
+  std::ostringstream find_err;
+  ASSERT_TRUE(benchmark::internal::FindBenchmarksInternal("BM_b", &instances,
+                                                          &find_err));
+  ASSERT_EQ(instances.size(), 1u);
+  EXPECT_DOUBLE_EQ(instances[0].min_time, 0.25);
+  EXPECT_EQ(instances[0].repetitions, 3);
+  EXPECT_EQ(instances[0].threads, 1);
+}
+
+TEST_F(ApplySweepTest, UnknownFamily) {
+  benchmark::RegisterBenchmark("BM_a", &BM_Nop)->Arg(1);
+  std::string err;
+  EXPECT_TRUE(Apply("BM_z repetitions 3\n", &err));
+  EXPECT_NE(err.find("BM_z is not registered"), std::string::npos);
+  EXPECT_EQ(InstanceNames(), std::vector<std::string>({"BM_a/1"}));
+}
+
+TEST_F(ApplySweepTest, ArgumentCountMismatch) {
+  benchmark::RegisterBenchmark("BM_a", &BM_Nop)->Args({1, 2});
+  benchmark::RegisterBenchmark("BM_b", &BM_Nop)
+      ->ArgNames({"n", "m"})
+      ->Args({1, 2});
+  std::string err;
+  // The added arguments do not match the registered ones.
+  EXPECT_FALSE(Apply("BM_a add_args 1\n", &err));
+  EXPECT_EQ(err, "The sweep of BM_a has 1 arguments but it takes 2.\n");
+  // The replaced arguments do not match the names of the arguments. The
+  // families are left as they were registered, including those swept
+  // before the one which failed.
+  EXPECT_FALSE(Apply("BM_a args 3\n"
+                     "BM_a repetitions 2\n"
+                     "BM_b args 3\n",
+                     &err));
+  EXPECT_EQ(err, "The sweep of BM_b has 1 arguments but it takes 2.\n");
+  EXPECT_EQ(InstanceNames(),
+            std::vector<std::string>({"BM_a/1/2", "BM_b/n:1/m:2"}));
+}
+
+}  // end namespace
@@ -0,0 +1,145 @@
+//===---------------------------------------------------------------------===//
+// sysinfo_test - Unit tests for src/sysinfo.cc and the expansion of the
+// benchmarks by core type
+//===---------------------------------------------------------------------===//
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "../src/benchmark_api_internal.h"
+#include "../src/sysinfo.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+TEST(ParseCPUListTest, Valid) {
+  std::vector<int> cpus;
+  ASSERT_TRUE(benchmark::ParseCPUList("0-3,8,10-11", &cpus));
+  EXPECT_EQ(cpus, std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+  ASSERT_TRUE(benchmark::ParseCPUList("5", &cpus));
+  EXPECT_EQ(cpus, std::vector<int>({5}));
+}
+
+TEST(ParseCPUListTest, Invalid) {
+  std::vector<int> cpus;
+  EXPECT_FALSE(benchmark::ParseCPUList("", &cpus));
+  EXPECT_FALSE(benchmark::ParseCPUList("-1", &cpus));
+  EXPECT_FALSE(benchmark::ParseCPUList("3-1", &cpus));
+  EXPECT_FALSE(benchmark::ParseCPUList("1-", &cpus));
+  EXPECT_FALSE(benchmark::ParseCPUList("1x", &cpus));
+  EXPECT_FALSE(benchmark::ParseCPUList("1,,2", &cpus));
+}
+
+// An empty fake sysfs, which the tests fill with the files they need.
+class FakeSysfs : public ::testing::Test {
+ protected:
+  void SetUp() {
+    char dir[] = "/tmp/sysinfo_test.XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != nullptr);
+    dir_ = dir;
+  }
+
+  void TearDown() { std::system(("rm -rf " + dir_).c_str()); }
+
+  void Write(const std::string& path, const std::string& contents) {
+    const std::string file = dir_ + "/" + path;
+    ASSERT_EQ(std::system(("mkdir -p " + file.substr(0, file.rfind('/')))
+                              .c_str()),
+              0);
+    std::ofstream f(file.c_str());
+    f << contents << "\n";
+  }
+
+  std::string dir_;
+};
+
+TEST_F(FakeSysfs, HybridPMUs) {
+  Write("bus/event_source/devices/cpu_core/cpus", "0-3");
+  Write("bus/event_source/devices/cpu_atom/cpus", "4-7,10");
+  const std::vector<benchmark::CPUInfo::CoreType> types =
+      benchmark::internal::GetCoreTypes(dir_, 11);
+  ASSERT_EQ(types.size(), 2u);
+  EXPECT_EQ(types[0].name, "core");
+  EXPECT_EQ(types[0].cpus, std::vector<int>({0, 1, 2, 3}));
+  EXPECT_EQ(types[1].name, "atom");
+  EXPECT_EQ(types[1].cpus, std::vector<int>({4, 5, 6, 7, 10}));
+}
+
+TEST_F(FakeSysfs, CapacityGroups) {
+  const int kCapacities[] = {446, 1024, 446, 871, 1024, 446};
+  for (int cpu = 0; cpu < 6; ++cpu) {
+    Write("devices/system/cpu/cpu" + std::to_string(cpu) + "/cpu_capacity",
+          std::to_string(kCapacities[cpu]));
+  }
+  // A single hybrid PMU does not tell the types apart.
+  Write("bus/event_source/devices/cpu_core/cpus", "0-5");
+  const std::vector<benchmark::CPUInfo::CoreType> types =
+      benchmark::internal::GetCoreTypes(dir_, 6);
+  ASSERT_EQ(types.size(), 3u);
+  EXPECT_EQ(types[0].name, "capacity_1024");
+  EXPECT_EQ(types[0].cpus, std::vector<int>({1, 4}));
+  EXPECT_EQ(types[1].name, "capacity_871");
+  EXPECT_EQ(types[1].cpus, std::vector<int>({3}));
+  EXPECT_EQ(types[2].name, "capacity_446");
+  EXPECT_EQ(types[2].cpus, std::vector<int>({0, 2, 5}));
+}
+
+TEST_F(FakeSysfs, NotHybrid) {
+  EXPECT_TRUE(benchmark::internal::GetCoreTypes(dir_, 2).empty());
+  Write("devices/system/cpu/cpu0/cpu_capacity", "1024");
+  Write("devices/system/cpu/cpu1/cpu_capacity", "1024");
+  EXPECT_TRUE(benchmark::internal::GetCoreTypes(dir_, 2).empty());
+  // The capacity of a CPU is missing.
+  Write("devices/system/cpu/cpu1/cpu_capacity", "512");
+  EXPECT_TRUE(benchmark::internal::GetCoreTypes(dir_, 3).empty());
+}
+
+benchmark::internal::Benchmark::Instance MakeInstance(
+    const std::string& name, const std::string& baseline) {
+  benchmark::internal::Benchmark::Instance instance =
+      benchmark::internal::Benchmark::Instance();
+  instance.name = name;
+  instance.baseline = baseline;
+  return instance;
+}
+
+TEST(ExpandByCoreTypeTest, InterleavesTheTypes) {
+  benchmark::CPUInfo::CoreType core, atom;
+  core.name = "core";
+  core.cpus = {0, 1};
+  atom.name = "atom";
+  atom.cpus = {2, 3};
+  std::vector<benchmark::internal::Benchmark::Instance> benchmarks = {
+      MakeInstance("BM_a/8", ""), MakeInstance("BM_a/64", "BM_a/8")};
+  benchmark::internal::ExpandByCoreType({&core, &atom}, &benchmarks);
+
+  ASSERT_EQ(benchmarks.size(), 4u);
+  EXPECT_EQ(benchmarks[0].name, "BM_a/8/core_type:core");
+  EXPECT_EQ(benchmarks[1].name, "BM_a/8/core_type:atom");
+  EXPECT_EQ(benchmarks[2].name, "BM_a/64/core_type:core");
+  EXPECT_EQ(benchmarks[3].name, "BM_a/64/core_type:atom");
+  EXPECT_EQ(benchmarks[0].core_type, &core);
+  EXPECT_EQ(benchmarks[1].core_type, &atom);
+  EXPECT_EQ(benchmarks[2].core_type, &core);
+  EXPECT_EQ(benchmarks[3].core_type, &atom);
+  // A baseline is compared to on the same core type.
+  EXPECT_EQ(benchmarks[0].baseline, "");
+  EXPECT_EQ(benchmarks[1].baseline, "");
+  EXPECT_EQ(benchmarks[2].baseline, "BM_a/8/core_type:core");
+  EXPECT_EQ(benchmarks[3].baseline, "BM_a/8/core_type:atom");
+}
+
+TEST(ExpandByCoreTypeTest, SingleType) {
+  benchmark::CPUInfo::CoreType atom;
+  atom.name = "atom";
+  std::vector<benchmark::internal::Benchmark::Instance> benchmarks = {
+      MakeInstance("BM_a", ""), MakeInstance("BM_b", "")};
+  benchmark::internal::ExpandByCoreType({&atom}, &benchmarks);
+  ASSERT_EQ(benchmarks.size(), 2u);
+  EXPECT_EQ(benchmarks[0].name, "BM_a/core_type:atom");
+  EXPECT_EQ(benchmarks[1].name, "BM_b/core_type:atom");
+}
+
+}  // end namespace
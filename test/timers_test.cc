@@ -0,0 +1,103 @@
+//===---------------------------------------------------------------------===//
+// timers_test - Unit tests for src/timers.cc and the choice and calibration
+// of the real time clock
+//===---------------------------------------------------------------------===//
+
+#include "../src/sleep.h"
+#include "../src/sysinfo.h"
+#include "../src/timers.h"
+#include "benchmark/benchmark.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+TEST(ParseSchedStatTest, ParsesTheLine) {
+  benchmark::SchedStat stat;
+  ASSERT_TRUE(benchmark::ParseSchedStat("1234567890 2500000 42\n", &stat));
+  EXPECT_DOUBLE_EQ(stat.run_time, 1.23456789);
+  EXPECT_DOUBLE_EQ(stat.wait_time, 0.0025);
+  EXPECT_EQ(stat.timeslices, 42);
+}
+
+TEST(ParseSchedStatTest, RejectsMalformedLines) {
+  benchmark::SchedStat stat;
+  EXPECT_FALSE(benchmark::ParseSchedStat("", &stat));
+  EXPECT_FALSE(benchmark::ParseSchedStat("1234567890 2500000\n", &stat));
+  EXPECT_FALSE(benchmark::ParseSchedStat("run wait slices\n", &stat));
+}
+
+TEST(ChooseTimerBackendTest, ChronoWhenRequested) {
+  EXPECT_EQ(benchmark::ChooseTimerBackend("chrono", true, "hpet", 1e-6, 10e-9),
+            "chrono");
+}
+
+TEST(ChooseTimerBackendTest, TSCMustBeInvariant) {
+  EXPECT_EQ(benchmark::ChooseTimerBackend("auto", false, "hpet", 1e-6, 10e-9),
+            "chrono");
+  EXPECT_EQ(benchmark::ChooseTimerBackend("tsc", false, "tsc", 20e-9, 10e-9),
+            "chrono");
+}
+
+TEST(ChooseTimerBackendTest, AutoPicksTheCheaperClock) {
+  EXPECT_EQ(benchmark::ChooseTimerBackend("auto", true, "tsc", 20e-9, 10e-9),
+            "tsc");
+  EXPECT_EQ(benchmark::ChooseTimerBackend("auto", true, "tsc", 20e-9, 20e-9),
+            "chrono");
+  EXPECT_EQ(benchmark::ChooseTimerBackend("auto", true, "tsc", 20e-9, 30e-9),
+            "chrono");
+}
+
+TEST(ChooseTimerBackendTest, AutoAvoidsASlowClocksource) {
+  EXPECT_TRUE(benchmark::IsSlowClocksource("hpet"));
+  EXPECT_TRUE(benchmark::IsSlowClocksource("acpi_pm"));
+  EXPECT_FALSE(benchmark::IsSlowClocksource("kvm-clock"));
+  EXPECT_EQ(benchmark::ChooseTimerBackend("auto", true, "hpet", 20e-9, 30e-9),
+            "tsc");
+  EXPECT_EQ(
+      benchmark::ChooseTimerBackend("auto", true, "kvm-clock", 20e-9, 30e-9),
+      "chrono");
+}
+
+TEST(ChooseTimerBackendTest, TSCWhenRequested) {
+  EXPECT_EQ(benchmark::ChooseTimerBackend("tsc", true, "tsc", 20e-9, 30e-9),
+            "tsc");
+}
+
+// Measures a sleep with the chrono clock and with the clock picked for real
+// time, which is the time stamp counter where it can be used.
+TEST(RealClockTest, AgreesWithChronoOverASleep) {
+  benchmark::internal::requested_timer = "tsc";
+  const benchmark::TimerInfo& info = benchmark::TimerInfo::Get();
+  EXPECT_TRUE(info.backend == "chrono" || info.backend == "tsc");
+  EXPECT_GT(info.call_overhead, 0);
+
+  const double chrono_start = benchmark::ChronoClockNow();
+  const double real_start = benchmark::RealClockNow();
+  const int64_t stamp = benchmark::Stamp();
+  benchmark::SleepForSeconds(0.05);
+  const double stamped = benchmark::SecondsSinceStamp(stamp);
+  const double real = benchmark::RealClockNow() - real_start;
+  const double chrono = benchmark::ChronoClockNow() - chrono_start;
+
+  EXPECT_GE(chrono, 0.05);
+  EXPECT_NEAR(real, chrono, 0.01 * chrono + 1e-4);
+  EXPECT_NEAR(stamped, chrono, 0.01 * chrono + 1e-4);
+}
+
+// The offsets between the time stamp counters of the CPUs are measured when
+// the time stamp counter is picked, each within a bounded time, so that no
+// stamp has to measure them.
+TEST(RealClockTest, CPUOffsetsAreMeasuredInBoundedTime) {
+  benchmark::internal::requested_timer = "tsc";
+  const int num_cpus = benchmark::CPUInfo::Get().num_cpus;
+  const double start = benchmark::ChronoClockNow();
+  benchmark::TimerInfo::Get();
+  const double elapsed = benchmark::ChronoClockNow() - start;
+  EXPECT_LT(elapsed, 0.2 * num_cpus + 1);
+  const double offsets_start = benchmark::ChronoClockNow();
+  const std::vector<int64_t>& offsets = benchmark::internal::TSCCPUOffsets();
+  EXPECT_LT(benchmark::ChronoClockNow() - offsets_start, 1e-3);
+  EXPECT_TRUE(offsets.empty() || offsets.size() >= 2);
+}
+
+}  // end namespace
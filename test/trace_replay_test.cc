@@ -0,0 +1,131 @@
+
+#include "benchmark/trace.h"
+
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace {
+
+const char* kCSVTrace = "trace_replay_test.csv";
+const char* kBinaryTrace = "trace_replay_test.bin";
+const int kRecords = 100;
+// Time between two records of the traces.
+const uint64_t kGapNs = 10000;
+
+void WriteCSVTrace() {
+  FILE* f = std::fopen(kCSVTrace, "w");
+  assert(f != nullptr);
+  std::fprintf(f, "timestamp,op,key,size\n");
+  for (int i = 0; i < kRecords; ++i) {
+    std::fprintf(f, "%.6f,%s,key%d,%d\n", 1.0 + i * kGapNs * 1e-9,
+                 i % 3 ? "get" : "put", i % 17, i);
+  }
+  std::fclose(f);
+}
+
+// Binary traces are little-endian whatever the host.
+void AppendLittleEndian(std::string* data, uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; ++i)
+    data->push_back(static_cast<char>(value >> (8 * i)));
+}
+
+void WriteBinaryTrace() {
+  std::string data("BMTRACE1", 8);
+  AppendLittleEndian(&data, 2, 4);  // The number of operation names.
+  AppendLittleEndian(&data, 0, 4);
+  AppendLittleEndian(&data, kRecords, 8);
+  data.append("read\0write\0", 11);
+  data.append(5, '\0');
+  for (int i = 0; i < kRecords; ++i) {
+    AppendLittleEndian(&data, static_cast<uint64_t>(i) * kGapNs, 8);
+    AppendLittleEndian(&data, static_cast<uint64_t>(i % 17), 8);
+    AppendLittleEndian(&data, static_cast<uint64_t>(i), 8);
+    AppendLittleEndian(&data, i % 2, 4);
+    AppendLittleEndian(&data, 0, 4);
+  }
+  FILE* f = std::fopen(kBinaryTrace, "wb");
+  assert(f != nullptr);
+  std::fwrite(data.data(), 1, data.size(), f);
+  std::fclose(f);
+}
+
+}  // end namespace
+
+template <benchmark::ReplayMode Mode, bool Binary>
+class KeyedReplay : public benchmark::TraceReplayFixture {
+ public:
+  KeyedReplay() : TraceReplayFixture(Binary ? kBinaryTrace : kCSVTrace, Mode) {
+    const char* ops[] = {"get", "put", "read", "write"};
+    for (const char* op : ops) {
+      Handle(op, [this](const benchmark::TraceRecord& record) {
+        assert(record.size < kRecords);
+        std::lock_guard<std::mutex> l(mu_);
+        // Each key is replayed by a single thread.
+        auto it = owners_.insert(
+            std::make_pair(record.key, thread_index_)).first;
+        assert(it->second == thread_index_);
+        ((void)it);
+      });
+    }
+  }
+
+  void SetUpOnce(benchmark::State& st) {
+    TraceReplayFixture::SetUpOnce(st);
+    owners_.clear();
+  }
+
+  // The threads of each run are new ones.
+  void SetUpThread(benchmark::State& st) {
+    TraceReplayFixture::SetUpThread(st);
+    thread_index_ = st.thread_index;
+  }
+
+  void Run(benchmark::State& st) {
+    const auto start = std::chrono::steady_clock::now();
+    Replay(st);
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    // One thread replays every record at its time.
+    if (Mode == benchmark::kReplayOpenLoop && st.threads == 1) {
+      assert(elapsed.count() >= (st.iterations() - 1) * kGapNs * 1e-9);
+    }
+    ((void)elapsed);
+  }
+
+  std::mutex mu_;
+  std::map<uint64_t, int> owners_;
+  static thread_local int thread_index_;
+};
+
+template <benchmark::ReplayMode Mode, bool Binary>
+thread_local int KeyedReplay<Mode, Binary>::thread_index_ = -1;
+
+BENCHMARK_TEMPLATE_DEFINE_F(KeyedReplay, CSV, benchmark::kReplayAsFastAsPossible,
+                            false)
+(benchmark::State& st) { this->Run(st); }
+BENCHMARK_REGISTER_F(KeyedReplay, CSV)->ThreadRange(1, 4);
+
+BENCHMARK_TEMPLATE_DEFINE_F(KeyedReplay, Binary,
+                            benchmark::kReplayAsFastAsPossible, true)
+(benchmark::State& st) { this->Run(st); }
+BENCHMARK_REGISTER_F(KeyedReplay, Binary)->ThreadRange(1, 4);
+
+BENCHMARK_TEMPLATE_DEFINE_F(KeyedReplay, OpenLoop, benchmark::kReplayOpenLoop,
+                            true)
+(benchmark::State& st) { this->Run(st); }
+BENCHMARK_REGISTER_F(KeyedReplay, OpenLoop)->Threads(1)->Threads(2)
+    ->UseRealTime();
+
+int main(int argc, char* argv[]) {
+  WriteCSVTrace();
+  WriteBinaryTrace();
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  std::remove(kCSVTrace);
+  std::remove(kBinaryTrace);
+}
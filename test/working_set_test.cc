@@ -0,0 +1,80 @@
+//===---------------------------------------------------------------------===//
+// working_set_test - Unit tests for src/working_set.cc
+//===---------------------------------------------------------------------===//
+
+#include <vector>
+
+#include "../src/working_set.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+TEST(DecodePagemapEntryTest, DecodesTheFlags) {
+  benchmark::PagemapEntry page = benchmark::DecodePagemapEntry(0);
+  EXPECT_FALSE(page.present);
+  EXPECT_FALSE(page.soft_dirty);
+  EXPECT_EQ(page.frame, 0u);
+
+  page = benchmark::DecodePagemapEntry(1ull << 63);
+  EXPECT_TRUE(page.present);
+  EXPECT_FALSE(page.soft_dirty);
+
+  page = benchmark::DecodePagemapEntry(1ull << 55);
+  EXPECT_FALSE(page.present);
+  EXPECT_TRUE(page.soft_dirty);
+  EXPECT_EQ(page.frame, 0u);
+}
+
+TEST(DecodePagemapEntryTest, DecodesTheFrame) {
+  // Bits 56 to 62 (exclusively mapped, file page or swapped) are not part of
+  // the frame number.
+  const benchmark::PagemapEntry page =
+      benchmark::DecodePagemapEntry((1ull << 63) | (0x7full << 56) | 0x12345);
+  EXPECT_TRUE(page.present);
+  EXPECT_FALSE(page.soft_dirty);
+  EXPECT_EQ(page.frame, 0x12345u);
+
+  EXPECT_EQ(benchmark::DecodePagemapEntry(~0ull).frame, (1ull << 55) - 1);
+}
+
+TEST(ParseMapsLineTest, ParsesTheRangeAndPermissions) {
+  benchmark::MemoryMapping m;
+  ASSERT_TRUE(benchmark::ParseMapsLine(
+      "7f2c4a000000-7f2c4a021000 rw-p 00000000 00:00 0 ", &m));
+  EXPECT_EQ(m.start, static_cast<uintptr_t>(0x7f2c4a000000ull));
+  EXPECT_EQ(m.end, static_cast<uintptr_t>(0x7f2c4a021000ull));
+  EXPECT_TRUE(m.writable);
+
+  ASSERT_TRUE(benchmark::ParseMapsLine(
+      "55d0c8a00000-55d0c8a02000 r-xp 00000000 08:01 1234 /usr/bin/true", &m));
+  EXPECT_FALSE(m.writable);
+}
+
+TEST(ParseMapsLineTest, SkipsMalformedLinesAndVsyscall) {
+  benchmark::MemoryMapping m;
+  EXPECT_FALSE(benchmark::ParseMapsLine("", &m));
+  EXPECT_FALSE(benchmark::ParseMapsLine("not a mapping", &m));
+  EXPECT_FALSE(benchmark::ParseMapsLine(
+      "ffffffffff600000-ffffffffff601000 --xp 00000000 00:00 0 [vsyscall]",
+      &m));
+}
+
+TEST(WorkingSetTrackerTest, CountsTheWrittenPages) {
+  benchmark::WorkingSetTracker tracker;
+  std::string error;
+  if (!tracker.Start(&error)) {
+    // Soft-dirty tracking is not available everywhere, e.g. in containers
+    // which do not allow writing /proc/self/clear_refs.
+    EXPECT_FALSE(error.empty());
+    return;
+  }
+  const size_t kPages = 64;
+  std::vector<char> buffer(kPages * 4096 * 4);
+  benchmark::WorkingSet ws;
+  ASSERT_TRUE(tracker.Stop(&ws, &error)) << error;
+  ASSERT_GT(ws.page_size, 0u);
+  EXPECT_GE(ws.written_pages * static_cast<int64_t>(ws.page_size),
+            static_cast<int64_t>(buffer.size()));
+}
+
+}  // end namespace
@@ -35,6 +35,14 @@ def check_inputs(in1, in2, flags):
 def create_parser():
     parser = ArgumentParser(
         description='versatile benchmark output compare tool')
+    parser.add_argument(
+        '-m',
+        '--metric',
+        dest='metric',
+        default=None,
+        help=('The metric to compare the benchmarks by: \'time\' or the name '
+              'of a perf event passed to --benchmark_primary_metric. Defaults '
+              'to the primary metric of the baseline'))
     subparsers = parser.add_subparsers(
         help='This tool has multiple modes of operation:',
         dest='mode')
@@ -201,7 +209,8 @@ def main():
             json2_orig, filter_contender, replacement)
 
     # Diff and output
-    output_lines = gbench.report.generate_difference_report(json1, json2)
+    output_lines = gbench.report.generate_difference_report(
+        json1, json2, metric=args.metric)
     print(description)
     for ln in output_lines:
         print(ln)
@@ -224,11 +233,19 @@ class TestParser(unittest.TestCase):
     def test_benchmarks_basic(self):
         parsed = self.parser.parse_args(
             ['benchmarks', self.testInput0, self.testInput1])
+        self.assertIsNone(parsed.metric)
         self.assertEqual(parsed.mode, 'benchmarks')
         self.assertEqual(parsed.test_baseline[0].name, self.testInput0)
         self.assertEqual(parsed.test_contender[0].name, self.testInput1)
         self.assertFalse(parsed.benchmark_options)
 
+    def test_benchmarks_metric(self):
+        parsed = self.parser.parse_args(
+            ['--metric=instructions', 'benchmarks', self.testInput0,
+             self.testInput1])
+        self.assertEqual(parsed.metric, 'instructions')
+        self.assertEqual(parsed.mode, 'benchmarks')
+
     def test_benchmarks_with_remainder(self):
         parsed = self.parser.parse_args(
             ['benchmarks', self.testInput0, self.testInput1, 'd'])
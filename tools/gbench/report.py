@@ -84,11 +84,22 @@ def filter_benchmark(json_orig, family, replacement=""):
     return filtered
 
 
-def generate_difference_report(json1, json2, use_color=True):
+def get_primary_metric(json):
+    """
+    Return the primary metric that the benchmarks in 'json' were run with:
+    either 'time' or the name of a perf event reported as a counter.
+    """
+    return json.get('context', {}).get('primary_metric', 'time')
+
+
+def generate_difference_report(json1, json2, use_color=True, metric=None):
     """
     Calculate and report the difference between each test of two benchmarks
-    runs specified as 'json1' and 'json2'.
+    runs specified as 'json1' and 'json2'. The benchmarks are compared by
+    'metric', which defaults to the primary metric of 'json1'.
     """
+    if metric is None:
+        metric = get_primary_metric(json1)
     first_col_width = find_longest_name(json1['benchmarks'])
     def find_test(name):
         for b in json2['benchmarks']:
@@ -96,6 +107,17 @@ def generate_difference_report(json1, json2, use_color=True):
                 return b
         return None
     first_col_width = max(first_col_width, len('Benchmark'))
+    def get_color(res):
+        if res > 0.05:
+            return BC_FAIL
+        elif res > -0.07:
+            return BC_WHITE
+        else:
+            return BC_CYAN
+    if metric != 'time':
+        return generate_metric_difference_report(
+            json1, json2, use_color, metric, first_col_width, find_test,
+            get_color)
     first_line = "{:<{}s}Time             CPU      Time Old      Time New       CPU Old       CPU New".format(
         'Benchmark', 12 + first_col_width)
     output_strs = [first_line, '-' * len(first_line)]
@@ -109,13 +131,6 @@ def generate_difference_report(json1, json2, use_color=True):
         if bn['time_unit'] != other_bench['time_unit']:
             continue
 
-        def get_color(res):
-            if res > 0.05:
-                return BC_FAIL
-            elif res > -0.07:
-                return BC_WHITE
-            else:
-                return BC_CYAN
         fmt_str = "{}{:<{}s}{endc}{}{:+16.4f}{endc}{}{:+16.4f}{endc}{:14.0f}{:14.0f}{endc}{:14.0f}{:14.0f}"
         tres = calculate_change(bn['real_time'], other_bench['real_time'])
         cpures = calculate_change(bn['cpu_time'], other_bench['cpu_time'])
@@ -127,6 +142,37 @@ def generate_difference_report(json1, json2, use_color=True):
             endc=BC_ENDC)]
     return output_strs
 
+
+def generate_metric_difference_report(json1, json2, use_color, metric,
+                                      first_col_width, find_test, get_color):
+    """
+    Report the difference of the per-iteration count of the perf event
+    'metric' between each test of 'json1' and 'json2', followed by the
+    difference of their real time. Tests without the counter are skipped.
+    """
+    metric_col_width = max(len(metric), 16)
+    first_line = "{:<{}s}{:>{}s}            Time  {:>{}s}  {:>{}s}      Time Old      Time New".format(
+        'Benchmark', first_col_width, metric, metric_col_width + 12,
+        metric + ' Old', metric_col_width, metric + ' New', metric_col_width)
+    output_strs = [first_line, '-' * len(first_line)]
+
+    gen = (bn for bn in json1['benchmarks'] if metric in bn and 'real_time' in bn)
+    for bn in gen:
+        other_bench = find_test(bn['name'])
+        if not other_bench or metric not in other_bench:
+            continue
+        fmt_str = "{}{:<{}s}{endc}{}{:+{}.4f}{endc}{}{:+16.4f}{endc}  {:{}.0f}  {:{}.0f}{:14.0f}{:14.0f}"
+        mres = calculate_change(bn[metric], other_bench[metric])
+        tres = calculate_change(bn['real_time'], other_bench['real_time'])
+        output_strs += [color_format(use_color, fmt_str,
+            BC_HEADER, bn['name'], first_col_width,
+            get_color(mres), mres, metric_col_width + 12,
+            get_color(tres), tres,
+            bn[metric], metric_col_width, other_bench[metric], metric_col_width,
+            bn['real_time'], other_bench['real_time'],
+            endc=BC_ENDC)]
+    return output_strs
+
 ###############################################################################
 # Unit tests
 
@@ -170,6 +216,46 @@ class TestReportDifference(unittest.TestCase):
             self.assertEqual(parts, expect_lines[i])
 
 
+class TestReportDifferenceByMetric(unittest.TestCase):
+    def make_results(self, instructions, real_time):
+        return {
+            'context': {'primary_metric': 'instructions'},
+            'benchmarks': [
+                {'name': 'BM_Fast', 'real_time': real_time[0],
+                 'cpu_time': real_time[0], 'time_unit': 'ns',
+                 'instructions': instructions[0]},
+                {'name': 'BM_Slow', 'real_time': real_time[1],
+                 'cpu_time': real_time[1], 'time_unit': 'ns',
+                 'instructions': instructions[1]},
+                {'name': 'BM_NoCounter', 'real_time': 10, 'cpu_time': 10,
+                 'time_unit': 'ns'},
+            ]
+        }
+
+    def test_basic(self):
+        expect_lines = [
+            ['BM_Fast', '-0.5000', '+0.1000', '200', '100', '10', '11'],
+            ['BM_Slow', '+0.0100', '-0.5000', '1000', '1010', '100', '50'],
+        ]
+        json1 = self.make_results([200, 1000], [10, 100])
+        json2 = self.make_results([100, 1010], [11, 50])
+        output_lines_with_header = generate_difference_report(
+            json1, json2, use_color=False)
+        self.assertIn('instructions', output_lines_with_header[0])
+        output_lines = output_lines_with_header[2:]
+        self.assertEqual(len(output_lines), len(expect_lines))
+        for i in range(0, len(output_lines)):
+            parts = [x for x in output_lines[i].split(' ') if x]
+            self.assertEqual(parts, expect_lines[i])
+
+    def test_time_override(self):
+        json1 = self.make_results([200, 1000], [10, 100])
+        json2 = self.make_results([100, 1010], [11, 50])
+        output_lines = generate_difference_report(
+            json1, json2, use_color=False, metric='time')[2:]
+        self.assertEqual(len(output_lines), 3)
+
+
 class TestReportDifferenceBetweenFamilies(unittest.TestCase):
     def load_result(self):
         import json